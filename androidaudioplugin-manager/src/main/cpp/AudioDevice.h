@@ -5,7 +5,9 @@
 #include "LocalDefinitions.h"
 #include "AudioBuffer.h"
 
+#if ANDROID
 #include <oboe/Oboe.h>
+#endif
 
 namespace aap {
 
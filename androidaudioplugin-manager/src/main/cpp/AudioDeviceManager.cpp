@@ -12,6 +12,13 @@ aap::AudioDeviceManager* aap::AudioDeviceManager::getInstance() {
 
 #else
 
-// implement desktop version?
+#include "VirtualAudioDeviceManager.h"
+
+// There is no platform audio API binding on desktop (yet). Virtual devices can drive the graph by clock.
+aap::VirtualAudioDeviceManager audioDeviceManager{};
+
+aap::AudioDeviceManager* aap::AudioDeviceManager::getInstance() {
+    return &audioDeviceManager;
+}
 
 #endif
@@ -1,14 +1,26 @@
 #include "AudioGraph.h"
+#include <aap/unstable/tracing.h>
+#include <aap/unstable/rt-safety.h>
 #if ANDROID
 #include <android/trace.h>
 #endif
 
+void aap::AudioGraph::beginBlock(int32_t numFrames) {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    block_time_nanoseconds = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    block_frame_position += last_block_frames;
+    last_block_frames = numFrames;
+}
+
 aap::SimpleLinearAudioGraph::~SimpleLinearAudioGraph() {
     for (auto node : nodes)
         node->pause(); // and leave destructors do the job
 }
 
 void aap::SimpleLinearAudioGraph::processAudio(AudioBuffer *audioData, int32_t numFrames) {
+    aap::trace::ScopedTrace trace{"AAP::SimpleLinearAudioGraph_processAudio"};
+    aap::rt::ScopedRealtimeSection realtime{"AAP::SimpleLinearAudioGraph_processAudio"};
     struct timespec timeSpecBegin{}, timeSpecEnd{};
 #if ANDROID
     if (ATrace_isEnabled()) {
@@ -17,9 +29,13 @@ void aap::SimpleLinearAudioGraph::processAudio(AudioBuffer *audioData, int32_t n
     }
 #endif
 
-    for (auto node : nodes)
-        if (!node->shouldSkip())
-            node->processAudio(audioData, numFrames);
+    beginBlock(numFrames);
+    for (auto node : nodes) {
+        if (node->shouldSkip())
+            continue;
+        aap::trace::ScopedTrace nodeTrace{node->getTraceName()};
+        node->processAudio(audioData, numFrames);
+    }
 
 #if ANDROID
     if (ATrace_isEnabled()) {
@@ -33,13 +49,43 @@ void aap::SimpleLinearAudioGraph::processAudio(AudioBuffer *audioData, int32_t n
 }
 
 void aap::SimpleLinearAudioGraph::setPlugin(aap::RemotePluginInstance *instance) {
-    midi_input.setPlugin(instance);
-    plugin.setPlugin(instance);
+    setPlugins(&instance, instance ? 1 : 0);
+}
+
+bool aap::SimpleLinearAudioGraph::setPlugins(aap::RemotePluginInstance **instances, int32_t count) {
+    if (!plugins.setPlugins(instances, count))
+        return false;
+    midi_input.setPlugin(count > 0 ? instances[0] : nullptr);
+    return true;
 }
 
 void
 aap::SimpleLinearAudioGraph::setAudioSource(uint8_t *data, int dataLength, const char *filename) {
-    audio_data.setAudioSource(data, dataLength, filename);
+    if (audio_data.setAudioSource(data, dataLength, filename))
+        updateAudioDataConverter();
+}
+
+bool aap::SimpleLinearAudioGraph::setAudioSourceFile(const char *path) {
+    if (!audio_data.setAudioSourceFile(path))
+        return false;
+    updateAudioDataConverter();
+    return true;
+}
+
+void aap::SimpleLinearAudioGraph::updateAudioDataConverter() {
+    auto sourceSampleRate = audio_data.getSourceSampleRate();
+    if (audio_data_converter && audio_data_converter->getSourceSampleRate() == sourceSampleRate)
+        return;
+    std::unique_ptr<SampleRateConverterNode> converter{nullptr};
+    if (sourceSampleRate != getSampleRate()) {
+        converter = std::make_unique<SampleRateConverterNode>(this, &audio_data, sourceSampleRate,
+                                                              PolyphaseResampler::AAP_RESAMPLER_QUALITY_HIGH);
+        if (is_processing)
+            converter->start();
+    }
+    source_mixer.setInputSource(audio_data_mixer_input, converter ? (AudioGraphNode*) converter.get() : &audio_data);
+    // the mixer does not refer to the previous converter anymore.
+    audio_data_converter = std::move(converter);
 }
 
 void aap::SimpleLinearAudioGraph::addMidiEvent(uint8_t *data, int32_t length, int64_t timestampInNanoseconds) {
@@ -64,6 +110,8 @@ void aap::SimpleLinearAudioGraph::pauseProcessing() {
     is_processing = false;
     for (auto node : nodes)
         node->pause();
+
+    aap::rt::endSession();
 }
 
 aap::SimpleLinearAudioGraph::SimpleLinearAudioGraph(int32_t sampleRate, uint32_t framesPerCallback, int32_t channelsInAudioBus) :
@@ -74,14 +122,23 @@ aap::SimpleLinearAudioGraph::SimpleLinearAudioGraph(int32_t sampleRate, uint32_t
         output(this, AudioDeviceManager::getInstance()->ensureDefaultOutputOpened(sampleRate,
                                                                                   framesPerCallback,
                                                                                   channelsInAudioBus)),
-        plugin(this, nullptr),
+        plugins(this),
         audio_data(this),
         midi_input(this, nullptr, sampleRate, framesPerCallback, CMIDI2_PROTOCOL_TYPE_MIDI2, AAP_PLUGIN_PLAYER_DEFAULT_MIDI_RING_BUFFER_SIZE),
-        midi_output(this, AAP_PLUGIN_PLAYER_DEFAULT_MIDI_RING_BUFFER_SIZE) {
-    nodes.emplace_back(&input);
-    nodes.emplace_back(&audio_data);
+        midi_output(this, AAP_PLUGIN_PLAYER_DEFAULT_MIDI_OUTPUT_RING_EVENTS),
+        recorder(this),
+        source_mixer(this),
+        meter(this) {
+    // the device input and the audio data are mixed (in the order of SimpleLinearAudioGraphSource).
+    source_mixer.addInput(&input);
+    audio_data_mixer_input = source_mixer.addInput(&audio_data);
+    // midi_input has to come first, so that the mixer inputs (e.g. instruments) receive the MIDI input of the same block.
     nodes.emplace_back(&midi_input);
-    nodes.emplace_back(&plugin);
+    nodes.emplace_back(&source_mixer);
+    nodes.emplace_back(&plugins);
+    nodes.emplace_back(&meter);
+    // it has to come before midi_output, which consumes midi_out.
+    nodes.emplace_back(&recorder);
     nodes.emplace_back(&midi_output);
     nodes.emplace_back(&output);
 
@@ -92,6 +149,16 @@ void aap::SimpleLinearAudioGraph::enableAudioRecorder() {
     input.setPermissionGranted();
 }
 
-void aap::SimpleLinearAudioGraph::setPresetIndex(int index) {
-    plugin.setPresetIndex(index);
+void aap::SimpleLinearAudioGraph::setPresetIndex(int32_t pluginIndex, int index) {
+    auto plugin = plugins.getPlugin(pluginIndex);
+    if (plugin)
+        plugin->getStandardExtensions().setCurrentPresetIndex(index);
+}
+
+bool aap::SimpleLinearAudioGraph::startRecording(const char *path, bool recordMidi) {
+    return recorder.startRecording(path, recordMidi);
+}
+
+void aap::SimpleLinearAudioGraph::stopRecording() {
+    recorder.stopRecording();
 }
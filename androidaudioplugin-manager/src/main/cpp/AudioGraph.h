@@ -13,6 +13,9 @@ namespace aap {
         int32_t sample_rate;
         int32_t frames_per_callback;
         int32_t num_channels;
+        int64_t block_time_nanoseconds{0};
+        int64_t block_frame_position{0};
+        int32_t last_block_frames{0};
 
     public:
         explicit AudioGraph(int32_t sampleRate, int32_t framesPerCallback, int32_t channelsInAudioBus) :
@@ -28,18 +31,43 @@ namespace aap {
         int32_t getFramesPerCallback() { return frames_per_callback; }
 
         int32_t getChannelsInAudioBus() { return num_channels; }
+
+        /// The `CLOCK_MONOTONIC` time at which the current block started processing.
+        int64_t getBlockTimeNanoseconds() { return block_time_nanoseconds; }
+
+        /// The frame position of the current block, counted since the graph started processing.
+        int64_t getBlockFramePosition() { return block_frame_position; }
+
+    protected:
+        /// Implementations call it at the beginning of each `processAudio()` to advance the clock.
+        void beginBlock(int32_t numFrames);
+    };
+
+    /// The inputs of the source mixer in `SimpleLinearAudioGraph`, which are mixed before the plugins.
+    enum SimpleLinearAudioGraphSource {
+        AAP_GRAPH_SOURCE_AUDIO_INPUT,
+        AAP_GRAPH_SOURCE_AUDIO_DATA
     };
 
     class SimpleLinearAudioGraph : public AudioGraph {
         AudioDeviceInputNode input;
         AudioDeviceOutputNode output;
-        AudioPluginNode plugin;
+        AudioPluginChainNode plugins;
         AudioDataSourceNode audio_data;
         MidiSourceNode midi_input;
         MidiDestinationNode midi_output;
+        AudioRecorderNode recorder;
+        AudioMixerNode source_mixer;
+        AudioMeterNode meter;
+        // non-null while `audio_data` is at another sample rate than the graph. It is the mixer input instead.
+        std::unique_ptr<SampleRateConverterNode> audio_data_converter{nullptr};
+        int32_t audio_data_mixer_input{-1};
         std::vector<AudioGraphNode*> nodes{};
         bool is_processing{false};
 
+        // (Re)inserts or removes `audio_data_converter` to match the sample rate of the audio data.
+        void updateAudioDataConverter();
+
         static void audio_callback(void* callbackContext, AudioBuffer* audioData, int32_t numFrames) {
             ((SimpleLinearAudioGraph*) callbackContext)->processAudio(audioData, numFrames);
         }
@@ -50,8 +78,27 @@ namespace aap {
 
         void setPlugin(RemotePluginInstance* instance);
 
+        /// Sets the ordered list of plugins to process. MIDI events added via `addMidiEvent()` are
+        /// translated for the first plugin.
+        bool setPlugins(RemotePluginInstance** instances, int32_t count);
+
+        void setPluginBypassed(int32_t index, bool bypassed) { plugins.setBypassed(index, bypassed); }
+
+        void setPluginMidiInputFromPrevious(int32_t index, bool fromPrevious) { plugins.setMidiInputFromPrevious(index, fromPrevious); }
+
         void setAudioSource(uint8_t *data, int dataLength, const char *filename);
 
+        bool setAudioSourceFile(const char *path);
+
+        /// `index` is one of `SimpleLinearAudioGraphSource`. All of them are RT-safe.
+        void setSourceGain(int32_t index, float gain) { source_mixer.setGain(index, gain); }
+
+        void setSourcePan(int32_t index, float pan) { source_mixer.setPan(index, pan); }
+
+        void setSourceMuted(int32_t index, bool muted) { source_mixer.setMuted(index, muted); }
+
+        void setSourceSolo(int32_t index, bool solo) { source_mixer.setSolo(index, solo); }
+
         void processAudio(AudioBuffer *audioData, int32_t numFrames) override;
 
         void addMidiEvent(uint8_t *data, int32_t dataLength, int64_t timestampInNanoseconds);
@@ -66,7 +113,23 @@ namespace aap {
 
         void enableAudioRecorder();
 
-        void setPresetIndex(int index);
+        /// Sets the preset of the plugin at `pluginIndex` in the chain. It does nothing if there is no such plugin.
+        void setPresetIndex(int32_t pluginIndex, int index);
+
+        bool startRecording(const char* path, bool recordMidi);
+
+        void stopRecording();
+
+        int64_t getNumDroppedRecordingBlocks() { return recorder.getNumDroppedBlocks(); }
+
+        int32_t readMidiOutput(MidiOutputEvent* events, int32_t maxEvents) { return midi_output.readEvents(events, maxEvents); }
+
+        int64_t getNumDroppedMidiOutputEvents() { return midi_output.getNumDroppedEvents(); }
+
+        /// Metering of the plugin output (disabled by default).
+        void setMeteringEnabled(bool enabled) { meter.setEnabled(enabled); }
+
+        void getMeterSnapshot(AudioMeterSnapshot& snapshot) { meter.getSnapshot(snapshot); }
     };
 
     // Not planned to implement so far.
@@ -4,7 +4,6 @@
 #include <audio/choc_AudioFileFormat_MP3.h>
 #include <audio/choc_AudioFileFormat_Ogg.h>
 #include <audio/choc_AudioFileFormat_FLAC.h>
-#include <audio/choc_SincInterpolator.h>
 
 
 class SeekableByteBuffer : public std::streambuf {
@@ -25,7 +24,9 @@ public:
 
 aap::AudioDataSourceNode::AudioDataSourceNode(aap::AudioGraph *ownerGraph) :
         AudioGraphNode(ownerGraph),
-        audio_data(std::make_unique<aap::AudioBuffer>(ownerGraph->getChannelsInAudioBus(), ownerGraph->getFramesPerCallback())) {
+        audio_data(std::make_unique<aap::AudioBuffer>(ownerGraph->getChannelsInAudioBus(), ownerGraph->getFramesPerCallback())),
+        num_source_frames((int32_t) audio_data->audio.getNumFrames()),
+        source_sample_rate(ownerGraph->getSampleRate()) {
 }
 
 bool aap::AudioDataSourceNode::shouldSkip() {
@@ -55,18 +56,25 @@ void aap::AudioDataSourceNode::setPlaying(bool newPlayingState) {
 
 int32_t aap::AudioDataSourceNode::read(AudioBuffer *dst, int32_t numFrames) {
 
-    uint32_t size = std::min(audio_data->audio.getNumFrames() - current_frame_offset,
-                             (uint32_t) numFrames);
-    if (size <= 0)
-        return 0;
+    // read only if it is not locked. The source (and its length) may be replaced meanwhile otherwise.
+    if (std::unique_lock<AdaptiveMutex> tryLock(data_source_mutex, std::try_to_lock); tryLock.owns_lock()) {
 
-    if (shouldConsumeButBypass()) {
-        current_frame_offset += size;
-        return size;
-    }
+        auto remaining = getNumFrames() - current_frame_offset;
+        if (remaining <= 0)
+            return 0;
+        uint32_t size = std::min((uint32_t) remaining, (uint32_t) numFrames);
 
-    // read only if it is not locked.
-    if (std::unique_lock<NanoSleepLock> tryLock(data_source_mutex, std::try_to_lock); tryLock.owns_lock()) {
+        if (shouldConsumeButBypass()) {
+            current_frame_offset += (int32_t) size;
+            return size;
+        }
+
+        if (mapped_wav) {
+            // read (and convert if needed) directly from the mapped file, no intermediate copy.
+            size = mapped_wav->readFrames(dst, current_frame_offset, (int32_t) size);
+            current_frame_offset += size;
+            return size;
+        }
 
         choc::buffer::FrameRange range{(uint32_t) current_frame_offset, current_frame_offset + size};
         choc::buffer::copyRemappingChannels(dst->audio.getStart(size),
@@ -78,6 +86,38 @@ int32_t aap::AudioDataSourceNode::read(AudioBuffer *dst, int32_t numFrames) {
         return 0;
 }
 
+// Resamples the entire buffer (at decoding), with silence at the end to flush the resampler.
+static void resampleEntireBuffer(aap::AudioBuffer& dst, aap::AudioBuffer& src, int32_t srcSampleRate, int32_t dstSampleRate) {
+    const int32_t chunkSize = 4096;
+    aap::PolyphaseResampler resampler{srcSampleRate, dstSampleRate, (int32_t) src.audio.getNumChannels(),
+                                      aap::PolyphaseResampler::AAP_RESAMPLER_QUALITY_HIGH, chunkSize};
+    std::vector<float> silence((size_t) resampler.getMaxInputFramesPerCall());
+    auto srcFrames = (int32_t) src.audio.getNumFrames();
+    auto dstFrames = (int32_t) dst.audio.getNumFrames();
+    const float* in[AAP_RESAMPLER_MAX_CHANNELS];
+    float* out[AAP_RESAMPLER_MAX_CHANNELS];
+
+    for (int32_t srcOffset = 0, dstOffset = 0; dstOffset < dstFrames; ) {
+        auto numOut = std::min(chunkSize, dstFrames - dstOffset);
+        auto numIn = resampler.getRequiredInputFrames(numOut);
+        auto available = std::min(numIn, srcFrames - srcOffset);
+        for (int32_t ch = 0; ch < resampler.getNumChannels(); ch++) {
+            in[ch] = src.audio.getChannel(ch).data.data + srcOffset;
+            out[ch] = dst.audio.getChannel(ch).data.data + dstOffset;
+        }
+        auto produced = resampler.process(in, available, out, numOut);
+        if (available < numIn) {
+            for (int32_t ch = 0; ch < resampler.getNumChannels(); ch++) {
+                in[ch] = silence.data();
+                out[ch] += produced;
+            }
+            produced += resampler.process(in, numIn - available, out, numOut - produced);
+        }
+        srcOffset += available;
+        dstOffset += produced;
+    }
+}
+
 choc::audio::WAVAudioFileFormat<false> formatWav{};
 choc::audio::MP3AudioFileFormat formatMp3{};
 choc::audio::OggAudioFileFormat<false> formatOgg{};
@@ -85,7 +125,7 @@ choc::audio::FLACAudioFileFormat<false> formatFlac{};
 choc::audio::AudioFileFormat* formats[] {&formatWav, &formatMp3, &formatOgg, &formatFlac};
 
 bool aap::AudioDataSourceNode::setAudioSource(uint8_t *data, int dataLength, const char *filename) {
-    const std::lock_guard <NanoSleepLock> lock{data_source_mutex};
+    const std::lock_guard <AdaptiveMutex> lock{data_source_mutex};
 
     for (auto format : formats) {
         if (format->filenameSuffixMatches(filename)) {
@@ -103,7 +143,13 @@ bool aap::AudioDataSourceNode::setAudioSource(uint8_t *data, int dataLength, con
             auto durationInSeconds = 1.0 * props.numFrames / props.sampleRate;
             auto targetFrames = (int32_t) (durationInSeconds * graph->getSampleRate());
             audio_data = std::make_unique<AudioBuffer>((int32_t) props.numChannels, targetFrames);
-            choc::interpolation::sincInterpolate(audio_data->audio, tmpData.audio);
+            if ((int32_t) props.sampleRate == graph->getSampleRate())
+                choc::buffer::copyIntersectionAndClearOutside(audio_data->audio, tmpData.audio);
+            else
+                resampleEntireBuffer(*audio_data, tmpData, (int32_t) props.sampleRate, graph->getSampleRate());
+            mapped_wav.reset();
+            num_source_frames.store(targetFrames, std::memory_order_relaxed);
+            source_sample_rate.store(graph->getSampleRate(), std::memory_order_relaxed);
 
             return true;
         }
@@ -112,6 +158,26 @@ bool aap::AudioDataSourceNode::setAudioSource(uint8_t *data, int dataLength, con
     return false;
 }
 
+bool aap::AudioDataSourceNode::setAudioSourceFile(const char *path) {
+    auto file = std::make_unique<MappedWavFile>();
+    if (!file->open(path))
+        return false;
+
+    if (file->isReadable()) {
+        // it is read at its own sample rate; the graph converts it if needed (see getSourceSampleRate()).
+        const std::lock_guard <AdaptiveMutex> lock{data_source_mutex};
+        num_source_frames.store(file->getNumFrames(), std::memory_order_relaxed);
+        source_sample_rate.store(file->getSampleRate(), std::memory_order_relaxed);
+        mapped_wav = std::move(file);
+        current_frame_offset = 0;
+        return true;
+    }
+
+    // Not directly readable (compressed, or unsupported sample format).
+    // The mapping is still useful as the source blob; decoded results are copied into `audio_data`.
+    return setAudioSource(file->getMappedData(), (int) file->getMappedSize(), path);
+}
+
 aap::AudioDataSourceNode::~AudioDataSourceNode() {
     playing = false;
     active = false;
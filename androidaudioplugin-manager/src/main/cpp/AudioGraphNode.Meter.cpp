@@ -0,0 +1,168 @@
+#include "AudioGraphNode.h"
+#include "AudioGraph.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <aap/core/host/audio-kernels.h>
+
+// The meter accumulates intervals of this length, and publishes a snapshot at the end of each.
+#define AAP_METER_INTERVAL_MILLISECONDS 50
+// 300ms, like the usual VU-ish RMS meters.
+#define AAP_METER_RMS_INTERVALS 6
+// 3 seconds, as in the short-term loudness of EBU R 128.
+#define AAP_METER_LOUDNESS_INTERVALS 60
+
+// The K-weighting filter of ITU-R BS.1770 (a high shelf followed by a high pass) at any sample rate.
+// The coefficients are derived in the same way as libebur128 does.
+static void calculateKWeightingFilters(int32_t sampleRate, double* shelf, double* highPass) {
+    double f0 = 1681.974450955533;
+    double g = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / sampleRate);
+    double vh = pow(10.0, g / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    // b0, b1, b2, a1, a2
+    shelf[0] = (vh + vb * k / q + k * k) / a0;
+    shelf[1] = 2.0 * (k * k - vh) / a0;
+    shelf[2] = (vh - vb * k / q + k * k) / a0;
+    shelf[3] = 2.0 * (k * k - 1.0) / a0;
+    shelf[4] = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    highPass[0] = 1.0;
+    highPass[1] = -2.0;
+    highPass[2] = 1.0;
+    highPass[3] = 2.0 * (k * k - 1.0) / a0;
+    highPass[4] = (1.0 - k / q + k * k) / a0;
+}
+
+aap::AudioMeterNode::AudioMeterNode(aap::AudioGraph *ownerGraph) :
+        AudioGraphNode(ownerGraph),
+        num_channels(std::min(ownerGraph->getChannelsInAudioBus(), AAP_MANAGER_MAX_METER_CHANNELS)),
+        interval_frames(ownerGraph->getSampleRate() * AAP_METER_INTERVAL_MILLISECONDS / 1000),
+        rms_history(AAP_METER_RMS_INTERVALS * num_channels),
+        loudness_history(AAP_METER_LOUDNESS_INTERVALS) {
+    calculateKWeightingFilters(ownerGraph->getSampleRate(), shelf_filter, high_pass_filter);
+    reset();
+}
+
+void aap::AudioMeterNode::reset() {
+    memset(filter_states, 0, sizeof(filter_states));
+    std::fill(std::begin(interval_peaks), std::end(interval_peaks), 0.0f);
+    std::fill(std::begin(interval_square_sums), std::end(interval_square_sums), 0.0);
+    interval_weighted_sum = 0;
+    interval_position = 0;
+    std::fill(rms_history.begin(), rms_history.end(), 0.0);
+    std::fill(loudness_history.begin(), loudness_history.end(), 0.0);
+    num_intervals = 0;
+}
+
+void aap::AudioMeterNode::setEnabled(bool enabled) {
+    // the next processAudio() resets the state (on the audio thread), so that stale history does not show up.
+    if (enabled && !is_enabled)
+        reset_requested = true;
+    is_enabled = enabled;
+}
+
+void aap::AudioMeterNode::processAudio(aap::AudioBuffer *audioData, int32_t numFrames) {
+    if (reset_requested.exchange(false))
+        reset();
+
+    // An audio block may span an interval boundary; measure each part separately.
+    for (int32_t offset = 0; offset < numFrames; ) {
+        auto size = std::min(numFrames - offset, interval_frames - interval_position);
+        for (int32_t ch = 0; ch < num_channels; ch++) {
+            auto x = audioData->audio.getChannel(ch).data.data + offset;
+
+            float peak, sumOfSquares;
+            aap::kernels::measurePeakAndSumOfSquares(x, size, peak, sumOfSquares);
+            interval_peaks[ch] = std::max(interval_peaks[ch], peak);
+            interval_square_sums[ch] += sumOfSquares;
+
+            // K-weighting is recursive, so it is not vectorized over time (transposed direct form II).
+            auto z = filter_states[ch];
+            double weighted = 0;
+            for (int32_t i = 0; i < size; i++) {
+                double in = x[i];
+                double s = shelf_filter[0] * in + z[0];
+                z[0] = shelf_filter[1] * in - shelf_filter[3] * s + z[1];
+                z[1] = shelf_filter[2] * in - shelf_filter[4] * s;
+                double h = high_pass_filter[0] * s + z[2];
+                z[2] = high_pass_filter[1] * s - high_pass_filter[3] * h + z[3];
+                z[3] = high_pass_filter[2] * s - high_pass_filter[4] * h;
+                weighted += h * h;
+            }
+            // all channels are weighted 1.0 (i.e. no surround channel weighting).
+            interval_weighted_sum += weighted;
+        }
+        offset += size;
+        interval_position += size;
+        frame_position += size;
+        if (interval_position == interval_frames)
+            completeInterval();
+    }
+}
+
+void aap::AudioMeterNode::completeInterval() {
+    auto rmsSlot = (num_intervals % AAP_METER_RMS_INTERVALS) * num_channels;
+    for (int32_t ch = 0; ch < num_channels; ch++)
+        rms_history[rmsSlot + ch] = interval_square_sums[ch];
+    loudness_history[num_intervals % AAP_METER_LOUDNESS_INTERVALS] = interval_weighted_sum;
+    num_intervals++;
+
+    // Until the windows are filled, average over what is available.
+    auto rmsFrames = (double) std::min(num_intervals, (int64_t) AAP_METER_RMS_INTERVALS) * interval_frames;
+    auto loudnessFrames = (double) std::min(num_intervals, (int64_t) AAP_METER_LOUDNESS_INTERVALS) * interval_frames;
+    double loudnessSum = 0;
+    for (double sum : loudness_history)
+        loudnessSum += sum;
+    double meanSquare = loudnessSum / loudnessFrames;
+    // -0.691 compensates the gain of the K-weighting filter at 1kHz.
+    float loudness = meanSquare > 0 ? (float) (-0.691 + 10 * log10(meanSquare)) : -INFINITY;
+
+    // seqlock: an odd sequence means that the values are being updated.
+    auto sequence = published_sequence.load(std::memory_order_relaxed);
+    published_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    published_frame_position.store(frame_position, std::memory_order_relaxed);
+    for (int32_t ch = 0; ch < num_channels; ch++) {
+        double channelSum = 0;
+        for (int32_t i = 0; i < AAP_METER_RMS_INTERVALS; i++)
+            channelSum += rms_history[i * num_channels + ch];
+        published_peaks[ch].store(interval_peaks[ch], std::memory_order_relaxed);
+        published_rms[ch].store((float) sqrt(channelSum / rmsFrames), std::memory_order_relaxed);
+    }
+    published_loudness.store(loudness, std::memory_order_relaxed);
+
+    published_sequence.store(sequence + 2, std::memory_order_release);
+
+    std::fill(std::begin(interval_peaks), std::end(interval_peaks), 0.0f);
+    std::fill(std::begin(interval_square_sums), std::end(interval_square_sums), 0.0);
+    interval_weighted_sum = 0;
+    interval_position = 0;
+}
+
+void aap::AudioMeterNode::getSnapshot(aap::AudioMeterSnapshot &snapshot) {
+    snapshot.num_channels = num_channels;
+    while (true) {
+        auto before = published_sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        snapshot.frame_position = published_frame_position.load(std::memory_order_relaxed);
+        for (int32_t ch = 0; ch < num_channels; ch++) {
+            snapshot.peak[ch] = published_peaks[ch].load(std::memory_order_relaxed);
+            snapshot.rms[ch] = published_rms[ch].load(std::memory_order_relaxed);
+        }
+        snapshot.short_term_loudness = published_loudness.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (published_sequence.load(std::memory_order_relaxed) == before)
+            return;
+    }
+}
@@ -1,4 +1,13 @@
 #include "AudioGraph.h"
+#include "zix/ring.h"
+#include <algorithm>
+#include <cmath>
+
+// a queued event is this header followed by `length` bytes of UMPs.
+struct QueuedMidiEventHeader {
+    int64_t timestamp_nanoseconds;
+    uint32_t length;
+};
 
 aap::MidiSourceNode::MidiSourceNode(AudioGraph* ownerGraph,
                                     RemotePluginInstance* instance,
@@ -11,84 +20,118 @@ aap::MidiSourceNode::MidiSourceNode(AudioGraph* ownerGraph,
         translator(instance, internalBufferSize, initialMidiProtocol),
         sample_rate(sampleRate),
         aap_frame_size(audioNumFramesPerCallback) {
-    buffer = (uint8_t*) calloc(1, internalBufferSize);
+    queue = zix_ring_new((uint32_t) internalBufferSize);
+    zix_ring_mlock(queue);
+    // every event has at least one UMP (4 bytes).
+    scheduled_events.reserve(internalBufferSize / 4);
+    scheduled_data.resize(internalBufferSize);
+    scheduled_data_swap.resize(internalBufferSize);
 }
 
 aap::MidiSourceNode::~MidiSourceNode() {
-    if (buffer)
-        free(buffer);
+    zix_ring_free(queue);
+}
+
+// Moves the queued events into the (sorted) schedule, resolving their timestamps into frame positions.
+void aap::MidiSourceNode::scheduleQueuedEvents() {
+    auto blockTime = graph->getBlockTimeNanoseconds();
+    auto blockFrame = graph->getBlockFramePosition();
+    QueuedMidiEventHeader header{};
+    while (zix_ring_peek(queue, &header, sizeof(header)) == sizeof(header)) {
+        // if the schedule is full, leave the rest in the queue until the scheduled events are sent.
+        if (scheduled_events.size() == scheduled_events.capacity() ||
+            scheduled_data_size + header.length > scheduled_data.size())
+            break;
+        zix_ring_skip(queue, sizeof(header));
+        zix_ring_read(queue, scheduled_data.data() + scheduled_data_size, header.length);
+
+        // An event that was added during the previous block is sent during this block, at the same
+        // offset (i.e. one callback of constant latency, instead of the jitter of up to one block).
+        auto frame = blockFrame + aap_frame_size +
+                     llround((double) (header.timestamp_nanoseconds - blockTime) * sample_rate / 1000000000.0);
+        ScheduledMidiEvent event{frame, scheduled_data_size, header.length};
+        scheduled_data_size += header.length;
+        // insertion after the events at the same position keeps the order they were added.
+        auto position = std::upper_bound(scheduled_events.begin(), scheduled_events.end(), event,
+                                         [](const ScheduledMidiEvent& a, const ScheduledMidiEvent& b) {
+            return a.frame_position < b.frame_position;
+        });
+        scheduled_events.insert(position, event); // it never reallocates (the capacity is checked above).
+    }
+}
+
+void aap::MidiSourceNode::removeScheduledEvents(int32_t count) {
+    if (count == 0)
+        return;
+    // compact the remaining event data into the other buffer.
+    uint32_t size = 0;
+    for (size_t i = count; i < scheduled_events.size(); i++) {
+        auto& event = scheduled_events[i];
+        memcpy(scheduled_data_swap.data() + size, scheduled_data.data() + event.offset, event.length);
+        event.offset = size;
+        size += event.length;
+    }
+    scheduled_events.erase(scheduled_events.begin(), scheduled_events.begin() + count);
+    std::swap(scheduled_data, scheduled_data_swap);
+    scheduled_data_size = size;
 }
 
 void aap::MidiSourceNode::processAudio(AudioBuffer *audioData, int32_t numFrames) {
+    scheduleQueuedEvents();
+
     auto dstBuffer = (AAPMidiBufferHeader*) audioData->midi_in;
-    // MIDI event might be being added, so we wait a bit using "almost-spin" lock (uses nano-sleep).
-    if (std::unique_lock<NanoSleepLock> tryLock(midi_buffer_mutex, std::try_to_lock); tryLock.owns_lock()) {
-        auto srcBuffer = (AAPMidiBufferHeader*) buffer;
-        if (srcBuffer->length)
-            memcpy(dstBuffer, srcBuffer, sizeof(AAPMidiBufferHeader) + srcBuffer->length);
-        srcBuffer->length = 0;
-    } else {
-        // failed to acquire lock; we do not send anything this time.
-        dstBuffer->length = 0;
+    auto dst8 = (uint8_t*) (dstBuffer + 1);
+    auto maxLength = (uint32_t) (audioData->midi_capacity - sizeof(AAPMidiBufferHeader));
+    auto blockFrame = graph->getBlockFramePosition();
+    uint32_t length = 0;
+    int64_t emittedTicks = 0;
+    int32_t numSent = 0;
+    for (auto& event : scheduled_events) {
+        if (event.frame_position >= blockFrame + numFrames)
+            break;
+        // late events (e.g. added before the graph started) are sent at the beginning of the block.
+        auto frameOffset = std::max((int64_t) 0, event.frame_position - blockFrame);
+        // JR timestamps are deltas; round the accumulated ticks, so that the errors do not accumulate.
+        int64_t ticks = llround((double) frameOffset * AAP_JR_TIMESTAMP_TICKS_PER_SECOND / sample_rate);
+        auto deltaTicks = ticks - emittedTicks;
+        auto numTimestamps = (deltaTicks + AAP_JR_TIMESTAMP_MAX_TICKS - 1) / AAP_JR_TIMESTAMP_MAX_TICKS;
+        if (length + numTimestamps * 4 + event.length > maxLength)
+            break; // send the rest in the next block.
+        for (; deltaTicks > 0; deltaTicks -= AAP_JR_TIMESTAMP_MAX_TICKS, length += 4)
+            *(uint32_t*) (dst8 + length) = cmidi2_ump_jr_timestamp_direct(0,
+                    (uint32_t) std::min(deltaTicks, (int64_t) AAP_JR_TIMESTAMP_MAX_TICKS));
+        emittedTicks = ticks;
+        memcpy(dst8 + length, scheduled_data.data() + event.offset, event.length);
+        length += event.length;
+        numSent++;
     }
+    dstBuffer->length = length;
+    removeScheduledEvents(numSent);
 }
 
 void aap::MidiSourceNode::addMidiEvent(uint8_t *bytes, int32_t length, int64_t timestampInNanoseconds) {
-
-    // This function is invoked every time Kotlin PluginPlayer.addMidiEvent() is invoked, immediately.
-    // On the other hand, AAPs don't process MIDI events immediately (it is handled at `process()`),
-    // so we have to buffer them and flush them to the instrument plugin every time process() is invoked.
-    //
-    // Since we don't really know when it is actually processed but have to accurately
-    // pass delta time for each input events, we assign event timecode from
-    // 1) argument timestampInNanoseconds and 2) actual time passed from previous call to
-    // this function.
-    int64_t actualTimestamp = timestampInNanoseconds;
-    struct timespec curtime{};
-    clock_gettime(CLOCK_REALTIME, &curtime);
-
-    // it is 99.999... percent true since audio loop must have started before any MIDI events...
-    if (last_aap_process_time.tv_sec > 0) {
-        int64_t diff = (curtime.tv_sec - last_aap_process_time.tv_sec) * 1000000000 +
-                       curtime.tv_nsec - last_aap_process_time.tv_nsec;
-        auto nanosecondsPerCycle = (int64_t) (1.0 * aap_frame_size / sample_rate * 1000000000);
-        actualTimestamp = (timestampInNanoseconds + diff) % nanosecondsPerCycle;
+    if (timestampInNanoseconds == 0) {
+        struct timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        timestampInNanoseconds = ts.tv_sec * 1000000000LL + ts.tv_nsec;
     }
 
-    // apply translation at this step (every time event is added, non-RT processing, unlocked)
+    // The lock only serializes producers (the translation buffer and the ring writer);
+    // the audio thread reads the queue without locking.
+    const std::lock_guard <AdaptiveMutex> lock{midi_buffer_mutex};
+
+    // apply translation at this step (every time event is added, non-RT processing)
     size_t translatedLength = translator.translateMidiEvent(bytes, length);
     auto actualData = translatedLength > 0 ? translator.getTranslationBuffer() : bytes;
-    auto actualLength = translatedLength > 0 ? translatedLength : length;
-
-    // update MIDI input buffer with lock
-    { // lock scope
-        auto dst8 = (uint8_t *) buffer;
-        auto dstMBH = (AAPMidiBufferHeader *) dst8;
-        const std::lock_guard <NanoSleepLock> lock{midi_buffer_mutex};
-
-        if (dst8 != nullptr) {
-            uint32_t savedOffset = dstMBH->length;
-            uint32_t currentOffset = savedOffset;
-            int32_t tIter = 0;
-            auto headerSize = sizeof(AAPMidiBufferHeader);
-            for (int64_t ticks = actualTimestamp / (1000000000 / 31250);
-                 ticks > 0; ticks -= 31250, tIter++) {
-                *(int32_t * )(dst8 + headerSize + currentOffset + tIter * 4) =
-                        (int32_t) cmidi2_ump_jr_timestamp_direct(0,
-                                                                 ticks > 31250 ? 31250 : ticks);
-            }
-            currentOffset += tIter * 4;
-            memcpy(dst8 + headerSize + currentOffset, actualData, actualLength);
-            currentOffset += actualLength;
-
-            if (savedOffset != dstMBH->length) {
-                // updated
-                memcpy(dst8 + headerSize, dst8 + headerSize + savedOffset, actualLength);
-                dstMBH->length = currentOffset - savedOffset;
-            } else
-                dstMBH->length = currentOffset;
-        }
+    auto actualLength = (uint32_t) (translatedLength > 0 ? translatedLength : length);
+
+    QueuedMidiEventHeader header{timestampInNanoseconds, actualLength};
+    if (zix_ring_write_space(queue) < sizeof(header) + actualLength) {
+        num_dropped_events++;
+        return;
     }
+    zix_ring_write(queue, &header, sizeof(header));
+    zix_ring_write(queue, actualData, actualLength);
 }
 
 
@@ -101,29 +144,48 @@ void aap::MidiSourceNode::pause() {
 
 //--------
 
-aap::MidiDestinationNode::MidiDestinationNode(AudioGraph* ownerGraph, int32_t internalBufferSize) :
+aap::MidiDestinationNode::MidiDestinationNode(AudioGraph* ownerGraph, int32_t capacityInEvents) :
         AudioGraphNode(ownerGraph) {
-    buffer = (uint8_t*) calloc(1, internalBufferSize);
+    ring = zix_ring_new((uint32_t) (capacityInEvents * sizeof(MidiOutputEvent)));
+    zix_ring_mlock(ring);
 }
 
 aap::MidiDestinationNode::~MidiDestinationNode() {
-    if (buffer)
-        free(buffer);
+    zix_ring_free(ring);
 }
 
 void aap::MidiDestinationNode::processAudio(AudioBuffer *audioData, int32_t numFrames) {
-    // MIDI event might be being consumed, so we wait a bit using "almost-spin" lock (uses nano-sleep).
-    if (std::unique_lock<NanoSleepLock> tryLock(midi_buffer_mutex, std::try_to_lock); tryLock.owns_lock()) {
-        auto srcBuffer = (AAPMidiBufferHeader*) audioData->midi_out;
-        auto dstBuffer = (AAPMidiBufferHeader*) buffer;
-        if (srcBuffer->length) {
-            memcpy(dstBuffer + 1, srcBuffer + 1, srcBuffer->length);
-            dstBuffer->length += srcBuffer->length;
+    auto srcBuffer = (AAPMidiBufferHeader*) audioData->midi_out;
+    auto length = std::min(srcBuffer->length, (uint32_t) (audioData->midi_capacity - sizeof(AAPMidiBufferHeader)));
+    auto srcData = srcBuffer + 1;
+    // the frame offset is computed from the accumulated ticks, so that the rounding errors do not accumulate.
+    int64_t ticks = 0;
+    int32_t frameOffset = 0;
+    CMIDI2_UMP_SEQUENCE_FOREACH(srcData, length, iter) {
+        auto ump = (cmidi2_ump*) iter;
+        if (cmidi2_ump_get_message_type(ump) == CMIDI2_MESSAGE_TYPE_UTILITY &&
+            cmidi2_ump_get_status_code(ump) == CMIDI2_JR_TIMESTAMP) {
+            ticks += cmidi2_ump_get_jr_timestamp_timestamp(ump);
+            frameOffset = (int32_t) (ticks * graph->getSampleRate() / AAP_JR_TIMESTAMP_TICKS_PER_SECOND);
+            continue;
         }
-        srcBuffer->length = 0;
-    } else {
-        // failed to acquire lock; we skip copying and keep source length.
+        MidiOutputEvent event{frame_position + std::min(frameOffset, numFrames - 1),
+                              cmidi2_ump_get_num_bytes(*ump)};
+        memcpy(event.ump, ump, event.length);
+        if (zix_ring_write_space(ring) < sizeof(event))
+            num_dropped_events++;
+        else
+            zix_ring_write(ring, &event, sizeof(event));
     }
+    srcBuffer->length = 0;
+    frame_position += numFrames;
+}
+
+int32_t aap::MidiDestinationNode::readEvents(aap::MidiOutputEvent *events, int32_t maxEvents) {
+    auto available = (int32_t) (zix_ring_read_space(ring) / sizeof(MidiOutputEvent));
+    auto size = std::min(available, maxEvents);
+    zix_ring_read(ring, events, (uint32_t) (size * sizeof(MidiOutputEvent)));
+    return size;
 }
 
 void aap::MidiDestinationNode::start() {
@@ -133,4 +195,3 @@ void aap::MidiDestinationNode::start() {
 void aap::MidiDestinationNode::pause() {
 
 }
-
@@ -0,0 +1,140 @@
+#include "AudioGraphNode.h"
+#include "AudioGraph.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <aap/ext/midi.h>
+#include <aap/core/host/audio-kernels.h>
+
+aap::AudioMixerNode::AudioMixerNode(aap::AudioGraph *ownerGraph) :
+        AudioGraphNode(ownerGraph) {
+}
+
+int32_t aap::AudioMixerNode::addInput(aap::AudioGraphNode *source) {
+    const std::lock_guard<AdaptiveMutex> lock{inputs_mutex};
+    if (num_inputs == AAP_MANAGER_MAX_MIXER_INPUTS)
+        return -1;
+    for (int32_t i = 0; source == nullptr && i < num_inputs; i++)
+        if (inputs[i].source == nullptr)
+            return -1; // there is only one incoming bus.
+
+    auto& input = inputs[num_inputs];
+    input.source = source;
+    if (source)
+        input.buffer = std::make_unique<AudioBuffer>(graph->getChannelsInAudioBus(), graph->getFramesPerCallback());
+    return num_inputs++;
+}
+
+void aap::AudioMixerNode::setInputSource(int32_t index, aap::AudioGraphNode *source) {
+    const std::lock_guard<AdaptiveMutex> lock{inputs_mutex};
+    if (index < 0 || index >= num_inputs || inputs[index].source == nullptr || source == nullptr) {
+        AAP_ASSERT_FALSE;
+        return;
+    }
+    inputs[index].source = source;
+}
+
+void aap::AudioMixerNode::setGain(int32_t index, float gain) {
+    if (index >= 0 && index < num_inputs)
+        inputs[index].gain = gain;
+}
+
+void aap::AudioMixerNode::setPan(int32_t index, float pan) {
+    if (index >= 0 && index < num_inputs)
+        inputs[index].pan = std::max(-1.0f, std::min(1.0f, pan));
+}
+
+void aap::AudioMixerNode::setMuted(int32_t index, bool muted) {
+    if (index >= 0 && index < num_inputs)
+        inputs[index].muted = muted;
+}
+
+void aap::AudioMixerNode::setSolo(int32_t index, bool solo) {
+    if (index >= 0 && index < num_inputs)
+        inputs[index].solo = solo;
+}
+
+void aap::AudioMixerNode::start() {
+    for (int32_t i = 0; i < num_inputs; i++)
+        if (inputs[i].source)
+            inputs[i].source->start();
+}
+
+void aap::AudioMixerNode::pause() {
+    for (int32_t i = 0; i < num_inputs; i++)
+        if (inputs[i].source)
+            inputs[i].source->pause();
+}
+
+// Mixes `input` (whose audio is in `src`) into `audioData`, ramping from the gains of the previous block.
+void aap::AudioMixerNode::mixInput(Input& input, AudioBuffer* src, AudioBuffer* audioData, int32_t numFrames, bool accumulate) {
+    auto numChannels = std::min((int32_t) audioData->audio.getNumChannels(), AAP_MANAGER_MAX_MIXER_CHANNELS);
+    float gain = input.gain;
+    float targets[AAP_MANAGER_MAX_MIXER_CHANNELS];
+    for (int32_t ch = 0; ch < numChannels; ch++)
+        targets[ch] = gain;
+    if (numChannels >= 2) {
+        // constant power panning over the first two channels.
+        float angle = (input.pan + 1) * (float) M_PI / 4;
+        targets[0] = gain * cosf(angle) * (float) M_SQRT2;
+        targets[1] = gain * sinf(angle) * (float) M_SQRT2;
+    }
+
+    for (int32_t ch = 0; ch < numChannels; ch++) {
+        // ramps from the gains of the previous block, so that changes do not click.
+        auto dst = audioData->audio.getChannel(ch).data.data;
+        auto srcChannel = src->audio.getChannel(ch).data.data;
+        if (accumulate)
+            aap::kernels::addWithGainRamp(srcChannel, dst, numFrames, input.current_gains[ch], targets[ch]);
+        else
+            aap::kernels::copyWithGainRamp(srcChannel, dst, numFrames, input.current_gains[ch], targets[ch]);
+        input.current_gains[ch] = targets[ch];
+    }
+}
+
+void aap::AudioMixerNode::processAudio(aap::AudioBuffer *audioData, int32_t numFrames) {
+    std::unique_lock<AdaptiveMutex> tryLock(inputs_mutex, std::try_to_lock);
+    if (!tryLock.owns_lock())
+        return;
+
+    bool anySolo = false;
+    for (int32_t i = 0; i < num_inputs; i++)
+        anySolo |= inputs[i].solo;
+
+    // Inputs that are muted (or not soloed) are neither processed nor mixed.
+    // Their gains restart from zero once they become audible again, so that they fade in.
+    auto isAudible = [&](Input& input) {
+        bool audible = !input.muted && (!anySolo || input.solo) && (!input.source || !input.source->shouldSkip());
+        if (!audible)
+            std::fill(std::begin(input.current_gains), std::end(input.current_gains), 0.0f);
+        return audible;
+    };
+
+    bool mixed = false;
+    // The incoming bus is mixed first, in place, before the other inputs are added to it.
+    for (int32_t i = 0; i < num_inputs; i++) {
+        auto& input = inputs[i];
+        if (input.source == nullptr && isAudible(input)) {
+            mixInput(input, audioData, audioData, numFrames, false);
+            mixed = true;
+        }
+    }
+    for (int32_t i = 0; i < num_inputs; i++) {
+        auto& input = inputs[i];
+        if (input.source == nullptr || !isAudible(input))
+            continue;
+
+        auto buffer = input.buffer.get();
+        buffer->audio.getStart((uint32_t) numFrames).clear();
+        // instruments in the input need the MIDI input to the graph.
+        auto midiIn = (AAPMidiBufferHeader*) audioData->midi_in;
+        memcpy(buffer->midi_in, midiIn, std::min((size_t) audioData->midi_capacity, sizeof(AAPMidiBufferHeader) + midiIn->length));
+        input.source->processAudio(buffer, numFrames);
+
+        mixInput(input, buffer, audioData, numFrames, mixed);
+        mixed = true;
+    }
+
+    if (!mixed)
+        audioData->audio.getStart((uint32_t) numFrames).clear();
+}
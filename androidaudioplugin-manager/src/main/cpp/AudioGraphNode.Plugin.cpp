@@ -10,10 +10,8 @@ bool aap::AudioPluginNode::shouldSkip() {
     return plugin == nullptr;
 }
 
-void aap::AudioPluginNode::processAudio(AudioBuffer *audioData, int32_t numFrames) {
-    if (!plugin)
-        return;
-
+void aap::processPluginInstance(aap::PluginInstance* plugin, aap::AudioBuffer *src, void* midiIn,
+                               aap::AudioBuffer *dst, int32_t numFrames) {
     // Copy input audioData into each plugin's buffer (it is inevitable; each plugin has
     // shared memory between the service and this host, which are not sharable with other plugins
     // in the chain. So, it's optimal enough.)
@@ -27,15 +25,15 @@ void aap::AudioPluginNode::processAudio(AudioBuffer *audioData, int32_t numFrame
         switch (plugin->getPort(i)->getContentType()) {
             case AAP_CONTENT_TYPE_AUDIO:
                 memcpy(aapBuffer->get_buffer(*aapBuffer, i),
-                       audioData->audio.getView().getChannel(currentChannelInAudioData).data.data,
+                       src->audio.getView().getChannel(currentChannelInAudioData).data.data,
                        numFrames * sizeof(float));
                 currentChannelInAudioData++;
                 break;
             case AAP_CONTENT_TYPE_MIDI2: {
-                auto mbh = (AAPMidiBufferHeader*) audioData->midi_in;
+                auto mbh = (AAPMidiBufferHeader*) midiIn;
                 size_t midiSize = std::min((int32_t) (sizeof(AAPMidiBufferHeader) + mbh->length),
-                                           std::min(aapBuffer->get_buffer_size(*aapBuffer, i), audioData->midi_capacity));
-                memcpy(aapBuffer->get_buffer(*aapBuffer, i), (const void *) audioData->midi_in, midiSize);
+                                           std::min(aapBuffer->get_buffer_size(*aapBuffer, i), src->midi_capacity));
+                memcpy(aapBuffer->get_buffer(*aapBuffer, i), (const void *) midiIn, midiSize);
                 break;
             }
             default:
@@ -51,15 +49,15 @@ void aap::AudioPluginNode::processAudio(AudioBuffer *audioData, int32_t numFrame
             continue;
         switch (plugin->getPort(i)->getContentType()) {
             case AAP_CONTENT_TYPE_AUDIO:
-                memcpy(audioData->audio.getView().getChannel(currentChannelInAudioData).data.data,
+                memcpy(dst->audio.getView().getChannel(currentChannelInAudioData).data.data,
                        aapBuffer->get_buffer(*aapBuffer, i),
                        numFrames * sizeof(float));
                 currentChannelInAudioData++;
                 break;
             case AAP_CONTENT_TYPE_MIDI2: {
                 size_t midiSize = std::min(aapBuffer->get_buffer_size(*aapBuffer, i),
-                                           audioData->midi_capacity);
-                memcpy(audioData->midi_out, aapBuffer->get_buffer(*aapBuffer, i), midiSize);
+                                           dst->midi_capacity);
+                memcpy(dst->midi_out, aapBuffer->get_buffer(*aapBuffer, i), midiSize);
                 break;
             }
             default:
@@ -68,6 +66,13 @@ void aap::AudioPluginNode::processAudio(AudioBuffer *audioData, int32_t numFrame
     }
 }
 
+void aap::AudioPluginNode::processAudio(AudioBuffer *audioData, int32_t numFrames) {
+    if (!plugin)
+        return;
+
+    processPluginInstance(plugin, audioData, audioData->midi_in, audioData, numFrames);
+}
+
 void aap::AudioPluginNode::start() {
     if (plugin->getInstanceState() == aap::PluginInstantiationState::PLUGIN_INSTANTIATION_STATE_UNPREPARED)
         plugin->prepare(graph->getFramesPerCallback());
@@ -82,3 +87,107 @@ void aap::AudioPluginNode::setPresetIndex(int32_t index) {
     plugin->getStandardExtensions().setCurrentPresetIndex(index);
 }
 
+
+//--------
+
+aap::AudioPluginChainNode::AudioPluginChainNode(aap::AudioGraph *ownerGraph) :
+        AudioGraphNode(ownerGraph),
+        ping(ownerGraph->getChannelsInAudioBus(), ownerGraph->getFramesPerCallback()),
+        pong(ownerGraph->getChannelsInAudioBus(), ownerGraph->getFramesPerCallback()) {
+}
+
+aap::AudioPluginChainNode::~AudioPluginChainNode() {
+    // The plugins are not disposed here; somewhere that instantiates the plugin should do the job.
+    pause();
+}
+
+bool aap::AudioPluginChainNode::setPlugins(aap::RemotePluginInstance **instances, int32_t count) {
+    if (count > AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH)
+        return false;
+
+    // newly added plugins have to be ready before they are processed.
+    if (active) {
+        for (int32_t i = 0; i < count; i++) {
+            if (instances[i]->getInstanceState() == aap::PluginInstantiationState::PLUGIN_INSTANTIATION_STATE_UNPREPARED)
+                instances[i]->prepare(graph->getFramesPerCallback());
+            instances[i]->activate();
+        }
+    }
+
+    const std::lock_guard<AdaptiveMutex> lock{chain_mutex};
+    for (int32_t i = 0; i < AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH; i++) {
+        entries[i].plugin = i < count ? instances[i] : nullptr;
+        entries[i].bypassed = false;
+        entries[i].midi_from_previous = false;
+    }
+    num_plugins = count;
+    return true;
+}
+
+void aap::AudioPluginChainNode::setBypassed(int32_t index, bool bypassed) {
+    if (index >= 0 && index < AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH)
+        entries[index].bypassed = bypassed;
+}
+
+void aap::AudioPluginChainNode::setMidiInputFromPrevious(int32_t index, bool fromPrevious) {
+    if (index >= 0 && index < AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH)
+        entries[index].midi_from_previous = fromPrevious;
+}
+
+void aap::AudioPluginChainNode::start() {
+    const std::lock_guard<AdaptiveMutex> lock{chain_mutex};
+    for (int32_t i = 0; i < num_plugins; i++) {
+        auto plugin = entries[i].plugin;
+        if (plugin->getInstanceState() == aap::PluginInstantiationState::PLUGIN_INSTANTIATION_STATE_UNPREPARED)
+            plugin->prepare(graph->getFramesPerCallback());
+        plugin->activate();
+    }
+    active = true;
+}
+
+void aap::AudioPluginChainNode::pause() {
+    const std::lock_guard<AdaptiveMutex> lock{chain_mutex};
+    for (int32_t i = 0; i < num_plugins; i++)
+        entries[i].plugin->deactivate();
+    active = false;
+}
+
+bool aap::AudioPluginChainNode::shouldSkip() {
+    return num_plugins == 0;
+}
+
+void aap::AudioPluginChainNode::processAudio(aap::AudioBuffer *audioData, int32_t numFrames) {
+    // Plugins without MIDI output (and bypassed or skipped ones) do not write midi_out, so the MIDI outputs
+    // of the previous block must not remain.
+    for (auto buffer : {audioData, &ping, &pong})
+        if (buffer->midi_out)
+            ((AAPMidiBufferHeader*) buffer->midi_out)->length = 0;
+
+    // The chain is being replaced. Pass the bus through this time.
+    std::unique_lock<AdaptiveMutex> tryLock(chain_mutex, std::try_to_lock);
+    if (!tryLock.owns_lock())
+        return;
+
+    // bypass flags may change at any time; take a snapshot so that the last plugin is consistent.
+    bool bypassed[AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH];
+    int32_t last = -1;
+    for (int32_t i = 0; i < num_plugins; i++) {
+        bypassed[i] = entries[i].bypassed;
+        if (!bypassed[i])
+            last = i;
+    }
+
+    AudioBuffer* src = audioData;
+    void* previousMidiOut = nullptr;
+    int32_t numProcessed = 0;
+    for (int32_t i = 0; i <= last; i++) {
+        if (bypassed[i])
+            continue; // `src` stays as is.
+        auto dst = i == last ? audioData : numProcessed % 2 == 0 ? &ping : &pong;
+        auto midiIn = entries[i].midi_from_previous && previousMidiOut ? previousMidiOut : audioData->midi_in;
+        processPluginInstance(entries[i].plugin, src, midiIn, dst, numFrames);
+        previousMidiOut = dst->midi_out;
+        src = dst;
+        numProcessed++;
+    }
+}
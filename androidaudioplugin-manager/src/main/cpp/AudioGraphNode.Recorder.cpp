@@ -0,0 +1,171 @@
+#include "AudioGraphNode.h"
+#include "AudioGraph.h"
+#include "zix/ring.h"
+#include <string>
+#include <sys/resource.h>
+#include <aap/ext/midi.h>
+#include <aap/unstable/logging.h>
+
+// The writer accumulates this many seconds of audio before each write to the file.
+#define AAP_RECORDER_WRITE_CHUNK_SECONDS 1
+#define AAP_RECORDER_WRITER_POLL_MILLISECONDS 10
+#define AAP_RECORDER_MIDI_DIRECTION_IN 0
+#define AAP_RECORDER_MIDI_DIRECTION_OUT 1
+
+struct RecorderBlockHeader {
+    int64_t frame_position;
+    int32_t num_frames;
+    int32_t num_channels;
+    uint32_t midi_in_length;
+    uint32_t midi_out_length;
+};
+
+static inline uint32_t blockSize(const RecorderBlockHeader& header) {
+    return sizeof(RecorderBlockHeader) + header.num_channels * header.num_frames * sizeof(float)
+        + header.midi_in_length + header.midi_out_length;
+}
+
+aap::AudioRecorderNode::AudioRecorderNode(aap::AudioGraph *ownerGraph, int32_t ringBufferSizeInSeconds) :
+        AudioGraphNode(ownerGraph) {
+    auto audioBytesPerSecond = ownerGraph->getSampleRate() * ownerGraph->getChannelsInAudioBus() * sizeof(float);
+    // make sure that a block with full MIDI buffers fits, even if it is very unlikely.
+    auto size = audioBytesPerSecond * ringBufferSizeInSeconds + AAP_MANAGER_MIDI_BUFFER_SIZE * 2;
+    ring = zix_ring_new((uint32_t) size);
+    zix_ring_mlock(ring);
+}
+
+aap::AudioRecorderNode::~AudioRecorderNode() {
+    stopRecording();
+    zix_ring_free(ring);
+}
+
+void aap::AudioRecorderNode::processAudio(aap::AudioBuffer *audioData, int32_t numFrames) {
+    // stopRecording() waits for this flag, so that the ring is not written after the writer has finished.
+    in_audio_thread = true;
+    if (recording) {
+        RecorderBlockHeader header{frame_position, numFrames, (int32_t) audioData->audio.getNumChannels(), 0, 0};
+        auto midiIn = (AAPMidiBufferHeader*) audioData->midi_in;
+        auto midiOut = (AAPMidiBufferHeader*) audioData->midi_out;
+        auto maxMidiLength = (uint32_t) (audioData->midi_capacity - sizeof(AAPMidiBufferHeader));
+        if (record_midi) {
+            header.midi_in_length = std::min(midiIn->length, maxMidiLength);
+            header.midi_out_length = std::min(midiOut->length, maxMidiLength);
+        }
+
+        if (zix_ring_write_space(ring) < blockSize(header))
+            num_dropped_blocks++;
+        else {
+            zix_ring_write(ring, &header, sizeof(header));
+            for (int32_t ch = 0; ch < header.num_channels; ch++)
+                zix_ring_write(ring, audioData->audio.getChannel(ch).data.data, numFrames * sizeof(float));
+            if (header.midi_in_length)
+                zix_ring_write(ring, midiIn + 1, header.midi_in_length);
+            if (header.midi_out_length)
+                zix_ring_write(ring, midiOut + 1, header.midi_out_length);
+        }
+        frame_position += numFrames;
+    }
+    in_audio_thread = false;
+}
+
+bool aap::AudioRecorderNode::startRecording(const char *path, bool recordMidi) {
+    stopRecording();
+
+    auto chunkFrames = graph->getSampleRate() * AAP_RECORDER_WRITE_CHUNK_SECONDS;
+    if (!wav_writer.open(path, graph->getSampleRate(), graph->getChannelsInAudioBus(), chunkFrames))
+        return false;
+    if (recordMidi) {
+        auto midiPath = std::string{path} + ".ump";
+        midi_file = fopen(midiPath.c_str(), "wb");
+        if (!midi_file)
+            aap::a_log_f(AAP_LOG_LEVEL_WARN, AAP_MANAGER_LOG_TAG,
+                         "AudioRecorderNode: could not open %s; MIDI is not recorded.", midiPath.c_str());
+    }
+
+    zix_ring_reset(ring);
+    frame_position = 0;
+    num_dropped_blocks = 0;
+    record_midi = midi_file != nullptr;
+
+    writer_running = true;
+    writer_thread = std::thread([this] { runWriter(); });
+    recording = true;
+    return true;
+}
+
+void aap::AudioRecorderNode::stopRecording() {
+    if (!writer_thread.joinable())
+        return;
+
+    recording = false;
+    // wait for the block that might be being written. It takes (much) less than a block.
+    while (in_audio_thread)
+        std::this_thread::yield();
+
+    writer_running = false;
+    writer_thread.join();
+
+    wav_writer.close();
+    if (midi_file) {
+        fclose(midi_file);
+        midi_file = nullptr;
+    }
+    if (num_dropped_blocks > 0)
+        aap::a_log_f(AAP_LOG_LEVEL_WARN, AAP_MANAGER_LOG_TAG,
+                     "AudioRecorderNode: %lld blocks were dropped during recording.", (long long) num_dropped_blocks.load());
+}
+
+void aap::AudioRecorderNode::runWriter() {
+    // it must never get in the way of the audio thread. On Linux (and Android) it applies to this thread only.
+    setpriority(PRIO_PROCESS, 0, 10);
+
+    auto chunkFrames = graph->getSampleRate() * AAP_RECORDER_WRITE_CHUNK_SECONDS;
+    AudioBuffer chunk{graph->getChannelsInAudioBus(), chunkFrames};
+    std::vector<uint8_t> midi(AAP_MANAGER_MIDI_BUFFER_SIZE);
+    int32_t chunkFilled = 0;
+
+    while (true) {
+        // check it before looking at the ring, so that the ring is fully drained once it turns false.
+        bool running = writer_running;
+
+        RecorderBlockHeader header{};
+        if (zix_ring_peek(ring, &header, sizeof(header)) < sizeof(header) ||
+            zix_ring_read_space(ring) < blockSize(header)) {
+            if (!running)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(AAP_RECORDER_WRITER_POLL_MILLISECONDS));
+            continue;
+        }
+        zix_ring_skip(ring, sizeof(header));
+
+        if (chunkFilled + header.num_frames > chunkFrames) {
+            wav_writer.write(&chunk, chunkFilled);
+            chunkFilled = 0;
+        }
+        for (int32_t ch = 0; ch < header.num_channels; ch++) {
+            auto size = (uint32_t) (header.num_frames * sizeof(float));
+            if (ch < (int32_t) chunk.audio.getNumChannels())
+                zix_ring_read(ring, chunk.audio.getChannel(ch).data.data + chunkFilled, size);
+            else
+                zix_ring_skip(ring, size);
+        }
+        chunkFilled += header.num_frames;
+
+        uint32_t lengths[] {header.midi_in_length, header.midi_out_length};
+        for (uint8_t direction : {AAP_RECORDER_MIDI_DIRECTION_IN, AAP_RECORDER_MIDI_DIRECTION_OUT}) {
+            auto length = lengths[direction];
+            if (length == 0)
+                continue;
+            zix_ring_read(ring, midi.data(), length);
+            if (midi_file) {
+                fwrite(&header.frame_position, sizeof(header.frame_position), 1, midi_file);
+                fwrite(&direction, sizeof(direction), 1, midi_file);
+                fwrite(&length, sizeof(length), 1, midi_file);
+                fwrite(midi.data(), 1, length, midi_file);
+            }
+        }
+    }
+
+    if (chunkFilled > 0)
+        wav_writer.write(&chunk, chunkFilled);
+}
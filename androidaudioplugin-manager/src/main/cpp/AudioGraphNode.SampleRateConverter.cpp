@@ -0,0 +1,48 @@
+#include "AudioGraphNode.h"
+#include "AudioGraph.h"
+
+aap::SampleRateConverterNode::SampleRateConverterNode(aap::AudioGraph *ownerGraph,
+                                                      aap::AudioGraphNode *sourceNode,
+                                                      int32_t sourceSampleRate,
+                                                      PolyphaseResampler::Quality quality) :
+        AudioGraphNode(ownerGraph),
+        source(sourceNode),
+        resampler(sourceSampleRate, ownerGraph->getSampleRate(), ownerGraph->getChannelsInAudioBus(),
+                  quality, ownerGraph->getFramesPerCallback()),
+        source_buffer(ownerGraph->getChannelsInAudioBus(), resampler.getMaxInputFramesPerCall()) {
+}
+
+void aap::SampleRateConverterNode::start() {
+    resampler.reset();
+    remaining_tail_frames = 0;
+    source->start();
+}
+
+void aap::SampleRateConverterNode::pause() {
+    source->pause();
+}
+
+bool aap::SampleRateConverterNode::shouldSkip() {
+    return remaining_tail_frames <= 0 && source->shouldSkip();
+}
+
+void aap::SampleRateConverterNode::processAudio(aap::AudioBuffer *audioData, int32_t numFrames) {
+    auto numSourceFrames = std::min(resampler.getRequiredInputFrames(numFrames), getMaxSourceFramesPerCall());
+
+    // a skipped source still has to advance the resampler, with silence, until its tail is flushed.
+    source_buffer.audio.getStart((uint32_t) numSourceFrames).clear();
+    if (!source->shouldSkip()) {
+        source->processAudio(&source_buffer, numSourceFrames);
+        remaining_tail_frames = resampler.getLookaheadFrames();
+    } else
+        remaining_tail_frames -= numSourceFrames;
+
+    const float* in[AAP_RESAMPLER_MAX_CHANNELS];
+    float* out[AAP_RESAMPLER_MAX_CHANNELS];
+    // both sides are on the graph audio bus, so they have the same number of channels.
+    for (int32_t ch = 0; ch < resampler.getNumChannels(); ch++) {
+        in[ch] = source_buffer.audio.getChannel(ch).data.data;
+        out[ch] = audioData->audio.getChannel(ch).data.data;
+    }
+    resampler.process(in, numSourceFrames, out, numFrames);
+}
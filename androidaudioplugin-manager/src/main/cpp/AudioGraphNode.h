@@ -3,12 +3,21 @@
 
 #include "AudioDevice.h"
 #include "AAPMidiEventTranslator.h"
+#include "MappedWavFile.h"
+#include "PolyphaseResampler.h"
+#include "WavFileWriter.h"
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <thread>
 #include <aap/core/host/plugin-instance.h>
 #include <aap/unstable/utility.h>
 #ifndef CMIDI2_H_INCLUDED // it is only a workaround to avoid reference resolution failure at aap-juce-* repos.
 #include <cmidi2.h>
 #endif
 
+typedef struct ZixRingImpl ZixRing;
+
 namespace aap {
     class AudioGraph;
 
@@ -25,6 +34,8 @@ namespace aap {
         virtual void start() = 0;
         virtual void pause() = 0;
         virtual void processAudio(AudioBuffer* audioData, int32_t numFrames) = 0;
+        /// The name that identifies the node in traces. It must be a string literal (see aap/unstable/tracing.h).
+        virtual const char* getTraceName() = 0;
     };
 
     /**
@@ -57,6 +68,7 @@ namespace aap {
         void start() override;
         void pause() override;
         void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::AudioDeviceInputNode"; }
 
         void setPermissionGranted();
     };
@@ -88,8 +100,14 @@ namespace aap {
         void start() override;
         void pause() override;
         void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::AudioDeviceOutputNode"; }
     };
 
+    /// Processes `plugin` with audio from `src` and MIDI from `midiIn`, and writes its outputs to `dst`.
+    /// `src` and `dst` may be the same buffer.
+    void processPluginInstance(PluginInstance* plugin, AudioBuffer *src, void* midiIn,
+                               AudioBuffer *dst, int32_t numFrames);
+
     class AudioPluginNode : public AudioGraphNode {
         RemotePluginInstance* plugin;
 
@@ -106,19 +124,77 @@ namespace aap {
         void pause() override;
         bool shouldSkip() override;
         void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::AudioPluginNode"; }
 
         // FIXME: this should be generalized to invoke arbitrary extension functions.
         void setPresetIndex(int index);
     };
 
+    /**
+     * AudioPluginChainNode processes the audio bus through an ordered list of plugins
+     * (e.g. an instrument followed by effects).
+     *
+     * Each plugin reads the output of the previous (non-bypassed) plugin and writes to one of two
+     * ping-pong buffers, so there is no allocation or extra copy between plugins. The last active
+     * plugin writes directly into the graph bus. Bypassing a plugin only skips it (the next one
+     * reads from the same buffer), so the chain with everything bypassed passes the bus through.
+     *
+     * Each plugin receives the MIDI input of the graph by default. It can instead receive the MIDI
+     * output of the previous plugin (`setMidiInputFromPrevious()`), e.g. after a MIDI effect.
+     */
+    class AudioPluginChainNode : public AudioGraphNode {
+        struct Entry {
+            RemotePluginInstance* plugin{nullptr};
+            std::atomic<bool> bypassed{false};
+            std::atomic<bool> midi_from_previous{false};
+        };
+        std::array<Entry, AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH> entries{};
+        int32_t num_plugins{0};
+        AudioBuffer ping;
+        AudioBuffer pong;
+        AdaptiveMutex chain_mutex{};
+        bool active{false};
+
+    public:
+        explicit AudioPluginChainNode(AudioGraph* ownerGraph);
+        ~AudioPluginChainNode() override;
+
+        /// Replaces the chain. Returns false if `count` exceeds AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH.
+        /// Bypass and MIDI routing states are reset. Plugins that were removed from the chain are
+        /// not deactivated (the owner of the instances should do it).
+        bool setPlugins(RemotePluginInstance** instances, int32_t count);
+        int32_t getNumPlugins() { return num_plugins; }
+        RemotePluginInstance* getPlugin(int32_t index) { return index >= 0 && index < num_plugins ? entries[index].plugin : nullptr; }
+
+        /// RT-safe; it can be switched while processing.
+        void setBypassed(int32_t index, bool bypassed);
+        /// RT-safe; it can be switched while processing.
+        void setMidiInputFromPrevious(int32_t index, bool fromPrevious);
+
+        void start() override;
+        void pause() override;
+        bool shouldSkip() override;
+        void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::AudioPluginChainNode"; }
+    };
+
     class AudioDataSourceNode : public AudioGraphNode {
         bool active{false};
         bool playing{false};
         std::unique_ptr<AudioBuffer> audio_data{nullptr};
-        NanoSleepLock data_source_mutex{};
-
+        // non-null when the source is a memory-mapped WAV file that is read in place.
+        std::unique_ptr<MappedWavFile> mapped_wav{nullptr};
+        AdaptiveMutex data_source_mutex{};
+        // the frames in `mapped_wav` or `audio_data`, whichever is the source, and its sample rate. They are
+        // updated along with the source under `data_source_mutex`, so that they can be read without locking.
+        std::atomic<int32_t> num_source_frames{0};
+        std::atomic<int32_t> source_sample_rate{0};
+
+        // in the source frames
         int32_t current_frame_offset{0};
 
+        int32_t getNumFrames() { return num_source_frames.load(std::memory_order_relaxed); }
+
     public:
         explicit AudioDataSourceNode(AudioGraph* ownerGraph);
         ~AudioDataSourceNode() override;
@@ -128,8 +204,14 @@ namespace aap {
         bool shouldSkip() override;
         virtual bool shouldConsumeButBypass() { return playing && !active; }
         void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::AudioDataSourceNode"; }
 
-        bool hasData() { return audio_data != nullptr && current_frame_offset < audio_data->audio.getNumFrames(); };
+        bool hasData() { return current_frame_offset < getNumFrames(); };
+
+        /// The sample rate that `read()` outputs at. It differs from the graph sample rate only if the source
+        /// is a WAV file at another sample rate that is read in place; then the graph reads this node through
+        /// a SampleRateConverterNode.
+        int32_t getSourceSampleRate() { return source_sample_rate.load(std::memory_order_relaxed); }
 
         void setPlaying(bool newPlayingState);
 
@@ -143,20 +225,256 @@ namespace aap {
         ///
         /// It locks the data source until it finishes loading and converting data into `audio_data`.
         bool setAudioSource(uint8_t *data, int dataLength, const char *filename);
+
+        /// Sets an audio file at `path` as the source.
+        ///
+        /// If it is an uncompressed WAV file, the file is `mmap()`-ed and read in place at each
+        /// `processAudio()` (converted per block unless it is 32-bit float, at its own sample rate;
+        /// see `getSourceSampleRate()`), without decoding the entire file beforehand.
+        /// Otherwise the mapped bytes are passed to `setAudioSource()` to be decoded and resampled.
+        /// Returns true if loaded successfully, false if not.
+        bool setAudioSourceFile(const char *path);
+    };
+
+    /**
+     * SampleRateConverterNode pulls audio from its `source` node that runs at another sample rate,
+     * and outputs it at the graph sample rate.
+     *
+     * At each `processAudio()` it asks the source for as many frames as the resampler needs to fill
+     * `numFrames` (which varies per call unless the ratio is integral), so the source node must
+     * accept arbitrary frame counts up to `getMaxSourceFramesPerCall()`.
+     * When the source stops producing (i.e. it is skipped), the converter keeps running on silence
+     * until the resampler lookahead is flushed, so that the end of the source is not cut off.
+     * The source node is not owned by this node.
+     */
+    class SampleRateConverterNode : public AudioGraphNode {
+        AudioGraphNode* source;
+        PolyphaseResampler resampler;
+        AudioBuffer source_buffer;
+        // the silent source frames still to be fed after the source was skipped.
+        int32_t remaining_tail_frames{0};
+
+    public:
+        SampleRateConverterNode(AudioGraph* ownerGraph,
+                                AudioGraphNode* sourceNode,
+                                int32_t sourceSampleRate,
+                                PolyphaseResampler::Quality quality = PolyphaseResampler::AAP_RESAMPLER_QUALITY_MEDIUM);
+
+        int32_t getSourceSampleRate() { return resampler.getInputSampleRate(); }
+        int32_t getMaxSourceFramesPerCall() { return (int32_t) source_buffer.audio.getNumFrames(); }
+
+        void start() override;
+        void pause() override;
+        bool shouldSkip() override;
+        void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::SampleRateConverterNode"; }
     };
 
 
+    /**
+     * AudioMixerNode sums up to AAP_MANAGER_MAX_MIXER_INPUTS input buses into the graph bus,
+     * with per-input gain, pan, mute and solo.
+     *
+     * Each input is either another node (not owned by this node), which is processed into a buffer
+     * of its own with the MIDI input of the graph, or the incoming graph bus itself (`nullptr`).
+     * Gain and (constant power) pan changes are applied as linear ramps over the next block, so that
+     * they do not click. Muted inputs, and inputs that are not soloed while any other input is, are
+     * not processed at all. If no input is audible, the bus is cleared.
+     */
+    class AudioMixerNode : public AudioGraphNode {
+        struct Input {
+            AudioGraphNode* source{nullptr};
+            std::unique_ptr<AudioBuffer> buffer{nullptr};
+            std::atomic<float> gain{1};
+            std::atomic<float> pan{0};
+            std::atomic<bool> muted{false};
+            std::atomic<bool> solo{false};
+            // the per-channel gains at the end of the last processed block (only for the audio thread).
+            float current_gains[AAP_MANAGER_MAX_MIXER_CHANNELS]{};
+        };
+        std::array<Input, AAP_MANAGER_MAX_MIXER_INPUTS> inputs{};
+        int32_t num_inputs{0};
+        AdaptiveMutex inputs_mutex{};
+
+        void mixInput(Input& input, AudioBuffer* src, AudioBuffer* audioData, int32_t numFrames, bool accumulate);
+
+    public:
+        explicit AudioMixerNode(AudioGraph* ownerGraph);
+
+        /// Adds an input and returns its index, or -1 if there is no more room (or `source` is
+        /// `nullptr` and the graph bus is already an input). It allocates the input buffer.
+        int32_t addInput(AudioGraphNode* source);
+        int32_t getNumInputs() { return num_inputs; }
+        /// Replaces the node of the input at `index` (which must not be the graph bus). The previous node can
+        /// be released once it returns.
+        void setInputSource(int32_t index, AudioGraphNode* source);
+
+        /// RT-safe; linear gain (1 = unity).
+        void setGain(int32_t index, float gain);
+        /// RT-safe; -1 (left) to 1 (right). It applies to the first two channels.
+        void setPan(int32_t index, float pan);
+        /// RT-safe.
+        void setMuted(int32_t index, bool muted);
+        /// RT-safe.
+        void setSolo(int32_t index, bool solo);
+
+        void start() override;
+        void pause() override;
+        void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::AudioMixerNode"; }
+    };
+
+    struct AudioMeterSnapshot {
+        int32_t num_channels;
+        /// the number of frames measured since the meter was enabled, at the end of the snapshot interval.
+        int64_t frame_position;
+        /// linear, within the last 50 milliseconds.
+        float peak[AAP_MANAGER_MAX_METER_CHANNELS];
+        /// linear, over the last 300 milliseconds.
+        float rms[AAP_MANAGER_MAX_METER_CHANNELS];
+        /// LUFS over the last 3 seconds, of all channels (ITU-R BS.1770 K-weighting, without channel weights).
+        float short_term_loudness;
+    };
+
+    /**
+     * AudioMeterNode measures the audio bus (without modifying it): per-channel peak and RMS levels,
+     * and the short-term loudness.
+     *
+     * The results are published every 50 milliseconds as a seqlock-protected snapshot, so that a UI
+     * thread can poll `getSnapshot()` at any rate without locks and without copying the audio.
+     */
+    class AudioMeterNode : public AudioGraphNode {
+        int32_t num_channels;
+        int32_t interval_frames;
+        std::atomic<bool> is_enabled{false};
+        std::atomic<bool> reset_requested{false};
+
+        // b0, b1, b2, a1, a2
+        double shelf_filter[5]{};
+        double high_pass_filter[5]{};
+
+        // audio thread only
+        double filter_states[AAP_MANAGER_MAX_METER_CHANNELS][4]{};
+        float interval_peaks[AAP_MANAGER_MAX_METER_CHANNELS]{};
+        double interval_square_sums[AAP_MANAGER_MAX_METER_CHANNELS]{};
+        double interval_weighted_sum{0};
+        int32_t interval_position{0};
+        int64_t frame_position{0};
+        // ring buffers of the per-interval sums
+        std::vector<double> rms_history;
+        std::vector<double> loudness_history;
+        int64_t num_intervals{0};
+
+        std::atomic<uint32_t> published_sequence{0};
+        std::atomic<int64_t> published_frame_position{0};
+        std::array<std::atomic<float>, AAP_MANAGER_MAX_METER_CHANNELS> published_peaks{};
+        std::array<std::atomic<float>, AAP_MANAGER_MAX_METER_CHANNELS> published_rms{};
+        std::atomic<float> published_loudness{-INFINITY};
+
+        void reset();
+        void completeInterval();
+
+    public:
+        explicit AudioMeterNode(AudioGraph* ownerGraph);
+
+        /// It is disabled by default. Enabling it restarts the measurement.
+        void setEnabled(bool enabled);
+
+        /// Copies the latest published values. It never blocks the audio thread. RT-safe.
+        void getSnapshot(AudioMeterSnapshot& snapshot);
+
+        void start() override {}
+        void pause() override {}
+        bool shouldSkip() override { return !is_enabled; }
+        void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::AudioMeterNode"; }
+    };
+
+    /**
+     * AudioRecorderNode captures the audio bus (and optionally the MIDI2 buffers) at its position
+     * in the graph into a file, e.g. to "bounce" the plugin output for debugging.
+     *
+     * At `processAudio()` it only copies the block into a preallocated lock-free ring (it never
+     * blocks on I/O). A low-priority writer thread drains the ring into a 32-bit float WAV file in
+     * large sequential writes. When the writer falls behind and the ring is full, the block is
+     * dropped and counted (`getNumDroppedBlocks()`).
+     *
+     * When MIDI recording is enabled, the `midi_in` and `midi_out` UMP streams are written to
+     * `<path>.ump`, as a sequence of records:
+     * `int64_t framePosition, uint8_t direction (0 = in, 1 = out), uint32_t length, uint8_t ump[length]`
+     * (in host byte order).
+     */
+    class AudioRecorderNode : public AudioGraphNode {
+        ZixRing* ring{nullptr};
+        std::atomic<bool> recording{false};
+        std::atomic<bool> in_audio_thread{false};
+        bool record_midi{false};
+        int64_t frame_position{0};
+        std::atomic<int64_t> num_dropped_blocks{0};
+
+        std::thread writer_thread{};
+        std::atomic<bool> writer_running{false};
+        WavFileWriter wav_writer{};
+        FILE* midi_file{nullptr};
+
+        void runWriter();
+
+    public:
+        explicit AudioRecorderNode(AudioGraph* ownerGraph, int32_t ringBufferSizeInSeconds = 2);
+        ~AudioRecorderNode() override;
+
+        /// Starts recording into the WAV file at `path` (and `<path>.ump` if `recordMidi` is true).
+        /// It must not be called from the audio thread.
+        bool startRecording(const char* path, bool recordMidi);
+        /// Stops recording, waits for the writer thread to drain the ring, and closes the files.
+        void stopRecording();
+        bool isRecording() { return recording; }
+
+        /// The number of blocks dropped since the last `startRecording()`.
+        int64_t getNumDroppedBlocks() { return num_dropped_blocks; }
+
+        void start() override {}
+        void pause() override {}
+        bool shouldSkip() override { return !recording; }
+        void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::AudioRecorderNode"; }
+    };
+
+    /**
+     * MidiSourceNode sends the MIDI events added by `addMidiEvent()` to the plugin, sample accurately.
+     *
+     * Each event is stamped with the `CLOCK_MONOTONIC` time and queued in a lock-free ring (producers
+     * are serialized by a lock, but the audio thread never waits for it). At each block, the audio
+     * thread maps the queued timestamps to frame positions by the clock of the block, with a constant
+     * latency of one callback (`audioNumFramesPerCallback`), and keeps them sorted until they are due.
+     * Due events are written to `midi_in` with JR timestamps of their offsets in the block.
+     */
     class MidiSourceNode : public AudioGraphNode {
-        uint8_t* buffer;
+        struct ScheduledMidiEvent {
+            int64_t frame_position;
+            uint32_t offset; // in `scheduled_data`
+            uint32_t length;
+        };
+
+        ZixRing* queue{nullptr};
         int32_t capacity;
 
-        NanoSleepLock midi_buffer_mutex{};
+        AdaptiveMutex midi_buffer_mutex{};
         AAPMidiEventTranslator translator;
+        std::atomic<int64_t> num_dropped_events{0};
 
         // needed for sample accurate time calculation
         int32_t sample_rate{0};
         int32_t aap_frame_size{1024};
-        struct timespec last_aap_process_time{0, 0};
+
+        // audio thread only. They are preallocated and never grow.
+        std::vector<ScheduledMidiEvent> scheduled_events{};
+        std::vector<uint8_t> scheduled_data{};
+        std::vector<uint8_t> scheduled_data_swap{};
+        uint32_t scheduled_data_size{0};
+
+        void scheduleQueuedEvents();
+        void removeScheduledEvents(int32_t count);
 
     public:
         MidiSourceNode(AudioGraph* ownerGraph,
@@ -170,26 +488,55 @@ namespace aap {
 
         void setPlugin(RemotePluginInstance* instance) { translator.setPlugin(instance); }
 
+        /// Adds MIDI events to be sent at `timestampInNanoseconds` (by `CLOCK_MONOTONIC`, which is
+        /// what `System.nanoTime()` returns on Android), or as soon as possible if it is 0.
         void addMidiEvent(uint8_t *data, int32_t length, int64_t timestampInNanoseconds);
 
+        /// The number of events that were dropped because the queue was full.
+        int64_t getNumDroppedEvents() { return num_dropped_events; }
+
         void start() override;
         void pause() override;
         void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::MidiSourceNode"; }
     };
 
-    class MidiDestinationNode : public AudioGraphNode {
-        uint8_t* buffer;
+    /// A UMP from the MIDI output, at the absolute frame position in the graph (counted since the node was created,
+    /// i.e. since the player was created; start() and pause() do not reset it).
+    struct MidiOutputEvent {
+        int64_t frame_position;
+        uint32_t length;
+        uint8_t ump[16];
+    };
 
-        NanoSleepLock midi_buffer_mutex{};
+    /**
+     * MidiDestinationNode consumes the MIDI output (`midi_out`) of the audio bus.
+     *
+     * The audio thread splits the UMP stream into events, resolves their JR timestamps into frame
+     * positions, and pushes them into a preallocated lock-free ring. A (single) consumer thread
+     * drains it with `readEvents()`. When the ring is full, the events are dropped and counted.
+     */
+    class MidiDestinationNode : public AudioGraphNode {
+        ZixRing* ring{nullptr};
+        int64_t frame_position{0};
+        std::atomic<int64_t> num_dropped_events{0};
 
     public:
-        explicit MidiDestinationNode(AudioGraph* ownerGraph, int32_t internalBufferSize = AAP_PLUGIN_PLAYER_DEFAULT_MIDI_RING_BUFFER_SIZE);
+        explicit MidiDestinationNode(AudioGraph* ownerGraph, int32_t capacityInEvents = AAP_PLUGIN_PLAYER_DEFAULT_MIDI_OUTPUT_RING_EVENTS);
 
         ~MidiDestinationNode() override;
 
+        /// Copies up to `maxEvents` events into `events` and returns the number of them.
+        /// It must not be called from more than one thread at a time.
+        int32_t readEvents(MidiOutputEvent* events, int32_t maxEvents);
+
+        /// The number of events that were dropped because the consumer did not catch up.
+        int64_t getNumDroppedEvents() { return num_dropped_events; }
+
         void start() override;
         void pause() override;
         void processAudio(AudioBuffer* audioData, int32_t numFrames) override;
+        const char* getTraceName() override { return "AAP::MidiDestinationNode"; }
     };
 }
 
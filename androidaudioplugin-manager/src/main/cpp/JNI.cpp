@@ -1,6 +1,7 @@
 #include <jni.h>
 
 #include "PluginPlayer.h"
+#include <aap/unstable/tracing.h>
 
 extern "C"
 JNIEXPORT void JNICALL
@@ -19,6 +20,18 @@ Java_org_androidaudioplugin_manager_PluginPlayer_loadAudioResourceNative(JNIEnv
         free((void*) data);
 }
 
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_loadAudioFileNative(JNIEnv *env, jobject thiz,
+                                                                     jlong player,
+                                                                     jstring path) {
+    jboolean isPathCopy{false};
+    auto pathChars = env->GetStringUTFChars(path, &isPathCopy);
+    bool ret = ((aap::PluginPlayer*) player)->setAudioSourceFile(pathChars);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return ret;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_org_androidaudioplugin_manager_PluginPlayer_addMidiEventsNative(JNIEnv *env, jobject thiz,
@@ -83,6 +96,80 @@ Java_org_androidaudioplugin_manager_PluginPlayer_setPluginNative(JNIEnv *env, jo
     ((aap::PluginPlayer*) player)->getGraph().setPlugin((aap::RemotePluginInstance*) instance);
 }
 
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_setPluginsNative(JNIEnv *env, jobject thiz,
+                                                                  jlong player, jlongArray nativeClients,
+                                                                  jintArray instanceIds) {
+    auto count = env->GetArrayLength(instanceIds);
+    if (count > AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH || count != env->GetArrayLength(nativeClients))
+        return false;
+    jlong clients[AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH];
+    jint ids[AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH];
+    env->GetLongArrayRegion(nativeClients, 0, count, clients);
+    env->GetIntArrayRegion(instanceIds, 0, count, ids);
+
+    // validate all of them before touching the chain.
+    aap::RemotePluginInstance* instances[AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH];
+    for (jsize i = 0; i < count; i++) {
+        auto client = (aap::PluginClient*) clients[i];
+        instances[i] = client ? (aap::RemotePluginInstance*) client->getInstanceById(ids[i]) : nullptr;
+        if (!instances[i]) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_MANAGER_LOG_TAG, "setPlugins: instance %d (at %d) is not found", ids[i], i);
+            return false;
+        }
+    }
+    return ((aap::PluginPlayer*) player)->setPlugins(instances, count);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_setPluginBypassedNative(JNIEnv *env, jobject thiz,
+                                                                         jlong player, jint index,
+                                                                         jboolean bypassed) {
+    ((aap::PluginPlayer*) player)->setPluginBypassed(index, bypassed);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_setPluginMidiInputFromPreviousNative(JNIEnv *env, jobject thiz,
+                                                                                      jlong player, jint index,
+                                                                                      jboolean fromPrevious) {
+    ((aap::PluginPlayer*) player)->setPluginMidiInputFromPrevious(index, fromPrevious);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_setSourceGainNative(JNIEnv *env, jobject thiz,
+                                                                     jlong player, jint index,
+                                                                     jfloat gain) {
+    ((aap::PluginPlayer*) player)->setSourceGain(index, gain);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_setSourcePanNative(JNIEnv *env, jobject thiz,
+                                                                    jlong player, jint index,
+                                                                    jfloat pan) {
+    ((aap::PluginPlayer*) player)->setSourcePan(index, pan);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_setSourceMutedNative(JNIEnv *env, jobject thiz,
+                                                                      jlong player, jint index,
+                                                                      jboolean muted) {
+    ((aap::PluginPlayer*) player)->setSourceMuted(index, muted);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_setSourceSoloNative(JNIEnv *env, jobject thiz,
+                                                                     jlong player, jint index,
+                                                                     jboolean solo) {
+    ((aap::PluginPlayer*) player)->setSourceSolo(index, solo);
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_org_androidaudioplugin_manager_PluginPlayer_enableAudioRecorderNative(JNIEnv *,
@@ -93,6 +180,96 @@ Java_org_androidaudioplugin_manager_PluginPlayer_enableAudioRecorderNative(JNIEn
 extern "C"
 JNIEXPORT void JNICALL
 Java_org_androidaudioplugin_manager_PluginPlayer_setPresetIndexNative(JNIEnv *env, jobject thiz,
-                                                                      jlong player, jint index) {
-    ((aap::PluginPlayer*) player)->setPresetIndex(index);
-}
\ No newline at end of file
+                                                                      jlong player, jint pluginIndex, jint index) {
+    ((aap::PluginPlayer*) player)->setPresetIndex(pluginIndex, index);
+}
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_startRecordingNative(JNIEnv *env, jobject thiz,
+                                                                      jlong player, jstring path,
+                                                                      jboolean recordMidi) {
+    jboolean isPathCopy{false};
+    auto pathChars = env->GetStringUTFChars(path, &isPathCopy);
+    bool ret = ((aap::PluginPlayer*) player)->startRecording(pathChars, recordMidi);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return ret;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_stopRecordingNative(JNIEnv *env, jobject thiz,
+                                                                     jlong player) {
+    ((aap::PluginPlayer*) player)->stopRecording();
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_getNumDroppedRecordingBlocksNative(JNIEnv *env, jobject thiz,
+                                                                                   jlong player) {
+    return ((aap::PluginPlayer*) player)->getNumDroppedRecordingBlocks();
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_setMeteringEnabledNative(JNIEnv *env, jobject thiz,
+                                                                          jlong player, jboolean enabled) {
+    ((aap::PluginPlayer*) player)->setMeteringEnabled(enabled);
+}
+
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_getMeterLevelsNative(JNIEnv *env, jobject thiz,
+                                                                      jlong player) {
+    aap::AudioMeterSnapshot snapshot{};
+    ((aap::PluginPlayer*) player)->getMeterSnapshot(snapshot);
+    // [short term loudness, peak * numChannels, rms * numChannels]
+    auto size = 1 + snapshot.num_channels * 2;
+    auto ret = env->NewFloatArray(size);
+    env->SetFloatArrayRegion(ret, 0, 1, &snapshot.short_term_loudness);
+    env->SetFloatArrayRegion(ret, 1, snapshot.num_channels, snapshot.peak);
+    env->SetFloatArrayRegion(ret, 1 + snapshot.num_channels, snapshot.num_channels, snapshot.rms);
+    return ret;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_readMidiOutputNative(JNIEnv *env, jobject thiz,
+                                                                      jlong player, jlongArray framePositions,
+                                                                      jintArray lengths, jbyteArray umps) {
+    auto maxEvents = env->GetArrayLength(lengths);
+    std::vector<aap::MidiOutputEvent> events(maxEvents);
+    auto size = ((aap::PluginPlayer*) player)->readMidiOutput(events.data(), maxEvents);
+    for (int32_t i = 0; i < size; i++) {
+        auto& event = events[i];
+        auto position = (jlong) event.frame_position;
+        auto length = (jint) event.length;
+        env->SetLongArrayRegion(framePositions, i, 1, &position);
+        env->SetIntArrayRegion(lengths, i, 1, &length);
+        env->SetByteArrayRegion(umps, i * (jsize) sizeof(event.ump), length, (jbyte*) event.ump);
+    }
+    return size;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_getNumDroppedMidiOutputEventsNative(JNIEnv *env, jobject thiz,
+                                                                                    jlong player) {
+    return ((aap::PluginPlayer*) player)->getNumDroppedMidiOutputEvents();
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_startTracingNative(JNIEnv *env, jclass clazz,
+                                                                    jstring path) {
+    jboolean isPathCopy{false};
+    auto pathChars = env->GetStringUTFChars(path, &isPathCopy);
+    bool ret = aap::trace::startTracing(pathChars);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return ret;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_manager_PluginPlayer_stopTracingNative(JNIEnv *env, jclass clazz) {
+    aap::trace::stopTracing();
+}
@@ -5,6 +5,13 @@
 
 #define AAP_MANAGER_MIDI_BUFFER_SIZE 65536
 #define AAP_PLUGIN_PLAYER_DEFAULT_MIDI_RING_BUFFER_SIZE 8192
+#define AAP_PLUGIN_PLAYER_DEFAULT_MIDI_OUTPUT_RING_EVENTS 2048
 #define AAP_MANAGER_LOG_TAG "AAPManager"
+#define AAP_MANAGER_MAX_PLUGIN_CHAIN_LENGTH 16
+#define AAP_MANAGER_MAX_MIXER_INPUTS 8
+#define AAP_MANAGER_MAX_MIXER_CHANNELS 8
+#define AAP_MANAGER_MAX_METER_CHANNELS 8
+#define AAP_JR_TIMESTAMP_TICKS_PER_SECOND 31250
+#define AAP_JR_TIMESTAMP_MAX_TICKS 0xFFFF
 
 #endif //AAP_CORE_LOCALDEFINITIONS_H
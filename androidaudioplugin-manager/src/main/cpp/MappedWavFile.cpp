@@ -0,0 +1,191 @@
+#include "MappedWavFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <aap/unstable/logging.h>
+#include <aap/core/host/audio-kernels.h>
+
+#define AAP_WAV_FORMAT_PCM 1
+#define AAP_WAV_FORMAT_IEEE_FLOAT 3
+#define AAP_WAV_FORMAT_EXTENSIBLE 0xFFFE
+#define AAP_WAV_MAX_DEINTERLEAVE_CHANNELS 8
+
+static inline uint16_t readLE16(const uint8_t* p) { return (uint16_t) (p[0] | (p[1] << 8)); }
+static inline uint32_t readLE32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24); }
+
+aap::MappedWavFile::~MappedWavFile() {
+    close();
+}
+
+void aap::MappedWavFile::close() {
+    if (mapped)
+        munmap(mapped, mapped_size);
+    mapped = nullptr;
+    mapped_size = 0;
+    frames = nullptr;
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+bool aap::MappedWavFile::open(const char *path) {
+    close();
+
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_MANAGER_LOG_TAG, "MappedWavFile: could not open %s", path);
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close();
+        return false;
+    }
+    mapped_size = (size_t) st.st_size;
+    auto ptr = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_MANAGER_LOG_TAG, "MappedWavFile: could not mmap %s", path);
+        mapped_size = 0;
+        close();
+        return false;
+    }
+    mapped = (uint8_t*) ptr;
+    // playback mostly goes forward, so let the kernel read ahead.
+    madvise(mapped, mapped_size, MADV_SEQUENTIAL);
+
+    if (!parseHeader())
+        sample_format = AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED;
+    return true;
+}
+
+bool aap::MappedWavFile::parseHeader() {
+    if (mapped_size < 12 || memcmp(mapped, "RIFF", 4) != 0 || memcmp(mapped + 8, "WAVE", 4) != 0)
+        return false;
+
+    uint16_t formatTag = 0;
+    uint16_t bitsPerSample = 0;
+    bool hasFormat = false;
+    size_t pos = 12;
+    while (pos + 8 <= mapped_size) {
+        auto chunk = mapped + pos;
+        size_t chunkSize = readLE32(chunk + 4);
+        auto body = chunk + 8;
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && pos + 8 + chunkSize <= mapped_size) {
+            formatTag = readLE16(body);
+            num_channels = readLE16(body + 2);
+            sample_rate = (int32_t) readLE32(body + 4);
+            bytes_per_frame = readLE16(body + 12);
+            bitsPerSample = readLE16(body + 14);
+            // WAVE_FORMAT_EXTENSIBLE: the actual format is the first two bytes of the SubFormat GUID.
+            if (formatTag == AAP_WAV_FORMAT_EXTENSIBLE && chunkSize >= 40)
+                formatTag = readLE16(body + 24);
+            hasFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!hasFormat || num_channels <= 0 || bytes_per_frame <= 0)
+                return false;
+            // some writers leave the size unfinalized (0 or 0xFFFFFFFF); take whatever is mapped.
+            size_t available = mapped_size - (pos + 8);
+            if (chunkSize == 0 || chunkSize > available)
+                chunkSize = available;
+            frames = body;
+            num_frames = (int32_t) (chunkSize / bytes_per_frame);
+            break;
+        }
+        pos += 8 + chunkSize + (chunkSize & 1); // chunks are padded to even size
+    }
+    if (!frames)
+        return false;
+
+    if (formatTag == AAP_WAV_FORMAT_IEEE_FLOAT)
+        sample_format = bitsPerSample == 32 ? AAP_WAV_SAMPLE_FORMAT_FLOAT32 :
+                        bitsPerSample == 64 ? AAP_WAV_SAMPLE_FORMAT_FLOAT64 :
+                        AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED;
+    else if (formatTag == AAP_WAV_FORMAT_PCM)
+        sample_format = bitsPerSample == 8 ? AAP_WAV_SAMPLE_FORMAT_UINT8 :
+                        bitsPerSample == 16 ? AAP_WAV_SAMPLE_FORMAT_INT16 :
+                        bitsPerSample == 24 ? AAP_WAV_SAMPLE_FORMAT_INT24 :
+                        bitsPerSample == 32 ? AAP_WAV_SAMPLE_FORMAT_INT32 :
+                        AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED;
+    else
+        sample_format = AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED;
+
+    if (bytes_per_frame != num_channels * (bitsPerSample / 8))
+        sample_format = AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED;
+    // In-place float reads require sample alignment. It is almost always the case (44-byte header).
+    if (sample_format == AAP_WAV_SAMPLE_FORMAT_FLOAT32 && ((uintptr_t) frames % sizeof(float)) != 0)
+        sample_format = AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED;
+    return sample_format != AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED;
+}
+
+static inline float sampleToFloat(aap::MappedWavFile::SampleFormat format, const uint8_t* p) {
+    switch (format) {
+        case aap::MappedWavFile::AAP_WAV_SAMPLE_FORMAT_UINT8:
+            return ((int32_t) p[0] - 128) * (1.0f / 128.0f);
+        case aap::MappedWavFile::AAP_WAV_SAMPLE_FORMAT_INT16:
+            return (int16_t) readLE16(p) * (1.0f / 32768.0f);
+        case aap::MappedWavFile::AAP_WAV_SAMPLE_FORMAT_INT24:
+            // place the 24 bits at the top of int32 so that the sign is kept.
+            return (int32_t) (((uint32_t) p[0] << 8) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 24)) * (1.0f / 2147483648.0f);
+        case aap::MappedWavFile::AAP_WAV_SAMPLE_FORMAT_INT32:
+            return (int32_t) readLE32(p) * (1.0f / 2147483648.0f);
+        case aap::MappedWavFile::AAP_WAV_SAMPLE_FORMAT_FLOAT32: {
+            float f;
+            memcpy(&f, p, sizeof(float));
+            return f;
+        }
+        case aap::MappedWavFile::AAP_WAV_SAMPLE_FORMAT_FLOAT64: {
+            double d;
+            memcpy(&d, p, sizeof(double));
+            return (float) d;
+        }
+        default:
+            return 0;
+    }
+}
+
+int32_t aap::MappedWavFile::readFrames(AudioBuffer *dst, int32_t frameOffset, int32_t numFrames, int32_t dstFrameOffset) {
+    if (!isReadable() || frameOffset >= num_frames || dstFrameOffset >= (int32_t) dst->audio.getNumFrames())
+        return 0;
+    int32_t size = std::min(std::min(numFrames, num_frames - frameOffset), (int32_t) dst->audio.getNumFrames() - dstFrameOffset);
+    int32_t dstChannels = (int32_t) dst->audio.getNumChannels();
+    auto src = frames + (size_t) frameOffset * bytes_per_frame;
+
+    if (sample_format == AAP_WAV_SAMPLE_FORMAT_FLOAT32 && num_channels > 1 && num_channels <= dstChannels &&
+        num_channels <= AAP_WAV_MAX_DEINTERLEAVE_CHANNELS) {
+        float* outs[AAP_WAV_MAX_DEINTERLEAVE_CHANNELS];
+        for (int32_t ch = 0; ch < num_channels; ch++)
+            outs[ch] = dst->audio.getChannel(ch).data.data + dstFrameOffset;
+        aap::kernels::deinterleave((const float*) src, outs, num_channels, size);
+        for (int32_t ch = num_channels; ch < dstChannels; ch++)
+            memset(dst->audio.getChannel(ch).data.data + dstFrameOffset, 0, size * sizeof(float));
+        return size;
+    }
+
+    int32_t bytesPerSample = bytes_per_frame / num_channels;
+    for (int32_t ch = 0; ch < dstChannels; ch++) {
+        auto out = dst->audio.getChannel(ch).data.data + dstFrameOffset;
+        int32_t srcChannel = num_channels == 1 ? 0 : ch;
+        if (srcChannel >= num_channels) {
+            memset(out, 0, size * sizeof(float));
+            continue;
+        }
+        auto in = src + srcChannel * bytesPerSample;
+        // mono integer data is contiguous, so the vectorized converters apply directly.
+        if (num_channels == 1 && sample_format == AAP_WAV_SAMPLE_FORMAT_INT16 && ((uintptr_t) in % sizeof(int16_t)) == 0)
+            aap::kernels::int16ToFloat((const int16_t*) in, out, size);
+        else if (num_channels == 1 && sample_format == AAP_WAV_SAMPLE_FORMAT_INT24)
+            aap::kernels::int24ToFloat(in, out, size);
+        else if (sample_format == AAP_WAV_SAMPLE_FORMAT_FLOAT32) {
+            auto inF = (const float*) in;
+            for (int32_t i = 0; i < size; i++)
+                out[i] = inF[i * num_channels];
+        } else {
+            for (int32_t i = 0; i < size; i++)
+                out[i] = sampleToFloat(sample_format, in + (size_t) i * bytes_per_frame);
+        }
+    }
+    return size;
+}
@@ -0,0 +1,81 @@
+#ifndef AAP_CORE_MAPPEDWAVFILE_H
+#define AAP_CORE_MAPPEDWAVFILE_H
+
+#include <cstdint>
+#include "AudioBuffer.h"
+
+namespace aap {
+
+    /**
+     * MappedWavFile `mmap()`s an uncompressed WAV file and reads its PCM frames in place.
+     *
+     * Unlike the choc-based decoders used by `AudioDataSourceNode::setAudioSource()`, it does not
+     * decode the whole file into memory beforehand. Opening it is (almost) instant, and resident
+     * memory only grows as the pages are actually read.
+     *
+     * 32-bit float data is de-interleaved directly into the destination `AudioBuffer`
+     * (vectorized on SSE2 and NEON for stereo). 8/16/24/32-bit integer and 64-bit float data are
+     * converted per block at `readFrames()`.
+     *
+     * It does not resample; callers should check `getSampleRate()` and fall back to other paths.
+     */
+    class MappedWavFile {
+    public:
+        enum SampleFormat {
+            AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED,
+            AAP_WAV_SAMPLE_FORMAT_UINT8,
+            AAP_WAV_SAMPLE_FORMAT_INT16,
+            AAP_WAV_SAMPLE_FORMAT_INT24,
+            AAP_WAV_SAMPLE_FORMAT_INT32,
+            AAP_WAV_SAMPLE_FORMAT_FLOAT32,
+            AAP_WAV_SAMPLE_FORMAT_FLOAT64
+        };
+
+    private:
+        int fd{-1};
+        uint8_t* mapped{nullptr};
+        size_t mapped_size{0};
+
+        const uint8_t* frames{nullptr};
+        int32_t num_frames{0};
+        int32_t num_channels{0};
+        int32_t sample_rate{0};
+        int32_t bytes_per_frame{0};
+        SampleFormat sample_format{AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED};
+
+        bool parseHeader();
+        void close();
+
+    public:
+        MappedWavFile() = default;
+        ~MappedWavFile();
+
+        /// Maps the file at `path`. Returns false if it could not be mapped.
+        /// A successfully mapped file may still not be a readable WAV; check `isReadable()`.
+        bool open(const char* path);
+
+        /// Returns true if the file is a WAV file that `readFrames()` can read.
+        bool isReadable() { return frames != nullptr && sample_format != AAP_WAV_SAMPLE_FORMAT_UNSUPPORTED; }
+
+        /// Returns true if frames are 32-bit float and thus read without any sample conversion.
+        bool isZeroCopy() { return sample_format == AAP_WAV_SAMPLE_FORMAT_FLOAT32; }
+
+        uint8_t* getMappedData() { return mapped; }
+        size_t getMappedSize() { return mapped_size; }
+
+        int32_t getNumFrames() { return num_frames; }
+        int32_t getNumChannels() { return num_channels; }
+        int32_t getSampleRate() { return sample_rate; }
+        SampleFormat getSampleFormat() { return sample_format; }
+
+        /// Reads `numFrames` frames starting at `frameOffset` into `dst`, at `dstFrameOffset`.
+        /// Channels are remapped in the same manner as `choc::buffer::copyRemappingChannels()`
+        /// (mono is copied to all channels, surplus destination channels are cleared).
+        ///
+        /// RT-safe in the sense that it neither locks nor allocates, but note that it may
+        /// take page faults on pages that are not resident yet.
+        int32_t readFrames(AudioBuffer* dst, int32_t frameOffset, int32_t numFrames, int32_t dstFrameOffset = 0);
+    };
+}
+
+#endif //AAP_CORE_MAPPEDWAVFILE_H
@@ -0,0 +1,100 @@
+#include "Midi2ClipFile.h"
+#include "LocalDefinitions.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <aap/unstable/logging.h>
+
+#define AAP_MIDI2_CLIP_HEADER "SMF2CLIP"
+#define AAP_MIDI2_CLIP_HEADER_SIZE 8
+// The defaults until DCTPQ and Set Tempo appear (120 BPM, in 10-nanosecond units per quarter note).
+#define AAP_MIDI2_CLIP_DEFAULT_TICKS_PER_QUARTER_NOTE 96
+#define AAP_MIDI2_CLIP_DEFAULT_TEMPO 50000000
+
+#define AAP_UMP_UTILITY_STATUS_DCTPQ 3
+#define AAP_UMP_UTILITY_STATUS_DELTA_CLOCKSTAMP 4
+#define AAP_UMP_STREAM_STATUS_END_OF_CLIP 0x21
+
+// UMP size in words, by message type.
+static const int32_t ump_words[16] {1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+
+static uint32_t readBE32(const uint8_t* p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+bool aap::Midi2ClipFile::load(const char *path, int32_t sampleRate) {
+    auto file = fopen(path, "rb");
+    if (!file) {
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_MANAGER_LOG_TAG, "Midi2ClipFile: could not open %s", path);
+        return false;
+    }
+    std::vector<uint8_t> data{};
+    uint8_t chunk[4096];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0;)
+        data.insert(data.end(), chunk, chunk + n);
+    fclose(file);
+    return parse(data.data(), data.size(), sampleRate);
+}
+
+bool aap::Midi2ClipFile::parse(const uint8_t *data, size_t size, int32_t sampleRate) {
+    events.clear();
+    length_in_frames = 0;
+    if (size < AAP_MIDI2_CLIP_HEADER_SIZE || memcmp(data, AAP_MIDI2_CLIP_HEADER, AAP_MIDI2_CLIP_HEADER_SIZE) != 0) {
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_MANAGER_LOG_TAG, "Midi2ClipFile: not a MIDI 2.0 clip file");
+        return false;
+    }
+
+    int32_t ticksPerQuarterNote = AAP_MIDI2_CLIP_DEFAULT_TICKS_PER_QUARTER_NOTE;
+    uint32_t tempo = AAP_MIDI2_CLIP_DEFAULT_TEMPO;
+    // accumulated in seconds so that tempo changes do not accumulate rounding errors.
+    double seconds = 0;
+    int64_t frame = 0;
+    bool endOfClip = false;
+
+    for (size_t offset = AAP_MIDI2_CLIP_HEADER_SIZE; offset + 4 <= size && !endOfClip;) {
+        uint32_t words[4]{};
+        words[0] = readBE32(data + offset);
+        auto messageType = words[0] >> 28;
+        auto numWords = ump_words[messageType];
+        if (offset + numWords * 4 > size) {
+            aap::a_log_f(AAP_LOG_LEVEL_WARN, AAP_MANAGER_LOG_TAG, "Midi2ClipFile: truncated UMP at %zu", offset);
+            break;
+        }
+        for (int32_t i = 1; i < numWords; i++)
+            words[i] = readBE32(data + offset + i * 4);
+        offset += numWords * 4;
+
+        switch (messageType) {
+            case 0: // Utility
+                switch ((words[0] >> 20) & 0xF) {
+                    case AAP_UMP_UTILITY_STATUS_DCTPQ:
+                        if (words[0] & 0xFFFF)
+                            ticksPerQuarterNote = (int32_t) (words[0] & 0xFFFF);
+                        break;
+                    case AAP_UMP_UTILITY_STATUS_DELTA_CLOCKSTAMP:
+                        seconds += (words[0] & 0xFFFFF) * (tempo / 100000000.0) / ticksPerQuarterNote;
+                        frame = llround(seconds * sampleRate);
+                        break;
+                }
+                continue;
+            case 0xD: // Flex Data: Set Tempo is status bank 0, status 0.
+                if (((words[0] >> 8) & 0xFF) == 0 && (words[0] & 0xFF) == 0) {
+                    if (words[1] != 0)
+                        tempo = words[1];
+                    continue;
+                }
+                break;
+            case 0xF: // UMP Stream
+                if (((words[0] >> 16) & 0x3FF) == AAP_UMP_STREAM_STATUS_END_OF_CLIP)
+                    endOfClip = true;
+                continue;
+        }
+
+        Midi2ClipEvent event{frame, (uint32_t) numWords * 4, {}};
+        memcpy(event.ump, words, sizeof(uint32_t) * numWords);
+        events.emplace_back(event);
+    }
+
+    length_in_frames = frame;
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef AAP_CORE_MIDI2CLIPFILE_H
+#define AAP_CORE_MIDI2CLIPFILE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace aap {
+
+    /// A UMP (1 to 4 words, in native byte order) at the absolute frame position in the clip.
+    struct Midi2ClipEvent {
+        int64_t frame_position;
+        uint32_t length; // in bytes
+        uint32_t ump[4];
+    };
+
+    /**
+     * Midi2ClipFile reads a MIDI 2.0 Clip File ("SMF2CLIP" followed by big-endian UMPs) and maps its
+     * Delta Clockstamps to frame positions, using the DCTPQ (ticks per quarter note) and
+     * Set Tempo (Flex Data) messages in the clip (120 BPM until the first Set Tempo).
+     *
+     * Utility and UMP Stream messages (including Start/End of Clip) are consumed; everything else
+     * is kept as events, in file order.
+     */
+    class Midi2ClipFile {
+        std::vector<Midi2ClipEvent> events{};
+        int64_t length_in_frames{0};
+
+    public:
+        /// Loads the clip at `path`. Returns false if it could not be read or is not a MIDI 2.0 clip.
+        bool load(const char* path, int32_t sampleRate);
+
+        /// Parses the clip bytes (including the "SMF2CLIP" header).
+        bool parse(const uint8_t* data, size_t size, int32_t sampleRate);
+
+        const std::vector<Midi2ClipEvent>& getEvents() { return events; }
+
+        /// The frame position of End of Clip (or the last event, if there is none).
+        int64_t getLengthInFrames() { return length_in_frames; }
+    };
+}
+
+#endif //AAP_CORE_MIDI2CLIPFILE_H
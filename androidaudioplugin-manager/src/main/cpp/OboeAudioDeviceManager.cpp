@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <cassert>
 #include "OboeAudioDeviceManager.h"
 #include <audio/choc_SampleBuffers.h>
 #include <containers/choc_VariableSizeFIFO.h>
+#include <aap/unstable/tracing.h>
+#include <aap/core/host/audio-kernels.h>
 #if ANDROID
 #include <aap/unstable/logging.h>
 #include <android/trace.h>
@@ -9,6 +12,37 @@
 
 namespace aap {
 #define AAP_OBOE_IO_TIMEOUT_MILLISECONDS 0
+#define AAP_OBOE_MAX_KERNEL_CHANNELS 8
+
+    // Oboe streams are interleaved while AAP buffers are planar. The vectorized kernels are used when
+    // the channel counts match (which is the usual case); otherwise choc copies what fits.
+    static void copyOboeToAAP(const float* oboeData, int32_t oboeChannels, AudioBuffer& aapBuffer, int32_t numFrames) {
+        auto numChannels = (int32_t) aapBuffer.audio.getNumChannels();
+        if (numChannels != oboeChannels || numChannels > AAP_OBOE_MAX_KERNEL_CHANNELS) {
+            auto oboeView = choc::buffer::createInterleavedView((float*) oboeData, oboeChannels, numFrames);
+            choc::buffer::copy(aapBuffer.audio.getStart(numFrames), oboeView);
+            return;
+        }
+        numFrames = std::min(numFrames, (int32_t) aapBuffer.audio.getNumFrames());
+        float* channels[AAP_OBOE_MAX_KERNEL_CHANNELS];
+        for (int32_t ch = 0; ch < numChannels; ch++)
+            channels[ch] = aapBuffer.audio.getChannel(ch).data.data;
+        kernels::deinterleave(oboeData, channels, numChannels, numFrames);
+    }
+
+    static void copyAAPToOboe(AudioBuffer& aapBuffer, float* oboeData, int32_t oboeChannels, int32_t numFrames) {
+        auto numChannels = (int32_t) aapBuffer.audio.getNumChannels();
+        if (numChannels != oboeChannels || numChannels > AAP_OBOE_MAX_KERNEL_CHANNELS) {
+            auto oboeView = choc::buffer::createInterleavedView(oboeData, oboeChannels, numFrames);
+            choc::buffer::copy(oboeView, aapBuffer.audio.getStart(numFrames));
+            return;
+        }
+        numFrames = std::min(numFrames, (int32_t) aapBuffer.audio.getNumFrames());
+        const float* channels[AAP_OBOE_MAX_KERNEL_CHANNELS];
+        for (int32_t ch = 0; ch < numChannels; ch++)
+            channels[ch] = aapBuffer.audio.getChannel(ch).data.data;
+        kernels::interleave(channels, oboeData, numChannels, numFrames);
+    }
 
     class OboeAudioDevice : public oboe::StabilizedCallback {
 
@@ -135,6 +169,8 @@ void aap::OboeAudioDevice::startCallback() {
     if (!stream->usesAAudio())
         aap::a_log(AAP_LOG_LEVEL_WARN, AAP_MANAGER_LOG_TAG, "AAudio is not enabled; anticipate audio output latency.");
 
+    // for the callback thread, which registers itself at the first callback.
+    aap::logging::reserveRealtimeThreads(1);
     result = stream->requestStart();
     if (result != oboe::Result::OK)
         throw std::runtime_error(std::string{"Failed to start Oboe stream: "} + oboe::convertToText(result));
@@ -154,6 +190,10 @@ void aap::OboeAudioDevice::stopCallback() {
 oboe::DataCallbackResult
 aap::OboeAudioDevice::onAudioReady(oboe::AudioStream *audioStream, void *oboeAudioData,
                                       int32_t numFrames) {
+    // takes the ring reserved at startCallback(); no-op after the first callback on the thread.
+    aap::logging::registerRealtimeThread();
+    aap::trace::registerCurrentThread();
+
     if (audioStream->getDirection() == oboe::Direction::Input)
         return onAudioInputReady(audioStream, oboeAudioData, numFrames);
     else
@@ -168,10 +208,7 @@ aap::OboeAudioDevice::onAudioInputReady(oboe::AudioStream *audioStream, void *ob
         memset(aap_buffer.midi_in, 0, aap_buffer.midi_capacity);
         memset(aap_buffer.midi_out, 0, aap_buffer.midi_capacity);
 
-        memset(oboeAudioData, 0, numFrames * sizeof(float));
-
-        auto oboeView = choc::buffer::createInterleavedView((float*) oboeAudioData, audioStream->getChannelCount(), numFrames);
-        choc::buffer::copy(aap_buffer.audio.getStart(numFrames), oboeView);
+        copyOboeToAAP((const float*) oboeAudioData, audioStream->getChannelCount(), aap_buffer, numFrames);
 
         aap_callback(callback_context, &aap_buffer, numFrames);
     }
@@ -184,6 +221,7 @@ aap::OboeAudioDevice::onAudioOutputReady(oboe::AudioStream *audioStream, void *o
                                         int32_t numFrames) {
     if (aap_callback != nullptr) {
         // kick AAP callback, convert AAP result (channel array) to Oboe (interleaved), then write to oboe buffer
+        aap::trace::ScopedTrace trace{local_trace_name};
 #if ANDROID
         struct timespec timeSpecBegin{}, timeSpecEnd{};
         if (ATrace_isEnabled()) {
@@ -199,10 +237,7 @@ aap::OboeAudioDevice::onAudioOutputReady(oboe::AudioStream *audioStream, void *o
 
         aap_callback(callback_context, &aap_buffer, numFrames);
 
-        memset(oboeAudioData, 0, numFrames * sizeof(float));
-
-        auto oboeView = choc::buffer::createInterleavedView((float*) oboeAudioData, audioStream->getChannelCount(), numFrames);
-        choc::buffer::copy(oboeView, aap_buffer.audio.getStart(numFrames));
+        copyAAPToOboe(aap_buffer, (float*) oboeAudioData, audioStream->getChannelCount(), numFrames);
 
 #if ANDROID
         if (ATrace_isEnabled()) {
@@ -14,6 +14,10 @@ void aap::PluginPlayer::setAudioSource(uint8_t *data, int32_t dataLength, const
     graph.setAudioSource(data, dataLength, filename);
 }
 
+bool aap::PluginPlayer::setAudioSourceFile(const char *path) {
+    return graph.setAudioSourceFile(path);
+}
+
 void aap::PluginPlayer::startProcessing() {
     graph.startProcessing();
 }
@@ -31,6 +35,62 @@ aap::PluginPlayer::addMidiEvents(uint8_t *data, int32_t dataLength, int64_t time
     graph.addMidiEvent(data, dataLength, timestampInNanoseconds);
 }
 
-void aap::PluginPlayer::setPresetIndex(int index) {
-    graph.setPresetIndex(index);
+void aap::PluginPlayer::setPresetIndex(int32_t pluginIndex, int index) {
+    graph.setPresetIndex(pluginIndex, index);
+}
+
+bool aap::PluginPlayer::setPlugins(aap::RemotePluginInstance **instances, int32_t count) {
+    return graph.setPlugins(instances, count);
+}
+
+void aap::PluginPlayer::setPluginBypassed(int32_t index, bool bypassed) {
+    graph.setPluginBypassed(index, bypassed);
+}
+
+void aap::PluginPlayer::setPluginMidiInputFromPrevious(int32_t index, bool fromPrevious) {
+    graph.setPluginMidiInputFromPrevious(index, fromPrevious);
+}
+
+void aap::PluginPlayer::setSourceGain(int32_t index, float gain) {
+    graph.setSourceGain(index, gain);
+}
+
+void aap::PluginPlayer::setSourcePan(int32_t index, float pan) {
+    graph.setSourcePan(index, pan);
+}
+
+void aap::PluginPlayer::setSourceMuted(int32_t index, bool muted) {
+    graph.setSourceMuted(index, muted);
+}
+
+void aap::PluginPlayer::setSourceSolo(int32_t index, bool solo) {
+    graph.setSourceSolo(index, solo);
+}
+
+bool aap::PluginPlayer::startRecording(const char *path, bool recordMidi) {
+    return graph.startRecording(path, recordMidi);
+}
+
+void aap::PluginPlayer::stopRecording() {
+    graph.stopRecording();
+}
+
+int64_t aap::PluginPlayer::getNumDroppedRecordingBlocks() {
+    return graph.getNumDroppedRecordingBlocks();
+}
+
+int32_t aap::PluginPlayer::readMidiOutput(aap::MidiOutputEvent *events, int32_t maxEvents) {
+    return graph.readMidiOutput(events, maxEvents);
+}
+
+int64_t aap::PluginPlayer::getNumDroppedMidiOutputEvents() {
+    return graph.getNumDroppedMidiOutputEvents();
+}
+
+void aap::PluginPlayer::setMeteringEnabled(bool enabled) {
+    graph.setMeteringEnabled(enabled);
+}
+
+void aap::PluginPlayer::getMeterSnapshot(aap::AudioMeterSnapshot &snapshot) {
+    graph.getMeterSnapshot(snapshot);
 }
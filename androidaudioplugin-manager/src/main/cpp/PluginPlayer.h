@@ -19,6 +19,8 @@ namespace aap {
 
         void setAudioSource(uint8_t *data, int32_t dataLength, const char *filename);
 
+        bool setAudioSourceFile(const char *path);
+
         void addMidiEvents(uint8_t* data, int32_t dataLength, int64_t timestampInNanoseconds);
 
         void startProcessing();
@@ -27,7 +29,42 @@ namespace aap {
 
         void enableAudioRecorder();
 
-        void setPresetIndex(int index);
+        /// Sets the preset of the plugin at `pluginIndex` in the chain.
+        void setPresetIndex(int32_t pluginIndex, int index);
+
+        /// Sets the ordered list of plugins (e.g. an instrument followed by effects).
+        bool setPlugins(RemotePluginInstance** instances, int32_t count);
+
+        void setPluginBypassed(int32_t index, bool bypassed);
+
+        /// Routes the MIDI output of the previous plugin to the plugin at `index`, instead of the player MIDI input.
+        void setPluginMidiInputFromPrevious(int32_t index, bool fromPrevious);
+
+        /// Mixer controls of the player sources (`index` is one of `SimpleLinearAudioGraphSource`).
+        void setSourceGain(int32_t index, float gain);
+
+        void setSourcePan(int32_t index, float pan);
+
+        void setSourceMuted(int32_t index, bool muted);
+
+        void setSourceSolo(int32_t index, bool solo);
+
+        /// Records the plugin output into a WAV file at `path` (and MIDI2 streams into `<path>.ump`).
+        bool startRecording(const char* path, bool recordMidi);
+
+        void stopRecording();
+
+        int64_t getNumDroppedRecordingBlocks();
+
+        /// Drains the MIDI output of the plugins (up to `maxEvents`). It must be called from one thread at a time.
+        int32_t readMidiOutput(MidiOutputEvent* events, int32_t maxEvents);
+
+        int64_t getNumDroppedMidiOutputEvents();
+
+        void setMeteringEnabled(bool enabled);
+
+        /// Retrieves the latest levels of the plugin output, without locking the audio thread.
+        void getMeterSnapshot(AudioMeterSnapshot& snapshot);
     };
 }
 
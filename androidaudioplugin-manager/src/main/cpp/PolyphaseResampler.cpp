@@ -0,0 +1,157 @@
+#include "PolyphaseResampler.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <aap/core/host/audio-kernels.h>
+
+// Kaiser window, modified Bessel function of the first kind (order 0) by its power series.
+static double besselI0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+aap::PolyphaseFilterBank::PolyphaseFilterBank(int32_t numPhases, double cutoff, int32_t numTaps, double kaiserBeta)
+        : num_phases(numPhases), num_taps(numTaps) {
+    coefficients.resize((size_t) numPhases * numTaps);
+
+    // When downsampling, the cutoff has to go below the output Nyquist frequency.
+    // A small margin keeps the transition band out of the audible range.
+    cutoff *= 0.95;
+    double halfLength = numTaps / 2.0;
+    double i0Beta = besselI0(kaiserBeta);
+
+    for (int32_t p = 0; p < numPhases; p++) {
+        auto c = coefficients.data() + (size_t) p * numTaps;
+        double frac = (double) p / numPhases;
+        double sum = 0;
+        for (int32_t j = 0; j < numTaps; j++) {
+            // tap j multiplies x[i + j - (numTaps / 2 - 1)], whose distance from the output position is:
+            double t = (j - (numTaps / 2 - 1)) - frac;
+            double x = M_PI * cutoff * t;
+            double sinc = t == 0 ? 1.0 : sin(x) / x;
+            double r = t / halfLength;
+            double window = r * r >= 1 ? 0 : besselI0(kaiserBeta * sqrt(1 - r * r)) / i0Beta;
+            c[j] = (float) (sinc * window);
+            sum += c[j];
+        }
+        // normalize per phase so that DC gain is exactly 1 (otherwise it ripples with the phase).
+        for (int32_t j = 0; j < numTaps; j++)
+            c[j] = (float) (c[j] / sum);
+    }
+}
+
+std::shared_ptr<const aap::PolyphaseFilterBank> aap::PolyphaseFilterBank::getShared(int32_t numPhases, double cutoff, int32_t quality) {
+    static std::mutex mutex{};
+    static std::map<std::tuple<int32_t,double,int32_t>, std::shared_ptr<const PolyphaseFilterBank>> banks{};
+
+    std::lock_guard<std::mutex> lock{mutex};
+    auto key = std::make_tuple(numPhases, cutoff, quality);
+    auto it = banks.find(key);
+    if (it != banks.end())
+        return it->second;
+
+    int32_t numTaps;
+    double beta;
+    switch (quality) {
+        case PolyphaseResampler::AAP_RESAMPLER_QUALITY_LOW:
+            numTaps = 16;
+            beta = 6.0;
+            break;
+        case PolyphaseResampler::AAP_RESAMPLER_QUALITY_MEDIUM:
+            numTaps = 32;
+            beta = 8.0;
+            break;
+        default:
+            numTaps = 64;
+            beta = 10.0;
+            break;
+    }
+    auto bank = std::make_shared<const PolyphaseFilterBank>(numPhases, cutoff, numTaps, beta);
+    banks[key] = bank;
+    return bank;
+}
+
+aap::PolyphaseResampler::PolyphaseResampler(int32_t inputSampleRate, int32_t outputSampleRate, int32_t numChannels,
+                                            Quality quality, int32_t maxOutputFramesPerCall)
+        : input_sample_rate(inputSampleRate),
+          output_sample_rate(outputSampleRate),
+          num_channels(std::min(numChannels, AAP_RESAMPLER_MAX_CHANNELS)) {
+    auto gcd = std::gcd(inputSampleRate, outputSampleRate);
+    interpolation = outputSampleRate / gcd;
+    decimation = inputSampleRate / gcd;
+    // The position is always tracked exactly. Only the filter phase is quantized when L is too large.
+    num_phases = std::min(interpolation, AAP_RESAMPLER_MAX_PHASES);
+    filter_bank = PolyphaseFilterBank::getShared(num_phases, std::min(1.0, (double) interpolation / decimation), quality);
+    num_taps = filter_bank->getNumTaps();
+
+    int32_t maxInputFramesPerCall = (int32_t) ((int64_t) maxOutputFramesPerCall * decimation / interpolation) + 2;
+    buffer_capacity = maxInputFramesPerCall + num_taps * 2;
+    history.resize(num_channels);
+    for (auto& h : history)
+        h.resize(buffer_capacity);
+    reset();
+}
+
+void aap::PolyphaseResampler::reset() {
+    for (auto& h : history)
+        std::fill(h.begin(), h.end(), 0.0f);
+    // the taps look back (num_taps / 2 - 1) frames, which are silent at the beginning.
+    read_index = num_taps / 2 - 1;
+    buffered_frames = read_index;
+    phase = 0;
+}
+
+int32_t aap::PolyphaseResampler::getRequiredInputFrames(int32_t numOutputFrames) {
+    if (numOutputFrames <= 0)
+        return 0;
+    int64_t lastPosition = phase + (int64_t) (numOutputFrames - 1) * decimation;
+    int64_t lastIndex = read_index + lastPosition / interpolation;
+    int64_t required = lastIndex + num_taps / 2 + 1 - buffered_frames;
+    return (int32_t) std::max((int64_t) 0, required);
+}
+
+int32_t aap::PolyphaseResampler::process(const float* const* input, int32_t numInputFrames, float* const* output, int32_t numOutputFrames) {
+    assert(numInputFrames <= buffer_capacity - buffered_frames);
+    numInputFrames = std::min(numInputFrames, buffer_capacity - buffered_frames);
+    for (int32_t ch = 0; ch < num_channels; ch++)
+        memcpy(history[ch].data() + buffered_frames, input[ch], numInputFrames * sizeof(float));
+    buffered_frames += numInputFrames;
+
+    const int32_t lookBehind = num_taps / 2 - 1;
+    int32_t produced = 0;
+    int32_t index = read_index;
+    int32_t ph = phase;
+    while (produced < numOutputFrames && index + num_taps / 2 < buffered_frames) {
+        auto coefficients = filter_bank->getPhase(num_phases == interpolation ? ph :
+                                                  (int32_t) ((int64_t) ph * num_phases / interpolation));
+        for (int32_t ch = 0; ch < num_channels; ch++)
+            output[ch][produced] = aap::kernels::dotProduct(history[ch].data() + index - lookBehind, coefficients, num_taps);
+        produced++;
+        int64_t next = (int64_t) ph + decimation;
+        index += (int32_t) (next / interpolation);
+        ph = (int32_t) (next % interpolation);
+    }
+    phase = ph;
+
+    // discard frames that will never be looked at again.
+    int32_t consumed = std::min(index - lookBehind, buffered_frames);
+    if (consumed > 0) {
+        for (auto& h : history)
+            memmove(h.data(), h.data() + consumed, (buffered_frames - consumed) * sizeof(float));
+        buffered_frames -= consumed;
+        index -= consumed;
+    }
+    read_index = index;
+    return produced;
+}
@@ -0,0 +1,103 @@
+#ifndef AAP_CORE_POLYPHASERESAMPLER_H
+#define AAP_CORE_POLYPHASERESAMPLER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define AAP_RESAMPLER_MAX_CHANNELS 16
+// Ratios that need more phases than this (e.g. 44100 -> 48001) use the nearest phase in the bank.
+#define AAP_RESAMPLER_MAX_PHASES 1024
+
+namespace aap {
+
+    /**
+     * Polyphase windowed-sinc filter bank for one conversion ratio and quality.
+     *
+     * It is immutable once built, and shared between resamplers of the same configuration
+     * (see `getShared()`), so that common ratios (44.1k/48k/96k) are computed only once per process.
+     */
+    class PolyphaseFilterBank {
+        int32_t num_phases;
+        int32_t num_taps;
+        std::vector<float> coefficients{};
+
+    public:
+        /// `cutoff` is relative to the input Nyquist frequency, i.e. `min(1, outputRate / inputRate)`.
+        PolyphaseFilterBank(int32_t numPhases, double cutoff, int32_t numTaps, double kaiserBeta);
+
+        /// Returns the filter bank for the ratio and quality, building it if it does not exist yet.
+        /// It is not RT-safe (it may lock and allocate).
+        static std::shared_ptr<const PolyphaseFilterBank> getShared(int32_t numPhases, double cutoff, int32_t quality);
+
+        int32_t getNumPhases() const { return num_phases; }
+        int32_t getNumTaps() const { return num_taps; }
+        const float* getPhase(int32_t phase) const { return coefficients.data() + (size_t) phase * num_taps; }
+    };
+
+    /**
+     * Streaming polyphase sample rate converter for planar float audio.
+     *
+     * The inner loop (dot product over the taps) uses NEON on ARM, and AVX2 (when available at
+     * runtime) or SSE on x86. The output is aligned to the input (no group delay), which means
+     * that the first call requires `numTaps / 2` frames of lookahead beyond the output span;
+     * `getRequiredInputFrames()` takes that into account.
+     *
+     * Everything is allocated at construction; `process()` and `getRequiredInputFrames()` are RT-safe.
+     */
+    class PolyphaseResampler {
+    public:
+        enum Quality {
+            AAP_RESAMPLER_QUALITY_LOW, // 16 taps
+            AAP_RESAMPLER_QUALITY_MEDIUM, // 32 taps
+            AAP_RESAMPLER_QUALITY_HIGH // 64 taps
+        };
+
+    private:
+        int32_t input_sample_rate;
+        int32_t output_sample_rate;
+        int32_t num_channels;
+        int32_t interpolation; // L
+        int32_t decimation; // M
+        std::shared_ptr<const PolyphaseFilterBank> filter_bank;
+        int32_t num_phases; // same as L unless it exceeds AAP_RESAMPLER_MAX_PHASES
+        int32_t num_taps;
+
+        int32_t buffer_capacity;
+        std::vector<std::vector<float>> history{};
+        int32_t buffered_frames{0};
+        int32_t read_index{0};
+        int32_t phase{0}; // in 1/L of an input frame
+
+    public:
+        PolyphaseResampler(int32_t inputSampleRate, int32_t outputSampleRate, int32_t numChannels,
+                           Quality quality, int32_t maxOutputFramesPerCall);
+
+        int32_t getInputSampleRate() { return input_sample_rate; }
+        int32_t getOutputSampleRate() { return output_sample_rate; }
+        int32_t getNumChannels() { return num_channels; }
+
+        /// The maximum number of frames that `process()` accepts at a time.
+        int32_t getMaxInputFramesPerCall() { return buffer_capacity - num_taps; }
+
+        /// The input frames that the output lags behind. At the end of a stream, this many frames of
+        /// silence have to be fed so that the output for the last input frames comes out.
+        int32_t getLookaheadFrames() { return num_taps / 2; }
+
+        /// Clears the stream state.
+        void reset();
+
+        /// Returns the number of input frames that `process()` needs to produce `numOutputFrames` frames.
+        int32_t getRequiredInputFrames(int32_t numOutputFrames);
+
+        /// Consumes all `numInputFrames` frames of `input` and produces up to `numOutputFrames` frames
+        /// into `output`. Returns the number of produced frames.
+        ///
+        /// The input must fit in the history: feeding no more than `getRequiredInputFrames(numOutputFrames)`
+        /// frames always does, for up to `maxOutputFramesPerCall` output frames. More input than that is a
+        /// programming error; it asserts (and the excess frames are dropped in release builds).
+        int32_t process(const float* const* input, int32_t numInputFrames, float* const* output, int32_t numOutputFrames);
+    };
+}
+
+#endif //AAP_CORE_POLYPHASERESAMPLER_H
@@ -1 +1,224 @@
 #include "VirtualAudioDeviceManager.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+#include <aap/unstable/logging.h>
+#include <aap/unstable/tracing.h>
+
+#define AAP_VIRTUAL_AUDIO_INPUT_LEVEL 0.25f
+
+static inline int64_t monotonicNanoseconds() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline void sleepUntil(int64_t nanoseconds) {
+    struct timespec ts{(time_t) (nanoseconds / 1000000000LL), (long) (nanoseconds % 1000000000LL)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+}
+
+static inline void updateMax(std::atomic<int64_t>& target, int64_t value) {
+    // only the clock thread updates it, so no CAS loop is needed.
+    if (value > target.load(std::memory_order_relaxed))
+        target.store(value, std::memory_order_relaxed);
+}
+
+aap::AudioDeviceIn *
+aap::VirtualAudioDeviceManager::ensureDefaultInputOpened(int32_t sampleRate, int32_t framesPerCallback, int32_t numChannels) {
+    if (input == nullptr)
+        input = std::make_shared<VirtualAudioDeviceIn>(sampleRate, numChannels);
+    return input.get();
+}
+
+aap::AudioDeviceOut *
+aap::VirtualAudioDeviceManager::ensureDefaultOutputOpened(int32_t sampleRate, int32_t framesPerCallback, int32_t numChannels) {
+    if (output == nullptr)
+        output = std::make_shared<VirtualAudioDeviceOut>(sampleRate, framesPerCallback, numChannels);
+    return output.get();
+}
+
+//--------
+
+bool aap::VirtualAudioDeviceIn::setSourceFile(const char *path) {
+    auto newFile = std::make_unique<MappedWavFile>();
+    if (!newFile->open(path) || !newFile->isReadable() || newFile->getNumFrames() == 0)
+        return false;
+    if (newFile->getSampleRate() != sample_rate)
+        aap::a_log_f(AAP_LOG_LEVEL_WARN, AAP_MANAGER_LOG_TAG,
+                     "VirtualAudioDeviceIn: %s is at %d Hz while the device runs at %d Hz. It is not resampled.",
+                     path, newFile->getSampleRate(), sample_rate);
+    file = std::move(newFile);
+    setSource(AAP_VIRTUAL_AUDIO_INPUT_FILE);
+    return true;
+}
+
+void aap::VirtualAudioDeviceIn::read(AudioBuffer *dstAudioData, int32_t bufferPosition, int32_t numFrames) {
+    auto& audio = dstAudioData->audio;
+    numFrames = std::min(numFrames, (int32_t) audio.getNumFrames());
+    if (!running || source == AAP_VIRTUAL_AUDIO_INPUT_SILENCE || (source == AAP_VIRTUAL_AUDIO_INPUT_FILE && !file)) {
+        audio.getStart((uint32_t) numFrames).clear();
+        return;
+    }
+
+    switch (source) {
+        case AAP_VIRTUAL_AUDIO_INPUT_SINE: {
+            auto ch0 = audio.getChannel(0).data.data;
+            for (int32_t i = 0; i < numFrames; i++)
+                ch0[i] = AAP_VIRTUAL_AUDIO_INPUT_LEVEL * sinf((float) (2 * M_PI * 440 * ((position + i) % sample_rate) / sample_rate));
+            for (uint32_t ch = 1; ch < audio.getNumChannels(); ch++)
+                memcpy(audio.getChannel(ch).data.data, ch0, numFrames * sizeof(float));
+            break;
+        }
+        case AAP_VIRTUAL_AUDIO_INPUT_NOISE:
+            for (uint32_t ch = 0; ch < audio.getNumChannels(); ch++) {
+                auto out = audio.getChannel(ch).data.data;
+                for (int32_t i = 0; i < numFrames; i++) {
+                    // xorshift32
+                    noise_state ^= noise_state << 13;
+                    noise_state ^= noise_state >> 17;
+                    noise_state ^= noise_state << 5;
+                    out[i] = AAP_VIRTUAL_AUDIO_INPUT_LEVEL * ((float) noise_state / (float) UINT32_MAX * 2 - 1);
+                }
+            }
+            break;
+        case AAP_VIRTUAL_AUDIO_INPUT_FILE:
+            // loop around at the end of the file.
+            for (int32_t done = 0; done < numFrames; ) {
+                auto offset = (int32_t) (position % file->getNumFrames());
+                auto size = file->readFrames(dstAudioData, offset, numFrames - done, done);
+                if (size == 0)
+                    break;
+                position += size;
+                done += size;
+            }
+            return;
+        default:
+            break;
+    }
+    position += numFrames;
+}
+
+//--------
+
+aap::VirtualAudioDeviceOut::~VirtualAudioDeviceOut() {
+    stopCallback();
+}
+
+void aap::VirtualAudioDeviceOut::startCallback() {
+    if (running)
+        return;
+    // the clock thread stops by itself at the frame limit, without stopCallback().
+    if (thread.joinable())
+        thread.join();
+    if (!output_path.empty() && !writer.open(output_path.c_str(), sample_rate, num_channels, frames_per_callback))
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_MANAGER_LOG_TAG,
+                     "VirtualAudioDeviceOut: could not open %s; the output is discarded.", output_path.c_str());
+    running = true;
+    thread = std::thread([this] { run(); });
+}
+
+void aap::VirtualAudioDeviceOut::stopCallback() {
+    running = false;
+    if (thread.joinable())
+        thread.join();
+    writer.close();
+}
+
+void aap::VirtualAudioDeviceOut::write(AudioBuffer *audioDataToWrite, int32_t bufferPosition, int32_t numFrames) {
+    // The graph usually processes the device buffer itself in place, in which case there is nothing to copy.
+    if (audioDataToWrite == &aap_buffer)
+        return;
+    choc::buffer::FrameRange range{0, (uint32_t) numFrames};
+    choc::buffer::copy(aap_buffer.audio.getFrameRange(range), audioDataToWrite->audio.getView().getFrameRange(range));
+}
+
+void aap::VirtualAudioDeviceOut::processBlock() {
+    aap_buffer.audio.clear();
+    memset(aap_buffer.midi_in, 0, aap_buffer.midi_capacity);
+    memset(aap_buffer.midi_out, 0, aap_buffer.midi_capacity);
+
+    if (aap_callback)
+        aap_callback(callback_context, &aap_buffer, frames_per_callback);
+
+    if (writer.isOpen())
+        writer.write(&aap_buffer, frames_per_callback);
+}
+
+void aap::VirtualAudioDeviceOut::run() {
+    pthread_setname_np(pthread_self(), "AAPVirtualAudio");
+    if (clock_mode == AAP_VIRTUAL_AUDIO_CLOCK_REALTIME) {
+        // try to behave like an audio thread. It usually fails without privileges, which only affects jitter.
+        sched_param param{};
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+            aap::a_log(AAP_LOG_LEVEL_INFO, AAP_MANAGER_LOG_TAG, "VirtualAudioDeviceOut: running without realtime priority.");
+    }
+    aap::logging::registerRealtimeThread();
+    aap::trace::registerCurrentThread();
+
+    // The schedule is computed from the number of frames since `origin`, so that it does not drift
+    // by rounding errors (e.g. 256 frames at 44100Hz is not an integral number of nanoseconds).
+    int64_t origin = monotonicNanoseconds();
+    int64_t scheduledFrames = 0;
+    int64_t next = origin;
+
+    while (running) {
+        int64_t begin = monotonicNanoseconds();
+        if (clock_mode == AAP_VIRTUAL_AUDIO_CLOCK_REALTIME) {
+            auto jitter = begin - next;
+            total_jitter.fetch_add(jitter, std::memory_order_relaxed);
+            updateMax(max_jitter, jitter);
+        }
+
+        processBlock();
+
+        int64_t end = monotonicNanoseconds();
+        total_callback_time.fetch_add(end - begin, std::memory_order_relaxed);
+        updateMax(max_callback_time, end - begin);
+        num_callbacks.fetch_add(1, std::memory_order_relaxed);
+        auto frames = num_frames.fetch_add(frames_per_callback, std::memory_order_relaxed) + frames_per_callback;
+
+        if (frame_limit > 0 && frames >= frame_limit)
+            running = false;
+
+        if (clock_mode == AAP_VIRTUAL_AUDIO_CLOCK_REALTIME) {
+            scheduledFrames += frames_per_callback;
+            next = origin + scheduledFrames * 1000000000LL / sample_rate;
+            if (end > next) {
+                // missed the deadline. Do not try to catch up with bursts; restart the schedule from now.
+                num_overruns.fetch_add(1, std::memory_order_relaxed);
+                origin = next = end;
+                scheduledFrames = 0;
+            }
+            else
+                sleepUntil(next);
+        }
+    }
+}
+
+aap::VirtualAudioDeviceStats aap::VirtualAudioDeviceOut::getStats() {
+    return VirtualAudioDeviceStats {
+        num_callbacks.load(std::memory_order_relaxed),
+        num_frames.load(std::memory_order_relaxed),
+        num_overruns.load(std::memory_order_relaxed),
+        max_jitter.load(std::memory_order_relaxed),
+        total_jitter.load(std::memory_order_relaxed),
+        max_callback_time.load(std::memory_order_relaxed),
+        total_callback_time.load(std::memory_order_relaxed)
+    };
+}
+
+void aap::VirtualAudioDeviceOut::resetStats() {
+    num_callbacks = 0;
+    num_frames = 0;
+    num_overruns = 0;
+    max_jitter = 0;
+    total_jitter = 0;
+    max_callback_time = 0;
+    total_callback_time = 0;
+}
@@ -1,57 +1,164 @@
 #ifndef AAP_CORE_VIRTUALAUDIODEVICEMANAGER_H
 #define AAP_CORE_VIRTUALAUDIODEVICEMANAGER_H
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <thread>
 
 #include "AudioDeviceManager.h"
+#include "MappedWavFile.h"
+#include "WavFileWriter.h"
 
 namespace aap {
 
+    enum VirtualAudioClockMode {
+        /// invokes the callback every `framesPerCallback / sampleRate` seconds, by the monotonic clock.
+        AAP_VIRTUAL_AUDIO_CLOCK_REALTIME,
+        /// invokes the callback as fast as possible (e.g. for offline rendering and throughput tests).
+        AAP_VIRTUAL_AUDIO_CLOCK_FREEWHEEL
+    };
+
+    enum VirtualAudioInputSource {
+        AAP_VIRTUAL_AUDIO_INPUT_SILENCE,
+        /// 440Hz sine wave at -12dB on all channels.
+        AAP_VIRTUAL_AUDIO_INPUT_SINE,
+        /// white noise at -12dB, from a fixed seed (so that runs are reproducible).
+        AAP_VIRTUAL_AUDIO_INPUT_NOISE,
+        /// a WAV file, looped.
+        AAP_VIRTUAL_AUDIO_INPUT_FILE
+    };
+
+    /// Callback statistics of a virtual device. Jitter is the wakeup lateness against the
+    /// scheduled callback time (only in `AAP_VIRTUAL_AUDIO_CLOCK_REALTIME` mode).
+    struct VirtualAudioDeviceStats {
+        int64_t num_callbacks;
+        int64_t num_frames;
+        /// callbacks that did not finish before the next one was due (the schedule is then reset).
+        int64_t num_overruns;
+        int64_t max_jitter_nanoseconds;
+        int64_t total_jitter_nanoseconds;
+        int64_t max_callback_nanoseconds;
+        int64_t total_callback_nanoseconds;
+    };
+
     class VirtualAudioDeviceIn : public AudioDeviceIn {
-        bool running{false};
+        int32_t sample_rate;
+        int32_t num_channels;
+        // switched by startCallback()/stopCallback() while the audio thread reads it in read().
+        std::atomic<bool> running{false};
+        VirtualAudioInputSource source{AAP_VIRTUAL_AUDIO_INPUT_SILENCE};
+        std::unique_ptr<MappedWavFile> file{nullptr};
+        int64_t position{0};
+        uint32_t noise_state{0x12345678};
+
     public:
-        explicit VirtualAudioDeviceIn() = default;
+        VirtualAudioDeviceIn(int32_t sampleRate, int32_t numChannels)
+                : sample_rate(sampleRate), num_channels(numChannels) {}
         virtual ~VirtualAudioDeviceIn() = default;
 
         void startCallback() override { running = true; }
         void stopCallback() override { running = false; }
-        void setAudioCallback(AudioDeviceCallback audioDeviceCallback, void* callbackContext) override {
-            // should we implement something here?
-        }
-        void read(AudioBuffer *dstAudioData, int32_t bufferPosition, int32_t numFrames) override {
-            // should we implement something here?
-        }
+
+        /// The virtual input does not run a clock of its own; it is pulled by the graph through `read()`,
+        /// at the pace of whichever device drives the graph (the output device in `SimpleLinearAudioGraph`).
+        void setAudioCallback(AudioDeviceCallback audioDeviceCallback, void* callbackContext) override {}
+
+        /// generates (or reads from the file) the next `numFrames` frames into `dstAudioData`.
+        void read(AudioBuffer *dstAudioData, int32_t bufferPosition, int32_t numFrames) override;
+
+        /// Sets the input source. It must not be changed while the device is running.
+        void setSource(VirtualAudioInputSource newSource) { source = newSource; position = 0; }
+
+        /// Sets a WAV file as the source (see `MappedWavFile` for supported formats).
+        /// It is not resampled. Returns false if it is not readable.
+        bool setSourceFile(const char* path);
     };
 
     class VirtualAudioDeviceOut : public AudioDeviceOut {
-        bool running{false};
+        int32_t sample_rate;
+        int32_t frames_per_callback;
+        int32_t num_channels;
+        VirtualAudioClockMode clock_mode{AAP_VIRTUAL_AUDIO_CLOCK_REALTIME};
+        int64_t frame_limit{0};
+
+        AudioDeviceCallback *aap_callback{nullptr};
+        void* callback_context{nullptr};
+        AudioBuffer aap_buffer;
+        WavFileWriter writer{};
+        std::string output_path{};
+
+        std::thread thread{};
+        std::atomic<bool> running{false};
+
+        std::atomic<int64_t> num_callbacks{0};
+        std::atomic<int64_t> num_frames{0};
+        std::atomic<int64_t> num_overruns{0};
+        std::atomic<int64_t> max_jitter{0};
+        std::atomic<int64_t> total_jitter{0};
+        std::atomic<int64_t> max_callback_time{0};
+        std::atomic<int64_t> total_callback_time{0};
+
+        void run();
+        void processBlock();
+
     public:
-        explicit VirtualAudioDeviceOut() = default;
-        virtual ~VirtualAudioDeviceOut() = default;
+        VirtualAudioDeviceOut(int32_t sampleRate, int32_t framesPerCallback, int32_t numChannels)
+                : sample_rate(sampleRate),
+                  frames_per_callback(framesPerCallback),
+                  num_channels(numChannels),
+                  aap_buffer(numChannels, framesPerCallback) {}
+        virtual ~VirtualAudioDeviceOut();
+
+        /// starts the clock thread that invokes the audio callback.
+        void startCallback() override;
+        /// stops the clock thread and finalizes the output file (if any).
+        void stopCallback() override;
 
-        void startCallback() override { running = true; }
-        void stopCallback() override { running = false; }
         void setAudioCallback(AudioDeviceCallback audioDeviceCallback, void* callbackContext) override {
-            // should we implement something here?
-        }
-        void write(AudioBuffer *audioDataToWrite, int32_t bufferPosition, int32_t numFrames) override {
-            // should we implement something here?
+            aap_callback = audioDeviceCallback;
+            callback_context = callbackContext;
         }
+
+        void write(AudioBuffer *audioDataToWrite, int32_t bufferPosition, int32_t numFrames) override;
+
+        /// It must not be changed while the device is running.
+        void setClockMode(VirtualAudioClockMode mode) { clock_mode = mode; }
+
+        /// Writes the output into a 32-bit float WAV file at `path` instead of discarding it.
+        /// The file is (re)created at each `startCallback()`. An empty path means the null sink.
+        void setOutputFile(const char* path) { output_path = path ? path : ""; }
+
+        /// Stops the clock by itself after `numFrames` frames (0 = unlimited), which is useful for
+        /// reproducible runs. Call `stopCallback()` afterwards to finalize the output.
+        void setFrameLimit(int64_t numFrames) { frame_limit = numFrames; }
+
+        bool isRunning() { return running; }
+
+        VirtualAudioDeviceStats getStats();
+        void resetStats();
     };
 
+    /**
+     * VirtualAudioDeviceManager provides audio devices that do not depend on any platform audio API.
+     *
+     * The output device drives the graph from its own thread, either paced by the monotonic clock
+     * or freewheeling. The input is generated (or read from a file), and the output is written to a
+     * file or discarded. It is used on non-Android platforms (e.g. load testing on Linux).
+     */
     class VirtualAudioDeviceManager : public AudioDeviceManager {
         std::shared_ptr<VirtualAudioDeviceIn> input{};
         std::shared_ptr<VirtualAudioDeviceOut> output{};
 
     public:
-        VirtualAudioDeviceManager()
-                : input(std::make_shared<VirtualAudioDeviceIn>()),
-                  output(std::make_shared<VirtualAudioDeviceOut>()) {
-        }
+        VirtualAudioDeviceManager() = default;
+
+        AudioDeviceIn * ensureDefaultInputOpened(int32_t sampleRate, int32_t framesPerCallback, int32_t numChannels) override;
+        AudioDeviceOut * ensureDefaultOutputOpened(int32_t sampleRate, int32_t framesPerCallback, int32_t numChannels) override;
 
-        AudioDeviceIn * ensureDefaultInputOpened(int32_t sampleRate, int32_t framesPerCallback, int32_t numChannels) override { return input.get(); }
-        AudioDeviceOut * ensureDefaultOutputOpened(int32_t sampleRate, int32_t framesPerCallback, int32_t numChannels) override { return output.get(); }
+        VirtualAudioDeviceIn* getInput() { return input.get(); }
+        VirtualAudioDeviceOut* getOutput() { return output.get(); }
     };
 
 }
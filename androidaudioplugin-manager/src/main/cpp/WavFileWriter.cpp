@@ -0,0 +1,86 @@
+#include "WavFileWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <aap/unstable/logging.h>
+#include <aap/core/host/audio-kernels.h>
+
+#define AAP_WAV_HEADER_SIZE 44
+#define AAP_WAV_FORMAT_IEEE_FLOAT 3
+
+static void writeLE16(uint8_t* p, uint16_t v) { p[0] = (uint8_t) v; p[1] = (uint8_t) (v >> 8); }
+static void writeLE32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (uint8_t) (v >> (i * 8)); }
+
+static void buildHeader(uint8_t* header, int32_t sampleRate, int32_t numChannels, uint32_t dataSize) {
+    memcpy(header, "RIFF", 4);
+    writeLE32(header + 4, AAP_WAV_HEADER_SIZE - 8 + dataSize);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    writeLE32(header + 16, 16);
+    writeLE16(header + 20, AAP_WAV_FORMAT_IEEE_FLOAT);
+    writeLE16(header + 22, (uint16_t) numChannels);
+    writeLE32(header + 24, (uint32_t) sampleRate);
+    writeLE32(header + 28, (uint32_t) (sampleRate * numChannels * sizeof(float)));
+    writeLE16(header + 32, (uint16_t) (numChannels * sizeof(float)));
+    writeLE16(header + 34, 32);
+    memcpy(header + 36, "data", 4);
+    writeLE32(header + 40, dataSize);
+}
+
+aap::WavFileWriter::~WavFileWriter() {
+    close();
+}
+
+bool aap::WavFileWriter::open(const char *path, int32_t sampleRate, int32_t numChannels, int32_t maxFramesPerWrite) {
+    close();
+
+    file = fopen(path, "wb");
+    if (!file) {
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_MANAGER_LOG_TAG, "WavFileWriter: could not open %s", path);
+        return false;
+    }
+    sample_rate = sampleRate;
+    num_channels = numChannels;
+    num_frames_written = 0;
+    interleaved.resize((size_t) numChannels * maxFramesPerWrite);
+    silence.assign(maxFramesPerWrite, 0);
+    channel_pointers.reserve(numChannels);
+
+    uint8_t header[AAP_WAV_HEADER_SIZE];
+    // the sizes are fixed at close(). Until then, readers treat it as "unfinalized".
+    buildHeader(header, sampleRate, numChannels, 0);
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool aap::WavFileWriter::write(AudioBuffer *src, int32_t numFrames) {
+    if (!file)
+        return false;
+    numFrames = std::min(numFrames, (int32_t) (interleaved.size() / num_channels));
+    auto srcChannels = (int32_t) src->audio.getNumChannels();
+    channel_pointers.clear();
+    for (int32_t ch = 0; ch < num_channels; ch++)
+        channel_pointers.emplace_back(ch < srcChannels ? src->audio.getChannel(ch).data.data : silence.data());
+    aap::kernels::interleave(channel_pointers.data(), interleaved.data(), num_channels, numFrames);
+    auto numSamples = (size_t) numFrames * num_channels;
+    if (fwrite(interleaved.data(), sizeof(float), numSamples, file) != numSamples)
+        return false;
+    num_frames_written += numFrames;
+    return true;
+}
+
+void aap::WavFileWriter::close() {
+    if (!file)
+        return;
+
+    uint8_t header[AAP_WAV_HEADER_SIZE];
+    auto dataSize = (uint64_t) num_frames_written * num_channels * sizeof(float);
+    // RIFF cannot describe more than 4GB; leave it as is and let readers take the file size.
+    buildHeader(header, sample_rate, num_channels, dataSize > UINT32_MAX - AAP_WAV_HEADER_SIZE ? 0 : (uint32_t) dataSize);
+    if (fseek(file, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), file) != sizeof(header))
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_MANAGER_LOG_TAG, "WavFileWriter: could not finalize the header");
+    fclose(file);
+    file = nullptr;
+}
@@ -0,0 +1,47 @@
+#ifndef AAP_CORE_WAVFILEWRITER_H
+#define AAP_CORE_WAVFILEWRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "AudioBuffer.h"
+
+namespace aap {
+
+    /**
+     * WavFileWriter writes planar float audio into a 32-bit float WAV file.
+     *
+     * The header is written at `open()` with empty sizes, and finalized at `close()`
+     * (or destruction). `write()` does not allocate, but it does file I/O; it is meant for
+     * non-RT threads (or threads that do not need to meet deadlines, such as virtual devices).
+     */
+    class WavFileWriter {
+        FILE* file{nullptr};
+        int32_t sample_rate{0};
+        int32_t num_channels{0};
+        int64_t num_frames_written{0};
+        std::vector<float> interleaved{};
+        std::vector<float> silence{};
+        std::vector<const float*> channel_pointers{};
+
+    public:
+        WavFileWriter() = default;
+        ~WavFileWriter();
+
+        /// Creates (or truncates) the file at `path`. `maxFramesPerWrite` is the largest `numFrames` for `write()`.
+        bool open(const char* path, int32_t sampleRate, int32_t numChannels, int32_t maxFramesPerWrite);
+
+        bool isOpen() { return file != nullptr; }
+
+        int64_t getNumFramesWritten() { return num_frames_written; }
+
+        /// Interleaves and appends the first `numFrames` frames of `src`.
+        /// Surplus channels in `src` are ignored, and missing ones are written as silence.
+        bool write(AudioBuffer* src, int32_t numFrames);
+
+        /// Finalizes the header and closes the file.
+        void close();
+    };
+}
+
+#endif //AAP_CORE_WAVFILEWRITER_H
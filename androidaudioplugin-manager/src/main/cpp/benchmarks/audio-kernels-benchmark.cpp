@@ -0,0 +1,97 @@
+// Measures the throughput (samples per second) of the aap::kernels sample conversion kernels,
+// for every implementation that the CPU supports.
+#include "aap/core/host/audio-kernels.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#define BENCHMARK_BLOCK_SIZE 256
+#define BENCHMARK_MAX_CHANNELS 8
+
+using namespace aap::kernels;
+
+static double seconds_per_case = 0.2;
+
+// returns samples per second, where `samplesPerCall` samples are processed by each `func()`.
+static double run(int32_t samplesPerCall, const std::function<void()>& func) {
+    int64_t samples = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration<double>(seconds_per_case);
+    auto now = start;
+    while (now < end) {
+        for (int i = 0; i < 256; i++)
+            func();
+        samples += (int64_t) samplesPerCall * 256;
+        now = std::chrono::steady_clock::now();
+    }
+    return samples / std::chrono::duration<double>(now - start).count();
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1)
+        seconds_per_case = atof(argv[1]);
+
+    std::vector<std::vector<float>> planar(BENCHMARK_MAX_CHANNELS);
+    float* planarPtrs[BENCHMARK_MAX_CHANNELS];
+    for (int ch = 0; ch < BENCHMARK_MAX_CHANNELS; ch++) {
+        planar[ch].resize(BENCHMARK_BLOCK_SIZE);
+        for (int i = 0; i < BENCHMARK_BLOCK_SIZE; i++)
+            planar[ch][i] = (float) sin(i * 0.01 * (ch + 1));
+        planarPtrs[ch] = planar[ch].data();
+    }
+    std::vector<float> interleaved(BENCHMARK_BLOCK_SIZE * BENCHMARK_MAX_CHANNELS);
+    std::vector<float> floats(BENCHMARK_BLOCK_SIZE * 2);
+    std::vector<int16_t> int16s(BENCHMARK_BLOCK_SIZE * 2);
+    std::vector<uint8_t> int24s(BENCHMARK_BLOCK_SIZE * 2 * 3);
+    for (size_t i = 0; i < floats.size(); i++)
+        floats[i] = (float) sin(i * 0.01);
+    DitherState dither{};
+
+    const KernelImplementation implementations[] {AAP_KERNELS_SCALAR, AAP_KERNELS_SSE, AAP_KERNELS_AVX2, AAP_KERNELS_NEON};
+    auto defaultImplementation = getImplementation();
+
+    printf("%-8s %-28s %16s\n", "impl", "kernel", "Msamples/sec");
+    for (auto impl : implementations) {
+        if (!setImplementation(impl))
+            continue;
+        auto name = getImplementationName(impl);
+        auto report = [&](const char* kernel, double samplesPerSecond) {
+            printf("%-8s %-28s %16.1f\n", name, kernel, samplesPerSecond / 1000000);
+        };
+        char label[64];
+
+        for (int32_t channels : {1, 2, 4, 6, 8}) {
+            snprintf(label, sizeof(label), "interleave %dch", channels);
+            report(label, run(channels * BENCHMARK_BLOCK_SIZE, [&] {
+                interleave(planarPtrs, interleaved.data(), channels, BENCHMARK_BLOCK_SIZE, 0.5f);
+            }));
+            snprintf(label, sizeof(label), "interleaveAdd %dch", channels);
+            report(label, run(channels * BENCHMARK_BLOCK_SIZE, [&] {
+                interleaveAdd(planarPtrs, interleaved.data(), channels, BENCHMARK_BLOCK_SIZE, 0.5f);
+            }));
+            snprintf(label, sizeof(label), "deinterleave %dch", channels);
+            report(label, run(channels * BENCHMARK_BLOCK_SIZE, [&] {
+                deinterleave(interleaved.data(), planarPtrs, channels, BENCHMARK_BLOCK_SIZE);
+            }));
+        }
+        auto numSamples = (int32_t) floats.size();
+        report("copyWithGain", run(numSamples, [&] { copyWithGain(floats.data(), interleaved.data(), numSamples, 0.5f); }));
+        report("addWithGain", run(numSamples, [&] { addWithGain(floats.data(), interleaved.data(), numSamples, 0.5f); }));
+        report("addWithGainRamp", run(numSamples, [&] { addWithGainRamp(floats.data(), interleaved.data(), numSamples, 0.25f, 0.5f); }));
+        float peak, sumOfSquares, dot = 0;
+        report("measurePeakAndSumOfSquares", run(numSamples, [&] { measurePeakAndSumOfSquares(floats.data(), numSamples, peak, sumOfSquares); }));
+        report("dotProduct", run(numSamples, [&] { dot += dotProduct(floats.data(), interleaved.data(), numSamples); }));
+        report("floatToInt16", run(numSamples, [&] { floatToInt16(floats.data(), int16s.data(), numSamples); }));
+        report("floatToInt16 (dither)", run(numSamples, [&] { floatToInt16(floats.data(), int16s.data(), numSamples, &dither); }));
+        report("int16ToFloat", run(numSamples, [&] { int16ToFloat(int16s.data(), floats.data(), numSamples); }));
+        report("floatToInt24", run(numSamples, [&] { floatToInt24(floats.data(), int24s.data(), numSamples); }));
+        report("floatToInt24 (dither)", run(numSamples, [&] { floatToInt24(floats.data(), int24s.data(), numSamples, &dither); }));
+        report("int24ToFloat", run(numSamples, [&] { int24ToFloat(int24s.data(), floats.data(), numSamples); }));
+    }
+    setImplementation(defaultImplementation);
+    printf("default implementation: %s\n", getImplementationName(defaultImplementation));
+    return 0;
+}
@@ -0,0 +1,66 @@
+// Measures PolyphaseResampler throughput (output frames per second) for each quality level,
+// over the common sample rate conversions.
+#include "PolyphaseResampler.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define BENCHMARK_BLOCK_SIZE 256
+#define BENCHMARK_NUM_CHANNELS 2
+
+static const char* quality_names[] {"low", "medium", "high"};
+
+static double run(int32_t inputRate, int32_t outputRate, aap::PolyphaseResampler::Quality quality, double seconds) {
+    aap::PolyphaseResampler resampler{inputRate, outputRate, BENCHMARK_NUM_CHANNELS, quality, BENCHMARK_BLOCK_SIZE};
+
+    std::vector<std::vector<float>> input(BENCHMARK_NUM_CHANNELS);
+    std::vector<std::vector<float>> output(BENCHMARK_NUM_CHANNELS);
+    const float* in[BENCHMARK_NUM_CHANNELS];
+    float* out[BENCHMARK_NUM_CHANNELS];
+    for (int ch = 0; ch < BENCHMARK_NUM_CHANNELS; ch++) {
+        input[ch].resize(resampler.getMaxInputFramesPerCall());
+        for (size_t i = 0; i < input[ch].size(); i++)
+            input[ch][i] = (float) sin(i * 0.01 * (ch + 1));
+        output[ch].resize(BENCHMARK_BLOCK_SIZE);
+        in[ch] = input[ch].data();
+        out[ch] = output[ch].data();
+    }
+
+    int64_t frames = 0;
+    float sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    auto now = start;
+    while (now < end) {
+        for (int i = 0; i < 64; i++) {
+            auto numInputFrames = resampler.getRequiredInputFrames(BENCHMARK_BLOCK_SIZE);
+            frames += resampler.process(in, numInputFrames, out, BENCHMARK_BLOCK_SIZE);
+            sink += out[0][0];
+        }
+        now = std::chrono::steady_clock::now();
+    }
+    // keep the results observable so that the loop is not optimized away.
+    if (sink == 12345.f)
+        puts("");
+    return frames / std::chrono::duration<double>(now - start).count();
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    const int32_t conversions[][2] {
+        {44100, 48000}, {48000, 44100}, {48000, 96000}, {96000, 48000}, {44100, 96000}
+    };
+
+    printf("%-16s %-8s %16s %12s\n", "conversion", "quality", "frames/sec", "x realtime");
+    for (auto& c : conversions) {
+        for (int q = aap::PolyphaseResampler::AAP_RESAMPLER_QUALITY_LOW; q <= aap::PolyphaseResampler::AAP_RESAMPLER_QUALITY_HIGH; q++) {
+            auto fps = run(c[0], c[1], (aap::PolyphaseResampler::Quality) q, seconds);
+            char name[32];
+            snprintf(name, sizeof(name), "%d->%d", c[0], c[1]);
+            printf("%-16s %-8s %16.0f %12.1f\n", name, quality_names[q], fps, fps / c[1]);
+        }
+    }
+    return 0;
+}
@@ -11,6 +11,10 @@ class PluginPlayer private constructor(private val native: Long) : AutoCloseable
     companion object {
         const val sample_audio_filename = "androidaudioplugin_manager_sample_audio.ogg"
 
+        // The player sources that are mixed before the plugins (see setSourceGain() etc.)
+        const val SOURCE_AUDIO_INPUT = 0
+        const val SOURCE_AUDIO_DATA = 1
+
         fun create(sampleRate: Int, framesPerCallback: Int, channelCount: Int) =
             PluginPlayer(createNewPluginPlayer(sampleRate, framesPerCallback, channelCount))
 
@@ -20,6 +24,21 @@ class PluginPlayer private constructor(private val native: Long) : AutoCloseable
 
         @JvmStatic
         private external fun createNewPluginPlayer(sampleRate: Int, framesPerCallback: Int, channelCount: Int): Long
+
+        /**
+         * Starts tracing the native audio processing (graph nodes, plugin process, AAPXS sessions, UMP merges)
+         * into a Chrome trace event JSON file at [path], which can be loaded by ui.perfetto.dev.
+         * Returns false if tracing has already started or the file could not be created.
+         */
+        fun startTracing(path: String) = startTracingNative(path)
+
+        /** Stops tracing and writes out the trace file. */
+        fun stopTracing() = stopTracingNative()
+
+        @JvmStatic
+        private external fun startTracingNative(path: String): Boolean
+        @JvmStatic
+        private external fun stopTracingNative()
     }
 
     override fun close() {
@@ -32,11 +51,49 @@ class PluginPlayer private constructor(private val native: Long) : AutoCloseable
 
     private external fun setPluginNative(player: Long, nativeClient: Long, instanceId: Int)
 
+    // Plugins are processed in order, e.g. an instrument followed by effects.
+    fun setPlugins(plugins: List<NativeRemotePluginInstance>) =
+        setPluginsNative(native, plugins.map { it.client }.toLongArray(), plugins.map { it.instanceId }.toIntArray())
+
+    private external fun setPluginsNative(player: Long, nativeClients: LongArray, instanceIds: IntArray): Boolean
+
+    fun setPluginBypassed(index: Int, bypassed: Boolean) = setPluginBypassedNative(native, index, bypassed)
+
+    private external fun setPluginBypassedNative(player: Long, index: Int, bypassed: Boolean)
+
+    // By default each plugin receives the player MIDI input. This routes the MIDI output of the previous plugin instead.
+    fun setPluginMidiInputFromPrevious(index: Int, fromPrevious: Boolean) =
+        setPluginMidiInputFromPreviousNative(native, index, fromPrevious)
+
+    private external fun setPluginMidiInputFromPreviousNative(player: Long, index: Int, fromPrevious: Boolean)
+
     fun loadAudioResource(bytes: ByteArray, filename: String) =
         loadAudioResourceNative(native, bytes, filename)
 
     private external fun loadAudioResourceNative(player: Long, bytes: ByteArray, filename: String)
 
+    // Uncompressed WAV files at the player sample rate are memory-mapped and streamed without decoding.
+    fun loadAudioFile(path: String) = loadAudioFileNative(native, path)
+
+    private external fun loadAudioFileNative(player: Long, path: String): Boolean
+
+    // Mixing the audio input and the loaded audio. Gain is linear, pan is from -1 (left) to 1 (right).
+    fun setSourceGain(source: Int, gain: Float) = setSourceGainNative(native, source, gain)
+
+    private external fun setSourceGainNative(player: Long, index: Int, gain: Float)
+
+    fun setSourcePan(source: Int, pan: Float) = setSourcePanNative(native, source, pan)
+
+    private external fun setSourcePanNative(player: Long, index: Int, pan: Float)
+
+    fun setSourceMuted(source: Int, muted: Boolean) = setSourceMutedNative(native, source, muted)
+
+    private external fun setSourceMutedNative(player: Long, index: Int, muted: Boolean)
+
+    fun setSourceSolo(source: Int, solo: Boolean) = setSourceSoloNative(native, source, solo)
+
+    private external fun setSourceSoloNative(player: Long, index: Int, solo: Boolean)
+
     fun startProcessing() = startProcessingNative(native)
 
     private external fun startProcessingNative(native: Long)
@@ -53,17 +110,79 @@ class PluginPlayer private constructor(private val native: Long) : AutoCloseable
 
     private external fun enableAudioRecorderNative(native: Long)
 
+    // Recording ("bouncing") the plugin output. MIDI2 streams are written to "$path.ump".
+    fun startRecording(path: String, recordMidi: Boolean = false) = startRecordingNative(native, path, recordMidi)
+
+    private external fun startRecordingNative(native: Long, path: String, recordMidi: Boolean): Boolean
+
+    fun stopRecording() = stopRecordingNative(native)
+
+    private external fun stopRecordingNative(native: Long)
+
+    val droppedRecordingBlocks: Long
+        get() = getNumDroppedRecordingBlocksNative(native)
+
+    private external fun getNumDroppedRecordingBlocksNative(native: Long): Long
+
+    // Metering the plugin output. Levels are updated every 50 milliseconds.
+    class MeterLevels(
+        // linear, per channel
+        val peaks: FloatArray,
+        // linear, per channel (300 milliseconds)
+        val rms: FloatArray,
+        // LUFS (3 seconds)
+        val shortTermLoudness: Float)
+
+    var meteringEnabled: Boolean = false
+        set(value) {
+            setMeteringEnabledNative(native, value)
+            field = value
+        }
+
+    private external fun setMeteringEnabledNative(native: Long, enabled: Boolean)
+
+    val meterLevels: MeterLevels
+        get() {
+            val values = getMeterLevelsNative(native)
+            val numChannels = (values.size - 1) / 2
+            return MeterLevels(values.copyOfRange(1, 1 + numChannels), values.copyOfRange(1 + numChannels, values.size), values[0])
+        }
+
+    private external fun getMeterLevelsNative(native: Long): FloatArray
+
     // MIDI events
 
     fun addMidiEvent(ump: Long) = addMidiEvent(Ump(ump))
 
     fun addMidiEvent(ump: Ump) = addMidiEvents(ump.toPlatformNativeBytes())
 
+    // timestampInNanoseconds is by System.nanoTime() (0 = now). Events are sent to the plugin one audio callback later,
+    // at the sample position that corresponds to the timestamp.
     fun addMidiEvents(bytes: ByteArray, offset: Int = 0, length: Int = bytes.size - offset, timestampInNanoseconds: Long = 0) =
         addMidiEventsNative(native, bytes, offset, length, timestampInNanoseconds)
 
     private external fun addMidiEventsNative(native: Long, bytes: ByteArray, offset: Int = 0, length: Int, timestampInNanoseconds: Long)
 
+    // MIDI output of the plugins: a UMP (in platform native byte order) at the frame position counted since the player
+    // was created. It is not reset by play or pause, so positions keep growing across them.
+    class MidiOutputEvent(val framePosition: Long, val ump: ByteArray)
+
+    // Drains the MIDI output of the plugins. Events that were not read in time are dropped (see droppedMidiOutputEvents).
+    fun readMidiOutput(maxEvents: Int = 256): List<MidiOutputEvent> {
+        val framePositions = LongArray(maxEvents)
+        val lengths = IntArray(maxEvents)
+        val umps = ByteArray(maxEvents * 16)
+        val size = readMidiOutputNative(native, framePositions, lengths, umps)
+        return (0 until size).map { MidiOutputEvent(framePositions[it], umps.copyOfRange(it * 16, it * 16 + lengths[it])) }
+    }
+
+    private external fun readMidiOutputNative(native: Long, framePositions: LongArray, lengths: IntArray, umps: ByteArray): Int
+
+    val droppedMidiOutputEvents: Long
+        get() = getNumDroppedMidiOutputEventsNative(native)
+
+    private external fun getNumDroppedMidiOutputEventsNative(native: Long): Long
+
     fun setParameterValue(parameterId: UInt, value: Float) {
         val ints = UmpHelper.aapUmpSysex8Parameter(parameterId, value)
         val umps = ints.filterIndexed { i, _ -> i % 4 == 0 }.flatMapIndexed { i, v ->
@@ -93,7 +212,8 @@ class PluginPlayer private constructor(private val native: Long) : AutoCloseable
     }
 
     // non-MIDI events
-    fun setPresetIndex(index: Int) = setPresetIndexNative(native, index)
+    // `pluginIndex` is the index of the plugin in the chain (see setPlugins()).
+    fun setPresetIndex(index: Int, pluginIndex: Int = 0) = setPresetIndexNative(native, pluginIndex, index)
 
-    private external fun setPresetIndexNative(native: Long, index: Int)
+    private external fun setPresetIndexNative(native: Long, pluginIndex: Int, index: Int)
 }
@@ -1,16 +1,123 @@
 #include <sys/mman.h>
+#include <cerrno>
+#include <cmath>
 #include <mutex>
 #include "aap/unstable/logging.h"
+#include "aap/unstable/tracing.h"
 #include "aap/ext/midi.h"
+#include "aap/core/host/audio-kernels.h"
 #include "AAPMidiProcessor.h"
 
 #define LOG_TAG "AAPMidiProcessor"
+// The largest audio output channel count (that fillAudioOutput() interleaves).
+#define AAP_MIDI_PROCESSOR_MAX_CHANNELS 8
+// The smallest plugin block size that AdaptiveBlockSizeController tries.
+#define AAP_MIDI_PROCESSOR_MIN_BLOCK_SIZE 64
+// The number of measurement windows (~seconds) during which a block size that caused overruns is not tried again.
+#define AAP_MIDI_PROCESSOR_FAILED_BLOCK_SIZE_COOLDOWN_WINDOWS 30
+// The number of consecutive windows without overruns before shrinking the block size.
+#define AAP_MIDI_PROCESSOR_STABLE_WINDOWS_TO_SHRINK 3
+// How long the audio thread waits for the process workers, in the duration of the block being processed.
+// The instruments that have not finished by then are silent for the block.
+#define AAP_MIDI_PROCESSOR_WORKER_TIMEOUT_BLOCKS 1
+// The ring buffer between the plugins and the device holds this many blocks of the maximum block size.
+#define AAP_MIDI_PROCESSOR_RING_BUFFER_BLOCKS 4
+// A device callback larger than this many blocks of the maximum block size is rendered in slices;
+// it must leave room for a block in the ring buffer.
+#define AAP_MIDI_PROCESSOR_MAX_SLICE_BLOCKS 2
+// JR timestamps are in 1/31250 seconds.
+#define AAP_MIDI_PROCESSOR_JR_TICKS_PER_SECOND 31250
 
 namespace aap::midi {
-    long last_delay_value = 0, worst_delay_value = 0;
-    long success_count = 0, failure_count = 0;
+    void AdaptiveBlockSizeController::configure(int32_t sampleRate, int32_t minBlockSize, int32_t maxBlockSize) {
+        sample_rate = sampleRate;
+        max_block_size = maxBlockSize;
+        min_block_size = std::min(minBlockSize, maxBlockSize);
+        // start from the safest setting.
+        block_size = maxBlockSize;
+    }
+
+    void AdaptiveBlockSizeController::onCallbackCompleted(int32_t numFrames, int64_t processNanoseconds) {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        double load = processNanoseconds * (double) sample_rate / (1000000000.0 * numFrames);
+        bool overrun = load > 1.0;
+
+        num_callbacks.fetch_add(1, relaxed);
+        if (overrun)
+            num_overruns.fetch_add(1, relaxed);
+        if (processNanoseconds > 0) {
+            last_process_time.store(processNanoseconds, relaxed);
+            if (processNanoseconds > worst_process_time.load(relaxed))
+                worst_process_time.store(processNanoseconds, relaxed);
+        }
+
+        window_frames += numFrames;
+        window_callbacks++;
+        window_overruns += overrun ? 1 : 0;
+        window_peak_load = std::max(window_peak_load, load);
+        window_max_callback_frames = std::max(window_max_callback_frames, numFrames);
+        if (window_frames < sample_rate)
+            return;
+
+        // end of the measurement window
+        peak_load.store((float) window_peak_load, relaxed);
+        if (failed_block_size_cooldown > 0 && --failed_block_size_cooldown == 0)
+            failed_block_size = 0;
+
+        auto current = block_size.load(relaxed);
+        auto next = current;
+        if (enabled.load(std::memory_order_relaxed)) {
+            if (window_overruns > target_overrun_rate * window_callbacks) {
+                stable_windows = 0;
+                if (current < window_max_callback_frames && current < max_block_size) {
+                    // per-process() overhead dominates: amortize it over larger blocks.
+                    failed_block_size = current;
+                    failed_block_size_cooldown = AAP_MIDI_PROCESSOR_FAILED_BLOCK_SIZE_COOLDOWN_WINDOWS;
+                    next = std::min(current * 2, max_block_size);
+                }
+                else if (current > window_max_callback_frames && current > min_block_size)
+                    // one block is processed in a callback much shorter than the block: spread it out.
+                    next = std::max(current / 2, min_block_size);
+            } else if (window_overruns == 0 && window_peak_load < 0.5) {
+                auto smaller = std::max(current / 2, min_block_size);
+                if (++stable_windows >= AAP_MIDI_PROCESSOR_STABLE_WINDOWS_TO_SHRINK &&
+                    smaller < current && smaller > failed_block_size) {
+                    next = smaller;
+                    stable_windows = 0;
+                }
+            } else
+                stable_windows = 0;
+        }
+        if (next != current) {
+            block_size.store(next, relaxed);
+            num_adaptations.fetch_add(1, relaxed);
+        }
+
+        window_frames = 0;
+        window_callbacks = 0;
+        window_overruns = 0;
+        window_max_callback_frames = 0;
+        window_peak_load = 0;
+    }
+
+    void AdaptiveBlockSizeController::getStatistics(AdaptiveBlockSizeStatistics& statistics) {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        statistics.block_size = block_size.load(relaxed);
+        statistics.min_block_size = min_block_size;
+        statistics.max_block_size = max_block_size;
+        statistics.num_adaptations = num_adaptations.load(relaxed);
+        statistics.num_callbacks = num_callbacks.load(relaxed);
+        statistics.num_overruns = num_overruns.load(relaxed);
+        statistics.last_process_time_nanoseconds = last_process_time.load(relaxed);
+        statistics.worst_process_time_nanoseconds = worst_process_time.load(relaxed);
+        statistics.peak_load = peak_load.load(relaxed);
+    }
 
     int32_t AAPMidiProcessor::processAudioIO(void *audioData, int32_t numFrames) {
+        // takes the ring reserved at activate(); no-op after the first callback on the thread.
+        aap::logging::registerRealtimeThread();
+        aap::trace::registerCurrentThread();
+
         if (state != AAP_MIDI_PROCESSOR_STATE_ACTIVE)
             // it is not supposed to process audio at this state.
             // It is still possible that it gets called between Oboe requestStart()
@@ -24,46 +131,70 @@ namespace aap::midi {
         //
         //  Each plugin process is still expected to fit within a callback time slice,
         //  so we still call plugin process() within the callback.
+        //
+        //  The plugin block size is adjusted by block_size_controller. When it is smaller than
+        //  the callback size, process() is called more than once.
 
         // FIXME: I don't think we need this ring buffer anymore but removing this still resulted in audio glitches.
-        if (zix_ring_read_space(aap_input_ring_buffer) < numFrames * channel_count * sizeof(float)) {
+        auto bytesPerFrame = channel_count * sizeof(float);
+        auto blockSize = block_size_controller.getBlockSize();
+        struct timespec callbackBegin{}, callbackEnd{};
+        clock_gettime(CLOCK_MONOTONIC, &callbackBegin);
+        bool processed = false;
+
+        // The ring buffer cannot hold a device callback that is larger than itself (it would never be filled,
+        // and the output would be silent forever). Such a callback is rendered in slices that fit in it.
+        const int32_t maxSliceFrames = aap_frame_size * AAP_MIDI_PROCESSOR_MAX_SLICE_BLOCKS;
+        if (numFrames > maxSliceFrames)
+            num_sliced_callbacks.fetch_add(1, std::memory_order_relaxed);
+        for (int32_t sliceStart = 0; sliceStart < numFrames; sliceStart += maxSliceFrames) {
+            auto sliceFrames = std::min(maxSliceFrames, numFrames - sliceStart);
+            auto sliceData = (uint8_t*) audioData + sliceStart * bytesPerFrame;
+
+            while (zix_ring_read_space(aap_input_ring_buffer) < sliceFrames * bytesPerFrame &&
+                   zix_ring_write_space(aap_input_ring_buffer) >= blockSize * bytesPerFrame) {
+                processed = true;
+                aap::trace::ScopedTrace trace{"aap::midi::AAPMidiProcessor_callPluginProcess"};
 
 #if ANDROID
-            struct timespec timeSpecBegin{}, timeSpecEnd{};
-            if (ATrace_isEnabled()) {
-                ATrace_beginSection("aap::midi::AAPMidiProcessor_callPluginProcess");
-                clock_gettime(CLOCK_REALTIME, &timeSpecBegin);
-            }
+                struct timespec timeSpecBegin{}, timeSpecEnd{};
+                if (ATrace_isEnabled()) {
+                    ATrace_beginSection("aap::midi::AAPMidiProcessor_callPluginProcess");
+                    clock_gettime(CLOCK_REALTIME, &timeSpecBegin);
+                }
 #endif
-            callPluginProcess();
+                pal()->pluginProcessStarting(rendered_frames, blockSize);
+                callPluginProcess();
+                rendered_frames += blockSize;
 
-            // recorded for later reference at MIDI message buffering.
-            clock_gettime(CLOCK_REALTIME, &last_aap_process_time);
+                // recorded for later reference at MIDI message buffering.
+                clock_gettime(CLOCK_REALTIME, &last_aap_process_time);
 
-            // observer performance. (end)
+                // observer performance. (end)
 #if ANDROID
-            if (ATrace_isEnabled()) {
-                clock_gettime(CLOCK_REALTIME, &timeSpecEnd);
-                ATrace_setCounter("aap::midi::AAPMidiProcessor_callPluginProcess",
-                                  (timeSpecEnd.tv_sec - timeSpecBegin.tv_sec) * 1000000000 +
-                                  timeSpecEnd.tv_nsec - timeSpecBegin.tv_nsec);
-                ATrace_endSection();
-
-                long diff = (timeSpecEnd.tv_sec - timeSpecBegin.tv_sec) * 1000000000 +
-                            timeSpecEnd.tv_nsec - timeSpecBegin.tv_nsec;
-                if (diff > 1000000) { // you took 1msec!?
-                    last_delay_value = diff;
-                    if (diff > worst_delay_value)
-                        worst_delay_value = diff;
-                    failure_count++;
-                } else success_count++;
-            }
+                if (ATrace_isEnabled()) {
+                    clock_gettime(CLOCK_REALTIME, &timeSpecEnd);
+                    ATrace_setCounter("aap::midi::AAPMidiProcessor_callPluginProcess",
+                                      (timeSpecEnd.tv_sec - timeSpecBegin.tv_sec) * 1000000000 +
+                                      timeSpecEnd.tv_nsec - timeSpecBegin.tv_nsec);
+                    ATrace_endSection();
+                }
 #endif
 
-            fillAudioOutput();
+                fillAudioOutput();
+            }
+
+            // output silence rather than garbage if the plugins could not fill it.
+            if (zix_ring_read(aap_input_ring_buffer, sliceData, sliceFrames * bytesPerFrame) == 0)
+                memset(sliceData, 0, sliceFrames * bytesPerFrame);
         }
 
-        zix_ring_read(aap_input_ring_buffer, audioData, numFrames * channel_count * sizeof(float));
+        int64_t processTime = 0;
+        if (processed) {
+            clock_gettime(CLOCK_MONOTONIC, &callbackEnd);
+            processTime = (callbackEnd.tv_sec - callbackBegin.tv_sec) * 1000000000LL + callbackEnd.tv_nsec - callbackBegin.tv_nsec;
+        }
+        block_size_controller.onCallbackCompleted(numFrames, processTime);
 
         // FIXME: can we terminate it when it goes quiet?
         return AudioCallbackResult::Continue;
@@ -80,15 +211,27 @@ namespace aap::midi {
 
         // AAP settings
         client = std::make_unique<aap::PluginClient>(connections, &plugin_list);
+#if !ANDROID
+        local_service = std::make_unique<aap::StandalonePluginService>();
+#endif
         sample_rate = sampleRate;
         aap_frame_size = aapFrameSize;
         midi_buffer_size = midiBufferSize;
+        if (audioOutChannelCount > AAP_MIDI_PROCESSOR_MAX_CHANNELS) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "audioOutChannelCount %d is not supported; using %d channels.",
+                         audioOutChannelCount, AAP_MIDI_PROCESSOR_MAX_CHANNELS);
+            audioOutChannelCount = AAP_MIDI_PROCESSOR_MAX_CHANNELS;
+        }
         channel_count = audioOutChannelCount;
         receiver_midi_protocol = midiTransport == 2 ? CMIDI2_PROTOCOL_TYPE_MIDI2 : CMIDI2_PROTOCOL_TYPE_MIDI1;
 
-        aap_input_ring_buffer = zix_ring_new(aap_frame_size * audioOutChannelCount * sizeof(float) * 2); // xx for ring buffering
+        block_size_controller.configure(sampleRate, AAP_MIDI_PROCESSOR_MIN_BLOCK_SIZE, aapFrameSize);
+
+        // the device callback size is not bound to aap_frame_size (larger callbacks are sliced at processAudioIO()).
+        aap_input_ring_buffer = zix_ring_new(aap_frame_size * audioOutChannelCount * sizeof(float) * AAP_MIDI_PROCESSOR_RING_BUFFER_BLOCKS);
         zix_ring_mlock(aap_input_ring_buffer);
         interleave_buffer = (float*) calloc(sizeof(float), aapFrameSize * audioOutChannelCount);
+        silence_buffer = (float*) calloc(sizeof(float), aapFrameSize);
 
         translation_buffer = (uint8_t*) calloc(1, midiBufferSize);
 
@@ -98,28 +241,45 @@ namespace aap::midi {
         pal()->setupStream();
     }
 
+    aap::PluginHost* AAPMidiProcessor::getPluginHost() {
+#if ANDROID
+        return client.get();
+#else
+        return local_service.get();
+#endif
+    }
+
     void AAPMidiProcessor::terminate() {
-        if (instance_data != nullptr) {
-            if (instance_data->instance_id >= 0) {
-                auto instance = client->getInstanceById(instance_data->instance_id);
+        for (auto& data : instance_data) {
+            if (data->instance_id >= 0) {
+                auto instance = getPluginHost()->getInstanceById(data->instance_id);
                 if (!instance)
                     aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "instance of instance_id %d was not found",
-                                 instance_data->instance_id);
-                else
-                    client->destroyInstance(instance);
+                                 data->instance_id);
+                else {
+                    if (instance->getInstanceState() == PLUGIN_INSTANTIATION_STATE_ACTIVE)
+                        instance->deactivate();
+                    getPluginHost()->destroyInstance(instance);
+                }
             }
             else
                 aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "detected unexpected instance_id: %d",
-                             instance_data->instance_id);
+                             data->instance_id);
         }
+        instance_data.clear();
         if (aap_input_ring_buffer)
             zix_ring_free(aap_input_ring_buffer);
         if (interleave_buffer)
             free(interleave_buffer);
+        if (silence_buffer)
+            free(silence_buffer);
         if (translation_buffer)
             free(translation_buffer);
 
         client.reset();
+#if !ANDROID
+        local_service.reset();
+#endif
 
         aap::a_log_f(AAP_LOG_LEVEL_INFO, LOG_TAG, "Successfully terminated MIDI processor.");
     }
@@ -141,24 +301,20 @@ namespace aap::midi {
     }
 
     // Instantiate AAP plugin and proceed up to prepare().
-    void AAPMidiProcessor::instantiatePlugin(std::string pluginId) {
+    void AAPMidiProcessor::instantiatePlugin(std::string pluginId, InstrumentZone zone) {
         aap::a_log_f(AAP_LOG_LEVEL_INFO, LOG_TAG, "instantiating plugin %s", pluginId.c_str());
 
-        if (state != AAP_MIDI_PROCESSOR_STATE_CREATED) {
+        // more instruments can be added until it gets activated.
+        if (state != AAP_MIDI_PROCESSOR_STATE_CREATED && state != AAP_MIDI_PROCESSOR_STATE_INACTIVE) {
             aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Unexpected call to instantiatePlugin() at %s state.",
                          convertStateToText(state).c_str());
             state = AAP_MIDI_PROCESSOR_STATE_ERROR;
             return;
         }
 
-        if (instance_data) {
-            const auto& instance = client->getInstanceById(instance_data->instance_id);
-            if (instance)
-                aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "There is an already instantiated plugin \"%s\" for this MidiDeviceService.",
-                             instance->getPluginInformation()->getDisplayName().c_str());
-            else
-                aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Internal error: stale plugin instance data remains in the memory.",
-                             instance->getPluginInformation()->getDisplayName().c_str());
+        if (zone.lowest_key < 0 || zone.highest_key > 127 || zone.lowest_key > zone.highest_key) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Invalid key range for plugin \"%s\": %d - %d",
+                         pluginId.c_str(), zone.lowest_key, zone.highest_key);
             state = AAP_MIDI_PROCESSOR_STATE_ERROR;
             return;
         }
@@ -177,7 +333,8 @@ namespace aap::midi {
         }
 
         aap::a_log_f(AAP_LOG_LEVEL_INFO, LOG_TAG, "host is going to instantiate %s", pluginId.c_str());
-        std::function<void(std::string&)> cb = [&](std::string& error) {
+#if ANDROID
+        std::function<void(std::string&)> cb = [this, pluginId, pluginInfo, zone](std::string& error) {
             if (!error.empty()) {
                 aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG,R"(Plugin service for "%s" ("%s") could not be connected.)",
                              pluginInfo->getDisplayName().c_str(), pluginInfo->getPluginPackageName().c_str());
@@ -191,54 +348,64 @@ namespace aap::midi {
                 state = AAP_MIDI_PROCESSOR_STATE_ERROR;
                 return;
             }
-            auto instanceId = result.value;
-            auto instance = dynamic_cast<aap::RemotePluginInstance*>(client->getInstanceById(instanceId));
+            auto instance = dynamic_cast<aap::RemotePluginInstance*>(client->getInstanceById(result.value));
             if (!instance) {
                 aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG,"Plugin \"%s\" could not be instantiated",
                              pluginInfo->getDisplayName().c_str());
                 state = AAP_MIDI_PROCESSOR_STATE_ERROR;
                 return;
             }
-
-            instrument_instance_id = instanceId;
-
-            int32_t numPorts = instance->getNumPorts();
-            auto data = std::make_unique<PluginInstanceData>(instanceId, numPorts);
-
-            data->instance_id = instanceId;
-
-            for (int i = 0; i < numPorts; i++) {
-                auto port = instance->getPort(i);
-                if (port->getContentType() == AAP_CONTENT_TYPE_AUDIO &&
-                    port->getPortDirection() == AAP_PORT_DIRECTION_OUTPUT)
-                    data->getAudioOutPorts()->emplace_back(i);
-                else if (port->getContentType() == AAP_CONTENT_TYPE_MIDI2 &&
-                         port->getPortDirection() == AAP_PORT_DIRECTION_INPUT)
-                    data->midi2_in_port = i;
-                else if (port->getContentType() == AAP_CONTENT_TYPE_MIDI &&
-                         port->getPortDirection() == AAP_PORT_DIRECTION_INPUT)
-                    data->midi1_in_port = i;
-            }
-
             instance->prepare(aap_frame_size);
-
-            instance_data = std::move(data);
-
-            state = AAP_MIDI_PROCESSOR_STATE_INACTIVE;
-
-            aap::a_log_f(AAP_LOG_LEVEL_INFO, LOG_TAG, "instantiated plugin %s", pluginId.c_str());
+            addInstrument(instance, zone);
         };
         client->connectToPluginService(pluginId, cb);
+#else
+        auto instance = local_service->instantiate(pluginInfo, sample_rate);
+        auto error = instance ? local_service->setupInstance(instance, aap_frame_size) : std::string{"dlopen() failed"};
+        if (!error.empty()) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG,"Plugin \"%s\" could not be instantiated due to: %s",
+                         pluginInfo->getDisplayName().c_str(), error.c_str());
+            state = AAP_MIDI_PROCESSOR_STATE_ERROR;
+            return;
+        }
+        // setupInstance() activates it; activate() does it again when the processor gets activated.
+        instance->deactivate();
+        addInstrument(instance, zone);
+#endif
     }
 
-    // Note that it is an expensive operation so we cache it at activate().
-    int32_t AAPMidiProcessor::getInstrumentMidiMappingPolicy() {
-        for (int i = 0; i < client->getInstanceCount(); i++) {
-            auto instance = client->getInstanceByIndex(i);
-            if (instance->getPluginInformation()->isInstrument())
-                return instance->getStandardExtensions().getMidiMappingPolicy();
+    void AAPMidiProcessor::addInstrument(aap::PluginInstance* instance, InstrumentZone zone) {
+        int32_t numPorts = instance->getNumPorts();
+        auto data = std::make_unique<PluginInstanceData>(instance->getInstanceId(), numPorts);
+
+        data->instance = instance;
+        data->zone = zone;
+
+        for (int i = 0; i < numPorts; i++) {
+            auto port = instance->getPort(i);
+            if (port->getContentType() == AAP_CONTENT_TYPE_AUDIO &&
+                port->getPortDirection() == AAP_PORT_DIRECTION_OUTPUT)
+                data->getAudioOutPorts()->emplace_back(i);
+            else if (port->getContentType() == AAP_CONTENT_TYPE_MIDI2 &&
+                     port->getPortDirection() == AAP_PORT_DIRECTION_INPUT)
+                data->midi2_in_port = i;
+            else if (port->getContentType() == AAP_CONTENT_TYPE_MIDI &&
+                     port->getPortDirection() == AAP_PORT_DIRECTION_INPUT)
+                data->midi1_in_port = i;
         }
-        return 0;
+
+        instance_data.emplace_back(std::move(data));
+
+        state = AAP_MIDI_PROCESSOR_STATE_INACTIVE;
+
+        aap::a_log_f(AAP_LOG_LEVEL_INFO, LOG_TAG, "instantiated plugin %s",
+                     instance->getPluginInformation()->getPluginID().c_str());
+    }
+
+    int32_t AAPMidiProcessor::getInstrumentMidiMappingPolicy(size_t instrumentIndex) {
+        if (instrumentIndex >= instance_data.size())
+            return 0;
+        return instance_data[instrumentIndex]->instance->getStandardExtensions().getMidiMappingPolicy();
     }
 
     // Activate audio processing. Starts audio (oboe) streaming, CPU-intensive operations happen from here.
@@ -250,8 +417,13 @@ namespace aap::midi {
             return;
         }
 
-        current_mapping_policy = getInstrumentMidiMappingPolicy();
+        // each instrument maps the MIDI inputs in its zone by its own policy.
+        for (size_t i = 0; i < instance_data.size(); i++)
+            instance_data[i]->mapping_policy = getInstrumentMidiMappingPolicy(i);
 
+        rendered_frames = 0;
+        // for the audio callback thread, which registers itself at the first callback.
+        aap::logging::reserveRealtimeThreads(1);
         auto startStreamingResult = pal()->startStreaming();
         if (startStreamingResult) {
             aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "startStreaming() failed with error code %d.",
@@ -261,8 +433,13 @@ namespace aap::midi {
         }
 
         // activate instances
-        for (int i = 0; i < client->getInstanceCount(); i++)
-            client->getInstanceByIndex(i)->activate();
+        for (auto& data : instance_data)
+            data->instance->activate();
+
+        sem_init(&process_done_semaphore, 0, 0);
+        process_workers_scheduled = false;
+        for (size_t i = 1; i < instance_data.size(); i++)
+            process_workers.emplace_back(std::make_unique<PluginProcessWorker>(instance_data[i].get(), &process_done_semaphore));
 
         state = AAP_MIDI_PROCESSOR_STATE_ACTIVE;
     }
@@ -276,42 +453,223 @@ namespace aap::midi {
             return;
         }
 
-        // deactivate AAP instances
-        for (int i = 0; i < client->getInstanceCount(); i++)
-            client->getInstanceByIndex(i)->deactivate();
-
+        // No instance can be deactivated while it may still be processing: stop the audio callbacks first,
+        // then join the workers (which finish the block they are processing, even after a timeout).
         pal()->stopStreaming();
 
+        process_workers.clear();
+        sem_destroy(&process_done_semaphore);
+
+        // deactivate AAP instances
+        for (auto& data : instance_data)
+            data->instance->deactivate();
+
         state = AAP_MIDI_PROCESSOR_STATE_INACTIVE;
     }
 
+    PluginProcessWorker::PluginProcessWorker(PluginInstanceData* instanceData, sem_t* doneSemaphore)
+            : data(instanceData), done(doneSemaphore) {
+        sem_init(&start, 0, 0);
+        thread = std::thread([this] { run(); });
+    }
+
+    PluginProcessWorker::~PluginProcessWorker() {
+        alive = false;
+        sem_post(&start);
+        thread.join();
+        sem_destroy(&start);
+    }
+
+    void PluginProcessWorker::run() {
+        while (true) {
+            while (sem_wait(&start) != 0) {} // retry on EINTR
+            if (!alive)
+                break;
+            data->instance->process(frame_size, 1000000000);
+            data->processing.store(false, std::memory_order_release);
+            sem_post(done);
+        }
+    }
+
+    static inline bool isInZone(cmidi2_ump* ump, const InstrumentZone& zone) {
+        auto messageType = cmidi2_ump_get_message_type(ump);
+        if (messageType != CMIDI2_MESSAGE_TYPE_MIDI_1_CHANNEL && messageType != CMIDI2_MESSAGE_TYPE_MIDI_2_CHANNEL)
+            return true;
+        if ((zone.channel_mask & (1 << cmidi2_ump_get_channel(ump))) == 0)
+            return false;
+        switch (cmidi2_ump_get_status_code(ump)) {
+            case CMIDI2_STATUS_NOTE_OFF:
+            case CMIDI2_STATUS_NOTE_ON:
+            case CMIDI2_STATUS_PAF:
+            case CMIDI2_STATUS_PER_NOTE_RCC:
+            case CMIDI2_STATUS_PER_NOTE_ACC:
+            case CMIDI2_STATUS_PER_NOTE_PITCH_BEND:
+            case CMIDI2_STATUS_PER_NOTE_MANAGEMENT: {
+                auto key = cmidi2_ump_get_byte_at(ump, 2);
+                return zone.lowest_key <= key && key <= zone.highest_key;
+            }
+        }
+        return true;
+    }
+
+    // Translates a parameter change (CC, or NRPN/per-note ACC) to an AAP parameter SysEx8 (16 bytes) at `dst`,
+    // if the mapping `policy` says so. Returns false if it is not a mapped parameter change.
+    static inline bool mapParameterChange(cmidi2_ump* ump, int32_t policy, uint32_t* dst) {
+        if (cmidi2_ump_get_message_type(ump) != CMIDI2_MESSAGE_TYPE_MIDI_2_CHANNEL)
+            return false;
+        int32_t parameterIndex = -1;
+        uint32_t parameterValueI32 = 0;
+        int32_t parameterKey = 0;
+        int32_t parameterExtra = 0;
+        switch (cmidi2_ump_get_status_code(ump)) {
+            case CMIDI2_STATUS_CC:
+                if ((policy & AAP_PARAMETERS_MAPPING_POLICY_CC) != 0) {
+                    parameterIndex = cmidi2_ump_get_midi2_cc_index(ump);
+                    parameterValueI32 = cmidi2_ump_get_midi2_cc_data(ump);
+                }
+                break;
+            case CMIDI2_STATUS_PER_NOTE_ACC:
+                if ((policy & AAP_PARAMETERS_MAPPING_POLICY_ACC) != 0 &&
+                    (policy & AAP_PARAMETERS_MAPPING_POLICY_SYSEX8) == 0)
+                    parameterKey = cmidi2_ump_get_midi2_pnacc_note(ump);
+                // no break; go to case CMIDI2_STATUS_NRPN
+            case CMIDI2_STATUS_NRPN:
+                if ((policy & AAP_PARAMETERS_MAPPING_POLICY_ACC) != 0 &&
+                    (policy & AAP_PARAMETERS_MAPPING_POLICY_SYSEX8) == 0) {
+                    parameterIndex = cmidi2_ump_get_midi2_nrpn_msb(ump) * 0x80 +
+                                     cmidi2_ump_get_midi2_nrpn_lsb(ump);
+                    parameterValueI32 = cmidi2_ump_get_midi2_nrpn_data(ump);
+                }
+                break;
+        }
+        if (parameterIndex < 0)
+            return false;
+        aapMidi2ParameterSysex8(dst, dst + 1, dst + 2, dst + 3,
+                                cmidi2_ump_get_group(ump), cmidi2_ump_get_channel(ump), parameterKey, parameterExtra, parameterIndex, *(float*) (void*) &parameterValueI32);
+        return true;
+    }
+
+    void AAPMidiProcessor::routeMidiInput(AAPMidiBufferHeader* srcBuffer, PluginInstanceData* data) {
+        auto dstBuffer = (AAPMidiBufferHeader*) getAAPMidiInputBuffer(data);
+        dstBuffer->time_options = 0; // reserved in MIDI2 mode
+        auto dst = (uint8_t*) (dstBuffer + 1);
+        auto& zone = data->zone;
+        auto policy = data->mapping_policy;
+        bool mapsParameters = (policy & (AAP_PARAMETERS_MAPPING_POLICY_CC | AAP_PARAMETERS_MAPPING_POLICY_ACC)) != 0;
+        if (!mapsParameters && zone.lowest_key == 0 && zone.highest_key == 127 && zone.channel_mask == 0xFFFF) {
+            if (srcBuffer->length)
+                memcpy(dst, srcBuffer + 1, srcBuffer->length);
+            dstBuffer->length = srcBuffer->length;
+            return;
+        }
+        // JR timestamps and non-channel messages are passed to every instrument, so that the timing is kept.
+        // Parameter changes are mapped only for the instrument in whose zone they are.
+        int portIndex = getAAPMidiInputPortType(data) == CMIDI2_PROTOCOL_TYPE_MIDI2 ? data->midi2_in_port : data->midi1_in_port;
+        auto b = data->instance->getAudioPluginBuffer();
+        auto capacity = (uint32_t) b->get_buffer_size(*b, portIndex) - sizeof(AAPMidiBufferHeader);
+        uint32_t length = 0;
+        void* src = srcBuffer + 1;
+        CMIDI2_UMP_SEQUENCE_FOREACH(src, srcBuffer->length, iter) {
+            auto ump = (cmidi2_ump*) iter;
+            if (!isInZone(ump, zone))
+                continue;
+            // a mapped message (SysEx8) is larger than the source; drop the rest rather than overrunning.
+            if (length + 16 > capacity)
+                break;
+            if (mapsParameters && mapParameterChange(ump, policy, (uint32_t*) (dst + length)))
+                length += 16;
+            else {
+                auto size = cmidi2_ump_get_message_size_bytes(ump);
+                memcpy(dst + length, ump, size);
+                length += size;
+            }
+        }
+        dstBuffer->length = length;
+    }
+
     int32_t failed_plugin_process_count;
     // Called by Oboe audio callback implementation. It calls process.
     void AAPMidiProcessor::callPluginProcess() {
+        if (instance_data.empty()) {
+            // It's not ready to process audio yet.
+            if (failed_plugin_process_count++ < 10)
+                aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "callPluginProcess() failed. Plugin instance data Not ready uet.");
+            return;
+        }
 
-        auto dstBuffer = (AAPMidiBufferHeader*) getAAPMidiInputBuffer();
-        if (std::unique_lock<NanoSleepLock> tryLock(midi_buffer_mutex, std::try_to_lock); tryLock.owns_lock()) {
-            auto srcBuffer = (AAPMidiBufferHeader*) midi_input_buffer;
-            if (srcBuffer->length)
-                memcpy(dstBuffer + 1, srcBuffer + 1, srcBuffer->length);
-            dstBuffer->length = srcBuffer->length;
+        if (!process_workers_scheduled) {
+            scheduleProcessWorkers();
+            process_workers_scheduled = true;
+        }
+
+        auto blockSize = block_size_controller.getBlockSize();
+        struct timespec deadline{};
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        int64_t deadlineNanoseconds = deadline.tv_nsec +
+                AAP_MIDI_PROCESSOR_WORKER_TIMEOUT_BLOCKS * 1000000000LL * blockSize / sample_rate;
+        deadline.tv_sec += deadlineNanoseconds / 1000000000;
+        deadline.tv_nsec = deadlineNanoseconds % 1000000000;
+
+        // An instrument that is still processing an earlier block (after a timeout) owns its buffers;
+        // it neither receives MIDI inputs nor processes this block.
+        for (auto& data : instance_data)
+            data->skipped = data->processing.load(std::memory_order_acquire);
+
+        auto srcBuffer = (AAPMidiBufferHeader*) midi_input_buffer;
+        if (std::unique_lock<AdaptiveMutex> tryLock(midi_buffer_mutex, std::try_to_lock); tryLock.owns_lock()) {
+            for (auto& data : instance_data)
+                if (!data->skipped)
+                    routeMidiInput(srcBuffer, data.get());
             srcBuffer->length = 0;
+            midi_input_ticks = 0;
         } else {
             // failed to acquire lock; we do not send anything this time.
-            dstBuffer->length = 0;
+            for (auto& data : instance_data)
+                if (!data->skipped)
+                    ((AAPMidiBufferHeader*) getAAPMidiInputBuffer(data.get()))->length = 0;
         }
-        dstBuffer->time_options = 0; // reserved in MIDI2 mode
 
-        auto data = instance_data.get();
-        if (!data) {
-            // It's not ready to process audio yet.
-            if (failed_plugin_process_count++ < 10)
-                aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "callPluginProcess() failed. Plugin instance data Not ready uet.");
+        // the other instruments are processed on the workers while the first one is processed here.
+        for (size_t i = 0; i < process_workers.size(); i++)
+            if (!instance_data[i + 1]->skipped)
+                process_workers[i]->requestProcess(blockSize);
+        instance_data[0]->instance->process(blockSize, 1000000000);
+        waitForProcessWorkers(deadline);
+    }
+
+    void AAPMidiProcessor::scheduleProcessWorkers() {
+        int policy;
+        sched_param param{};
+        if (pthread_getschedparam(pthread_self(), &policy, &param) != 0)
+            return;
+        if (policy != SCHED_FIFO && policy != SCHED_RR)
+            // the audio thread is not realtime (e.g. the stub driver); there is nothing to match.
             return;
+        for (auto& worker : process_workers) {
+            auto error = worker->setSchedulingPolicy(SCHED_FIFO, param);
+            if (error != 0) {
+                // typically EPERM, without the privilege. The workers keep the default priority.
+                aap::a_log_f(AAP_LOG_LEVEL_WARN, LOG_TAG,
+                             "Could not set SCHED_FIFO priority %d to the process workers (error %d).",
+                             param.sched_priority, error);
+                return;
+            }
         }
+    }
 
-        auto instance = client->getInstanceById(data->instance_id);
-        instance->process(aap_frame_size, 1000000000);
+    void AAPMidiProcessor::waitForProcessWorkers(const struct timespec& deadline) {
+        // The semaphore may also count late completions from the earlier blocks, so `processing` is what we check.
+        for (size_t i = 1; i < instance_data.size(); i++) {
+            auto& data = instance_data[i];
+            while (data->processing.load(std::memory_order_acquire)) {
+                if (sem_timedwait(&process_done_semaphore, &deadline) != 0 && errno == ETIMEDOUT) {
+                    // the instruments that are still processing are silent for this block (see fillAudioOutput()).
+                    if (data->processing.load(std::memory_order_acquire))
+                        num_worker_timeouts.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
     }
 
     int32_t failed_audio_output_count{0};
@@ -320,44 +678,43 @@ namespace aap::midi {
     //  fill the audio outputs into an intermediate buffer, interleaving the results,
     //  then copied into the ring buffer.
     void AAPMidiProcessor::fillAudioOutput() {
-        // FIXME: the final processing result should not be the instrument instance output buffer
-        //  but should be chained output result. Right now we don't support chaining.
+        // The outputs of all the instruments (layers and splits) are mixed down.
 
-        memset(interleave_buffer, 0, channel_count * aap_frame_size * sizeof(float));
+        auto blockSize = block_size_controller.getBlockSize();
 
-        auto data = instance_data.get();
-        if (!data) {
+        if (instance_data.empty()) {
+            memset(interleave_buffer, 0, channel_count * blockSize * sizeof(float));
             // It's not ready to process audio yet.
             if (failed_audio_output_count++ < 10)
                 aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "fillAudioOutput() for Oboe audio callback failed. Plugin instance data Not ready uet.");
             return;
         }
-        else
-            failed_audio_output_count = 0;
+        failed_audio_output_count = 0;
 
-        if (data->instance_id == instrument_instance_id) {
+        bool first = true;
+        for (auto& data : instance_data) {
+            if (data->skipped || data->processing.load(std::memory_order_acquire))
+                continue;
             int numPorts = data->getAudioOutPorts()->size();
-            auto instance = client->getInstanceById(data->instance_id);
-            auto b = instance->getAudioPluginBuffer();
-            for (int p = 0; p < numPorts; p++) {
-                int portIndex = data->getAudioOutPorts()->at(p);
-                auto src = (float*) b->get_buffer(*b, portIndex);
-                // We have to interleave separate port outputs to copy...
-                for (int i = 0; i < aap_frame_size; i++)
-                    interleave_buffer[i * numPorts + p] = src[i];
+            auto b = data->instance->getAudioPluginBuffer();
+            const float* channels[AAP_MIDI_PROCESSOR_MAX_CHANNELS];
+            for (int ch = 0; ch < channel_count; ch++) {
+                // a mono instrument goes to all the channels, and missing channels are silent.
+                int p = numPorts == 1 ? 0 : ch;
+                channels[ch] = p < numPorts ? (const float*) b->get_buffer(*b, data->getAudioOutPorts()->at(p)) : silence_buffer;
             }
-            failed_audio_output_count = 0;
-        } else {
-            if (failed_audio_output_count++ < 10)
-                aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "fillAudioOutput() is invoked while there is no instrument plugin instantiated.");
-            return;
+            // We have to interleave separate port outputs to copy...
+            if (first)
+                aap::kernels::interleave(channels, interleave_buffer, channel_count, blockSize);
+            else
+                aap::kernels::interleaveAdd(channels, interleave_buffer, channel_count, blockSize);
+            first = false;
         }
 
-        zix_ring_write(aap_input_ring_buffer, interleave_buffer, channel_count * aap_frame_size * sizeof(float));
+        zix_ring_write(aap_input_ring_buffer, interleave_buffer, channel_count * blockSize * sizeof(float));
     }
 
-    int32_t AAPMidiProcessor::getAAPMidiInputPortType() {
-        auto data = instance_data.get();
+    int32_t AAPMidiProcessor::getAAPMidiInputPortType(PluginInstanceData* data) {
         if (!data) {
             AAP_ASSERT_FALSE;
             return 0;
@@ -372,84 +729,33 @@ namespace aap::midi {
             CMIDI2_PROTOCOL_TYPE_MIDI2;
     }
 
-    void* AAPMidiProcessor::getAAPMidiInputBuffer() {
-        auto data = instance_data.get();
+    void* AAPMidiProcessor::getAAPMidiInputBuffer(PluginInstanceData* data) {
         if (!data) {
             AAP_ASSERT_FALSE;
             return nullptr;
         }
-        int portIndex = getAAPMidiInputPortType() == CMIDI2_PROTOCOL_TYPE_MIDI2 ? data->midi2_in_port : data->midi1_in_port;
-        auto instance = client->getInstanceById(data->instance_id);
-        auto b = instance->getAudioPluginBuffer();
+        int portIndex = getAAPMidiInputPortType(data) == CMIDI2_PROTOCOL_TYPE_MIDI2 ? data->midi2_in_port : data->midi1_in_port;
+        auto b = data->instance->getAudioPluginBuffer();
         return b->get_buffer(*b, portIndex);
     }
 
-    size_t AAPMidiProcessor::runThroughMidi2UmpForMidiMapping(uint8_t* bytes, size_t offset, size_t length) {
-        int32_t translatedIndex = 0;
+    void AAPMidiProcessor::runThroughMidi2UmpForPresetMapping(uint8_t* bytes, size_t offset, size_t length) {
         CMIDI2_UMP_SEQUENCE_FOREACH(bytes + offset, length, iter) {
             auto ump = (cmidi2_ump*) iter;
-            int32_t parameterIndex = -1;
-            uint32_t parameterValueI32 = 0;
-            int32_t parameterKey = 0;
-            int32_t parameterExtra = 0;
-            int32_t presetIndex = -1;
-            switch (cmidi2_ump_get_message_type(ump)) {
-                case CMIDI2_MESSAGE_TYPE_MIDI_2_CHANNEL:
-                    switch (cmidi2_ump_get_status_code(ump)) {
-                        case CMIDI2_STATUS_CC:
-                            if ((current_mapping_policy & AAP_PARAMETERS_MAPPING_POLICY_CC) != 0) {
-                                parameterIndex = cmidi2_ump_get_midi2_cc_index(ump);
-                                parameterValueI32 = cmidi2_ump_get_midi2_cc_data(ump);
-                            }
-                            break;
-                        case CMIDI2_STATUS_PER_NOTE_ACC:
-                            if ((current_mapping_policy & AAP_PARAMETERS_MAPPING_POLICY_ACC) != 0 &&
-                                    (current_mapping_policy & AAP_PARAMETERS_MAPPING_POLICY_SYSEX8) == 0)
-                                parameterKey = cmidi2_ump_get_midi2_pnacc_note(ump);
-                            // no break; go to case CMIDI2_STATUS_NRPN
-                        case CMIDI2_STATUS_NRPN:
-                            if ((current_mapping_policy & AAP_PARAMETERS_MAPPING_POLICY_ACC) != 0 &&
-                                (current_mapping_policy & AAP_PARAMETERS_MAPPING_POLICY_SYSEX8) == 0) {
-                                parameterIndex = cmidi2_ump_get_midi2_nrpn_msb(ump) * 0x80 +
-                                        cmidi2_ump_get_midi2_nrpn_lsb(ump);
-                                parameterValueI32 = cmidi2_ump_get_midi2_nrpn_data(ump);
-                            }
-                            break;
-                        case CMIDI2_STATUS_PROGRAM:
-                            // unless the plugin requires it to be passed directly, treat them as preset setter.
-                            if ((current_mapping_policy & AAP_PARAMETERS_MAPPING_POLICY_PROGRAM) == 0) {
-                                bool bankValid = (cmidi2_ump_get_midi2_program_options(ump) & CMIDI2_PROGRAM_CHANGE_OPTION_BANK_VALID) != 0;
-                                auto bank = bankValid ?
-                                        cmidi2_ump_get_midi2_program_bank_msb(ump) * 0x80 +
-                                        cmidi2_ump_get_midi2_program_bank_lsb(ump) : 0;
-                                presetIndex = cmidi2_ump_get_midi2_program_program(ump) + bank * 0x80;
-                            }
-                            break;
-                    }
-                    break;
-            }
-            if (presetIndex >= 0) {
-                for (int i = 0; i < client->getInstanceCount(); i++) {
-                    auto instance = client->getInstanceByIndex(i);
-                    if (instance->getPluginInformation()->isInstrument())
-                        instance->getStandardExtensions().setCurrentPresetIndex(presetIndex);
-                }
-            }
-            // If a translated AAP parameter change message is detected, then output sysex8.
-            if (parameterIndex < 0) {
-                auto size = cmidi2_ump_get_message_size_bytes(ump);
-                memcpy(translation_buffer + translatedIndex, ump, size);
-                translatedIndex += size;
-            }
-            else {
-                auto intBuf = (uint32_t*) ((uint8_t*) translation_buffer + translatedIndex);
-                aapMidi2ParameterSysex8(intBuf, intBuf + 1, intBuf + 2, intBuf + 3,
-                                        cmidi2_ump_get_group(ump), cmidi2_ump_get_channel(ump), parameterKey, parameterExtra, parameterIndex, *(float*) (void*) &parameterValueI32);
-                translatedIndex += 16;
+            if (cmidi2_ump_get_message_type(ump) != CMIDI2_MESSAGE_TYPE_MIDI_2_CHANNEL ||
+                cmidi2_ump_get_status_code(ump) != CMIDI2_STATUS_PROGRAM)
+                continue;
+            bool bankValid = (cmidi2_ump_get_midi2_program_options(ump) & CMIDI2_PROGRAM_CHANGE_OPTION_BANK_VALID) != 0;
+            auto bank = bankValid ?
+                    cmidi2_ump_get_midi2_program_bank_msb(ump) * 0x80 +
+                    cmidi2_ump_get_midi2_program_bank_lsb(ump) : 0;
+            auto presetIndex = cmidi2_ump_get_midi2_program_program(ump) + bank * 0x80;
+            for (auto& data : instance_data) {
+                // unless the plugin requires it to be passed directly, treat them as preset setter.
+                if (isInZone(ump, data->zone) && (data->mapping_policy & AAP_PARAMETERS_MAPPING_POLICY_PROGRAM) == 0)
+                    data->instance->getStandardExtensions().setCurrentPresetIndex(presetIndex);
             }
         }
-        memcpy(bytes + offset, translation_buffer, translatedIndex);
-        return translatedIndex;
     }
 
     int32_t detectEndpointConfigurationMessage(uint8_t* bytes, size_t offset, size_t length) {
@@ -489,7 +795,7 @@ namespace aap::midi {
             context.midi_protocol = CMIDI2_PROTOCOL_TYPE_MIDI2;
             context.midi1_num_bytes = length;
             context.ump = (cmidi2_ump*) translation_buffer;
-            context.ump_num_bytes = sizeof(translation_buffer);
+            context.ump_num_bytes = midi_buffer_size;
             context.group = 0;
 
             auto result = cmidi2_convert_midi1_to_ump(&context);
@@ -503,6 +809,16 @@ namespace aap::midi {
         return 0;
     }
 
+    size_t AAPMidiProcessor::prepareMidiInput(uint8_t* bytes, size_t offset, size_t length, int64_t timestampInNanoseconds) {
+        pal()->midiInputReceived(bytes, offset, length, timestampInNanoseconds);
+
+        size_t translated = translateMidiBufferIfNeeded(bytes, offset, length);
+        if (translated > 0)
+            length = translated;
+        runThroughMidi2UmpForPresetMapping(bytes, offset, length);
+        return length;
+    }
+
     void AAPMidiProcessor::processMidiInput(uint8_t* bytes, size_t offset, size_t length, int64_t timestampInNanoseconds) {
         // This function is invoked every time Android MidiReceiver.onSend() is invoked, immediately.
         // On the other hand, AAPs don't process MIDI messages immediately, so we have to buffer
@@ -515,50 +831,41 @@ namespace aap::midi {
         int64_t actualTimestamp = timestampInNanoseconds;
         struct timespec curtime{};
         clock_gettime(CLOCK_REALTIME, &curtime);
-        pal()->midiInputReceived(bytes, offset, length, timestampInNanoseconds);
-
-        size_t translated = translateMidiBufferIfNeeded(bytes, offset, length);
-        if (translated > 0)
-            length = translated;
-        translated = runThroughMidi2UmpForMidiMapping(bytes, offset, length);
-        if (translated > 0)
-            length = translated;
+        length = prepareMidiInput(bytes, offset, length, timestampInNanoseconds);
 
         // it is 99.999... percent true since audio loop must have started before any MIDI events...
         if (last_aap_process_time.tv_sec > 0) {
             int64_t diff = (curtime.tv_sec - last_aap_process_time.tv_sec) * 1000000000 +
                         curtime.tv_nsec - last_aap_process_time.tv_nsec;
-            auto nanosecondsPerCycle = (int64_t) (1.0 * aap_frame_size / sample_rate * 1000000000);
+            auto nanosecondsPerCycle = (int64_t) (1.0 * block_size_controller.getBlockSize() / sample_rate * 1000000000);
             actualTimestamp = (timestampInNanoseconds + diff) % nanosecondsPerCycle;
         }
 
-        {
-            const std::lock_guard<NanoSleepLock> lock{midi_buffer_mutex};
-
-            auto dst8 = (uint8_t *) midi_input_buffer;
-            auto dstMBH = (AAPMidiBufferHeader *) dst8;
-            if (dst8 != nullptr) {
-                uint32_t savedOffset = dstMBH->length;
-                uint32_t currentOffset = savedOffset;
-                int32_t tIter = 0;
-                auto headerSize = sizeof(AAPMidiBufferHeader);
-                for (int64_t ticks = actualTimestamp / (1000000000 / 31250);
-                     ticks > 0; ticks -= 31250, tIter++) {
-                    *(int32_t *) (dst8 + headerSize + currentOffset + tIter * 4) =
-                            (int32_t) cmidi2_ump_jr_timestamp_direct(0,
-                                                                     ticks > 31250 ? 31250 : ticks);
-                }
-                currentOffset += tIter * 4;
-                memcpy(dst8 + headerSize + currentOffset, bytes + offset, length);
-                currentOffset += length;
-
-                if (savedOffset != dstMBH->length) {
-                    // updated
-                    memcpy(dst8 + headerSize, dst8 + headerSize + savedOffset, length);
-                    dstMBH->length = currentOffset - savedOffset;
-                } else
-                    dstMBH->length = currentOffset;
-            }
-        }
+        enqueueMidiInput(bytes, offset, length, actualTimestamp / (1000000000 / AAP_MIDI_PROCESSOR_JR_TICKS_PER_SECOND));
+    }
+
+    void AAPMidiProcessor::processMidiInputAtFrame(uint8_t* bytes, size_t offset, size_t length, int32_t frameOffset) {
+        length = prepareMidiInput(bytes, offset, length, (int64_t) (frameOffset * 1000000000.0 / sample_rate));
+        enqueueMidiInput(bytes, offset, length, llround((double) frameOffset * AAP_MIDI_PROCESSOR_JR_TICKS_PER_SECOND / sample_rate));
+    }
+
+    void AAPMidiProcessor::enqueueMidiInput(uint8_t* bytes, size_t offset, size_t length, int64_t ticks) {
+        const std::lock_guard<AdaptiveMutex> lock{midi_buffer_mutex};
+
+        auto dst8 = (uint8_t *) midi_input_buffer + sizeof(AAPMidiBufferHeader);
+        auto dstMBH = (AAPMidiBufferHeader *) midi_input_buffer;
+        // JR timestamps are deltas; the inputs that arrive late for the block are processed at the current position.
+        int64_t deltaTicks = std::max((int64_t) 0, ticks - midi_input_ticks);
+        auto numTimestamps = (deltaTicks + AAP_MIDI_PROCESSOR_JR_TICKS_PER_SECOND - 1) / AAP_MIDI_PROCESSOR_JR_TICKS_PER_SECOND;
+        if (dstMBH->length + numTimestamps * 4 + length > sizeof(midi_input_buffer) - sizeof(AAPMidiBufferHeader))
+            return; // the buffer is full until the next plugin block; drop it rather than overrunning.
+
+        uint32_t currentOffset = dstMBH->length;
+        for (; deltaTicks > 0; deltaTicks -= AAP_MIDI_PROCESSOR_JR_TICKS_PER_SECOND, currentOffset += 4)
+            *(int32_t *) (dst8 + currentOffset) = (int32_t) cmidi2_ump_jr_timestamp_direct(0,
+                    deltaTicks > AAP_MIDI_PROCESSOR_JR_TICKS_PER_SECOND ? AAP_MIDI_PROCESSOR_JR_TICKS_PER_SECOND : deltaTicks);
+        midi_input_ticks = std::max(midi_input_ticks, ticks);
+        memcpy(dst8 + currentOffset, bytes + offset, length);
+        dstMBH->length = currentOffset + length;
     }
 }
@@ -2,7 +2,11 @@
 #ifndef AAP_MIDI_DEVICE_SERVICE_AAPMIDIPROCESSOR_H
 #define AAP_MIDI_DEVICE_SERVICE_AAPMIDIPROCESSOR_H
 
+#include <atomic>
+#include <thread>
 #include <vector>
+#include <pthread.h>
+#include <semaphore.h>
 #include <zix/ring.h>
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-variable"
@@ -12,6 +16,7 @@
 #pragma clang diagnostic pop
 #include <aap/core/host/audio-plugin-host.h>
 #include <aap/core/aapxs/extension-service.h>
+#include <aap/ext/midi.h>
 #include <aap/unstable/utility.h>
 
 namespace aap::midi {
@@ -30,6 +35,10 @@ namespace aap::midi {
         // It is kind of raw MIDI input event listener (not a "handler" that overrides processing).
         // The Android Stub implementation would override this to dump the messages to Android log.
         virtual void midiInputReceived(uint8_t* bytes, size_t offset, size_t length, int64_t timestampInNanoseconds) {}
+        // Called on the audio thread right before the plugins process the frames [framePosition, framePosition + numFrames)
+        // (counted from activate()). A driver that knows the exact frames of its MIDI inputs (e.g. a file renderer)
+        // can pass them here by `AAPMidiProcessor::processMidiInputAtFrame()`.
+        virtual void pluginProcessStarting(int64_t framePosition, int32_t numFrames) {}
     };
 
     enum AudioDriverType {
@@ -51,6 +60,15 @@ namespace aap::midi {
         AAP_MIDI_TRANSLATION_TYPE_2To1
     };
 
+    // The range of MIDI inputs that an instrument receives, for layering and split setups.
+    // Channel voice messages outside the range are not passed to the instrument; everything else is.
+    struct InstrumentZone {
+        int32_t lowest_key{0};
+        int32_t highest_key{127};
+        // bit N corresponds to MIDI channel N (in any group).
+        uint16_t channel_mask{0xFFFF};
+    };
+
     class PluginInstanceData {
         std::vector<int> audio_out_ports{};
 
@@ -64,6 +82,112 @@ namespace aap::midi {
         int instance_id;
         int midi1_in_port{-1};
         int midi2_in_port{-1};
+        InstrumentZone zone{};
+        // the MIDI mapping policy of the instrument, retrieved at activate().
+        int32_t mapping_policy{AAP_PARAMETERS_MAPPING_POLICY_NONE};
+        aap::PluginInstance* instance{nullptr};
+        // true while its process() is running on a PluginProcessWorker.
+        std::atomic<bool> processing{false};
+        // (audio thread only) its process() for an earlier block was still running when the current block began,
+        // so it does not process the current block.
+        bool skipped{false};
+    };
+
+    // Runs process() of one instrument on its own thread, so that all the instruments
+    // (whose process() calls are independent IPCs) are processed concurrently.
+    // The audio thread waits for them, so they should run at its priority (see setSchedulingPolicy()).
+    class PluginProcessWorker {
+        PluginInstanceData* data;
+        int32_t frame_size{0};
+        sem_t* done;
+        sem_t start{};
+        bool alive{true};
+        std::thread thread;
+
+        void run();
+
+    public:
+        PluginProcessWorker(PluginInstanceData* instanceData, sem_t* doneSemaphore);
+        ~PluginProcessWorker();
+
+        // kicks process(). Completion is notified to the `done` semaphore (and `processing` gets false).
+        void requestProcess(int32_t frameSize) {
+            frame_size = frameSize;
+            data->processing.store(true, std::memory_order_release);
+            sem_post(&start);
+        }
+
+        // applies the scheduling policy and priority (of the audio thread) to the worker thread.
+        // Returns the error code of pthread_setschedparam().
+        int setSchedulingPolicy(int policy, const sched_param& param) {
+            return pthread_setschedparam(thread.native_handle(), policy, &param);
+        }
+    };
+
+    // Diagnostics of AdaptiveBlockSizeController.
+    struct AdaptiveBlockSizeStatistics {
+        int32_t block_size{0};
+        int32_t min_block_size{0};
+        int32_t max_block_size{0};
+        int32_t num_adaptations{0};
+        uint64_t num_callbacks{0};
+        // callbacks whose plugin processing took longer than the callback duration (i.e. likely xruns).
+        uint64_t num_overruns{0};
+        int64_t last_process_time_nanoseconds{0};
+        int64_t worst_process_time_nanoseconds{0};
+        // the highest processing time / callback duration ratio in the last measurement window.
+        float peak_load{0};
+    };
+
+    /**
+     * Picks the smallest plugin block size that keeps the overrun rate under the target.
+     *
+     * Plugins are prepared for the maximum block size and then process() the current block size,
+     * so that changing it does not need any re-preparation.
+     * It measures every audio callback and decides in windows of (about) one second:
+     * it doubles the block size when the overrun rate exceeds the target, and halves it after
+     * a few windows without overruns and with enough headroom. A block size that caused overruns
+     * is not tried again for a while.
+     *
+     * The measurement and the adaptation happen on the audio thread; statistics can be read from any thread.
+     */
+    class AdaptiveBlockSizeController {
+        int32_t sample_rate{48000};
+        int32_t min_block_size{64};
+        int32_t max_block_size{1024};
+        double target_overrun_rate{0.001};
+        // it can be switched from any thread while the audio thread adapts.
+        std::atomic<bool> enabled{true};
+        std::atomic<int32_t> block_size{1024};
+
+        // measurement window (audio thread only)
+        int64_t window_frames{0};
+        int32_t window_callbacks{0};
+        int32_t window_overruns{0};
+        int32_t window_max_callback_frames{0};
+        double window_peak_load{0};
+        int32_t stable_windows{0};
+        int32_t failed_block_size{0};
+        int32_t failed_block_size_cooldown{0};
+
+        std::atomic<int32_t> num_adaptations{0};
+        std::atomic<uint64_t> num_callbacks{0};
+        std::atomic<uint64_t> num_overruns{0};
+        std::atomic<int64_t> last_process_time{0};
+        std::atomic<int64_t> worst_process_time{0};
+        std::atomic<float> peak_load{0};
+
+    public:
+        void configure(int32_t sampleRate, int32_t minBlockSize, int32_t maxBlockSize);
+        void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+        void setTargetOverrunRate(double rate) { target_overrun_rate = rate; }
+
+        inline int32_t getBlockSize() { return block_size.load(std::memory_order_relaxed); }
+
+        // Records an audio callback of `numFrames` that spent `processNanoseconds` in plugin processing.
+        void onCallbackCompleted(int32_t numFrames, int64_t processNanoseconds);
+
+        void getStatistics(AdaptiveBlockSizeStatistics& statistics);
     };
 
     class AAPMidiProcessor {
@@ -72,19 +196,43 @@ namespace aap::midi {
         // AAP
         aap::PluginListSnapshot plugin_list{};
         std::unique_ptr<aap::PluginClient> client{nullptr};
+#if !ANDROID
+        // There is no plugin service on desktop; the instruments are instantiated in-process.
+        std::unique_ptr<aap::StandalonePluginService> local_service{nullptr};
+#endif
         int32_t sample_rate{0};
+        // the maximum plugin block size; the actual block size is determined by block_size_controller.
         int32_t aap_frame_size{1024};
+        AdaptiveBlockSizeController block_size_controller{};
         int32_t midi_buffer_size{4096};
         int32_t channel_count{2};
-        std::unique_ptr<PluginInstanceData> instance_data{nullptr};
-        int32_t instrument_instance_id{0};
+        std::vector<std::unique_ptr<PluginInstanceData>> instance_data{};
+        // process workers for instance_data[1..]; instance_data[0] is processed on the audio thread.
+        std::vector<std::unique_ptr<PluginProcessWorker>> process_workers{};
+        sem_t process_done_semaphore{};
+        // whether the scheduling policy of the audio thread is applied to process_workers (at the first callback).
+        bool process_workers_scheduled{false};
+        // the number of times the audio thread gave up waiting for a worker (the instrument is silent for the block).
+        std::atomic<uint64_t> num_worker_timeouts{0};
+        // device callbacks that were too large for the ring buffer and were rendered in slices.
+        std::atomic<uint64_t> num_sliced_callbacks{0};
         // MIDI protocol type of the messages it receives via JNI
         int32_t receiver_midi_protocol{CMIDI2_PROTOCOL_TYPE_MIDI1};
-        int32_t current_mapping_policy{AAP_PARAMETERS_MAPPING_POLICY_NONE};
 
-        int32_t getAAPMidiInputPortType();
-        PluginInstanceData* getAAPMidiInputData();
-        void* getAAPMidiInputBuffer();
+        // the host that owns the instruments.
+        aap::PluginHost* getPluginHost();
+        // adds the instance to the instruments, once it is prepared.
+        void addInstrument(aap::PluginInstance* instance, InstrumentZone zone);
+
+        int32_t getAAPMidiInputPortType(PluginInstanceData* data);
+        void* getAAPMidiInputBuffer(PluginInstanceData* data);
+        // copies the MIDI inputs that are in the zone of the instance to its MIDI input buffer,
+        // translating parameter changes to AAP SysEx8 as per its mapping policy.
+        void routeMidiInput(AAPMidiBufferHeader* srcBuffer, PluginInstanceData* data);
+        // gives process_workers the scheduling policy and priority of the calling audio thread.
+        void scheduleProcessWorkers();
+        // waits for the process_workers that are processing, until `deadline` (CLOCK_REALTIME).
+        void waitForProcessWorkers(const struct timespec& deadline);
         // used when we need MIDI1<->UMP translation.
         uint8_t* translation_buffer{nullptr};
 
@@ -92,17 +240,28 @@ namespace aap::midi {
         // returns 0 if translation did not happen. Otherwise return the size of translated buffer in translation_buffer.
         size_t translateMidiBufferIfNeeded(uint8_t* bytes, size_t offset, size_t length);
 
-        // If needed, process MIDI mapping for parameters (CC/ACC/PNACC to sysex8) and presets (program).
-        // returns 0 if translation did not happen. Otherwise return the size of translated buffer in translation_buffer.
-        size_t runThroughMidi2UmpForMidiMapping(uint8_t* bytes, size_t offset, size_t length);
+        // If needed, process MIDI mapping for presets (program changes), for the instruments in whose zone they are.
+        // (Parameter changes are mapped per instrument at routeMidiInput().)
+        void runThroughMidi2UmpForPresetMapping(uint8_t* bytes, size_t offset, size_t length);
 
         // Outputs
         ZixRing *aap_input_ring_buffer{nullptr};
         float *interleave_buffer{nullptr};
+        // zeroes, for the output channels that an instrument does not have.
+        float *silence_buffer{nullptr};
         struct timespec last_aap_process_time{0, 0};
 
-        NanoSleepLock midi_buffer_mutex{};
+        AdaptiveMutex midi_buffer_mutex{};
         uint8_t midi_input_buffer[4096];
+        // JR timestamp ticks that are already in midi_input_buffer (guarded by midi_buffer_mutex).
+        int64_t midi_input_ticks{0};
+        // frames that the plugins have processed since activate() (audio thread only).
+        int64_t rendered_frames{0};
+
+        // Translates and maps the input in place, returning the new length.
+        size_t prepareMidiInput(uint8_t* bytes, size_t offset, size_t length, int64_t timestampInNanoseconds);
+        // Appends the UMPs to midi_input_buffer, `ticks` after the beginning of the next plugin block.
+        void enqueueMidiInput(uint8_t* bytes, size_t offset, size_t length, int64_t ticks);
 
     protected:
         AAPMidiProcessorState state{AAP_MIDI_PROCESSOR_STATE_CREATED};
@@ -113,14 +272,24 @@ namespace aap::midi {
                         int32_t sampleRate, int32_t channelCount,
                         int32_t aapFrameSize, int32_t midiBufferSize, int32_t midiMessageFormat);
 
-        void instantiatePlugin(std::string pluginId);
+        // Instantiates an instrument. It can be called more than once to layer or split instruments
+        // (until activate()); each instrument receives the MIDI inputs in its `zone`.
+        void instantiatePlugin(std::string pluginId, InstrumentZone zone = {});
+
+        inline size_t getInstrumentCount() { return instance_data.size(); }
 
-        int32_t getInstrumentMidiMappingPolicy();
+        // Note that it is an expensive operation so we cache it at activate().
+        int32_t getInstrumentMidiMappingPolicy(size_t instrumentIndex);
 
         void activate();
 
         void processMidiInput(uint8_t* bytes, size_t offset, size_t length, int64_t timestampInNanoseconds);
 
+        // Frame-exact version of processMidiInput(): the input is processed `frameOffset` frames after the beginning
+        // of the next plugin block, without any adjustment by the wall clock time. It is meant to be called from
+        // `AAPMidiProcessorPAL::pluginProcessStarting()`, so that the result does not depend on timing (e.g. freewheeling).
+        void processMidiInputAtFrame(uint8_t* bytes, size_t offset, size_t length, int32_t frameOffset);
+
         void callPluginProcess();
 
         void fillAudioOutput();
@@ -131,9 +300,19 @@ namespace aap::midi {
 
         int32_t processAudioIO(void *audioData, int32_t numFrames);
 
+        inline AAPMidiProcessorState getState() { return state; }
+
+        inline int32_t getSampleRate() { return sample_rate; }
+
         inline int32_t getChannelCount() { return channel_count; }
 
         inline int32_t getAAPFrameSize() { return aap_frame_size; }
+
+        inline AdaptiveBlockSizeController& getBlockSizeController() { return block_size_controller; }
+
+        inline uint64_t getWorkerTimeoutCount() { return num_worker_timeouts.load(std::memory_order_relaxed); }
+
+        inline uint64_t getSlicedCallbackCount() { return num_sliced_callbacks.load(std::memory_order_relaxed); }
     };
 }
 
@@ -17,7 +17,8 @@ int32_t AAPMidiProcessorOboePAL::setupStream() {
         // channels should be processed by plugin framework itself, but in case its output is mono
         // and the audio output is stereo in the end, there is no reason to refuse it.
         ->setChannelConversionAllowed(true)
-        ->setFramesPerDataCallback(owner->getAAPFrameSize())
+        // The callback size is not tied to the plugin block size (which is adaptive); the ring buffer
+        // in AAPMidiProcessor absorbs the difference.
         ->setDataCallback(callback.get());
 
     return 0;
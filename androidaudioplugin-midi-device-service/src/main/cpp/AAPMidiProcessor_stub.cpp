@@ -0,0 +1,388 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include "aap/unstable/logging.h"
+#include "AAPMidiProcessor_stub.h"
+
+#define LOG_TAG "AAPMidiProcessorStub"
+#define AAP_WAV_HEADER_SIZE 44
+#define AAP_SMF_DEFAULT_TEMPO 500000 // microseconds per quarter note
+
+namespace aap::midi {
+
+    // Standard MIDI File -------------------------------------------------------------------------
+
+    namespace {
+        struct SmfEvent {
+            int64_t tick;
+            uint32_t track_order; // keeps the order of simultaneous events
+            int32_t tempo; // > 0 for tempo changes (no bytes)
+            uint32_t offset;
+            uint32_t length;
+        };
+
+        struct SmfReader {
+            const uint8_t* p;
+            const uint8_t* end;
+
+            bool available(size_t n) { return (size_t) (end - p) >= n; }
+            uint32_t readBE(int32_t n) {
+                uint32_t v = 0;
+                for (int32_t i = 0; i < n; i++)
+                    v = (v << 8) | *p++;
+                return v;
+            }
+            bool readVLQ(uint32_t& v) {
+                v = 0;
+                for (int32_t i = 0; i < 4; i++) {
+                    if (!available(1))
+                        return false;
+                    uint8_t b = *p++;
+                    v = (v << 7) | (b & 0x7F);
+                    if (!(b & 0x80))
+                        return true;
+                }
+                return false;
+            }
+        };
+    }
+
+    static bool readSmfTrack(SmfReader r, uint32_t& order, std::vector<SmfEvent>& events, std::vector<uint8_t>& bytes) {
+        int64_t tick = 0;
+        uint8_t runningStatus = 0;
+        while (r.available(1)) {
+            uint32_t delta;
+            if (!r.readVLQ(delta) || !r.available(1))
+                return false;
+            tick += delta;
+            uint8_t status = *r.p;
+            if (status & 0x80)
+                r.p++;
+            else if (runningStatus)
+                status = runningStatus;
+            else
+                return false;
+
+            if (status == 0xFF) {
+                if (!r.available(1))
+                    return false;
+                uint8_t type = *r.p++;
+                uint32_t length;
+                if (!r.readVLQ(length) || !r.available(length))
+                    return false;
+                if (type == 0x2F) // end of track
+                    return true;
+                if (type == 0x51 && length == 3)
+                    events.emplace_back(SmfEvent{tick, order++, (int32_t) r.readBE(3), 0, 0});
+                else
+                    r.p += length;
+            } else if (status == 0xF0 || status == 0xF7) {
+                uint32_t length;
+                if (!r.readVLQ(length) || !r.available(length))
+                    return false;
+                auto offset = (uint32_t) bytes.size();
+                // F0 is omitted in the file; F7 "escapes" carry raw bytes.
+                if (status == 0xF0)
+                    bytes.emplace_back(0xF0);
+                bytes.insert(bytes.end(), r.p, r.p + length);
+                r.p += length;
+                events.emplace_back(SmfEvent{tick, order++, 0, offset, (uint32_t) bytes.size() - offset});
+                runningStatus = 0;
+            } else if (status >= 0x80 && status < 0xF0) {
+                runningStatus = status;
+                int32_t dataSize = (status & 0xE0) == 0xC0 ? 1 : 2;
+                if (!r.available(dataSize))
+                    return false;
+                auto offset = (uint32_t) bytes.size();
+                bytes.emplace_back(status);
+                bytes.insert(bytes.end(), r.p, r.p + dataSize);
+                r.p += dataSize;
+                events.emplace_back(SmfEvent{tick, order++, 0, offset, (uint32_t) (1 + dataSize)});
+            } else
+                return false; // system common/realtime messages are not valid in SMF.
+        }
+        return true;
+    }
+
+    bool loadStandardMidiFile(const char* path, std::vector<StubMidiEvent>& events, std::vector<uint8_t>& bytes) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Cannot open MIDI file %s", path);
+            return false;
+        }
+        std::vector<uint8_t> data{};
+        uint8_t chunk[4096];
+        size_t size;
+        while ((size = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            data.insert(data.end(), chunk, chunk + size);
+        fclose(file);
+
+        SmfReader r{data.data(), data.data() + data.size()};
+        if (!r.available(14) || memcmp(r.p, "MThd", 4) != 0) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "%s is not a Standard MIDI File", path);
+            return false;
+        }
+        r.p += 4;
+        auto headerSize = r.readBE(4);
+        auto format = r.readBE(2);
+        auto numTracks = r.readBE(2);
+        auto division = r.readBE(2);
+        bool validDivision = (division & 0x8000) ? (-(int8_t) (division >> 8)) > 0 && (division & 0xFF) > 0 : division > 0;
+        if (headerSize < 6 || format > 1 || !validDivision || !r.available(headerSize - 6)) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "%s: unsupported SMF format %d", path, format);
+            return false;
+        }
+        r.p += headerSize - 6;
+
+        std::vector<SmfEvent> smfEvents{};
+        std::vector<uint8_t> smfBytes{};
+        uint32_t order = 0;
+        for (uint32_t t = 0; t < numTracks && r.available(8); t++) {
+            bool isTrack = memcmp(r.p, "MTrk", 4) == 0;
+            r.p += 4;
+            auto length = r.readBE(4);
+            if (!r.available(length))
+                return false;
+            if (isTrack && !readSmfTrack(SmfReader{r.p, r.p + length}, order, smfEvents, smfBytes)) {
+                aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "%s: track %d is broken", path, t);
+                return false;
+            }
+            r.p += length;
+        }
+        std::sort(smfEvents.begin(), smfEvents.end(), [](const SmfEvent& a, const SmfEvent& b) {
+            return a.tick != b.tick ? a.tick < b.tick : a.track_order < b.track_order;
+        });
+
+        // ticks to nanoseconds, following the tempo map (or SMPTE frames).
+        bool smpte = (division & 0x8000) != 0;
+        double nanosecondsPerTick = smpte ?
+                1000000000.0 / (-(int8_t) (division >> 8) * (division & 0xFF)) :
+                AAP_SMF_DEFAULT_TEMPO * 1000.0 / division;
+        int64_t lastTick = 0;
+        double nanoseconds = 0;
+        events.clear();
+        bytes = std::move(smfBytes);
+        for (auto& e : smfEvents) {
+            nanoseconds += (e.tick - lastTick) * nanosecondsPerTick;
+            lastTick = e.tick;
+            if (e.tempo > 0) {
+                if (!smpte)
+                    nanosecondsPerTick = e.tempo * 1000.0 / division;
+            } else
+                events.emplace_back(StubMidiEvent{(int64_t) nanoseconds, e.offset, e.length});
+        }
+        return true;
+    }
+
+    // WAV output ---------------------------------------------------------------------------------
+
+    static void writeLE16(uint8_t* p, uint16_t v) { p[0] = (uint8_t) v; p[1] = (uint8_t) (v >> 8); }
+    static void writeLE32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (uint8_t) (v >> (i * 8)); }
+
+    static void buildWavHeader(uint8_t* header, int32_t sampleRate, int32_t numChannels, int64_t numFrames) {
+        auto dataSize = (uint32_t) (numFrames * numChannels * sizeof(float));
+        memcpy(header, "RIFF", 4);
+        writeLE32(header + 4, 36 + dataSize);
+        memcpy(header + 8, "WAVEfmt ", 8);
+        writeLE32(header + 16, 16);
+        writeLE16(header + 20, 3); // IEEE float
+        writeLE16(header + 22, (uint16_t) numChannels);
+        writeLE32(header + 24, (uint32_t) sampleRate);
+        writeLE32(header + 28, (uint32_t) (sampleRate * numChannels * sizeof(float)));
+        writeLE16(header + 32, (uint16_t) (numChannels * sizeof(float)));
+        writeLE16(header + 34, 32);
+        memcpy(header + 36, "data", 4);
+        writeLE32(header + 40, dataSize);
+    }
+
+    // AAPMidiProcessorStubPAL --------------------------------------------------------------------
+
+    AAPMidiProcessorStubPAL::~AAPMidiProcessorStubPAL() {
+        if (render_thread)
+            stopStreaming();
+    }
+
+    int32_t AAPMidiProcessorStubPAL::setupStream() {
+        sample_rate = owner->getSampleRate();
+        channel_count = owner->getChannelCount();
+        if (sample_rate <= 0 || channel_count <= 0 || frames_per_callback <= 0) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Invalid stream settings: sampleRate %d, channels %d, framesPerCallback %d",
+                         sample_rate, channel_count, frames_per_callback);
+            return -1;
+        }
+        audio_buffer.resize((size_t) frames_per_callback * channel_count);
+        return 0;
+    }
+
+    int32_t AAPMidiProcessorStubPAL::startStreaming() {
+        if (render_thread) {
+            AAP_ASSERT_FALSE;
+            return -1;
+        }
+        if (!output_wav_path.empty()) {
+            wav_file = fopen(output_wav_path.c_str(), "wb");
+            if (!wav_file) {
+                aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Cannot create WAV file %s", output_wav_path.c_str());
+                return -1;
+            }
+            uint8_t header[AAP_WAV_HEADER_SIZE];
+            buildWavHeader(header, sample_rate, channel_count, 0);
+            fwrite(header, 1, sizeof(header), wav_file);
+            wav_frames_written = 0;
+        }
+        if (freewheel)
+            owner->getBlockSizeController().setEnabled(false);
+        statistics = {};
+        next_midi_event = 0;
+        // every note-on could be pending in the worst case; allocate here, not on the rendering thread.
+        pending_note_on_frames.reserve(midi_events.size());
+        pending_note_on_frames.clear();
+        pending_note_on_head = 0;
+        finished = false;
+        alive = true;
+        render_thread = std::make_unique<std::thread>([this] { runRenderingLoop(); });
+        return 0;
+    }
+
+    int32_t AAPMidiProcessorStubPAL::stopStreaming() {
+        if (!render_thread) {
+            // it is fine if the rendering has finished and waitForCompletion() joined it.
+            if (finished)
+                return 0;
+            AAP_ASSERT_FALSE;
+            return -1;
+        }
+        alive = false;
+        waitForCompletion();
+        return 0;
+    }
+
+    void AAPMidiProcessorStubPAL::waitForCompletion() {
+        if (render_thread && render_thread->joinable())
+            render_thread->join();
+        render_thread.reset();
+
+        if (wav_file) {
+            uint8_t header[AAP_WAV_HEADER_SIZE];
+            buildWavHeader(header, sample_rate, channel_count, wav_frames_written);
+            fseek(wav_file, 0, SEEK_SET);
+            fwrite(header, 1, sizeof(header), wav_file);
+            fclose(wav_file);
+            wav_file = nullptr;
+        }
+    }
+
+    void AAPMidiProcessorStubPAL::dispatchMidiEvents(int64_t blockStartFrame, int32_t numFrames, bool frameExact) {
+        for (; next_midi_event < midi_events.size(); next_midi_event++) {
+            auto& e = midi_events[next_midi_event];
+            auto eventFrame = (int64_t) (e.timestamp_nanoseconds * (double) sample_rate / 1000000000.0);
+            if (eventFrame >= blockStartFrame + numFrames)
+                break;
+            if (e.length > sizeof(midi_event_buffer)) {
+                statistics.midi_events_skipped++;
+                continue;
+            }
+            // processMidiInput() translates the message in place (into larger UMPs), so pass a copy,
+            // like the JNI receiver does.
+            memcpy(midi_event_buffer, midi_bytes.data() + e.offset, e.length);
+            bool isNoteOn = (midi_event_buffer[0] & 0xF0) == 0x90 && e.length > 2 && midi_event_buffer[2] > 0;
+            // the timestamp is relative to the beginning of the block.
+            auto frameOffset = (int32_t) std::max((int64_t) 0, eventFrame - blockStartFrame);
+            if (frameExact)
+                owner->processMidiInputAtFrame(midi_event_buffer, 0, e.length, frameOffset);
+            else
+                owner->processMidiInput(midi_event_buffer, 0, e.length, (int64_t) (frameOffset * 1000000000.0 / sample_rate));
+            statistics.midi_events_dispatched++;
+            if (isNoteOn && pending_note_on_frames.size() < pending_note_on_frames.capacity())
+                pending_note_on_frames.emplace_back(blockStartFrame + frameOffset);
+        }
+    }
+
+    void AAPMidiProcessorStubPAL::pluginProcessStarting(int64_t framePosition, int32_t numFrames) {
+        if (freewheel)
+            dispatchMidiEvents(framePosition, numFrames, true);
+    }
+
+    void AAPMidiProcessorStubPAL::recordLatency(int64_t frames) {
+        auto& s = statistics;
+        s.min_latency_frames = s.num_latency_measurements == 0 ? frames : std::min(s.min_latency_frames, frames);
+        s.max_latency_frames = std::max(s.max_latency_frames, frames);
+        s.average_latency_frames = (s.average_latency_frames * s.num_latency_measurements + frames) / (s.num_latency_measurements + 1);
+        s.num_latency_measurements++;
+    }
+
+    // The first audible frame at or after a note-on is taken as its response. All the note-ons before
+    // that frame are resolved at once (their sounds cannot be told apart).
+    void AAPMidiProcessorStubPAL::measureLatency(int64_t blockStartFrame) {
+        for (int32_t i = 0; i < frames_per_callback && pending_note_on_head < pending_note_on_frames.size(); i++) {
+            auto frame = blockStartFrame + i;
+            if (pending_note_on_frames[pending_note_on_head] > frame)
+                continue;
+            bool audible = false;
+            for (int32_t ch = 0; ch < channel_count; ch++)
+                audible |= std::abs(audio_buffer[i * channel_count + ch]) > audible_threshold;
+            if (!audible)
+                continue;
+            while (pending_note_on_head < pending_note_on_frames.size() && pending_note_on_frames[pending_note_on_head] <= frame)
+                recordLatency(frame - pending_note_on_frames[pending_note_on_head++]);
+        }
+    }
+
+    void AAPMidiProcessorStubPAL::runRenderingLoop() {
+        auto framesPerCallbackDuration = std::chrono::nanoseconds((int64_t) (frames_per_callback * 1000000000.0 / sample_rate));
+        int64_t endFrame = max_frames;
+        if (endFrame < 0) {
+            int64_t lastEventFrame = midi_events.empty() ? 0 :
+                    (int64_t) (midi_events.back().timestamp_nanoseconds * (double) sample_rate / 1000000000.0);
+            endFrame = lastEventFrame + (tail_frames < 0 ? sample_rate : tail_frames);
+        }
+
+        // startStreaming() is called before the processor becomes ACTIVE, and processAudioIO() does
+        // nothing until then. Do not let freewheeling run through the song in the meantime.
+        while (alive && owner->getState() != AAP_MIDI_PROCESSOR_STATE_ACTIVE)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        int64_t frame = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start;
+        while (alive && frame < endFrame) {
+            if (!freewheel)
+                dispatchMidiEvents(frame, frames_per_callback, false);
+
+            // processAudioIO() does not touch the buffer until the processor gets activated.
+            std::fill(audio_buffer.begin(), audio_buffer.end(), 0.0f);
+            auto callbackStart = std::chrono::steady_clock::now();
+            owner->processAudioIO(audio_buffer.data(), frames_per_callback);
+            auto callbackTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - callbackStart).count();
+            statistics.num_callbacks++;
+            statistics.total_callback_nanoseconds += callbackTime;
+            statistics.worst_callback_nanoseconds = std::max(statistics.worst_callback_nanoseconds, callbackTime);
+
+            measureLatency(frame);
+            if (wav_file) {
+                auto numFrames = (int32_t) std::min((int64_t) frames_per_callback, endFrame - frame);
+                fwrite(audio_buffer.data(), sizeof(float) * channel_count, numFrames, wav_file);
+                wav_frames_written += numFrames;
+            }
+            frame += frames_per_callback;
+            statistics.frames_rendered = std::min(frame, endFrame);
+
+            if (!freewheel) {
+                deadline += framesPerCallbackDuration;
+                std::this_thread::sleep_until(deadline);
+            }
+        }
+        statistics.elapsed_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        finished = true;
+
+        aap::a_log_f(AAP_LOG_LEVEL_INFO, LOG_TAG,
+                     "Rendered %lld frames in %.3f seconds (%.1fx realtime). Callbacks: %lld (worst %lld ns). MIDI events: %lld (%lld skipped). Latency: %d measurements, min %lld / avg %.1f / max %lld frames",
+                     (long long) statistics.frames_rendered, statistics.elapsed_nanoseconds / 1000000000.0,
+                     statistics.elapsed_nanoseconds > 0 ? statistics.frames_rendered * 1000000000.0 / sample_rate / statistics.elapsed_nanoseconds : 0.0,
+                     (long long) statistics.num_callbacks, (long long) statistics.worst_callback_nanoseconds,
+                     (long long) statistics.midi_events_dispatched, (long long) statistics.midi_events_skipped,
+                     statistics.num_latency_measurements,
+                     (long long) statistics.min_latency_frames, statistics.average_latency_frames, (long long) statistics.max_latency_frames);
+    }
+}
@@ -0,0 +1,145 @@
+
+#ifndef AAP_MIDI_DEVICE_SERVICE_AAPMIDIPROCESSOR_STUB_H
+#define AAP_MIDI_DEVICE_SERVICE_AAPMIDIPROCESSOR_STUB_H
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AAPMidiProcessor.h"
+
+// The same size as the JNI receiver buffer. The event is translated to UMP in place, so it needs room for that.
+#define AAP_MIDI_PROCESSOR_STUB_MIDI_EVENT_BUFFER_SIZE 1024
+
+namespace aap::midi {
+
+    // A MIDI 1.0 message to replay, `timestamp_nanoseconds` after the beginning of the rendering.
+    // The message bytes are stored at [`offset`, `offset` + `length`) of a shared byte array.
+    struct StubMidiEvent {
+        int64_t timestamp_nanoseconds;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // Loads the channel messages and sysex messages of a Standard MIDI File (format 0 or 1),
+    // with the tempo changes applied to the timestamps. Returns false if it is not a valid SMF.
+    bool loadStandardMidiFile(const char* path, std::vector<StubMidiEvent>& events, std::vector<uint8_t>& bytes);
+
+    struct StubAudioDriverStatistics {
+        int64_t frames_rendered{0};
+        int64_t num_callbacks{0};
+        int64_t midi_events_dispatched{0};
+        // messages longer than AAP_MIDI_PROCESSOR_STUB_MIDI_EVENT_BUFFER_SIZE (e.g. huge sysex) are not dispatched.
+        int64_t midi_events_skipped{0};
+        int64_t elapsed_nanoseconds{0};
+        int64_t total_callback_nanoseconds{0};
+        int64_t worst_callback_nanoseconds{0};
+        // MIDI-to-audio latency: frames from a note-on dispatch until the output becomes audible.
+        int32_t num_latency_measurements{0};
+        int64_t min_latency_frames{0};
+        int64_t max_latency_frames{0};
+        double average_latency_frames{0};
+    };
+
+    /**
+     * Portable audio driver that does not need any audio device.
+     *
+     * It calls `processAudioIO()` from its own thread, either paced in realtime or as fast as possible
+     * ("freewheeling"), replays the timestamped MIDI events, and writes the rendered output into a 32-bit
+     * float WAV file. In realtime, the events are passed through `processMidiInput()` at each callback like
+     * a MIDI device would do. When freewheeling, they are passed through `processMidiInputAtFrame()` right
+     * before each plugin block, so that the output is the same for every run. It is meant to measure the MIDI-to-audio
+     * latency and the throughput of the pipeline on hosts without audio hardware (e.g. Linux).
+     *
+     * Configure it before `AAPMidiProcessor::initialize()` (which calls `setupStream()`).
+     */
+    class AAPMidiProcessorStubPAL : public AAPMidiProcessorPAL {
+        AAPMidiProcessor *owner;
+
+        int32_t frames_per_callback{256};
+        bool freewheel{false};
+        int64_t max_frames{-1};
+        int64_t tail_frames{-1};
+        float audible_threshold{0.0001f};
+        std::string output_wav_path{};
+        std::vector<StubMidiEvent> midi_events{};
+        std::vector<uint8_t> midi_bytes{};
+        // the message being dispatched (rendering thread only).
+        uint8_t midi_event_buffer[AAP_MIDI_PROCESSOR_STUB_MIDI_EVENT_BUFFER_SIZE];
+        // the index of the first event that is not dispatched yet (rendering thread only).
+        size_t next_midi_event{0};
+
+        int32_t sample_rate{0};
+        int32_t channel_count{0};
+        std::vector<float> audio_buffer{};
+        FILE* wav_file{nullptr};
+        int64_t wav_frames_written{0};
+
+        std::atomic<bool> alive{false};
+        std::atomic<bool> finished{false};
+        std::unique_ptr<std::thread> render_thread{nullptr};
+        StubAudioDriverStatistics statistics{};
+        // frames of the note-ons that are not audible yet (queued in dispatch order)
+        std::vector<int64_t> pending_note_on_frames{};
+        size_t pending_note_on_head{0};
+
+        void runRenderingLoop();
+        // Dispatches the events in [blockStartFrame, blockStartFrame + numFrames).
+        void dispatchMidiEvents(int64_t blockStartFrame, int32_t numFrames, bool frameExact);
+        void measureLatency(int64_t blockStartFrame);
+        void recordLatency(int64_t frames);
+
+    public:
+        explicit AAPMidiProcessorStubPAL(AAPMidiProcessor *ownerProcessor) : owner(ownerProcessor) {}
+
+        ~AAPMidiProcessorStubPAL();
+
+        void setFramesPerCallback(int32_t frames) { frames_per_callback = frames; }
+
+        // Renders as fast as possible instead of pacing the callbacks in realtime.
+        // The block size adaptation is disabled then, as it depends on the processing time.
+        void setFreewheel(bool value) { freewheel = value; }
+
+        // Stops after `frames` frames. By default (-1), it stops `tail_frames` after the last MIDI event.
+        void setMaxFrames(int64_t frames) { max_frames = frames; }
+
+        // Frames to keep rendering after the last MIDI event (for release tails). -1 means one second.
+        void setTailFrames(int64_t frames) { tail_frames = frames; }
+
+        void setOutputWavFile(std::string path) { output_wav_path = path; }
+
+        bool loadMidiInputFile(const char* smfPath) { return loadStandardMidiFile(smfPath, midi_events, midi_bytes); }
+
+        void setMidiInputEvents(std::vector<StubMidiEvent> events, std::vector<uint8_t> bytes) {
+            midi_events = std::move(events);
+            midi_bytes = std::move(bytes);
+        }
+
+        // Waits until the rendering finishes by itself (see `setMaxFrames()`).
+        void waitForCompletion();
+
+        bool isFinished() { return finished; }
+
+        // It is updated on the rendering thread; read it after the rendering has finished or stopped.
+        StubAudioDriverStatistics getStatistics() { return statistics; }
+
+        int32_t setupStream() override;
+        int32_t startStreaming() override;
+        int32_t stopStreaming() override;
+        void pluginProcessStarting(int64_t framePosition, int32_t numFrames) override;
+    };
+
+    class AAPMidiProcessorStub : public AAPMidiProcessor {
+        AAPMidiProcessorStubPAL stub_pal;
+    protected:
+        AAPMidiProcessorPAL* pal() override { return &stub_pal; }
+    public:
+        AAPMidiProcessorStub() : stub_pal(this) {}
+
+        AAPMidiProcessorStubPAL* getStubPAL() { return &stub_pal; }
+    };
+}
+
+#endif //AAP_MIDI_DEVICE_SERVICE_AAPMIDIPROCESSOR_STUB_H
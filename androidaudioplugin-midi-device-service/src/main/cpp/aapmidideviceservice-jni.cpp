@@ -89,6 +89,44 @@ JNIEXPORT void JNICALL Java_org_androidaudioplugin_midideviceservice_AudioPlugin
     free((void *) pluginIdPtr);
 }
 
+JNIEXPORT void JNICALL Java_org_androidaudioplugin_midideviceservice_AudioPluginMidiDeviceInstance_instantiatePluginInZone(
+        JNIEnv *env, jobject midiReceiver, jstring pluginId, jint lowestKey, jint highestKey, jint channelMask) {
+    auto pluginIdPtr = dupFromJava(env, pluginId);
+    std::string pluginIdString = pluginIdPtr;
+
+    aap::midi::InstrumentZone zone{lowestKey, highestKey, (uint16_t) channelMask};
+    AAPMIDIDEVICE_INSTANCE->instantiatePlugin(pluginIdString, zone);
+
+    free((void *) pluginIdPtr);
+}
+
+JNIEXPORT jint JNICALL Java_org_androidaudioplugin_midideviceservice_AudioPluginMidiDeviceInstance_getBlockSize(
+        JNIEnv *env, jobject midiReceiver) {
+    return AAPMIDIDEVICE_INSTANCE->getBlockSizeController().getBlockSize();
+}
+
+JNIEXPORT void JNICALL Java_org_androidaudioplugin_midideviceservice_AudioPluginMidiDeviceInstance_setAdaptiveBlockSizeEnabled(
+        JNIEnv *env, jobject midiReceiver, jboolean enabled) {
+    AAPMIDIDEVICE_INSTANCE->getBlockSizeController().setEnabled(enabled);
+}
+
+JNIEXPORT jlongArray JNICALL Java_org_androidaudioplugin_midideviceservice_AudioPluginMidiDeviceInstance_getBlockSizeStatistics(
+        JNIEnv *env, jobject midiReceiver) {
+    aap::midi::AdaptiveBlockSizeStatistics s{};
+    AAPMIDIDEVICE_INSTANCE->getBlockSizeController().getStatistics(s);
+    int32_t peakLoadBits;
+    memcpy(&peakLoadBits, &s.peak_load, sizeof(peakLoadBits));
+    // in the order of the AdaptiveBlockSizeStatistics constructor parameters (peak load as float bits).
+    jlong values[] {s.block_size, s.min_block_size, s.max_block_size, s.num_adaptations,
+                    (jlong) s.num_callbacks, (jlong) s.num_overruns,
+                    s.last_process_time_nanoseconds, s.worst_process_time_nanoseconds, peakLoadBits,
+                    (jlong) AAPMIDIDEVICE_INSTANCE->getWorkerTimeoutCount()};
+    auto size = (jsize) (sizeof(values) / sizeof(jlong));
+    auto ret = env->NewLongArray(size);
+    env->SetLongArrayRegion(ret, 0, size, values);
+    return ret;
+}
+
 jbyte jni_midi_buffer[1024]{};
 
 JNIEXPORT void JNICALL Java_org_androidaudioplugin_midideviceservice_AudioPluginMidiDeviceInstance_processMessage(
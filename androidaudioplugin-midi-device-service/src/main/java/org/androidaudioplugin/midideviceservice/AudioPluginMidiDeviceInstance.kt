@@ -6,12 +6,44 @@ import org.androidaudioplugin.hosting.AudioPluginClientBase
 
 // Unlike MidiReceiver, it is instantiated whenever the port is opened, and disposed every time it is closed.
 // By isolating most of the implementation here, it makes better lifetime management.
+/**
+ * An instrument in a layered or split setup: it receives only the notes within [lowestKey]..[highestKey]
+ * on the channels in [channelMask] (bit N for MIDI channel N).
+ */
+data class InstrumentLayer(
+    val pluginId: String,
+    val lowestKey: Int = 0,
+    val highestKey: Int = 127,
+    val channelMask: Int = 0xFFFF)
+
+/**
+ * Diagnostics of the adaptive plugin block size (see [AudioPluginMidiDeviceInstance.blockSizeStatistics]).
+ * [numOverruns] counts the callbacks whose plugin processing took longer than the callback (i.e. likely xruns),
+ * and [peakLoad] is the highest processing time / callback duration ratio in the last second.
+ * [numWorkerTimeouts] counts the blocks where a layered instrument did not finish in time (and was silent).
+ */
+data class AdaptiveBlockSizeStatistics(
+    val blockSize: Int,
+    val minBlockSize: Int,
+    val maxBlockSize: Int,
+    val numAdaptations: Int,
+    val numCallbacks: Long,
+    val numOverruns: Long,
+    val lastProcessTimeNanoseconds: Long,
+    val worstProcessTimeNanoseconds: Long,
+    val peakLoad: Float,
+    val numWorkerTimeouts: Long)
+
 class AudioPluginMidiDeviceInstance private constructor(
     // It is used to manage Service connections, not instancing (which is managed by native code).
     private val client: AudioPluginClientBase) {
 
     companion object {
-        suspend fun create(pluginId: String, ownerService: AudioPluginMidiDevice, midiTransport: Int) : AudioPluginMidiDeviceInstance {
+        suspend fun create(pluginId: String, ownerService: AudioPluginMidiDevice, midiTransport: Int) =
+            create(listOf(InstrumentLayer(pluginId)), ownerService, midiTransport)
+
+        // Instantiates all the instruments in `layers`, whose outputs are mixed.
+        suspend fun create(layers: List<InstrumentLayer>, ownerService: AudioPluginMidiDevice, midiTransport: Int) : AudioPluginMidiDeviceInstance {
             val audioManager = ownerService.applicationContext.getSystemService(Context.AUDIO_SERVICE) as AudioManager
             val sampleRate = audioManager.getProperty(AudioManager.PROPERTY_OUTPUT_SAMPLE_RATE)?.toInt() ?: 44100
             val oboeFrameSize = audioManager.getProperty(AudioManager.PROPERTY_OUTPUT_FRAMES_PER_BUFFER)?.toInt() ?: 1024
@@ -26,9 +58,11 @@ class AudioPluginMidiDeviceInstance private constructor(
                 sampleRate, oboeFrameSize, ret.audioOutChannelCount, ret.aapFrameSize,
                 ret.midiBufferSize, midiTransport)
 
-            val pluginInfo = ownerService.plugins.first { p -> p.pluginId == pluginId }
-            client.connectToPluginService(pluginInfo.packageName)
-            ret.instantiatePlugin(pluginId)
+            for (layer in layers) {
+                val pluginInfo = ownerService.plugins.first { p -> p.pluginId == layer.pluginId }
+                client.connectToPluginService(pluginInfo.packageName)
+                ret.instantiatePluginInZone(layer.pluginId, layer.lowestKey, layer.highestKey, layer.channelMask)
+            }
             ret.activate()
             return ret
         }
@@ -38,6 +72,22 @@ class AudioPluginMidiDeviceInstance private constructor(
     private val aapFrameSize = 512
     private val midiBufferSize = 4096
 
+    // The plugin block size currently in use. It adapts between 64 and aapFrameSize to the measured process cost.
+    val currentBlockSize: Int
+        get() = getBlockSize()
+
+    val blockSizeStatistics: AdaptiveBlockSizeStatistics
+        get() = getBlockSizeStatistics().let { v ->
+            AdaptiveBlockSizeStatistics(v[0].toInt(), v[1].toInt(), v[2].toInt(), v[3].toInt(),
+                v[4], v[5], v[6], v[7], Float.fromBits(v[8].toInt()), v[9])
+        }
+
+    var adaptiveBlockSizeEnabled: Boolean = true
+        set(value) {
+            field = value
+            setAdaptiveBlockSizeEnabled(value)
+        }
+
     fun onDeviceClosed() {
         deactivate()
         client.dispose()
@@ -62,7 +112,11 @@ class AudioPluginMidiDeviceInstance private constructor(
         midiTransport: Int)
     private external fun terminateMidiProcessor()
     private external fun instantiatePlugin(pluginId: String)
+    private external fun instantiatePluginInZone(pluginId: String, lowestKey: Int, highestKey: Int, channelMask: Int)
     private external fun processMessage(msg: ByteArray?, offset: Int, count: Int, timestampInNanoseconds: Long)
     private external fun activate()
     private external fun deactivate()
+    private external fun getBlockSize(): Int
+    private external fun setAdaptiveBlockSizeEnabled(enabled: Boolean)
+    private external fun getBlockSizeStatistics(): LongArray
 }
\ No newline at end of file
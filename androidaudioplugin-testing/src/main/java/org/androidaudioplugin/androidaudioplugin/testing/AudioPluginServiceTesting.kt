@@ -2,11 +2,13 @@ package org.androidaudioplugin.androidaudioplugin.testing
 
 import android.content.Context
 import junit.framework.Assert.assertEquals
+import junit.framework.Assert.assertTrue
 import kotlinx.coroutines.runBlocking
 import org.androidaudioplugin.AudioPluginServiceHelper
 import org.androidaudioplugin.PluginInformation
 import org.androidaudioplugin.PluginServiceInformation
 import org.androidaudioplugin.hosting.AudioPluginClientBase
+import org.androidaudioplugin.hosting.PluginInstancePoolConfiguration
 
 class AudioPluginServiceTesting(private val applicationContext: Context) {
 
@@ -59,4 +61,42 @@ class AudioPluginServiceTesting(private val applicationContext: Context) {
         host.disconnectPluginService(pluginInfo.packageName)
         host.dispose()
     }
+
+    // Takes an instance out of the instance pool and processes with it, then checks that the pool gets refilled.
+    fun testInstancePool(pluginInfo: PluginInformation, poolSize: Int = 2, timeoutMilliseconds: Long = 10000) {
+        val host = AudioPluginClientBase(applicationContext)
+        val pluginId = pluginInfo.pluginId!!
+        val floatCount = 1024
+        val controlBufferSize = 0x10000
+
+        runBlocking {
+            host.connectToPluginService(pluginInfo.packageName)
+        }
+
+        fun waitForPoolSize(expected: Int) {
+            val start = System.currentTimeMillis()
+            while (host.getPooledInstanceCount(pluginId) != expected && System.currentTimeMillis() - start < timeoutMilliseconds)
+                Thread.sleep(10)
+            assertEquals("pooled instances", expected, host.getPooledInstanceCount(pluginId))
+        }
+
+        host.configureInstancePool(listOf(PluginInstancePoolConfiguration(pluginId, host.sampleRate, poolSize, floatCount)))
+        waitForPoolSize(poolSize)
+
+        val instance = host.instantiateNativePlugin(pluginInfo)
+        assertEquals("instance pool hits", 1L, host.instancePoolHitCount)
+        assertTrue("pooled instance count after taking one", host.getPooledInstanceCount(pluginId) <= poolSize)
+        instance.prepare(floatCount, controlBufferSize)
+        instance.activate()
+        instance.process(floatCount, 0)
+        instance.deactivate()
+        instance.destroy()
+
+        waitForPoolSize(poolSize)
+        host.clearInstancePool()
+        assertEquals("pooled instances after clearInstancePool()", 0, host.getPooledInstanceCount(pluginId))
+
+        host.disconnectPluginService(pluginInfo.packageName)
+        host.dispose()
+    }
 }
@@ -355,6 +355,72 @@ namespace aap {
         });
     }
 
+    jobjectArray AAPJniFacade::queryInstalledPluginsInPackageJNI(std::string packageName) {
+        return usingJNIEnv<jobjectArray>([packageName](JNIEnv *env) {
+            jclass java_audio_plugin_host_helper_class = env->FindClass(
+                    "org/androidaudioplugin/hosting/AudioPluginHostHelper");
+            if (!java_audio_plugin_host_helper_class)
+                AAP_ASSERT_FALSE; // ... and leave WTF JNI causes.
+            jmethodID j_method_query_audio_plugins_in_package = env->GetStaticMethodID(
+                    java_audio_plugin_host_helper_class, "queryAudioPluginsInPackage",
+                    "(Landroid/content/Context;Ljava/lang/String;)[Lorg/androidaudioplugin/PluginInformation;");
+            if (!j_method_query_audio_plugins_in_package)
+                AAP_ASSERT_FALSE; // ... and leave WTF JNI causes.
+            auto packageNameJString = env->NewStringUTF(packageName.c_str());
+            return (jobjectArray) env->CallStaticObjectMethod(java_audio_plugin_host_helper_class,
+                                                              j_method_query_audio_plugins_in_package,
+                                                              aap::get_android_application_context(),
+                                                              packageNameJString);
+        });
+    }
+
+    std::vector<std::string> AAPJniFacade::queryInstalledPluginPackageNames() {
+        return usingJNIEnv<std::vector<std::string>>([](JNIEnv *env) {
+            std::vector<std::string> ret{};
+            jclass java_audio_plugin_host_helper_class = env->FindClass(
+                    "org/androidaudioplugin/hosting/AudioPluginHostHelper");
+            if (!java_audio_plugin_host_helper_class)
+                AAP_ASSERT_FALSE; // ... and leave WTF JNI causes.
+            jmethodID j_method_query_audio_plugin_package_names = env->GetStaticMethodID(
+                    java_audio_plugin_host_helper_class, "queryAudioPluginPackageNames",
+                    "(Landroid/content/Context;)[Ljava/lang/String;");
+            if (!j_method_query_audio_plugin_package_names)
+                AAP_ASSERT_FALSE; // ... and leave WTF JNI causes.
+            auto names = (jobjectArray) env->CallStaticObjectMethod(java_audio_plugin_host_helper_class,
+                                                                    j_method_query_audio_plugin_package_names,
+                                                                    aap::get_android_application_context());
+            if (!names)
+                return ret;
+            for (jsize i = 0, n = env->GetArrayLength(names); i < n; i++) {
+                auto name = (jstring) env->GetObjectArrayElement(names, i);
+                const char *u8 = env->GetStringUTFChars(name, nullptr);
+                ret.emplace_back(u8);
+                env->ReleaseStringUTFChars(name, u8);
+                env->DeleteLocalRef(name);
+            }
+            return ret;
+        });
+    }
+
+    int64_t AAPJniFacade::getPackageLastUpdateTime(std::string packageName) {
+        return usingJNIEnv<int64_t>([packageName](JNIEnv *env) {
+            jclass java_audio_plugin_host_helper_class = env->FindClass(
+                    "org/androidaudioplugin/hosting/AudioPluginHostHelper");
+            if (!java_audio_plugin_host_helper_class)
+                AAP_ASSERT_FALSE; // ... and leave WTF JNI causes.
+            jmethodID j_method_get_package_last_update_time = env->GetStaticMethodID(
+                    java_audio_plugin_host_helper_class, "getPackageLastUpdateTime",
+                    "(Landroid/content/Context;Ljava/lang/String;)J");
+            if (!j_method_get_package_last_update_time)
+                AAP_ASSERT_FALSE; // ... and leave WTF JNI causes.
+            auto packageNameJString = env->NewStringUTF(packageName.c_str());
+            return (int64_t) env->CallStaticLongMethod(java_audio_plugin_host_helper_class,
+                                                       j_method_get_package_last_update_time,
+                                                       aap::get_android_application_context(),
+                                                       packageNameJString);
+        });
+    }
+
 // --------------------------------------------------
 
     int32_t AAPJniFacade::getMidiSettingsFromLocalConfig(std::string pluginId) {
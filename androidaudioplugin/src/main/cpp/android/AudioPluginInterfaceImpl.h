@@ -84,11 +84,11 @@ public:
     ::ndk::ScopedAStatus beginCreate(const std::string &in_pluginId, int32_t in_sampleRate,
                                      int32_t *_aidl_return) override {
         *_aidl_return = svc->createInstance(in_pluginId, in_sampleRate);
+        if (*_aidl_return < 0)
+            return ndk::ScopedAStatus::fromServiceSpecificErrorWithMessage(
+                    AAP_BINDER_ERROR_CREATE_INSTANCE_FAILED, "failed to create AAP service instance.");
         auto instance = svc->getLocalInstance(*_aidl_return);
         instance->setIpcExtensionMessageSender(aapxs_host_ipc_sender_func, this);
-        if (*_aidl_return < 0)
-        return ndk::ScopedAStatus::fromServiceSpecificErrorWithMessage(
-                AAP_BINDER_ERROR_CREATE_INSTANCE_FAILED, "failed to create AAP service instance.");
 
         return ndk::ScopedAStatus::ok();
     }
@@ -97,7 +97,7 @@ public:
     if (_instance_ == nullptr) { \
         std::stringstream msg; \
         msg << "The specified instance " << _id_ << " does not exist."; \
-        aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_AIDL_SVC_LOG_TAG, msg.str().c_str()); \
+        aap::a_log(AAP_LOG_LEVEL_ERROR, AAP_AIDL_SVC_LOG_TAG, msg.str().c_str()); \
         return ndk::ScopedAStatus::fromServiceSpecificErrorWithMessage( \
                 AAP_BINDER_ERROR_UNEXPECTED_INSTANCE_ID, msg.str().c_str()); \
     } \
@@ -55,6 +55,32 @@ Java_org_androidaudioplugin_AudioPluginNatives_destroyBinderForService(JNIEnv *e
     sp_binder.reset();
 }
 
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_androidaudioplugin_AudioPluginNatives_preloadPluginLibraries(JNIEnv *env, jclass clazz,
+                                                                      jobjectArray pluginIds) {
+    auto plugins = aap::PluginListSnapshot::queryServices();
+    auto cache = aap::PluginLibraryCache::getInstance();
+    jint numLoaded = 0;
+    for (jsize i = 0, n = env->GetArrayLength(pluginIds); i < n; i++) {
+        auto element = (jstring) env->GetObjectArrayElement(pluginIds, i);
+        auto pluginId = jstringToStdString(env, element);
+        env->DeleteLocalRef(element);
+        auto info = plugins.getPluginInformation(pluginId);
+        if (info && cache->preload(info))
+            numLoaded++;
+        else
+            aap::a_log_f(AAP_LOG_LEVEL_WARN, LOG_TAG, "Could not preload the library for plugin %s", pluginId.c_str());
+    }
+    return numLoaded;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_AudioPluginNatives_releasePreloadedPluginLibraries(JNIEnv *env, jclass clazz) {
+    aap::PluginLibraryCache::getInstance()->releasePreloadedLibraries();
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_org_androidaudioplugin_AudioPluginNatives_prepareNativeLooper(JNIEnv *env, jclass clazz) {
@@ -158,6 +184,52 @@ Java_org_androidaudioplugin_hosting_NativePluginClient_destroyInstance(JNIEnv *e
 	delete client;
 }
 
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_androidaudioplugin_hosting_NativePluginClient_configureInstancePool(JNIEnv *env, jclass clazz,
+																			 jlong native,
+																			 jobjectArray pluginIds,
+																			 jintArray poolSizes,
+																			 jintArray sampleRates,
+																			 jintArray frameCounts) {
+	auto client = (aap::PluginClient*) native;
+	jsize n = env->GetArrayLength(pluginIds);
+	if (env->GetArrayLength(poolSizes) != n || env->GetArrayLength(sampleRates) != n || env->GetArrayLength(frameCounts) != n) {
+		aap::a_log(AAP_LOG_LEVEL_ERROR, LOG_TAG, "configureInstancePool: the configuration arrays differ in length");
+		AAP_ASSERT_FALSE;
+		return;
+	}
+	std::vector<jint> sizes(n), rates(n), frames(n);
+	env->GetIntArrayRegion(poolSizes, 0, n, sizes.data());
+	env->GetIntArrayRegion(sampleRates, 0, n, rates.data());
+	env->GetIntArrayRegion(frameCounts, 0, n, frames.data());
+
+	std::vector<aap::PluginInstancePoolConfiguration> configurations{};
+	for (jsize i = 0; i < n; i++) {
+		auto pluginId = (jstring) env->GetObjectArrayElement(pluginIds, i);
+		configurations.emplace_back(aap::PluginInstancePoolConfiguration{jstringToStdString(env, pluginId), sizes[i], rates[i], frames[i]});
+		env->DeleteLocalRef(pluginId);
+	}
+	client->configureInstancePool(configurations);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_androidaudioplugin_hosting_NativePluginClient_getPooledInstanceCount(JNIEnv *env, jclass clazz,
+																			  jlong native,
+																			  jstring pluginId) {
+	auto client = (aap::PluginClient*) native;
+	return (jint) client->getPooledInstanceCount(jstringToStdString(env, pluginId));
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_org_androidaudioplugin_hosting_NativePluginClient_getInstancePoolHitCount(JNIEnv *env, jclass clazz,
+																			   jlong native) {
+	auto client = (aap::PluginClient*) native;
+	return (jlong) client->getInstancePoolHitCount();
+}
+
 extern "C"
 JNIEXPORT jint JNICALL
 Java_org_androidaudioplugin_hosting_NativeRemotePluginInstance_createRemotePluginInstance(
@@ -27,28 +27,22 @@ std::vector<PluginInformation*> queryInstalledPlugins() {
 }
 
 std::vector<std::string> AndroidPluginClientSystem::getPluginPaths() {
-    std::vector<std::string> ret{};
-    for (auto p : queryInstalledPlugins()) {
-        if (!p)
-            AAP_ASSERT_FALSE;
-        else {
-            auto packageName = p->getPluginPackageName();
-            if (std::find(ret.begin(), ret.end(), packageName) == ret.end())
-                ret.emplace_back(packageName);
-        }
-    }
-    return ret;
+    return AAPJniFacade::getInstance()->queryInstalledPluginPackageNames();
 }
 
 std::vector<PluginInformation*> AndroidPluginClientSystem::getPluginsFromMetadataPaths(std::vector<std::string>& aapMetadataPaths) {
+    // Each "metadata path" is a package name (see getAAPMetadataPaths()).
     std::vector<PluginInformation *> results{};
-    for (auto p : queryInstalledPlugins())
-        if (std::find(aapMetadataPaths.begin(), aapMetadataPaths.end(),
-                      p->getPluginPackageName()) != aapMetadataPaths.end())
+    for (auto& packageName : aapMetadataPaths)
+        for (auto p : convertPluginList(AAPJniFacade::getInstance()->queryInstalledPluginsInPackageJNI(packageName)))
             results.emplace_back(p);
     return results;
 }
 
+int64_t AndroidPluginClientSystem::getPluginPathTimestamp(const std::string& path, const std::vector<std::string>& aapMetadataPaths) {
+    return AAPJniFacade::getInstance()->getPackageLastUpdateTime(path);
+}
+
 void AndroidPluginClientSystem::ensurePluginServiceConnected(aap::PluginClientConnectionList* connections, std::string serviceName, std::function<void(std::string&)> callback) {
     auto connId = AAPJniFacade::getInstance()->getConnectorInstanceId(connections);
     AAPJniFacade::getInstance()->ensureServiceConnectedFromJni(connId, serviceName, callback);
@@ -39,6 +39,12 @@ public:
 
     std::vector<PluginInformation *>
     getPluginsFromMetadataPaths(std::vector<std::string> &aapMetadataPaths) override;
+
+    // The "path" is a package name, and it changes only when the package is updated.
+    int64_t getPluginPathTimestamp(const std::string& path, const std::vector<std::string>& aapMetadataPaths) override;
+
+    // Plugin discovery goes through JNI, which cannot look up our Java classes from native threads.
+    int32_t getMaxScanningThreads() override { return 1; }
 };
 
 class AndroidPluginClientConnectionData {
@@ -46,10 +46,9 @@ void aap_bcap_log_error_with_details(const char* fmtBase, ndk::ScopedAStatus& st
 #else
 		if (__ANDROID_API__ >= 30) {
 #endif
-		aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_PXORY_LOG_TAG, (std::string{fmtBase} + ": %s").c_str(),
-					 status.getDescription().c_str());
+		aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_PXORY_LOG_TAG, "%s: %s", fmtBase, status.getDescription().c_str());
 	} else {
-		aap::a_log_f(AAP_LOG_LEVEL_ERROR, AAP_PXORY_LOG_TAG, fmtBase);
+		aap::a_log(AAP_LOG_LEVEL_ERROR, AAP_PXORY_LOG_TAG, fmtBase);
 	}
 }
 
@@ -0,0 +1,431 @@
+// Microbenchmarks for the hot paths in libandroidaudioplugin (desktop only).
+//
+// Usage: aap-benchmarks [--filter substring] [--min-time-ms 200] [--json results.json]
+//                       [--baseline old.json] [--threshold 10] [--plugin-dir dir]
+//
+// With `--baseline`, it exits with 1 if any benchmark got slower than the threshold (in percent) or allocates more.
+// It also exits with 1 if a stress benchmark detected a failure (e.g. a lost update under AdaptiveMutex).
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <aap/core/aap_midi2_helper.h>
+#include <aap/core/AAPXSMidi2RecipientSession.h>
+#include <aap/core/host/plugin-host.h>
+#include <aap/core/host/plugin-instance.h>
+#include <aap/core/host/shared-memory-store.h>
+#include <aap/ext/midi.h>
+#include <aap/ext/render-mode.h>
+#include <aap/unstable/utility.h>
+#include "../core/include_cmidi2.h"
+#include "benchmark-runner.h"
+
+#ifndef AAP_BENCHMARK_PLUGIN_DIR
+#define AAP_BENCHMARK_PLUGIN_DIR "."
+#endif
+#define AAP_BENCHMARK_SAMPLE_RATE 48000
+#define AAP_BENCHMARK_DEFAULT_MIN_TIME_MS 200
+#define AAP_BENCHMARK_DEFAULT_THRESHOLD_PERCENT 10
+#define AAP_BENCHMARK_MUTEX_STRESS_THREADS 8
+
+using namespace aap::benchmark;
+
+// Keeps the compiler from optimizing away the benchmarked results.
+static volatile int64_t benchmark_sink;
+
+static const int32_t block_sizes[] {32, 64, 128, 256, 512, 1024};
+
+// The failures that stress benchmarks detected.
+static int32_t stress_failures{0};
+
+// ---- MIDI2 AAPXS SysEx8
+
+static void benchmarkAAPXSSysex8(BenchmarkRunner& runner) {
+    for (int32_t dataSize : {16, 256}) {
+        std::vector<uint8_t> data(dataSize, 0x5A);
+        std::vector<uint32_t> ump(AAP_MIDI2_AAPXS_DATA_MAX_SIZE / sizeof(uint32_t));
+        std::vector<uint8_t> helper(AAP_MIDI2_AAPXS_DATA_MAX_SIZE);
+        size_t size = 0;
+
+        runner.run("midi2/generate_aapxs_sysex8/" + std::to_string(dataSize), [&](int64_t iterations) {
+            for (int64_t i = 0; i < iterations; i++)
+                size = aap_midi2_generate_aapxs_sysex8(ump.data(), ump.size(), helper.data(), helper.size(),
+                                                       0, (uint32_t) i, 1, AAP_PARAMETERS_EXTENSION_URI,
+                                                       0, data.data(), data.size());
+            benchmark_sink = (int64_t) size;
+        });
+
+        size = aap_midi2_generate_aapxs_sysex8(ump.data(), ump.size(), helper.data(), helper.size(),
+                                               0, 1, 1, AAP_PARAMETERS_EXTENSION_URI, 0, data.data(), data.size());
+        std::vector<uint8_t> parsed(AAP_MIDI2_AAPXS_DATA_MAX_SIZE);
+        aap_midi2_aapxs_parse_context context{};
+        aap_midi2_aapxs_parse_context_prepare(&context, parsed.data(), helper.data(), helper.size());
+        runner.run("midi2/parse_aapxs_sysex8/" + std::to_string(dataSize), [&](int64_t iterations) {
+            int64_t parsedCount = 0;
+            for (int64_t i = 0; i < iterations; i++)
+                parsedCount += aap_midi2_parse_aapxs_sysex8(&context, (uint8_t*) ump.data(), size);
+            benchmark_sink = parsedCount;
+        });
+    }
+}
+
+// ---- AAPXSMidi2RecipientSession
+
+// Writes `numNotes` note on/off pairs with JR timestamps, with an AAPXS SysEx8 request in the middle.
+static uint32_t writeMixedTraffic(void* buffer, int32_t numNotes) {
+    auto header = (AAPMidiBufferHeader*) buffer;
+    auto dst = (cmidi2_ump*) (header + 1);
+    uint32_t length = 0;
+    for (int32_t i = 0; i < numNotes; i++) {
+        if (i == numNotes / 2) {
+            uint8_t helper[AAP_MIDI2_AAPXS_DATA_MAX_SIZE];
+            int32_t data[2]{0, 1};
+            length += aap_midi2_generate_aapxs_sysex8((uint32_t*) ((uint8_t*) dst + length), AAP_MIDI2_AAPXS_DATA_MAX_SIZE / sizeof(uint32_t),
+                                                      helper, sizeof(helper), 0, 1, 1, AAP_PARAMETERS_EXTENSION_URI,
+                                                      0, (uint8_t*) data, sizeof(data));
+        }
+        *(uint32_t*) ((uint8_t*) dst + length) = cmidi2_ump_jr_timestamp_direct(0, 100);
+        length += 4;
+        cmidi2_ump_write64((cmidi2_ump*) ((uint8_t*) dst + length), cmidi2_ump_midi2_note_on(0, 0, 60 + i % 12, 0, 0xF800, 0));
+        length += 8;
+        cmidi2_ump_write64((cmidi2_ump*) ((uint8_t*) dst + length), cmidi2_ump_midi2_note_off(0, 0, 60 + i % 12, 0, 0, 0));
+        length += 8;
+    }
+    header->length = length;
+    return length;
+}
+
+static void benchmarkRecipientSession(BenchmarkRunner& runner) {
+    aap::AAPXSMidi2RecipientSession session{};
+    int64_t calls = 0;
+    session.setExtensionCallback([&calls](aap_midi2_aapxs_parse_context*) { calls++; });
+    std::vector<uint8_t> buffer(DEFAULT_CONTROL_BUFFER_SIZE);
+    writeMixedTraffic(buffer.data(), 16);
+
+    runner.run("aapxs/recipient_session_process/mixed", [&](int64_t iterations) {
+        for (int64_t i = 0; i < iterations; i++)
+            session.process(buffer.data());
+        benchmark_sink = calls;
+    });
+}
+
+// ---- UridMapping
+
+static void benchmarkUridMapping(BenchmarkRunner& runner) {
+    const char* uris[] {
+        AAP_PLUGIN_INFO_EXTENSION_URI, AAP_PORT_CONFIG_EXTENSION_URI, AAP_MIDI_EXTENSION_URI,
+        AAP_PARAMETERS_EXTENSION_URI, AAP_PRESETS_EXTENSION_URI, AAP_STATE_EXTENSION_URI,
+        AAP_GUI_EXTENSION_URI, AAP_URID_EXTENSION_URI, AAP_RENDER_MODE_EXTENSION_URI
+    };
+    aap::xs::UridMapping mapping{};
+    for (auto uri : uris)
+        mapping.tryAdd(uri);
+    // the last one is the worst case for the linear lookup.
+    const char* last = uris[sizeof(uris) / sizeof(uris[0]) - 1];
+    std::string copy{last};
+
+    runner.run("urid/get_urid/same_pointer", [&](int64_t iterations) {
+        int64_t sum = 0;
+        for (int64_t i = 0; i < iterations; i++)
+            sum += mapping.getUrid(last);
+        benchmark_sink = sum;
+    });
+    runner.run("urid/get_urid/other_pointer", [&](int64_t iterations) {
+        int64_t sum = 0;
+        for (int64_t i = 0; i < iterations; i++)
+            sum += mapping.getUrid(copy.c_str());
+        benchmark_sink = sum;
+    });
+}
+
+// ---- AbstractPluginBuffer
+
+// The default port layout of an effect plugin (see PluginInstance::setupPortConfigDefaults()).
+class DefaultLayoutPluginBuffer : public aap::AbstractPluginBuffer {
+public:
+    int32_t getPortContentType(int32_t portIndex) override {
+        return portIndex < 4 ? AAP_CONTENT_TYPE_AUDIO : AAP_CONTENT_TYPE_MIDI2;
+    }
+    int32_t getPortDirection(int32_t portIndex) override {
+        return portIndex % 2 == 0 ? AAP_PORT_DIRECTION_INPUT : AAP_PORT_DIRECTION_OUTPUT;
+    }
+};
+
+static void benchmarkGetBufferSize(BenchmarkRunner& runner) {
+    DefaultLayoutPluginBuffer buffer{};
+    buffer.initialize(6, 1024);
+
+    runner.run("buffer/get_buffer_size/6ports", [&](int64_t iterations) {
+        int64_t sum = 0;
+        for (int64_t i = 0; i < iterations; i++)
+            for (int32_t p = 0; p < 6; p++)
+                sum += buffer.getBufferSize(p);
+        benchmark_sink = sum;
+    });
+}
+
+// ---- AdaptiveMutex
+
+// AAP_BENCHMARK_MUTEX_STRESS_THREADS threads increment a plain counter under one AdaptiveMutex. Half of them
+// run as SCHED_FIFO (if permitted), so that they sleep by FUTEX_LOCK_PI and get the lock handed over by
+// FUTEX_UNLOCK_PI, while the others sleep on the plain futex. A lost update or a thread that sees another one
+// in the critical section is a failure. ns/op is per lock()/unlock() pair across all the threads.
+static void benchmarkAdaptiveMutexStress(BenchmarkRunner& runner) {
+    std::string name{"mutex/adaptive_mutex_stress/" + std::to_string(AAP_BENCHMARK_MUTEX_STRESS_THREADS) + "threads"};
+    if (!runner.isEnabled(name))
+        return;
+    aap::AdaptiveMutex mutex{};
+    int64_t counter = 0;
+    std::atomic<int32_t> inside{0};
+    std::atomic<int32_t> overlaps{0};
+    std::atomic<int32_t> realtimeThreads{0};
+    int64_t lostUpdates = 0;
+
+    runner.run(name, [&](int64_t iterations) {
+        counter = 0;
+        std::vector<std::thread> threads{};
+        for (int32_t t = 0; t < AAP_BENCHMARK_MUTEX_STRESS_THREADS; t++) {
+            int64_t count = iterations / AAP_BENCHMARK_MUTEX_STRESS_THREADS +
+                    (t < iterations % AAP_BENCHMARK_MUTEX_STRESS_THREADS ? 1 : 0);
+            threads.emplace_back([&, t, count] {
+                if (t % 2 == 0) {
+                    sched_param param{};
+                    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+                    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0)
+                        realtimeThreads++;
+                }
+                for (int64_t i = 0; i < count; i++) {
+                    std::lock_guard<aap::AdaptiveMutex> lock{mutex};
+                    if (inside.fetch_add(1, std::memory_order_relaxed) != 0)
+                        overlaps++;
+                    counter++;
+                    inside.fetch_sub(1, std::memory_order_relaxed);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        lostUpdates += iterations - counter;
+        benchmark_sink = counter;
+    });
+
+    auto s = mutex.getStatistics();
+    printf("    %d realtime thread run(s), %lld contention(s), %lld spin acquisition(s), %lld sleep(s), "
+           "%.1f us worst wait\n", realtimeThreads.load(), (long long) s.contentions,
+           (long long) s.spin_acquisitions, (long long) s.sleeps, s.max_wait_nanoseconds / 1000.0);
+    if (realtimeThreads == 0)
+        printf("    SCHED_FIFO is not permitted; the FUTEX_LOCK_PI handoff was not exercised.\n");
+    if (lostUpdates != 0 || overlaps != 0) {
+        fprintf(stderr, "%s: %lld lost update(s), %d overlapping critical section(s)\n", name.c_str(),
+                (long long) lostUpdates, overlaps.load());
+        stress_failures++;
+    }
+}
+
+// ---- instances of the sample plugins
+
+struct SamplePlugin {
+    const char* name;
+    std::unique_ptr<aap::PluginInformation> info;
+};
+
+static std::vector<SamplePlugin> createSamplePlugins(const std::string& pluginDir) {
+    std::vector<SamplePlugin> ret{};
+    ret.emplace_back(SamplePlugin{"barebone", std::make_unique<aap::PluginInformation>(
+            false, "org.androidaudioplugin.samples.aapbarebonepluginsample", "", "Test Filter", "AAP Developers", "",
+            "urn:org.androidaudioplugin/samples/aapbarebonepluginsample/TestFilter",
+            (pluginDir + "/libaapbarebonepluginsample.so").c_str(), "GetAndroidAudioPluginFactory", "",
+            "Effect", "", "", "")});
+    ret.emplace_back(SamplePlugin{"ayumi", std::make_unique<aap::PluginInformation>(
+            false, "org.androidaudioplugin.samples.aapinstrumentsample", "", "Instrument Sample", "AAP Developers", "",
+            "urn:org.androidaudioplugin/samples/aapinstrumentsample/InstrumentSample",
+            (pluginDir + "/libaapinstrumentsample.so").c_str(), "GetAndroidAudioPluginFactory", "",
+            "Instrument", "", "", "")});
+    return ret;
+}
+
+// Returns the buffer of the first port of the content type and direction, or nullptr.
+static void* findPortBuffer(aap::PluginInstance* instance, int32_t contentType, int32_t direction) {
+    auto buffer = instance->getAudioPluginBuffer();
+    for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+        auto port = instance->getPort(i);
+        if (port->getContentType() == contentType && port->getPortDirection() == direction)
+            return buffer->get_buffer(*buffer, i);
+    }
+    return nullptr;
+}
+
+static aap::LocalPluginInstance* createInstance(aap::StandalonePluginService& service, const SamplePlugin& plugin, int32_t blockSize) {
+    auto instance = service.instantiate(plugin.info.get(), AAP_BENCHMARK_SAMPLE_RATE);
+    if (!instance) {
+        fprintf(stderr, "Could not load %s (%s). Skipping.\n", plugin.name, plugin.info->getLocalPluginSharedLibrary().c_str());
+        return nullptr;
+    }
+    instance->setRenderMode(AAP_RENDER_MODE_OFFLINE);
+    auto error = service.setupInstance(instance, blockSize);
+    if (!error.empty()) {
+        fprintf(stderr, "Could not set up %s: %s. Skipping.\n", plugin.name, error.c_str());
+        return nullptr;
+    }
+    return instance;
+}
+
+static void benchmarkMergeUmpSequences(BenchmarkRunner& runner, const SamplePlugin& plugin) {
+    std::string name{"instance/merge_ump_sequences/16+16"};
+    if (!runner.isEnabled(name))
+        return;
+    aap::StandalonePluginService service{};
+    auto instance = createInstance(service, plugin, 1024);
+    if (!instance)
+        return;
+    auto midiIn = findPortBuffer(instance, AAP_CONTENT_TYPE_MIDI2, AAP_PORT_DIRECTION_INPUT);
+
+    std::vector<uint8_t> sequence(DEFAULT_CONTROL_BUFFER_SIZE);
+    auto sequenceSize = writeMixedTraffic(sequence.data(), 16);
+    std::vector<uint8_t> original(DEFAULT_CONTROL_BUFFER_SIZE);
+    auto originalSize = writeMixedTraffic(original.data(), 16);
+    std::vector<uint8_t> merged(DEFAULT_CONTROL_BUFFER_SIZE);
+
+    // restoring the port buffer content is included (it is a small memcpy() compared to the merge).
+    runner.run(name, [&](int64_t iterations) {
+        for (int64_t i = 0; i < iterations; i++) {
+            memcpy(midiIn, original.data(), sizeof(AAPMidiBufferHeader) + originalSize);
+            aap::PluginInstance::merge_ump_sequences(AAP_PORT_DIRECTION_INPUT, merged.data(), (int32_t) merged.size(),
+                                                     sequence.data() + sizeof(AAPMidiBufferHeader), (int32_t) sequenceSize,
+                                                     instance->getAudioPluginBuffer(), instance);
+        }
+        benchmark_sink = ((AAPMidiBufferHeader*) midiIn)->length;
+    });
+}
+
+static void benchmarkAllocateClientBuffer(BenchmarkRunner& runner, const SamplePlugin& plugin) {
+    std::string name{"shm/allocate_client_buffer/1024"};
+    if (!runner.isEnabled(name))
+        return;
+    aap::StandalonePluginService service{};
+    auto instance = createInstance(service, plugin, 1024);
+    if (!instance)
+        return;
+
+    // includes releasing the buffers (munmap() and close()) at the store destructor.
+    runner.run(name, [&](int64_t iterations) {
+        int64_t failures = 0;
+        for (int64_t i = 0; i < iterations; i++) {
+            aap::ClientPluginSharedMemoryStore store{};
+            failures += store.allocateClientBuffer(instance->getNumPorts(), 1024, *instance, DEFAULT_CONTROL_BUFFER_SIZE) !=
+                        aap::PluginSharedMemoryStore::PLUGIN_MEMORY_ALLOCATOR_SUCCESS;
+        }
+        benchmark_sink = failures;
+    });
+}
+
+static void benchmarkProcess(BenchmarkRunner& runner, const SamplePlugin& plugin) {
+    for (auto blockSize : block_sizes) {
+        std::string name = std::string{"process/"} + plugin.name + "/" + std::to_string(blockSize);
+        if (!runner.isEnabled(name))
+            continue;
+        aap::StandalonePluginService service{};
+        auto instance = createInstance(service, plugin, blockSize);
+        if (!instance)
+            return;
+
+        // some non-silent input for effects, and a held note for instruments.
+        auto buffer = instance->getAudioPluginBuffer();
+        for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+            auto port = instance->getPort(i);
+            if (port->getContentType() != AAP_CONTENT_TYPE_AUDIO || port->getPortDirection() != AAP_PORT_DIRECTION_INPUT)
+                continue;
+            auto samples = (float*) buffer->get_buffer(*buffer, i);
+            for (int32_t f = 0; f < blockSize; f++)
+                samples[f] = sinf(f * 0.05f) * 0.5f;
+        }
+        auto midiIn = (AAPMidiBufferHeader*) findPortBuffer(instance, AAP_CONTENT_TYPE_MIDI2, AAP_PORT_DIRECTION_INPUT);
+        if (midiIn) {
+            cmidi2_ump_write64((cmidi2_ump*) (midiIn + 1), cmidi2_ump_midi2_note_on(0, 0, 60, 0, 0xF800, 0));
+            midiIn->length = 8;
+            instance->process(blockSize, 0);
+            midiIn->length = 0;
+        }
+
+        runner.run(name, [&](int64_t iterations) {
+            for (int64_t i = 0; i < iterations; i++)
+                instance->process(blockSize, 0);
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string filter{};
+    int64_t minTimeMs = AAP_BENCHMARK_DEFAULT_MIN_TIME_MS;
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    double threshold = AAP_BENCHMARK_DEFAULT_THRESHOLD_PERCENT;
+    std::string pluginDir{AAP_BENCHMARK_PLUGIN_DIR};
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg{argv[i]};
+        bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue)
+            filter = argv[++i];
+        else if (arg == "--min-time-ms" && hasValue)
+            minTimeMs = atoll(argv[++i]);
+        else if (arg == "--json" && hasValue)
+            jsonPath = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            baselinePath = argv[++i];
+        else if (arg == "--threshold" && hasValue)
+            threshold = atof(argv[++i]);
+        else if (arg == "--plugin-dir" && hasValue)
+            pluginDir = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--filter substring] [--min-time-ms %d] [--json results.json] "
+                            "[--baseline old.json] [--threshold %d] [--plugin-dir dir]\n",
+                    argv[0], AAP_BENCHMARK_DEFAULT_MIN_TIME_MS, AAP_BENCHMARK_DEFAULT_THRESHOLD_PERCENT);
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    std::vector<BenchmarkResult> baseline{};
+    if (baselinePath) {
+        baseline = BenchmarkRunner::readJson(baselinePath);
+        if (baseline.empty()) {
+            fprintf(stderr, "Could not read the baseline %s\n", baselinePath);
+            return 2;
+        }
+    }
+
+    BenchmarkRunner runner{minTimeMs * 1000000, filter};
+    benchmarkAAPXSSysex8(runner);
+    benchmarkRecipientSession(runner);
+    benchmarkUridMapping(runner);
+    benchmarkGetBufferSize(runner);
+    benchmarkAdaptiveMutexStress(runner);
+    auto plugins = createSamplePlugins(pluginDir);
+    benchmarkMergeUmpSequences(runner, plugins[0]);
+    benchmarkAllocateClientBuffer(runner, plugins[0]);
+    for (auto& plugin : plugins)
+        benchmarkProcess(runner, plugin);
+
+    if (jsonPath) {
+        auto out = fopen(jsonPath, "w");
+        if (!out) {
+            fprintf(stderr, "Could not write to %s\n", jsonPath);
+            return 2;
+        }
+        runner.writeJson(out);
+        fclose(out);
+    }
+
+    if (baselinePath) {
+        auto regressions = runner.compare(baseline, threshold);
+        if (regressions > 0) {
+            printf("%d regression(s) beyond %.1f%%\n", regressions, threshold);
+            return 1;
+        }
+    }
+    return stress_failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+#include "allocation-counter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#define AAP_BENCHMARK_SANITIZED 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define AAP_BENCHMARK_SANITIZED 1
+#endif
+
+static std::atomic<int64_t> allocation_count{0};
+static std::atomic<int64_t> allocated_bytes{0};
+// __thread (not thread_local) so that they need no TLS initialization inside malloc().
+static __thread int64_t thread_allocation_count{0};
+static __thread int64_t thread_allocated_bytes{0};
+
+static inline void countAllocation(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add((int64_t) size, std::memory_order_relaxed);
+    thread_allocation_count++;
+    thread_allocated_bytes += (int64_t) size;
+}
+
+#if defined(__GLIBC__) && !defined(AAP_BENCHMARK_SANITIZED)
+// Interpose the malloc family. It covers operator new and the allocations in the core and the plugins too.
+// The calls are forwarded to the next definition, not __libc_malloc(), so that a preloaded library
+// (e.g. libaaprtcheck.so) still sees them.
+#include <dlfcn.h>
+
+// dlsym() itself calls calloc(), which is served from this arena while resolving.
+alignas(16) static char bootstrap_arena[4096];
+static std::atomic<size_t> bootstrap_used{0};
+static __thread bool resolving{false};
+
+static void* bootstrapAlloc(size_t size) {
+    size = (size + 15) & ~(size_t) 15;
+    auto offset = bootstrap_used.fetch_add(size, std::memory_order_relaxed);
+    return offset + size <= sizeof(bootstrap_arena) ? bootstrap_arena + offset : nullptr;
+}
+
+static inline bool isBootstrap(void* ptr) {
+    return ptr >= bootstrap_arena && ptr < bootstrap_arena + sizeof(bootstrap_arena);
+}
+
+template <typename F>
+static F resolveNext(std::atomic<F>& cache, const char* name) {
+    auto f = cache.load(std::memory_order_relaxed);
+    if (!f) {
+        resolving = true;
+        f = (F) dlsym(RTLD_NEXT, name);
+        resolving = false;
+        cache.store(f, std::memory_order_relaxed);
+    }
+    return f;
+}
+
+static std::atomic<void*(*)(size_t)> next_malloc{nullptr};
+static std::atomic<void*(*)(size_t, size_t)> next_calloc{nullptr};
+static std::atomic<void*(*)(void*, size_t)> next_realloc{nullptr};
+static std::atomic<void(*)(void*)> next_free{nullptr};
+
+extern "C" {
+void* malloc(size_t size) {
+    if (resolving)
+        return bootstrapAlloc(size);
+    countAllocation(size);
+    return resolveNext(next_malloc, "malloc")(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (resolving)
+        return bootstrapAlloc(count * size); // the arena is zero-initialized and never reused
+    countAllocation(count * size);
+    return resolveNext(next_calloc, "calloc")(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (resolving)
+        return bootstrapAlloc(size);
+    countAllocation(size);
+    if (isBootstrap(ptr)) {
+        auto ret = resolveNext(next_malloc, "malloc")(size);
+        if (ret)
+            memcpy(ret, ptr, std::min(size, (size_t) (bootstrap_arena + sizeof(bootstrap_arena) - (char*) ptr)));
+        return ret;
+    }
+    return resolveNext(next_realloc, "realloc")(ptr, size);
+}
+
+void free(void* ptr) {
+    if (isBootstrap(ptr) || resolving)
+        return;
+    resolveNext(next_free, "free")(ptr);
+}
+}
+#elif !defined(AAP_BENCHMARK_SANITIZED)
+// malloc() cannot be interposed portably, so only operator new is counted.
+void* operator new(size_t size) {
+    countAllocation(size);
+    if (auto ptr = malloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+#endif
+
+int64_t aap::benchmark::getAllocationCount() { return allocation_count.load(std::memory_order_relaxed); }
+int64_t aap::benchmark::getAllocatedBytes() { return allocated_bytes.load(std::memory_order_relaxed); }
+int64_t aap::benchmark::getThreadAllocationCount() { return thread_allocation_count; }
+int64_t aap::benchmark::getThreadAllocatedBytes() { return thread_allocated_bytes; }
@@ -0,0 +1,18 @@
+#ifndef AAP_BENCHMARKS_ALLOCATION_COUNTER_H
+#define AAP_BENCHMARKS_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+namespace aap::benchmark {
+
+    // The process-wide heap allocation counters (see allocation-counter.cpp). Linking allocation-counter.cpp
+    // into an executable makes it count malloc/calloc/realloc (or operator new where malloc cannot be
+    // interposed). They stay 0 under sanitizers, which replace the allocator.
+    int64_t getAllocationCount();
+    int64_t getAllocatedBytes();
+    // The same counters for the calling thread only.
+    int64_t getThreadAllocationCount();
+    int64_t getThreadAllocatedBytes();
+}
+
+#endif //AAP_BENCHMARKS_ALLOCATION_COUNTER_H
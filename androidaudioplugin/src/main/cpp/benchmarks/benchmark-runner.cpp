@@ -0,0 +1,112 @@
+#include "benchmark-runner.h"
+#include "allocation-counter.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <unistd.h>
+
+// A benchmark stops growing its iterations at this count even if it is faster than the minimum time.
+#define AAP_BENCHMARK_MAX_ITERATIONS ((int64_t) 1000000000)
+// An increase of allocations/op below this is regarded as noise from amortized one-time allocations.
+#define AAP_BENCHMARK_ALLOCATION_TOLERANCE 0.01
+
+static int64_t getMonotonicNanoseconds() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void aap::benchmark::BenchmarkRunner::run(const std::string& name, BenchmarkFunction function) {
+    if (!isEnabled(name))
+        return;
+
+    function(1); // warm up: first-time allocations, page faults, lazy binding etc.
+
+    for (int64_t n = 1;;) {
+        auto allocations = getAllocationCount();
+        auto bytes = getAllocatedBytes();
+        auto begin = getMonotonicNanoseconds();
+        function(n);
+        auto elapsed = getMonotonicNanoseconds() - begin;
+        allocations = getAllocationCount() - allocations;
+        bytes = getAllocatedBytes() - bytes;
+
+        if (elapsed >= min_time_ns || n >= AAP_BENCHMARK_MAX_ITERATIONS) {
+            BenchmarkResult result{name, n, (double) elapsed / n, (double) allocations / n, (double) bytes / n};
+            printf("%-48s %12lld iterations %14.1f ns/op %10.2f allocs/op %12.1f B/op\n", name.c_str(),
+                   (long long) n, result.ns_per_op, result.allocations_per_op, result.bytes_per_op);
+            fflush(stdout);
+            results.emplace_back(result);
+            return;
+        }
+        // aim at 20% beyond the minimum time, growing by 100x at most per round.
+        auto nsPerOp = std::max(1.0, (double) elapsed / n);
+        n = std::min(n * 100, std::max(n + 1, (int64_t) (min_time_ns * 1.2 / nsPerOp)));
+        n = std::min(n, AAP_BENCHMARK_MAX_ITERATIONS);
+    }
+}
+
+void aap::benchmark::BenchmarkRunner::writeJson(FILE* out) {
+    char date[32]{};
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    char host[256]{};
+    gethostname(host, sizeof(host) - 1);
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"context\": {\"date\": \"%s\", \"host\": \"%s\", \"num_cpus\": %u, \"compiler\": \"%s\", \"min_time_ns\": %lld},\n",
+            date, host, std::thread::hardware_concurrency(), __VERSION__, (long long) min_time_ns);
+    fprintf(out, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_op\": %.3f, \"allocations_per_op\": %.4f, \"bytes_per_op\": %.1f}%s\n",
+                r.name.c_str(), (long long) r.iterations, r.ns_per_op, r.allocations_per_op, r.bytes_per_op,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+std::vector<aap::benchmark::BenchmarkResult> aap::benchmark::BenchmarkRunner::readJson(const char* path) {
+    std::vector<BenchmarkResult> ret{};
+    auto file = fopen(path, "r");
+    if (!file)
+        return ret;
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        auto entry = strstr(line, "{\"name\": \"");
+        if (!entry)
+            continue;
+        char name[512]{};
+        long long iterations;
+        BenchmarkResult r{};
+        if (sscanf(entry, "{\"name\": \"%511[^\"]\", \"iterations\": %lld, \"ns_per_op\": %lf, \"allocations_per_op\": %lf, \"bytes_per_op\": %lf",
+                   name, &iterations, &r.ns_per_op, &r.allocations_per_op, &r.bytes_per_op) != 5)
+            continue;
+        r.name = name;
+        r.iterations = iterations;
+        ret.emplace_back(r);
+    }
+    fclose(file);
+    return ret;
+}
+
+int32_t aap::benchmark::BenchmarkRunner::compare(const std::vector<BenchmarkResult>& baseline, double thresholdPercent) {
+    int32_t regressions = 0;
+    printf("\n%-48s %14s %14s %9s %18s\n", "benchmark", "baseline ns/op", "ns/op", "change", "allocs/op");
+    for (auto& r : results) {
+        auto b = std::find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult& e) { return e.name == r.name; });
+        if (b == baseline.end()) {
+            printf("%-48s %14s %14.1f %9s %18.2f  (new)\n", r.name.c_str(), "-", r.ns_per_op, "-", r.allocations_per_op);
+            continue;
+        }
+        double change = b->ns_per_op > 0 ? (r.ns_per_op / b->ns_per_op - 1) * 100 : 0;
+        bool slower = change > thresholdPercent;
+        bool allocates = r.allocations_per_op > b->allocations_per_op + AAP_BENCHMARK_ALLOCATION_TOLERANCE;
+        if (slower || allocates)
+            regressions++;
+        printf("%-48s %14.1f %14.1f %+8.1f%% %8.2f -> %7.2f%s%s\n", r.name.c_str(), b->ns_per_op, r.ns_per_op, change,
+               b->allocations_per_op, r.allocations_per_op, slower ? "  SLOWER" : "", allocates ? "  MORE ALLOCATIONS" : "");
+    }
+    return regressions;
+}
@@ -0,0 +1,58 @@
+#ifndef AAP_BENCHMARKS_BENCHMARK_RUNNER_H
+#define AAP_BENCHMARKS_BENCHMARK_RUNNER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace aap::benchmark {
+
+    struct BenchmarkResult {
+        std::string name{};
+        int64_t iterations{0};
+        double ns_per_op{0};
+        // heap allocations (malloc/calloc/realloc, or operator new where malloc cannot be counted) per operation.
+        double allocations_per_op{0};
+        double bytes_per_op{0};
+    };
+
+    // Performs the operation `iterations` times. Setup and teardown should be done outside of it.
+    using BenchmarkFunction = std::function<void(int64_t iterations)>;
+
+    /**
+     * Runs the benchmarks, each one for at least `minTimeNanoseconds`, and collects ns/op and allocations/op.
+     *
+     * The results are written as JSON, one benchmark per line, so that they can be diffed between releases
+     * and read back as a baseline by `readJson()`.
+     */
+    class BenchmarkRunner {
+        int64_t min_time_ns;
+        std::string filter;
+        std::vector<BenchmarkResult> results{};
+
+    public:
+        BenchmarkRunner(int64_t minTimeNanoseconds, std::string nameFilter = "")
+                : min_time_ns(minTimeNanoseconds), filter(std::move(nameFilter)) {}
+
+        // Whether `name` passes the filter (a substring match). Useful for skipping expensive setup.
+        bool isEnabled(const std::string& name) { return filter.empty() || name.find(filter) != std::string::npos; }
+
+        // Runs `function` (if enabled), prints the result to stdout, and keeps it.
+        void run(const std::string& name, BenchmarkFunction function);
+
+        const std::vector<BenchmarkResult>& getResults() { return results; }
+
+        void writeJson(FILE* out);
+
+        // Reads the benchmarks in the JSON written by writeJson(). Returns empty if it could not be read.
+        static std::vector<BenchmarkResult> readJson(const char* path);
+
+        // Prints the differences from `baseline` and returns the number of regressions, i.e. benchmarks that
+        // got slower by more than `thresholdPercent` or allocate more.
+        int32_t compare(const std::vector<BenchmarkResult>& baseline, double thresholdPercent);
+    };
+}
+
+#endif //AAP_BENCHMARKS_BENCHMARK_RUNNER_H
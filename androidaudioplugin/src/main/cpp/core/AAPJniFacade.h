@@ -38,6 +38,12 @@ namespace aap {
 
         jobjectArray queryInstalledPluginsJNI();
 
+        jobjectArray queryInstalledPluginsInPackageJNI(std::string packageName);
+
+        std::vector<std::string> queryInstalledPluginPackageNames();
+
+        int64_t getPackageLastUpdateTime(std::string packageName);
+
         void ensureServiceConnectedFromJni(jint connectorInstanceId, std::string servicePackageName,
                                            std::function<void(std::string &)> callback);
 
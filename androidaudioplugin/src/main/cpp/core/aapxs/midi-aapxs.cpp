@@ -1,9 +1,14 @@
 
 #include "aap/core/aapxs/midi-aapxs.h"
 #include "../AAPJniFacade.h"
+#include "../hosting/audio-plugin-host-internals.h"
 
 int32_t getMidiSettingsFromLocalConfig2(std::string pluginId) {
+#if ANDROID
     return aap::AAPJniFacade::getInstance()->getMidiSettingsFromLocalConfig(pluginId);
+#else
+    return aap::getMidiSettingsFromLocalConfig(pluginId);
+#endif
 }
 
 void aap::xs::AAPXSDefinition_Midi::aapxs_midi_process_incoming_plugin_aapxs_request(
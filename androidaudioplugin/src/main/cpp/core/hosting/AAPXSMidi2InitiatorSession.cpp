@@ -6,6 +6,7 @@
 #include "aap/ext/midi.h"
 #include "aap/unstable/utility.h"
 #include "aap/unstable/logging.h"
+#include "aap/unstable/tracing.h"
 #include "../include_cmidi2.h"
 
 #define LOG_TAG "AAP.XS"
@@ -84,6 +85,9 @@ void aap::AAPXSMidi2InitiatorSession::addSession(add_midi2_event_func addMidi2Ev
 
 void aap::AAPXSMidi2InitiatorSession::completeSession(void* buffer, void* pluginOrHost) {
     auto mbh = (AAPMidiBufferHeader *) buffer;
+    if (mbh->length == 0)
+        return;
+    aap::trace::ScopedTrace trace{"AAP::AAPXSMidi2InitiatorSession_completeSession"};
     void* data = mbh + 1;
     CMIDI2_UMP_SEQUENCE_FOREACH(data, mbh->length, iter) {
         auto umpSize = mbh->length - ((uint8_t*) iter - (uint8_t*) data);
@@ -1,5 +1,6 @@
 #include "aap/core/AAPXSMidi2RecipientSession.h"
 #include "aap/ext/midi.h"
+#include "aap/unstable/tracing.h"
 #include "../include_cmidi2.h"
 
 
@@ -21,6 +22,9 @@ aap::AAPXSMidi2RecipientSession::~AAPXSMidi2RecipientSession() {
 
 void aap::AAPXSMidi2RecipientSession::process(void* buffer) {
     auto mbh = (AAPMidiBufferHeader *) buffer;
+    if (mbh->length == 0)
+        return;
+    aap::trace::ScopedTrace trace{"AAP::AAPXSMidi2RecipientSession_process"};
     void* data = mbh + 1;
     CMIDI2_UMP_SEQUENCE_FOREACH(data, mbh->length, iter) {
         auto umpSize = mbh->length - ((uint8_t*) iter - (uint8_t*) data);
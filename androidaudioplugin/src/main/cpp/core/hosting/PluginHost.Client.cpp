@@ -1,9 +1,28 @@
 
+#include <algorithm>
 #include <aap/core/host/plugin-client-system.h>
 #include <aap/core/host/plugin-host.h>
 #include <aap/core/host/plugin-instance.h>
 #include "audio-plugin-host-internals.h"
 
+#define LOG_TAG "AAP.PluginHost.Client"
+
+aap::PluginClient::~PluginClient() {
+    std::vector<PooledInstance> disposed{};
+    {
+        std::unique_lock<std::mutex> lock{instance_pool_mutex};
+        instance_pool_alive = false;
+        instance_pool_refill_requested.notify_all();
+        disposed.swap(pooled_instances);
+    }
+    if (instance_pool_worker)
+        instance_pool_worker->join();
+    // the worker may have added more
+    disposed.insert(disposed.end(), pooled_instances.begin(), pooled_instances.end());
+    for (auto& p : disposed)
+        disposeInstance(p.instance);
+}
+
 void aap::PluginClient::connectToPluginService(const std::string& identifier, std::function<void(std::string&)> callback) {
     const PluginInformation *descriptor = plugin_list->getPluginInformation(identifier);
     if (descriptor == nullptr) {
@@ -53,8 +72,12 @@ aap::PluginClient::Result<int32_t> aap::PluginClient::createInstance(std::string
         else
             return Result<int32_t>{-1, error};
     };
-    if (isRemoteExplicit || descriptor->isOutProcess())
+    if (isRemoteExplicit || descriptor->isOutProcess()) {
+        auto pooled = takePooledInstance(descriptor, sampleRate);
+        if (pooled)
+            return internalCallback(pooled, "");
         return instantiateRemotePlugin(descriptor, sampleRate);
+    }
     else {
         try {
             auto instance = instantiateLocalPlugin(descriptor, sampleRate);
@@ -66,6 +89,15 @@ aap::PluginClient::Result<int32_t> aap::PluginClient::createInstance(std::string
 }
 
 aap::PluginClient::Result<int32_t> aap::PluginClient::instantiateRemotePlugin(const PluginInformation *descriptor, int sampleRate)
+{
+    auto result = createRemotePluginInstance(descriptor, sampleRate);
+    if (result.value == nullptr)
+        return Result<int32_t>{-1, result.error};
+    registerInstance(result.value);
+    return Result<int32_t>{result.value->getInstanceId(), ""};
+}
+
+aap::PluginClient::Result<aap::PluginInstance*> aap::PluginClient::createRemotePluginInstance(const PluginInformation *descriptor, int sampleRate)
 {
     // We first ensure to bind the remote plugin service, and then create a plugin instance.
     //  Since binding the plugin service must be asynchronous while instancing does not have to be,
@@ -79,22 +111,21 @@ aap::PluginClient::Result<int32_t> aap::PluginClient::instantiateRemotePlugin(co
 #endif
             if (pluginFactory == nullptr) {
                 AAP_ASSERT_FALSE;
-                return Result<int32_t>{-1, std::string{"pluginFactory is not returned as expected"}};
+                return Result<PluginInstance*>{nullptr, std::string{"pluginFactory is not returned as expected"}};
             }
             auto instance = new RemotePluginInstance(this,
                                         aapxs_definition_registry,
                                                      descriptor, pluginFactory,
                                                      sampleRate, event_midi2_input_buffer_size);
-            instances.emplace_back(instance);
             instance->setupAAPXS(); // this needs to be done before setupAAPXSInstances() which is invoked by completeInstantiation() in binder-client-as-plugin.
             instance->completeInstantiation();
             instance->configurePorts();
             instance->scanParametersAndBuildList();
 
-            return Result<int32_t>{instance->getInstanceId(), ""};
+            return Result<PluginInstance*>{instance, ""};
         }
         else
-            return Result<int32_t>{-1, error};
+            return Result<PluginInstance*>{nullptr, error};
     };
     auto service = connections->getServiceHandleForConnectedPlugin(descriptor->getPluginPackageName(), descriptor->getPluginLocalName());
     if (service != nullptr)
@@ -103,3 +134,109 @@ aap::PluginClient::Result<int32_t> aap::PluginClient::instantiateRemotePlugin(co
         return internalCallback(std::string{"Plugin service is not started yet: "} + descriptor->getPluginID());
 }
 
+// Instance pool ----------------------------------------------------------------------------------
+
+void aap::PluginClient::configureInstancePool(std::vector<PluginInstancePoolConfiguration> configurations) {
+    std::vector<PooledInstance> disposed{};
+    {
+        std::unique_lock<std::mutex> lock{instance_pool_mutex};
+        instance_pool_configurations = std::move(configurations);
+        // drop the pooled instances that are not in the new configurations.
+        auto isStale = [this](const PooledInstance& p) {
+            for (auto& c : instance_pool_configurations)
+                if (c.plugin_id == p.instance->getPluginInformation()->getPluginID() &&
+                    c.sample_rate == p.sample_rate && c.frame_count == p.frame_count)
+                    return false;
+            return true;
+        };
+        for (auto& p : pooled_instances)
+            if (isStale(p))
+                disposed.emplace_back(p);
+        pooled_instances.erase(std::remove_if(pooled_instances.begin(), pooled_instances.end(), isStale), pooled_instances.end());
+
+        if (!instance_pool_configurations.empty() && !instance_pool_worker) {
+            instance_pool_alive = true;
+            instance_pool_worker = std::make_unique<std::thread>([this] { runInstancePoolWorker(); });
+        }
+        instance_pool_needs_refill = true;
+        instance_pool_refill_requested.notify_all();
+    }
+    for (auto& p : disposed)
+        disposeInstance(p.instance);
+}
+
+size_t aap::PluginClient::getPooledInstanceCount(const std::string& pluginId) {
+    std::unique_lock<std::mutex> lock{instance_pool_mutex};
+    return std::count_if(pooled_instances.begin(), pooled_instances.end(), [&](const PooledInstance& p) {
+        return p.instance->getPluginInformation()->getPluginID() == pluginId;
+    });
+}
+
+aap::PluginInstance* aap::PluginClient::takePooledInstance(const PluginInformation *descriptor, int sampleRate) {
+    std::unique_lock<std::mutex> lock{instance_pool_mutex};
+    for (auto p = pooled_instances.begin(); p != pooled_instances.end(); p++) {
+        if (p->instance->getPluginInformation() == descriptor && p->sample_rate == sampleRate) {
+            auto instance = p->instance;
+            pooled_instances.erase(p);
+            registerInstance(instance);
+            instance_pool_hits.fetch_add(1, std::memory_order_relaxed);
+            instance_pool_needs_refill = true;
+            instance_pool_refill_requested.notify_all();
+            return instance;
+        }
+    }
+    return nullptr;
+}
+
+void aap::PluginClient::runInstancePoolWorker() {
+    std::unique_lock<std::mutex> lock{instance_pool_mutex};
+    while (instance_pool_alive) {
+        instance_pool_refill_requested.wait(lock, [this] { return !instance_pool_alive || instance_pool_needs_refill; });
+        instance_pool_needs_refill = false;
+
+        // The configurations may be replaced while the lock is released for instantiation,
+        // so we re-check them every time.
+        for (size_t i = 0; instance_pool_alive && i < instance_pool_configurations.size(); i++) {
+            auto config = instance_pool_configurations[i];
+            auto countPooled = [&] {
+                return std::count_if(pooled_instances.begin(), pooled_instances.end(), [&](const PooledInstance& p) {
+                    return p.instance->getPluginInformation()->getPluginID() == config.plugin_id &&
+                           p.sample_rate == config.sample_rate && p.frame_count == config.frame_count;
+                });
+            };
+            auto isConfigured = [&] {
+                return i < instance_pool_configurations.size() &&
+                       instance_pool_configurations[i].plugin_id == config.plugin_id &&
+                       instance_pool_configurations[i].sample_rate == config.sample_rate &&
+                       instance_pool_configurations[i].frame_count == config.frame_count;
+            };
+            auto descriptor = plugin_list->getPluginInformation(config.plugin_id);
+            if (!descriptor) {
+                aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Instance pool: plugin not found: %s", config.plugin_id.c_str());
+                continue;
+            }
+
+            while (instance_pool_alive && isConfigured() && countPooled() < config.pool_size) {
+                lock.unlock();
+                auto result = createRemotePluginInstance(descriptor, config.sample_rate);
+                if (result.value)
+                    result.value->prepare(config.frame_count);
+                lock.lock();
+
+                if (!result.value) {
+                    // It will be retried at the next refill request.
+                    aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Instance pool: failed to instantiate %s: %s",
+                                 config.plugin_id.c_str(), result.error.c_str());
+                    break;
+                }
+                if (!instance_pool_alive || !isConfigured()) {
+                    lock.unlock();
+                    disposeInstance(result.value);
+                    lock.lock();
+                    break;
+                }
+                pooled_instances.emplace_back(PooledInstance{result.value, config.sample_rate, config.frame_count});
+            }
+        }
+    }
+}
@@ -11,5 +11,5 @@ int32_t aap::PluginService::createInstance(std::string identifier, int sampleRat
         return -1;
     }
     auto instance = instantiateLocalPlugin(info, sampleRate);
-    return instance->getInstanceId();
+    return instance ? instance->getInstanceId() : -1;
 }
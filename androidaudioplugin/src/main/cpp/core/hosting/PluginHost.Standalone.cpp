@@ -0,0 +1,92 @@
+
+#include <aap/core/host/plugin-client-system.h>
+#include <aap/core/host/plugin-host.h>
+#include <aap/core/host/plugin-instance.h>
+#include <aap/core/host/shared-memory-store.h>
+
+#define LOG_TAG "AAP.PluginHost.Standalone"
+
+// There is no client that plugins could talk to. The owner of the service processes the instances by itself.
+class StandalonePluginServiceCallback : public aap::AudioPluginServiceCallback {
+public:
+    void hostExtension(int32_t in_instanceId, const std::string& in_uri, int32_t in_opcode) override {}
+    void requestProcess(int32_t in_instanceId) override {}
+};
+
+static StandalonePluginServiceCallback standalone_service_callback{};
+static aap::PluginListSnapshot standalone_empty_plugin_list{};
+
+static void ignoreHostExtensionRequest(void* context, const char* uri, int32_t instanceId, int32_t opcode) {
+    aap::a_log_f(AAP_LOG_LEVEL_DEBUG, LOG_TAG,
+                 "host extension %s (opcode %d) from instance %d is ignored", uri, opcode, instanceId);
+}
+
+aap::StandalonePluginService::StandalonePluginService(xs::AAPXSDefinitionRegistry* aapxsDefinitionRegistry)
+        : PluginService(&standalone_empty_plugin_list, &standalone_service_callback, aapxsDefinitionRegistry) {
+}
+
+aap::StandalonePluginService::~StandalonePluginService() {
+    while (getInstanceCount() > 0) {
+        auto instance = getInstanceByIndex(0);
+        if (instance->getInstanceState() == PLUGIN_INSTANTIATION_STATE_ACTIVE)
+            instance->deactivate();
+        destroyInstance(instance);
+    }
+}
+
+aap::LocalPluginInstance* aap::StandalonePluginService::instantiate(const PluginInformation* pluginInfo, int32_t sampleRate) {
+    return (LocalPluginInstance*) instantiateLocalPlugin(pluginInfo, sampleRate);
+}
+
+std::string aap::StandalonePluginService::setupInstance(LocalPluginInstance* instance, int32_t framesPerBlock) {
+    auto system = PluginClientSystem::getInstance();
+    instance->setIpcExtensionMessageSender(ignoreHostExtensionRequest, nullptr);
+    auto shm = dynamic_cast<ServicePluginSharedMemoryStore*>(instance->getSharedMemoryStore());
+
+    for (auto& definition : *instance->getAAPXSRegistry()->items()) {
+        if (!definition.uri || definition.data_capacity == 0)
+            continue;
+        auto fd = system->createSharedMemory(definition.data_capacity);
+        if (fd < 0) {
+            // the extension buffers added so far are not used by anyone.
+            shm->disposeExtensionFDs();
+            shm->getExtensionUriToIndexMap().clear();
+            return "failed to allocate extension buffer";
+        }
+        shm->addExtensionFD(fd, definition.data_capacity);
+        shm->getExtensionUriToIndexMap()[definition.uri] = shm->getExtensionBufferCount() - 1;
+    }
+
+    instance->setupAAPXSInstances();
+    instance->completeInstantiation();
+    if (instance->getInstanceState() != PLUGIN_INSTANTIATION_STATE_UNPREPARED)
+        return "failed to instantiate the plugin";
+    instance->setupAAPXS();
+    instance->startPortConfiguration();
+    instance->confirmPorts();
+    instance->scanParametersAndBuildList();
+
+    std::vector<int32_t> fds{};
+    for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+        auto port = instance->getPort(i);
+        // the same size as allocateServiceBuffer() maps.
+        size_t size = port->hasProperty(AAP_PORT_MINIMUM_SIZE) ? port->getPropertyAsInteger(AAP_PORT_MINIMUM_SIZE) :
+                      port->getContentType() == AAP_CONTENT_TYPE_AUDIO ? framesPerBlock * sizeof(float) : DEFAULT_CONTROL_BUFFER_SIZE;
+        auto fd = system->createSharedMemory(size);
+        if (fd < 0) {
+            for (auto f : fds)
+                close(f);
+            return "failed to allocate port buffer";
+        }
+        fds.emplace_back(fd);
+    }
+    shm->resizePortBufferByCount(fds.size());
+    for (size_t i = 0; i < fds.size(); i++)
+        shm->setPortBufferFD(i, fds[i]);
+    if (!shm->completeServiceInitialization(framesPerBlock, *instance, DEFAULT_CONTROL_BUFFER_SIZE))
+        return "failed to map port buffers";
+
+    instance->prepare(framesPerBlock);
+    instance->activate();
+    return "";
+}
@@ -1,5 +1,4 @@
 
-#include <sys/stat.h>
 #include <aap/core/host/plugin-host.h>
 #include <aap/core/host/plugin-instance.h>
 #include <aap/core/aapxs/extension-service.h>
@@ -21,10 +20,66 @@ aap::PluginHost::PluginHost(PluginListSnapshot* contextPluginList,
     aapxs_definition_registry = aapxsDefinitionRegistry ? aapxsDefinitionRegistry : xs::AAPXSDefinitionRegistry::getStandardExtensions();
 }
 
+aap::PluginHost::~PluginHost() {
+    for (auto& chunk : instance_table)
+        delete chunk.load();
+}
+
+std::atomic<aap::PluginInstance*>* aap::PluginHost::getInstanceTableEntry(int32_t instanceId, bool allocate) {
+    if (instanceId < 0 || instanceId >= AAP_INSTANCE_TABLE_CHUNKS * AAP_INSTANCE_TABLE_CHUNK_SIZE)
+        return nullptr;
+    auto& chunkRef = instance_table[instanceId / AAP_INSTANCE_TABLE_CHUNK_SIZE];
+    auto chunk = chunkRef.load(std::memory_order_acquire);
+    if (!chunk) {
+        if (!allocate)
+            return nullptr;
+        // Only the (non-realtime) instance management thread allocates chunks.
+        chunk = new InstanceTableChunk();
+        chunkRef.store(chunk, std::memory_order_release);
+    }
+    return &chunk->entries[instanceId % AAP_INSTANCE_TABLE_CHUNK_SIZE];
+}
+
+void aap::PluginHost::registerInstance(PluginInstance* instance)
+{
+    std::lock_guard<std::mutex> lock{instances_mutex};
+    instances.emplace_back(instance);
+    auto entry = getInstanceTableEntry(instance->getInstanceId(), true);
+    // Remote instances from different services may share the same ID; the first one is looked up.
+    if (entry && entry->load(std::memory_order_relaxed) == nullptr)
+        entry->store(instance, std::memory_order_release);
+}
+
 void aap::PluginHost::destroyInstance(PluginInstance* instance)
 {
-    instances.erase(std::find(instances.begin(), instances.end(), instance));
+    {
+        std::lock_guard<std::mutex> lock{instances_mutex};
+        instances.erase(std::find(instances.begin(), instances.end(), instance));
+        auto instanceId = instance->getInstanceId();
+        auto entry = getInstanceTableEntry(instanceId, false);
+        if (entry && entry->load(std::memory_order_relaxed) == instance) {
+            PluginInstance* another{nullptr};
+            for (auto i : instances)
+                if (i->getInstanceId() == instanceId) {
+                    another = i;
+                    break;
+                }
+            entry->store(another, std::memory_order_release);
+        }
+    }
+    // no one can reach the instance via `instances` anymore.
+    disposeInstance(instance);
+}
+
+void aap::PluginHost::disposeInstance(PluginInstance* instance)
+{
+    auto library = local_instance_libraries.find(instance);
     delete instance;
+    // The library must be unloaded only after the plugin is released.
+    if (library != local_instance_libraries.end()) {
+        PluginLibraryCache::getInstance()->release(library->second);
+        local_instance_libraries.erase(library);
+    }
 }
 
 aap::PluginInstance* aap::PluginHost::getInstanceByIndex(int32_t index) {
@@ -36,48 +91,52 @@ aap::PluginInstance* aap::PluginHost::getInstanceByIndex(int32_t index) {
 }
 
 aap::PluginInstance* aap::PluginHost::getInstanceById(int32_t instanceId) {
+    if (instanceId >= 0 && instanceId < AAP_INSTANCE_TABLE_CHUNKS * AAP_INSTANCE_TABLE_CHUNK_SIZE) {
+        auto entry = getInstanceTableEntry(instanceId, false);
+        return entry ? entry->load(std::memory_order_acquire) : nullptr;
+    }
     for (auto i: instances)
         if (i->getInstanceId() == instanceId)
             return i;
     return nullptr;
 }
 
-int32_t localInstanceIdSerial{0};
+bool aap::PluginHost::getInstanceStatistics(int32_t instanceId, PluginInstanceStatisticsSnapshot& snapshot) {
+    // destroyInstance() must not delete the instance while it is being read.
+    std::lock_guard<std::mutex> lock{instances_mutex};
+    auto instance = getInstanceById(instanceId);
+    if (!instance)
+        return false;
+    instance->getStatistics().getSnapshot(snapshot);
+    snapshot.ump_merger_lock = instance->getUmpMergerLockStatistics();
+    snapshot.instance_id = instanceId;
+    return true;
+}
+
+std::vector<aap::PluginInstanceStatisticsSnapshot> aap::PluginHost::getAllInstanceStatistics() {
+    std::lock_guard<std::mutex> lock{instances_mutex};
+    std::vector<PluginInstanceStatisticsSnapshot> ret(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        instances[i]->getStatistics().getSnapshot(ret[i]);
+        ret[i].ump_merger_lock = instances[i]->getUmpMergerLockStatistics();
+        ret[i].instance_id = instances[i]->getInstanceId();
+    }
+    return ret;
+}
+
+// instances may be created on multiple threads (e.g. offline renderers running jobs in parallel).
+std::atomic<int32_t> localInstanceIdSerial{0};
 
 aap::PluginInstance* aap::PluginHost::instantiateLocalPlugin(const PluginInformation *descriptor, int sampleRate)
 {
-    dlerror(); // clean up any previous error state
-    auto file = descriptor->getLocalPluginSharedLibrary();
-    auto metadataFullPath = descriptor->getMetadataFullPath();
-    if (!metadataFullPath.empty()) {
-        size_t idx = metadataFullPath.find_last_of('/');
-        if (idx > 0) {
-            auto soFullPath = metadataFullPath.substr(0, idx + 1) + file;
-            struct stat st;
-            if (stat(soFullPath.c_str(), &st) == 0)
-                file = soFullPath;
-        }
-    }
-    auto entrypoint = descriptor->getLocalPluginLibraryEntryPoint();
-    auto dl = dlopen(file.length() > 0 ? file.c_str() : "libandroidaudioplugin.so", RTLD_LAZY);
-    if (dl == nullptr) {
-        aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "aap::PluginHost: AAP library %s could not be loaded: %s", file.c_str(), dlerror());
-        return nullptr;
-    }
-    auto factoryGetter = (aap_factory_t) dlsym(dl, entrypoint.length() > 0 ? entrypoint.c_str() : "GetAndroidAudioPluginFactory");
-    if (factoryGetter == nullptr) {
-        aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "aap::PluginHost: AAP factory entrypoint function %s was not found in %s.", entrypoint.c_str(), file.c_str());
+    auto library = PluginLibraryCache::getInstance()->acquire(descriptor);
+    if (library == nullptr)
         return nullptr;
-    }
-    auto pluginFactory = factoryGetter();
-    if (pluginFactory == nullptr) {
-        aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "aap::PluginHost: AAP factory entrypoint function %s could not instantiate a plugin.", entrypoint.c_str());
-        return nullptr;
-    }
     auto instance = new LocalPluginInstance(this,
                                             aapxs_definition_registry,
                                             localInstanceIdSerial++,
-                                            descriptor, pluginFactory, sampleRate, event_midi2_input_buffer_size);
-    instances.emplace_back(instance);
+                                            descriptor, library->getFactory(), sampleRate, event_midi2_input_buffer_size);
+    registerInstance(instance);
+    local_instance_libraries[instance] = library;
     return instance;
 }
@@ -1,5 +1,7 @@
 #include "aap/core/host/shared-memory-store.h"
 #include "aap/core/host/plugin-instance.h"
+#include "aap/unstable/tracing.h"
+#include "aap/unstable/rt-safety.h"
 
 #define LOG_TAG "AAP.Local.Instance"
 
@@ -55,6 +57,10 @@ aap::LocalPluginInstance::getHostExtension(uint8_t urid, const char *uri) {
         host_plugin_info.get = get_plugin_info;
         return &host_plugin_info;
     }
+    if (strcmp(uri, AAP_RENDER_MODE_EXTENSION_URI) == 0) {
+        host_render_mode.get_render_mode = internalGetRenderMode;
+        return &host_render_mode;
+    }
     // Look up host extension and get proxy via AAPXSDefinition.
     auto registry = getAAPXSRegistry()->items();
     auto definition = urid != 0 ? registry->getByUrid(urid) : registry->getByUri(uri);
@@ -96,7 +102,7 @@ void aap::LocalPluginInstance::requestProcessToHost() {
 void aap::LocalPluginInstance::addEventUmpOutput(void *input, int32_t size) {
     // unlike client side, we are not multithreaded during the audio processing,
     // but multiple async extension calls may race, so lock here too.
-    const std::lock_guard<NanoSleepLock> lock{aapxs_out_merger_mutex_out};
+    const std::lock_guard<AdaptiveMutex> lock{aapxs_out_merger_mutex_out};
     if (aapxs_out_midi2_buffer_offset + size > event_midi2_buffer_size)
         return;
     memcpy((uint8_t *) aapxs_out_midi2_buffer + aapxs_out_midi2_buffer_offset,
@@ -107,6 +113,10 @@ void aap::LocalPluginInstance::addEventUmpOutput(void *input, int32_t size) {
 const char* local_trace_name = "AAP::LocalPluginInstance_process";
 void aap::LocalPluginInstance::process(int32_t frameCount, int32_t timeoutInNanoseconds) {
     process_requested_to_host = false;
+    aap::trace::ScopedTrace trace{local_trace_name};
+    aap::rt::ScopedRealtimeSection realtime{local_trace_name};
+    struct timespec processBegin{};
+    clock_gettime(CLOCK_MONOTONIC, &processBegin);
 
     struct timespec timeSpecBegin{}, timeSpecEnd{};
 #if ANDROID
@@ -116,7 +126,7 @@ void aap::LocalPluginInstance::process(int32_t frameCount, int32_t timeoutInNano
     }
 #endif
 
-    if (std::unique_lock<NanoSleepLock> tryLock(ump_sequence_merger_mutex, std::try_to_lock); tryLock.owns_lock()) {
+    if (std::unique_lock<AdaptiveMutex> tryLock(ump_sequence_merger_mutex, std::try_to_lock); tryLock.owns_lock()) {
         // merge input from native UI into the host's MIDI inputs
         merge_ump_sequences(AAP_PORT_DIRECTION_INPUT, event_midi2_merge_buffer, event_midi2_buffer_size,
                             event_midi2_buffer, event_midi2_buffer_offset,
@@ -136,17 +146,21 @@ void aap::LocalPluginInstance::process(int32_t frameCount, int32_t timeoutInNano
         aapxs_midi2_in_session.process(data);
     }
 
+    statistics.recordUmpInput(countUmps(AAP_PORT_DIRECTION_INPUT));
     plugin->process(plugin, getAudioPluginBuffer(), frameCount, timeoutInNanoseconds);
+    statistics.recordUmpOutput(countUmps(AAP_PORT_DIRECTION_OUTPUT));
 
     // before sending back to host, merge AAPXS SysEx8 UMPs from async extension calls
     // into the plugin's MIDI output buffer.
-    if (std::unique_lock<NanoSleepLock> tryLock(aapxs_out_merger_mutex_out, std::try_to_lock); tryLock.owns_lock()) {
+    if (std::unique_lock<AdaptiveMutex> tryLock(aapxs_out_merger_mutex_out, std::try_to_lock); tryLock.owns_lock()) {
         merge_ump_sequences(AAP_PORT_DIRECTION_OUTPUT, aapxs_out_merge_buffer, event_midi2_buffer_size,
                             aapxs_out_midi2_buffer, aapxs_out_midi2_buffer_offset,
                             getAudioPluginBuffer(), this);
         aapxs_out_midi2_buffer_offset = 0;
     }
 
+    recordProcess(processBegin.tv_sec * 1000000000LL + processBegin.tv_nsec, frameCount);
+
 #if ANDROID
     if (ATrace_isEnabled()) {
         clock_gettime(CLOCK_REALTIME, &timeSpecEnd);
@@ -189,6 +203,7 @@ void aap::LocalPluginInstance::setupAAPXSInstances() {
 void
 aap::LocalPluginInstance::sendPluginAAPXSReply(AAPXSRequestContext* request) {
     if (instantiation_state == PLUGIN_INSTANTIATION_STATE_ACTIVE) {
+        statistics.recordAAPXSOutgoing(request->serialization->data_size);
         aapxs_midi2_in_session.addReply(aapxsProcessorAddEventUmpOutput,
                                         this,
                                         request->urid,
@@ -211,6 +226,7 @@ aap::LocalPluginInstance::sendHostAAPXSRequest(AAPXSRequestContext* request) {
     if (instantiation_state == PLUGIN_INSTANTIATION_STATE_ACTIVE) {
         // aapxsInstance already contains binary data here, so we retrieve data from there.
         // This is an asynchronous function, so we do not wait for the result.
+        statistics.recordAAPXSOutgoing(request->serialization->data_size);
         aapxs_host_session.addSession(aapxsSessionAddEventUmpInput, this, request);
         return true;
     } else {
@@ -247,6 +263,7 @@ void aap::LocalPluginInstance::controlExtension(uint8_t urid, const std::string
 }
 
 void aap::LocalPluginInstance::handleAAPXSInput(aap_midi2_aapxs_parse_context *context) {
+    statistics.recordAAPXSIncoming(context->dataSize);
     if (context->opcode >= 0) {
         // plugin request
         auto& dispatcher = getAAPXSDispatcher();
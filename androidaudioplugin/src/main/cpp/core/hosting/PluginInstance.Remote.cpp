@@ -1,5 +1,7 @@
 #include "aap/core/host/plugin-instance.h"
 #include "aap/core/host/shared-memory-store.h"
+#include "aap/unstable/tracing.h"
+#include "aap/unstable/rt-safety.h"
 #include "../AAPJniFacade.h"
 
 #define LOG_TAG "AAP.Remote.Instance"
@@ -54,7 +56,12 @@ AndroidAudioPluginHost* aap::RemotePluginInstance::getHostFacadeForCompleteInsta
 }
 
 void aap::RemotePluginInstance::prepare(int frameCount) {
-    if (instantiation_state != PLUGIN_INSTANTIATION_STATE_UNPREPARED) {
+    // An instance from the instance pool is already prepared. It is prepared again (with new shared memory
+    // on both sides) only if it needs more frames than it was prepared for.
+    if (instantiation_state == PLUGIN_INSTANTIATION_STATE_INACTIVE && frameCount <= prepared_frame_count)
+        return;
+    if (instantiation_state != PLUGIN_INSTANTIATION_STATE_UNPREPARED &&
+        instantiation_state != PLUGIN_INSTANTIATION_STATE_INACTIVE) {
         aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG,
                      "Unexpected call to prepare() at state: %d (instanceId: %d)",
                      instantiation_state, instance_id);
@@ -66,9 +73,11 @@ void aap::RemotePluginInstance::prepare(int frameCount) {
     auto code = shm->allocateClientBuffer(numPorts, frameCount, *this, DEFAULT_CONTROL_BUFFER_SIZE);
     if (code != aap::PluginSharedMemoryStore::PluginMemoryAllocatorResult::PLUGIN_MEMORY_ALLOCATOR_SUCCESS) {
         aap::a_log(AAP_LOG_LEVEL_ERROR, LOG_TAG, aap::PluginSharedMemoryStore::getMemoryAllocationErrorMessage(code));
+        return;
     }
 
     plugin->prepare(plugin, getAudioPluginBuffer());
+    prepared_frame_count = frameCount;
     instantiation_state = PLUGIN_INSTANTIATION_STATE_INACTIVE;
 }
 
@@ -117,6 +126,10 @@ void aap::RemotePluginInstance::connectRemoteNativeView(int32_t width, int32_t h
 
 void aap::RemotePluginInstance::process(int32_t frameCount, int32_t timeoutInNanoseconds) {
     const char* remote_trace_name = "AAP::RemotePluginInstance_process";
+    aap::trace::ScopedTrace trace{remote_trace_name};
+    aap::rt::ScopedRealtimeSection realtime{remote_trace_name};
+    struct timespec processBegin{};
+    clock_gettime(CLOCK_MONOTONIC, &processBegin);
     struct timespec timeSpecBegin{}, timeSpecEnd{};
 #if ANDROID
     if (ATrace_isEnabled()) {
@@ -126,7 +139,7 @@ void aap::RemotePluginInstance::process(int32_t frameCount, int32_t timeoutInNan
 #endif
 
     // merge input from AAPXS SysEx8 into the host's MIDI inputs
-    if (std::unique_lock<NanoSleepLock> tryLock(ump_sequence_merger_mutex, std::try_to_lock); tryLock.owns_lock()) {
+    if (std::unique_lock<AdaptiveMutex> tryLock(ump_sequence_merger_mutex, std::try_to_lock); tryLock.owns_lock()) {
         merge_ump_sequences(AAP_PORT_DIRECTION_INPUT, event_midi2_merge_buffer, event_midi2_buffer_size,
                             event_midi2_buffer, event_midi2_buffer_offset,
                             getAudioPluginBuffer(), this);
@@ -134,7 +147,9 @@ void aap::RemotePluginInstance::process(int32_t frameCount, int32_t timeoutInNan
     }
 
     // now we can pass the input to the plugin.
+    statistics.recordUmpInput(countUmps(AAP_PORT_DIRECTION_INPUT));
     plugin->process(plugin, getAudioPluginBuffer(), frameCount, timeoutInNanoseconds);
+    statistics.recordUmpOutput(countUmps(AAP_PORT_DIRECTION_OUTPUT));
 
     // retrieve AAPXS SysEx8 replies if any.
     for (auto i = 0, n = getNumPorts(); i < n; i++) {
@@ -149,6 +164,8 @@ void aap::RemotePluginInstance::process(int32_t frameCount, int32_t timeoutInNan
         ((AAPMidiBufferHeader*) data)->length = 0;
     }
 
+    recordProcess(processBegin.tv_sec * 1000000000LL + processBegin.tv_nsec, frameCount);
+
 #if ANDROID
     if (ATrace_isEnabled()) {
         clock_gettime(CLOCK_REALTIME, &timeSpecEnd);
@@ -174,19 +191,27 @@ aap::RemotePluginInstance::internalGetHostExtension(uint8_t urid, const char *ur
 //----
 
 aap::RemotePluginInstance::RemotePluginNativeUIController::RemotePluginNativeUIController(RemotePluginInstance* owner) {
+#if ANDROID
     handle = AAPJniFacade::getInstance()->createSurfaceControl();
+#endif
 }
 
 aap::RemotePluginInstance::RemotePluginNativeUIController::~RemotePluginNativeUIController() {
+#if ANDROID
     AAPJniFacade::getInstance()->disposeSurfaceControl(handle);
+#endif
 }
 
 void aap::RemotePluginInstance::RemotePluginNativeUIController::show() {
+#if ANDROID
     AAPJniFacade::getInstance()->showSurfaceControlView(handle);
+#endif
 }
 
 void aap::RemotePluginInstance::RemotePluginNativeUIController::hide() {
+#if ANDROID
     AAPJniFacade::getInstance()->hideSurfaceControlView(handle);
+#endif
 }
 
 
@@ -227,6 +252,7 @@ aap::RemotePluginInstance::sendPluginAAPXSRequest(AAPXSRequestContext* request)
     if (instantiation_state == PLUGIN_INSTANTIATION_STATE_ACTIVE) {
         // request->serialization already contains binary data here, so we retrieve data from there.
         // This is an asynchronous function, so we do not wait for the result, and it has no awaiter (hence std::nullopt)
+        statistics.recordAAPXSOutgoing(request->serialization->data_size);
         aapxs_session.addSession(aapxsSessionAddEventUmpInput,
                                  this, request);
         return true;
@@ -259,6 +285,7 @@ aap::RemotePluginInstance::sendHostAAPXSReply(AAPXSRequestContext* request) {
     if (instantiation_state == PLUGIN_INSTANTIATION_STATE_ACTIVE) {
         // aapxsInstance already contains binary data here, so we retrieve data from there.
         int32_t group = 0; // will we have to give special semantics on it?
+        statistics.recordAAPXSOutgoing(request->serialization->data_size);
         aapxs_session.addSession(aapxsSessionAddEventUmpInput, this, group,
                                  request->request_id, request->urid, request->uri, request->serialization->data,
                                  request->serialization->data_size, request->opcode);
@@ -282,6 +309,7 @@ void aap::RemotePluginInstance::setupAAPXS() {
 }
 
 void aap::RemotePluginInstance::handleAAPXSReply(aap_midi2_aapxs_parse_context *context) {
+    statistics.recordAAPXSIncoming(context->dataSize);
     auto& dispatcher = getAAPXSDispatcher();
     auto registry = feature_registry->items();
     auto aapxs = context->urid != 0 ? registry->getByUrid(context->urid) : registry->getByUri(context->uri);
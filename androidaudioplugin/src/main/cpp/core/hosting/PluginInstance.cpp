@@ -1,6 +1,8 @@
 
 #include "aap/core/host/shared-memory-store.h"
 #include "aap/core/host/plugin-instance.h"
+#include "aap/unstable/tracing.h"
+#include "aap/unstable/rt-safety.h"
 #include "../include_cmidi2.h"
 
 #define LOG_TAG "AAP.Instance"
@@ -197,11 +199,13 @@ void aap::PluginInstance::deactivate() {
 
     plugin->deactivate(plugin);
     instantiation_state = PLUGIN_INSTANTIATION_STATE_INACTIVE;
+
+    aap::rt::endSession();
 }
 
 
 void aap::PluginInstance::addEventUmpInput(void *input, int32_t size) {
-    const std::lock_guard<NanoSleepLock> lock{ump_sequence_merger_mutex};
+    const std::lock_guard<AdaptiveMutex> lock{ump_sequence_merger_mutex};
     if (event_midi2_buffer_offset + size > event_midi2_buffer_size)
         return;
     memcpy((uint8_t *) event_midi2_buffer + event_midi2_buffer_offset,
@@ -212,6 +216,7 @@ void aap::PluginInstance::addEventUmpInput(void *input, int32_t size) {
 void aap::PluginInstance::merge_ump_sequences(aap_port_direction portDirection, void *mergeTmp, int32_t mergeBufSize, void* sequence, int32_t sequenceSize, aap_buffer_t *buffer, PluginInstance* instance) {
     if (sequenceSize == 0)
         return;
+    aap::trace::ScopedTrace trace{"AAP::PluginInstance_merge_ump_sequences"};
     for (int i = 0; i < instance->getNumPorts(); i++) {
         auto port = instance->getPort(i);
         if (port->getContentType() == AAP_CONTENT_TYPE_MIDI2 && port->getPortDirection() == portDirection) {
@@ -227,6 +232,44 @@ void aap::PluginInstance::merge_ump_sequences(aap_port_direction portDirection,
     }
 }
 
+int32_t aap::PluginInstance::countUmps(aap_port_direction direction) {
+    int32_t count = 0;
+    auto aapBuffer = getAudioPluginBuffer();
+    for (int32_t i = 0, n = getNumPorts(); i < n; i++) {
+        auto port = getPort(i);
+        if (port->getContentType() != AAP_CONTENT_TYPE_MIDI2 || port->getPortDirection() != direction)
+            continue;
+        auto mbh = (AAPMidiBufferHeader*) aapBuffer->get_buffer(*aapBuffer, i);
+        void* data = mbh + 1;
+        CMIDI2_UMP_SEQUENCE_FOREACH(data, mbh->length, iter) {
+            auto ump = (cmidi2_ump*) iter;
+            switch (cmidi2_ump_get_message_type(ump)) {
+            case CMIDI2_MESSAGE_TYPE_UTILITY:
+                // JR timestamps and NOOPs only carry timing, they are not events.
+                continue;
+            case CMIDI2_MESSAGE_TYPE_SYSEX7:
+            case CMIDI2_MESSAGE_TYPE_SYSEX8_MDS:
+                // a SysEx spans multiple packets; count it once, at its first packet.
+                if (cmidi2_ump_get_status_code(ump) != CMIDI2_SYSEX_IN_ONE_UMP &&
+                    cmidi2_ump_get_status_code(ump) != CMIDI2_SYSEX_START)
+                    continue;
+                break;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+void aap::PluginInstance::recordProcess(int64_t beginNanoseconds, int32_t frameCount) {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t elapsed = ts.tv_sec * 1000000000LL + ts.tv_nsec - beginNanoseconds;
+    // the deadline is the audio duration of the block.
+    int64_t deadline = (int64_t) frameCount * 1000000000LL / sample_rate;
+    statistics.recordProcess(elapsed, deadline);
+}
+
 // plugin-info host extension implementation.
 static uint32_t plugin_info_port_get_index(aap_plugin_info_port_t* port) { return ((aap::PortInformation*) port->context)->getIndex(); }
 static const char* plugin_info_port_get_name(aap_plugin_info_port_t* port) { return ((aap::PortInformation*) port->context)->getName(); }
@@ -287,7 +330,7 @@ aap_plugin_info_t aap::PluginInstance::get_plugin_info(aap_host_plugin_info_exte
     return ret;
 }
 
-uint32_t aapxs_request_id_serial{0};
+std::atomic<uint32_t> aapxs_request_id_serial{0};
 uint32_t aap::PluginInstance::aapxsRequestIdSerial() {
     return aapxs_request_id_serial++;
 }
@@ -0,0 +1,1015 @@
+#include "aap/core/host/audio-kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// int24 conversions go through an int32 buffer of this size on the stack.
+#define AAP_KERNELS_INT24_CHUNK_SIZE 256
+
+namespace aap::kernels {
+
+    // Each implementation fills this table. Kernels take a `begin` index where it makes sense,
+    // so that vector loops can hand the remaining samples to the scalar ones.
+    struct KernelTable {
+        KernelImplementation implementation;
+        void (*interleave)(const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gain, bool accumulate);
+        void (*deinterleave)(const float* src, float* const* dst, int32_t numChannels, int32_t numFrames);
+        void (*apply_gain)(const float* src, float* dst, int32_t numSamples, float gain, bool accumulate);
+        // scales, dithers, rounds and saturates to [-scale, scale - 1].
+        void (*float_to_int32)(const float* src, int32_t* dst, int32_t numSamples, float scale, DitherState* dither);
+        void (*int32_to_float)(const int32_t* src, float* dst, int32_t numSamples, float scale);
+        void (*float_to_int16)(const float* src, int16_t* dst, int32_t numSamples, DitherState* dither);
+        void (*int16_to_float)(const int16_t* src, float* dst, int32_t numSamples);
+        // the gain is gainStart + step * i.
+        void (*apply_gain_ramp)(const float* src, float* dst, int32_t numSamples, float gainStart, float step, bool accumulate);
+        void (*measure)(const float* src, int32_t numSamples, float& peak, float& sumOfSquares);
+        float (*dot_product)(const float* x, const float* y, int32_t numSamples);
+    };
+
+    // Scalar kernels -------------------------------------------------------------------------------
+
+    static inline uint32_t xorshift(uint32_t& x) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    // triangular distribution in (-1, 1) LSB.
+    static inline float ditherScalar(DitherState* dither) {
+        auto r1 = (float) (xorshift(dither->lanes[0]) >> 8);
+        auto r2 = (float) (xorshift(dither->lanes[0]) >> 8);
+        return (r1 - r2) * (1.0f / 16777216.0f);
+    }
+
+    static inline int32_t toInt32Scalar(float v, float scale, DitherState* dither) {
+        float x = v * scale + (dither ? ditherScalar(dither) : 0.0f);
+        // written this way so that NaN ends up in the range too.
+        x = x > -scale ? x : -scale;
+        x = x < scale - 1.0f ? x : scale - 1.0f;
+        return (int32_t) lrintf(x);
+    }
+
+    template<int32_t N>
+    static void interleaveFixed(const float* const* src, float* dst, int32_t begin, int32_t numFrames, float gain, bool accumulate) {
+        for (int32_t i = begin; i < numFrames; i++) {
+            for (int32_t ch = 0; ch < N; ch++) {
+                float v = src[ch][i] * gain;
+                dst[i * N + ch] = accumulate ? dst[i * N + ch] + v : v;
+            }
+        }
+    }
+
+    static void interleaveFrom(const float* const* src, float* dst, int32_t numChannels, int32_t begin, int32_t numFrames, float gain, bool accumulate) {
+        switch (numChannels) {
+            case 1: interleaveFixed<1>(src, dst, begin, numFrames, gain, accumulate); return;
+            case 2: interleaveFixed<2>(src, dst, begin, numFrames, gain, accumulate); return;
+            case 3: interleaveFixed<3>(src, dst, begin, numFrames, gain, accumulate); return;
+            case 4: interleaveFixed<4>(src, dst, begin, numFrames, gain, accumulate); return;
+            case 5: interleaveFixed<5>(src, dst, begin, numFrames, gain, accumulate); return;
+            case 6: interleaveFixed<6>(src, dst, begin, numFrames, gain, accumulate); return;
+            case 7: interleaveFixed<7>(src, dst, begin, numFrames, gain, accumulate); return;
+            case 8: interleaveFixed<8>(src, dst, begin, numFrames, gain, accumulate); return;
+            default:
+                for (int32_t ch = 0; ch < numChannels; ch++) {
+                    for (int32_t i = begin; i < numFrames; i++) {
+                        float v = src[ch][i] * gain;
+                        dst[i * numChannels + ch] = accumulate ? dst[i * numChannels + ch] + v : v;
+                    }
+                }
+        }
+    }
+
+    template<int32_t N>
+    static void deinterleaveFixed(const float* src, float* const* dst, int32_t begin, int32_t numFrames) {
+        for (int32_t i = begin; i < numFrames; i++)
+            for (int32_t ch = 0; ch < N; ch++)
+                dst[ch][i] = src[i * N + ch];
+    }
+
+    static void deinterleaveFrom(const float* src, float* const* dst, int32_t numChannels, int32_t begin, int32_t numFrames) {
+        switch (numChannels) {
+            case 1: deinterleaveFixed<1>(src, dst, begin, numFrames); return;
+            case 2: deinterleaveFixed<2>(src, dst, begin, numFrames); return;
+            case 3: deinterleaveFixed<3>(src, dst, begin, numFrames); return;
+            case 4: deinterleaveFixed<4>(src, dst, begin, numFrames); return;
+            case 5: deinterleaveFixed<5>(src, dst, begin, numFrames); return;
+            case 6: deinterleaveFixed<6>(src, dst, begin, numFrames); return;
+            case 7: deinterleaveFixed<7>(src, dst, begin, numFrames); return;
+            case 8: deinterleaveFixed<8>(src, dst, begin, numFrames); return;
+            default:
+                for (int32_t ch = 0; ch < numChannels; ch++)
+                    for (int32_t i = begin; i < numFrames; i++)
+                        dst[ch][i] = src[i * numChannels + ch];
+        }
+    }
+
+    static inline void applyGainFrom(const float* src, float* dst, int32_t begin, int32_t numSamples, float gain, bool accumulate) {
+        for (int32_t i = begin; i < numSamples; i++) {
+            float v = src[i] * gain;
+            dst[i] = accumulate ? dst[i] + v : v;
+        }
+    }
+
+    static inline void floatToInt32From(const float* src, int32_t* dst, int32_t begin, int32_t numSamples, float scale, DitherState* dither) {
+        for (int32_t i = begin; i < numSamples; i++)
+            dst[i] = toInt32Scalar(src[i], scale, dither);
+    }
+
+    static inline void int32ToFloatFrom(const int32_t* src, float* dst, int32_t begin, int32_t numSamples, float scale) {
+        for (int32_t i = begin; i < numSamples; i++)
+            dst[i] = (float) src[i] * scale;
+    }
+
+    static inline void floatToInt16From(const float* src, int16_t* dst, int32_t begin, int32_t numSamples, DitherState* dither) {
+        for (int32_t i = begin; i < numSamples; i++)
+            dst[i] = (int16_t) toInt32Scalar(src[i], 32768.0f, dither);
+    }
+
+    static inline void int16ToFloatFrom(const int16_t* src, float* dst, int32_t begin, int32_t numSamples) {
+        for (int32_t i = begin; i < numSamples; i++)
+            dst[i] = src[i] * (1.0f / 32768.0f);
+    }
+
+    static inline void applyGainRampFrom(const float* src, float* dst, int32_t begin, int32_t numSamples, float gainStart, float step, bool accumulate) {
+        for (int32_t i = begin; i < numSamples; i++) {
+            float v = src[i] * (gainStart + step * i);
+            dst[i] = accumulate ? dst[i] + v : v;
+        }
+    }
+
+    static inline void measureFrom(const float* src, int32_t begin, int32_t numSamples, float& peak, float& sumOfSquares) {
+        for (int32_t i = begin; i < numSamples; i++) {
+            peak = std::max(peak, std::abs(src[i]));
+            sumOfSquares += src[i] * src[i];
+        }
+    }
+
+    static inline float dotProductFrom(const float* x, const float* y, int32_t begin, int32_t numSamples, float sum) {
+        for (int32_t i = begin; i < numSamples; i++)
+            sum += x[i] * y[i];
+        return sum;
+    }
+
+    static const KernelTable scalar_kernels {
+        AAP_KERNELS_SCALAR,
+        [](const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gain, bool accumulate) {
+            interleaveFrom(src, dst, numChannels, 0, numFrames, gain, accumulate);
+        },
+        [](const float* src, float* const* dst, int32_t numChannels, int32_t numFrames) {
+            deinterleaveFrom(src, dst, numChannels, 0, numFrames);
+        },
+        [](const float* src, float* dst, int32_t numSamples, float gain, bool accumulate) {
+            applyGainFrom(src, dst, 0, numSamples, gain, accumulate);
+        },
+        [](const float* src, int32_t* dst, int32_t numSamples, float scale, DitherState* dither) {
+            floatToInt32From(src, dst, 0, numSamples, scale, dither);
+        },
+        [](const int32_t* src, float* dst, int32_t numSamples, float scale) {
+            int32ToFloatFrom(src, dst, 0, numSamples, scale);
+        },
+        [](const float* src, int16_t* dst, int32_t numSamples, DitherState* dither) {
+            floatToInt16From(src, dst, 0, numSamples, dither);
+        },
+        [](const int16_t* src, float* dst, int32_t numSamples) {
+            int16ToFloatFrom(src, dst, 0, numSamples);
+        },
+        [](const float* src, float* dst, int32_t numSamples, float gainStart, float step, bool accumulate) {
+            applyGainRampFrom(src, dst, 0, numSamples, gainStart, step, accumulate);
+        },
+        [](const float* src, int32_t numSamples, float& peak, float& sumOfSquares) {
+            peak = 0;
+            sumOfSquares = 0;
+            measureFrom(src, 0, numSamples, peak, sumOfSquares);
+        },
+        [](const float* x, const float* y, int32_t numSamples) {
+            return dotProductFrom(x, y, 0, numSamples, 0);
+        }
+    };
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+    // NEON kernels ---------------------------------------------------------------------------------
+
+    static inline uint32x4_t xorshiftNEON(uint32x4_t x) {
+        x = veorq_u32(x, vshlq_n_u32(x, 13));
+        x = veorq_u32(x, vshrq_n_u32(x, 17));
+        return veorq_u32(x, vshlq_n_u32(x, 5));
+    }
+
+    static inline float32x4_t ditherNEON(uint32x4_t& state) {
+        state = xorshiftNEON(state);
+        float32x4_t r1 = vcvtq_f32_u32(vshrq_n_u32(state, 8));
+        state = xorshiftNEON(state);
+        float32x4_t r2 = vcvtq_f32_u32(vshrq_n_u32(state, 8));
+        return vmulq_n_f32(vsubq_f32(r1, r2), 1.0f / 16777216.0f);
+    }
+
+    static inline int32x4_t roundNEON(float32x4_t x) {
+#if defined(__aarch64__)
+        return vcvtnq_s32_f32(x);
+#else
+        // ARMv7 has only truncating conversion: add +/-0.5 (rounds half away from zero).
+        uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000u));
+        float32x4_t half = vreinterpretq_f32_u32(vorrq_u32(sign, vreinterpretq_u32_f32(vdupq_n_f32(0.5f))));
+        return vcvtq_s32_f32(vaddq_f32(x, half));
+#endif
+    }
+
+    static inline int32x4_t toInt32NEON(float32x4_t v, float scale, bool useDither, uint32x4_t& state) {
+        float32x4_t x = vmulq_n_f32(v, scale);
+        if (useDither)
+            x = vaddq_f32(x, ditherNEON(state));
+        x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-scale)), vdupq_n_f32(scale - 1.0f));
+        return roundNEON(x);
+    }
+
+    static inline float32x4_t gainNEON(float32x4_t v, float gain, const float* dst, bool accumulate) {
+        return accumulate ? vmlaq_n_f32(vld1q_f32(dst), v, gain) : vmulq_n_f32(v, gain);
+    }
+
+    static void interleaveNEON(const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gain, bool accumulate) {
+        int32_t i = 0;
+        switch (numChannels) {
+            case 2:
+                for (; i + 4 <= numFrames; i += 4) {
+                    float32x4x2_t v = accumulate ? vld2q_f32(dst + i * 2) : float32x4x2_t{};
+                    v.val[0] = accumulate ? vmlaq_n_f32(v.val[0], vld1q_f32(src[0] + i), gain) : vmulq_n_f32(vld1q_f32(src[0] + i), gain);
+                    v.val[1] = accumulate ? vmlaq_n_f32(v.val[1], vld1q_f32(src[1] + i), gain) : vmulq_n_f32(vld1q_f32(src[1] + i), gain);
+                    vst2q_f32(dst + i * 2, v);
+                }
+                break;
+            case 3:
+                for (; i + 4 <= numFrames; i += 4) {
+                    float32x4x3_t v = accumulate ? vld3q_f32(dst + i * 3) : float32x4x3_t{};
+                    for (int32_t ch = 0; ch < 3; ch++)
+                        v.val[ch] = accumulate ? vmlaq_n_f32(v.val[ch], vld1q_f32(src[ch] + i), gain) : vmulq_n_f32(vld1q_f32(src[ch] + i), gain);
+                    vst3q_f32(dst + i * 3, v);
+                }
+                break;
+            case 4:
+                for (; i + 4 <= numFrames; i += 4) {
+                    float32x4x4_t v = accumulate ? vld4q_f32(dst + i * 4) : float32x4x4_t{};
+                    for (int32_t ch = 0; ch < 4; ch++)
+                        v.val[ch] = accumulate ? vmlaq_n_f32(v.val[ch], vld1q_f32(src[ch] + i), gain) : vmulq_n_f32(vld1q_f32(src[ch] + i), gain);
+                    vst4q_f32(dst + i * 4, v);
+                }
+                break;
+            case 1:
+                for (; i + 4 <= numFrames; i += 4)
+                    vst1q_f32(dst + i, gainNEON(vld1q_f32(src[0] + i), gain, dst + i, accumulate));
+                break;
+        }
+        interleaveFrom(src, dst, numChannels, i, numFrames, gain, accumulate);
+    }
+
+    static void deinterleaveNEON(const float* src, float* const* dst, int32_t numChannels, int32_t numFrames) {
+        int32_t i = 0;
+        switch (numChannels) {
+            case 2:
+                for (; i + 4 <= numFrames; i += 4) {
+                    float32x4x2_t v = vld2q_f32(src + i * 2);
+                    vst1q_f32(dst[0] + i, v.val[0]);
+                    vst1q_f32(dst[1] + i, v.val[1]);
+                }
+                break;
+            case 3:
+                for (; i + 4 <= numFrames; i += 4) {
+                    float32x4x3_t v = vld3q_f32(src + i * 3);
+                    for (int32_t ch = 0; ch < 3; ch++)
+                        vst1q_f32(dst[ch] + i, v.val[ch]);
+                }
+                break;
+            case 4:
+                for (; i + 4 <= numFrames; i += 4) {
+                    float32x4x4_t v = vld4q_f32(src + i * 4);
+                    for (int32_t ch = 0; ch < 4; ch++)
+                        vst1q_f32(dst[ch] + i, v.val[ch]);
+                }
+                break;
+        }
+        deinterleaveFrom(src, dst, numChannels, i, numFrames);
+    }
+
+    static void applyGainNEON(const float* src, float* dst, int32_t numSamples, float gain, bool accumulate) {
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4)
+            vst1q_f32(dst + i, gainNEON(vld1q_f32(src + i), gain, dst + i, accumulate));
+        applyGainFrom(src, dst, i, numSamples, gain, accumulate);
+    }
+
+    static void floatToInt32NEON(const float* src, int32_t* dst, int32_t numSamples, float scale, DitherState* dither) {
+        uint32x4_t state = dither ? vld1q_u32(dither->lanes) : vdupq_n_u32(1);
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4)
+            vst1q_s32(dst + i, toInt32NEON(vld1q_f32(src + i), scale, dither != nullptr, state));
+        if (dither)
+            vst1q_u32(dither->lanes, state);
+        floatToInt32From(src, dst, i, numSamples, scale, dither);
+    }
+
+    static void int32ToFloatNEON(const int32_t* src, float* dst, int32_t numSamples, float scale) {
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4)
+            vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)), scale));
+        int32ToFloatFrom(src, dst, i, numSamples, scale);
+    }
+
+    static void floatToInt16NEON(const float* src, int16_t* dst, int32_t numSamples, DitherState* dither) {
+        uint32x4_t state = dither ? vld1q_u32(dither->lanes) : vdupq_n_u32(1);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            int32x4_t a = toInt32NEON(vld1q_f32(src + i), 32768.0f, dither != nullptr, state);
+            int32x4_t b = toInt32NEON(vld1q_f32(src + i + 4), 32768.0f, dither != nullptr, state);
+            vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+        }
+        if (dither)
+            vst1q_u32(dither->lanes, state);
+        floatToInt16From(src, dst, i, numSamples, dither);
+    }
+
+    static void int16ToFloatNEON(const int16_t* src, float* dst, int32_t numSamples) {
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            int16x8_t v = vld1q_s16(src + i);
+            vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / 32768.0f));
+            vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / 32768.0f));
+        }
+        int16ToFloatFrom(src, dst, i, numSamples);
+    }
+
+    static void applyGainRampNEON(const float* src, float* dst, int32_t numSamples, float gainStart, float step, bool accumulate) {
+        const float offsets[4] {0, 1, 2, 3};
+        float32x4_t gain = vmlaq_n_f32(vdupq_n_f32(gainStart), vld1q_f32(offsets), step);
+        float32x4_t gainStep = vdupq_n_f32(step * 4);
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4) {
+            float32x4_t v = vmulq_f32(vld1q_f32(src + i), gain);
+            vst1q_f32(dst + i, accumulate ? vaddq_f32(vld1q_f32(dst + i), v) : v);
+            gain = vaddq_f32(gain, gainStep);
+        }
+        applyGainRampFrom(src, dst, i, numSamples, gainStart, step, accumulate);
+    }
+
+    static void measureNEON(const float* src, int32_t numSamples, float& peak, float& sumOfSquares) {
+        float32x4_t maxAbs = vdupq_n_f32(0);
+        float32x4_t sum = vdupq_n_f32(0);
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4) {
+            float32x4_t v = vld1q_f32(src + i);
+            maxAbs = vmaxq_f32(maxAbs, vabsq_f32(v));
+            sum = vmlaq_f32(sum, v, v);
+        }
+        float lanes[4];
+        vst1q_f32(lanes, maxAbs);
+        peak = std::max({lanes[0], lanes[1], lanes[2], lanes[3]});
+        vst1q_f32(lanes, sum);
+        sumOfSquares = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        measureFrom(src, i, numSamples, peak, sumOfSquares);
+    }
+
+    static float dotProductNEON(const float* x, const float* y, int32_t numSamples) {
+        float32x4_t acc0 = vdupq_n_f32(0);
+        float32x4_t acc1 = vdupq_n_f32(0);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+#if defined(__aarch64__)
+            acc0 = vfmaq_f32(acc0, vld1q_f32(x + i), vld1q_f32(y + i));
+            acc1 = vfmaq_f32(acc1, vld1q_f32(x + i + 4), vld1q_f32(y + i + 4));
+#else
+            acc0 = vmlaq_f32(acc0, vld1q_f32(x + i), vld1q_f32(y + i));
+            acc1 = vmlaq_f32(acc1, vld1q_f32(x + i + 4), vld1q_f32(y + i + 4));
+#endif
+        }
+        float32x4_t acc = vaddq_f32(acc0, acc1);
+#if defined(__aarch64__)
+        float sum = vaddvq_f32(acc);
+#else
+        float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+        float sum = vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+        return dotProductFrom(x, y, i, numSamples, sum);
+    }
+
+    static const KernelTable neon_kernels {
+        AAP_KERNELS_NEON,
+        interleaveNEON,
+        deinterleaveNEON,
+        applyGainNEON,
+        floatToInt32NEON,
+        int32ToFloatNEON,
+        floatToInt16NEON,
+        int16ToFloatNEON,
+        applyGainRampNEON,
+        measureNEON,
+        dotProductNEON
+    };
+
+    static bool isSupported(KernelImplementation implementation) {
+        return implementation == AAP_KERNELS_SCALAR || implementation == AAP_KERNELS_NEON;
+    }
+
+    static const KernelTable* selectKernels() { return &neon_kernels; }
+
+#elif defined(__x86_64__) || defined(__i386__)
+
+    // SSE kernels ----------------------------------------------------------------------------------
+
+    __attribute__((target("sse2")))
+    static inline __m128i xorshiftSSE(__m128i x) {
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    }
+
+    __attribute__((target("sse2")))
+    static inline __m128 ditherSSE(__m128i& state) {
+        state = xorshiftSSE(state);
+        __m128 r1 = _mm_cvtepi32_ps(_mm_srli_epi32(state, 8));
+        state = xorshiftSSE(state);
+        __m128 r2 = _mm_cvtepi32_ps(_mm_srli_epi32(state, 8));
+        return _mm_mul_ps(_mm_sub_ps(r1, r2), _mm_set1_ps(1.0f / 16777216.0f));
+    }
+
+    // _mm_max_ps() returns the second operand for NaN, so NaN ends up at -scale.
+    __attribute__((target("sse2")))
+    static inline __m128i toInt32SSE(__m128 v, __m128 scale, __m128 lowest, __m128 highest, bool useDither, __m128i& state) {
+        __m128 x = _mm_mul_ps(v, scale);
+        if (useDither)
+            x = _mm_add_ps(x, ditherSSE(state));
+        return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x, lowest), highest));
+    }
+
+    __attribute__((target("sse2")))
+    static inline __m128 gainSSE(__m128 v, __m128 gain, const float* dst, bool accumulate) {
+        v = _mm_mul_ps(v, gain);
+        return accumulate ? _mm_add_ps(_mm_loadu_ps(dst), v) : v;
+    }
+
+    __attribute__((target("sse2")))
+    static void interleaveSSE(const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gainValue, bool accumulate) {
+        __m128 gain = _mm_set1_ps(gainValue);
+        int32_t i = 0;
+        switch (numChannels) {
+            case 1:
+                for (auto mono = src[0]; i + 4 <= numFrames; i += 4)
+                    _mm_storeu_ps(dst + i, gainSSE(_mm_loadu_ps(mono + i), gain, dst + i, accumulate));
+                break;
+            case 2:
+                for (auto left = src[0], right = src[1]; i + 4 <= numFrames; i += 4) {
+                    __m128 l = _mm_loadu_ps(left + i);
+                    __m128 r = _mm_loadu_ps(right + i);
+                    auto out = dst + i * 2;
+                    _mm_storeu_ps(out, gainSSE(_mm_unpacklo_ps(l, r), gain, out, accumulate));
+                    _mm_storeu_ps(out + 4, gainSSE(_mm_unpackhi_ps(l, r), gain, out + 4, accumulate));
+                }
+                break;
+            case 4:
+                for (; i + 4 <= numFrames; i += 4) {
+                    __m128 c0 = _mm_loadu_ps(src[0] + i);
+                    __m128 c1 = _mm_loadu_ps(src[1] + i);
+                    __m128 c2 = _mm_loadu_ps(src[2] + i);
+                    __m128 c3 = _mm_loadu_ps(src[3] + i);
+                    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+                    auto out = dst + i * 4;
+                    _mm_storeu_ps(out, gainSSE(c0, gain, out, accumulate));
+                    _mm_storeu_ps(out + 4, gainSSE(c1, gain, out + 4, accumulate));
+                    _mm_storeu_ps(out + 8, gainSSE(c2, gain, out + 8, accumulate));
+                    _mm_storeu_ps(out + 12, gainSSE(c3, gain, out + 12, accumulate));
+                }
+                break;
+        }
+        interleaveFrom(src, dst, numChannels, i, numFrames, gainValue, accumulate);
+    }
+
+    __attribute__((target("sse2")))
+    static void deinterleaveSSE(const float* src, float* const* dst, int32_t numChannels, int32_t numFrames) {
+        int32_t i = 0;
+        switch (numChannels) {
+            case 2:
+                for (; i + 4 <= numFrames; i += 4) {
+                    __m128 a = _mm_loadu_ps(src + i * 2);     // L0 R0 L1 R1
+                    __m128 b = _mm_loadu_ps(src + i * 2 + 4); // L2 R2 L3 R3
+                    _mm_storeu_ps(dst[0] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+                    _mm_storeu_ps(dst[1] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+                }
+                break;
+            case 4:
+                for (; i + 4 <= numFrames; i += 4) {
+                    __m128 f0 = _mm_loadu_ps(src + i * 4);
+                    __m128 f1 = _mm_loadu_ps(src + i * 4 + 4);
+                    __m128 f2 = _mm_loadu_ps(src + i * 4 + 8);
+                    __m128 f3 = _mm_loadu_ps(src + i * 4 + 12);
+                    _MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+                    _mm_storeu_ps(dst[0] + i, f0);
+                    _mm_storeu_ps(dst[1] + i, f1);
+                    _mm_storeu_ps(dst[2] + i, f2);
+                    _mm_storeu_ps(dst[3] + i, f3);
+                }
+                break;
+        }
+        deinterleaveFrom(src, dst, numChannels, i, numFrames);
+    }
+
+    __attribute__((target("sse2")))
+    static void applyGainSSE(const float* src, float* dst, int32_t numSamples, float gainValue, bool accumulate) {
+        __m128 gain = _mm_set1_ps(gainValue);
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4)
+            _mm_storeu_ps(dst + i, gainSSE(_mm_loadu_ps(src + i), gain, dst + i, accumulate));
+        applyGainFrom(src, dst, i, numSamples, gainValue, accumulate);
+    }
+
+    __attribute__((target("sse2")))
+    static void floatToInt32SSE(const float* src, int32_t* dst, int32_t numSamples, float scaleValue, DitherState* dither) {
+        __m128 scale = _mm_set1_ps(scaleValue);
+        __m128 lowest = _mm_set1_ps(-scaleValue);
+        __m128 highest = _mm_set1_ps(scaleValue - 1.0f);
+        __m128i state = dither ? _mm_loadu_si128((const __m128i*) dither->lanes) : _mm_set1_epi32(1);
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4)
+            _mm_storeu_si128((__m128i*) (dst + i), toInt32SSE(_mm_loadu_ps(src + i), scale, lowest, highest, dither != nullptr, state));
+        if (dither)
+            _mm_storeu_si128((__m128i*) dither->lanes, state);
+        floatToInt32From(src, dst, i, numSamples, scaleValue, dither);
+    }
+
+    __attribute__((target("sse2")))
+    static void int32ToFloatSSE(const int32_t* src, float* dst, int32_t numSamples, float scaleValue) {
+        __m128 scale = _mm_set1_ps(scaleValue);
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4)
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*) (src + i))), scale));
+        int32ToFloatFrom(src, dst, i, numSamples, scaleValue);
+    }
+
+    __attribute__((target("sse2")))
+    static void floatToInt16SSE(const float* src, int16_t* dst, int32_t numSamples, DitherState* dither) {
+        __m128 scale = _mm_set1_ps(32768.0f);
+        __m128 lowest = _mm_set1_ps(-32768.0f);
+        __m128 highest = _mm_set1_ps(32767.0f);
+        __m128i state = dither ? _mm_loadu_si128((const __m128i*) dither->lanes) : _mm_set1_epi32(1);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            __m128i a = toInt32SSE(_mm_loadu_ps(src + i), scale, lowest, highest, dither != nullptr, state);
+            __m128i b = toInt32SSE(_mm_loadu_ps(src + i + 4), scale, lowest, highest, dither != nullptr, state);
+            _mm_storeu_si128((__m128i*) (dst + i), _mm_packs_epi32(a, b));
+        }
+        if (dither)
+            _mm_storeu_si128((__m128i*) dither->lanes, state);
+        floatToInt16From(src, dst, i, numSamples, dither);
+    }
+
+    __attribute__((target("sse2")))
+    static void int16ToFloatSSE(const int16_t* src, float* dst, int32_t numSamples) {
+        __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+            // sign-extend by placing each int16 at the top of int32 and shifting back.
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+        int16ToFloatFrom(src, dst, i, numSamples);
+    }
+
+    __attribute__((target("sse2")))
+    static void applyGainRampSSE(const float* src, float* dst, int32_t numSamples, float gainStart, float step, bool accumulate) {
+        __m128 gain = _mm_add_ps(_mm_set1_ps(gainStart), _mm_mul_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps(step)));
+        __m128 gainStep = _mm_set1_ps(step * 4);
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4) {
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), gain);
+            _mm_storeu_ps(dst + i, accumulate ? _mm_add_ps(_mm_loadu_ps(dst + i), v) : v);
+            gain = _mm_add_ps(gain, gainStep);
+        }
+        applyGainRampFrom(src, dst, i, numSamples, gainStart, step, accumulate);
+    }
+
+    __attribute__((target("sse2")))
+    static void measureSSE(const float* src, int32_t numSamples, float& peak, float& sumOfSquares) {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 maxAbs = _mm_setzero_ps();
+        __m128 sum = _mm_setzero_ps();
+        int32_t i = 0;
+        for (; i + 4 <= numSamples; i += 4) {
+            __m128 v = _mm_loadu_ps(src + i);
+            maxAbs = _mm_max_ps(maxAbs, _mm_and_ps(v, absMask));
+            sum = _mm_add_ps(sum, _mm_mul_ps(v, v));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, maxAbs);
+        peak = std::max({lanes[0], lanes[1], lanes[2], lanes[3]});
+        _mm_storeu_ps(lanes, sum);
+        sumOfSquares = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        measureFrom(src, i, numSamples, peak, sumOfSquares);
+    }
+
+    __attribute__((target("sse2")))
+    static inline float horizontalSumSSE(__m128 s) {
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+
+    __attribute__((target("sse2")))
+    static float dotProductSSE(const float* x, const float* y, int32_t numSamples) {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+        }
+        return dotProductFrom(x, y, i, numSamples, horizontalSumSSE(_mm_add_ps(acc0, acc1)));
+    }
+
+    static const KernelTable sse_kernels {
+        AAP_KERNELS_SSE,
+        interleaveSSE,
+        deinterleaveSSE,
+        applyGainSSE,
+        floatToInt32SSE,
+        int32ToFloatSSE,
+        floatToInt16SSE,
+        int16ToFloatSSE,
+        applyGainRampSSE,
+        measureSSE,
+        dotProductSSE
+    };
+
+    // AVX2 kernels ---------------------------------------------------------------------------------
+
+    __attribute__((target("avx2")))
+    static inline __m256i xorshiftAVX2(__m256i x) {
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+        return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256 ditherAVX2(__m256i& state) {
+        state = xorshiftAVX2(state);
+        __m256 r1 = _mm256_cvtepi32_ps(_mm256_srli_epi32(state, 8));
+        state = xorshiftAVX2(state);
+        __m256 r2 = _mm256_cvtepi32_ps(_mm256_srli_epi32(state, 8));
+        return _mm256_mul_ps(_mm256_sub_ps(r1, r2), _mm256_set1_ps(1.0f / 16777216.0f));
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i toInt32AVX2(__m256 v, __m256 scale, __m256 lowest, __m256 highest, bool useDither, __m256i& state) {
+        __m256 x = _mm256_mul_ps(v, scale);
+        if (useDither)
+            x = _mm256_add_ps(x, ditherAVX2(state));
+        return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(x, lowest), highest));
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256 gainAVX2(__m256 v, __m256 gain, const float* dst, bool accumulate) {
+        v = _mm256_mul_ps(v, gain);
+        return accumulate ? _mm256_add_ps(_mm256_loadu_ps(dst), v) : v;
+    }
+
+    // The scalar and SSE code that the AVX2 kernels hand over to is not VEX-encoded, so the upper halves
+    // of the registers are cleared before that (GCC does not always emit vzeroupper before tail calls).
+
+    __attribute__((target("avx2")))
+    static void interleaveAVX2(const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gainValue, bool accumulate) {
+        __m256 gain = _mm256_set1_ps(gainValue);
+        int32_t i = 0;
+        switch (numChannels) {
+            case 1:
+                for (auto mono = src[0]; i + 8 <= numFrames; i += 8)
+                    _mm256_storeu_ps(dst + i, gainAVX2(_mm256_loadu_ps(mono + i), gain, dst + i, accumulate));
+                break;
+            case 2:
+                for (auto left = src[0], right = src[1]; i + 8 <= numFrames; i += 8) {
+                    __m256 l = _mm256_loadu_ps(left + i);
+                    __m256 r = _mm256_loadu_ps(right + i);
+                    __m256 lo = _mm256_unpacklo_ps(l, r); // L0 R0 L1 R1 | L4 R4 L5 R5
+                    __m256 hi = _mm256_unpackhi_ps(l, r); // L2 R2 L3 R3 | L6 R6 L7 R7
+                    auto out = dst + i * 2;
+                    _mm256_storeu_ps(out, gainAVX2(_mm256_permute2f128_ps(lo, hi, 0x20), gain, out, accumulate));
+                    _mm256_storeu_ps(out + 8, gainAVX2(_mm256_permute2f128_ps(lo, hi, 0x31), gain, out + 8, accumulate));
+                }
+                break;
+            default:
+                interleaveSSE(src, dst, numChannels, numFrames, gainValue, accumulate);
+                return;
+        }
+        _mm256_zeroupper();
+        interleaveFrom(src, dst, numChannels, i, numFrames, gainValue, accumulate);
+    }
+
+    __attribute__((target("avx2")))
+    static void deinterleaveAVX2(const float* src, float* const* dst, int32_t numChannels, int32_t numFrames) {
+        if (numChannels != 2) {
+            deinterleaveSSE(src, dst, numChannels, numFrames);
+            return;
+        }
+        int32_t i = 0;
+        for (; i + 8 <= numFrames; i += 8) {
+            __m256 a = _mm256_loadu_ps(src + i * 2);     // L0 R0 L1 R1 L2 R2 L3 R3
+            __m256 b = _mm256_loadu_ps(src + i * 2 + 8); // L4 R4 L5 R5 L6 R6 L7 R7
+            __m256 p0 = _mm256_permute2f128_ps(a, b, 0x20); // L0 R0 L1 R1 | L4 R4 L5 R5
+            __m256 p1 = _mm256_permute2f128_ps(a, b, 0x31); // L2 R2 L3 R3 | L6 R6 L7 R7
+            _mm256_storeu_ps(dst[0] + i, _mm256_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm256_storeu_ps(dst[1] + i, _mm256_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+        _mm256_zeroupper();
+        deinterleaveFrom(src, dst, numChannels, i, numFrames);
+    }
+
+    __attribute__((target("avx2")))
+    static void applyGainAVX2(const float* src, float* dst, int32_t numSamples, float gainValue, bool accumulate) {
+        __m256 gain = _mm256_set1_ps(gainValue);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8)
+            _mm256_storeu_ps(dst + i, gainAVX2(_mm256_loadu_ps(src + i), gain, dst + i, accumulate));
+        _mm256_zeroupper();
+        applyGainFrom(src, dst, i, numSamples, gainValue, accumulate);
+    }
+
+    __attribute__((target("avx2")))
+    static void floatToInt32AVX2(const float* src, int32_t* dst, int32_t numSamples, float scaleValue, DitherState* dither) {
+        __m256 scale = _mm256_set1_ps(scaleValue);
+        __m256 lowest = _mm256_set1_ps(-scaleValue);
+        __m256 highest = _mm256_set1_ps(scaleValue - 1.0f);
+        __m256i state = dither ? _mm256_loadu_si256((const __m256i*) dither->lanes) : _mm256_set1_epi32(1);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8)
+            _mm256_storeu_si256((__m256i*) (dst + i), toInt32AVX2(_mm256_loadu_ps(src + i), scale, lowest, highest, dither != nullptr, state));
+        if (dither)
+            _mm256_storeu_si256((__m256i*) dither->lanes, state);
+        _mm256_zeroupper();
+        floatToInt32From(src, dst, i, numSamples, scaleValue, dither);
+    }
+
+    __attribute__((target("avx2")))
+    static void int32ToFloatAVX2(const int32_t* src, float* dst, int32_t numSamples, float scaleValue) {
+        __m256 scale = _mm256_set1_ps(scaleValue);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*) (src + i))), scale));
+        _mm256_zeroupper();
+        int32ToFloatFrom(src, dst, i, numSamples, scaleValue);
+    }
+
+    __attribute__((target("avx2")))
+    static void floatToInt16AVX2(const float* src, int16_t* dst, int32_t numSamples, DitherState* dither) {
+        __m256 scale = _mm256_set1_ps(32768.0f);
+        __m256 lowest = _mm256_set1_ps(-32768.0f);
+        __m256 highest = _mm256_set1_ps(32767.0f);
+        __m256i state = dither ? _mm256_loadu_si256((const __m256i*) dither->lanes) : _mm256_set1_epi32(1);
+        int32_t i = 0;
+        for (; i + 16 <= numSamples; i += 16) {
+            __m256i a = toInt32AVX2(_mm256_loadu_ps(src + i), scale, lowest, highest, dither != nullptr, state);
+            __m256i b = toInt32AVX2(_mm256_loadu_ps(src + i + 8), scale, lowest, highest, dither != nullptr, state);
+            // packs works per 128-bit lane (a0-3 b0-3 a4-7 b4-7), so restore the order.
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i*) (dst + i), packed);
+        }
+        if (dither)
+            _mm256_storeu_si256((__m256i*) dither->lanes, state);
+        _mm256_zeroupper();
+        floatToInt16From(src, dst, i, numSamples, dither);
+    }
+
+    __attribute__((target("avx2")))
+    static void int16ToFloatAVX2(const int16_t* src, float* dst, int32_t numSamples) {
+        __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src + i)));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+        }
+        _mm256_zeroupper();
+        int16ToFloatFrom(src, dst, i, numSamples);
+    }
+
+    __attribute__((target("avx2")))
+    static void applyGainRampAVX2(const float* src, float* dst, int32_t numSamples, float gainStart, float step, bool accumulate) {
+        __m256 gain = _mm256_add_ps(_mm256_set1_ps(gainStart), _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(step)));
+        __m256 gainStep = _mm256_set1_ps(step * 8);
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), gain);
+            _mm256_storeu_ps(dst + i, accumulate ? _mm256_add_ps(_mm256_loadu_ps(dst + i), v) : v);
+            gain = _mm256_add_ps(gain, gainStep);
+        }
+        _mm256_zeroupper();
+        applyGainRampFrom(src, dst, i, numSamples, gainStart, step, accumulate);
+    }
+
+    __attribute__((target("avx2")))
+    static void measureAVX2(const float* src, int32_t numSamples, float& peak, float& sumOfSquares) {
+        const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+        __m256 maxAbs = _mm256_setzero_ps();
+        __m256 sum = _mm256_setzero_ps();
+        int32_t i = 0;
+        for (; i + 8 <= numSamples; i += 8) {
+            __m256 v = _mm256_loadu_ps(src + i);
+            maxAbs = _mm256_max_ps(maxAbs, _mm256_and_ps(v, absMask));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(v, v));
+        }
+        float lanes[8];
+        _mm256_storeu_ps(lanes, maxAbs);
+        peak = *std::max_element(lanes, lanes + 8);
+        _mm256_storeu_ps(lanes, sum);
+        _mm256_zeroupper();
+        sumOfSquares = 0;
+        for (float lane : lanes)
+            sumOfSquares += lane;
+        measureFrom(src, i, numSamples, peak, sumOfSquares);
+    }
+
+    __attribute__((target("avx2")))
+    static float dotProductAVX2(const float* x, const float* y, int32_t numSamples) {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        int32_t i = 0;
+        for (; i + 16 <= numSamples; i += 16) {
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+        }
+        __m256 acc = _mm256_add_ps(acc0, acc1);
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        _mm256_zeroupper();
+        return dotProductFrom(x, y, i, numSamples, horizontalSumSSE(s));
+    }
+
+    static const KernelTable avx2_kernels {
+        AAP_KERNELS_AVX2,
+        interleaveAVX2,
+        deinterleaveAVX2,
+        applyGainAVX2,
+        floatToInt32AVX2,
+        int32ToFloatAVX2,
+        floatToInt16AVX2,
+        int16ToFloatAVX2,
+        applyGainRampAVX2,
+        measureAVX2,
+        dotProductAVX2
+    };
+
+    static bool isSupported(KernelImplementation implementation) {
+        __builtin_cpu_init();
+        switch (implementation) {
+            case AAP_KERNELS_SCALAR:
+                return true;
+            case AAP_KERNELS_SSE:
+                return __builtin_cpu_supports("sse2");
+            case AAP_KERNELS_AVX2:
+                return __builtin_cpu_supports("avx2");
+            default:
+                return false;
+        }
+    }
+
+    static const KernelTable* selectKernels() {
+        return isSupported(AAP_KERNELS_AVX2) ? &avx2_kernels :
+               isSupported(AAP_KERNELS_SSE) ? &sse_kernels :
+               &scalar_kernels;
+    }
+
+#else
+
+    static bool isSupported(KernelImplementation implementation) {
+        return implementation == AAP_KERNELS_SCALAR;
+    }
+
+    static const KernelTable* selectKernels() { return &scalar_kernels; }
+
+#endif
+
+    // chosen at library load.
+    static const KernelTable* active_kernels = selectKernels();
+
+    KernelImplementation getImplementation() {
+        return active_kernels->implementation;
+    }
+
+    const char* getImplementationName(KernelImplementation implementation) {
+        switch (implementation) {
+            case AAP_KERNELS_SCALAR: return "scalar";
+            case AAP_KERNELS_SSE: return "SSE";
+            case AAP_KERNELS_AVX2: return "AVX2";
+            case AAP_KERNELS_NEON: return "NEON";
+        }
+        return "unknown";
+    }
+
+    bool setImplementation(KernelImplementation implementation) {
+        if (!isSupported(implementation))
+            return false;
+        switch (implementation) {
+            case AAP_KERNELS_SCALAR:
+                active_kernels = &scalar_kernels;
+                break;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+            case AAP_KERNELS_NEON:
+                active_kernels = &neon_kernels;
+                break;
+#elif defined(__x86_64__) || defined(__i386__)
+            case AAP_KERNELS_SSE:
+                active_kernels = &sse_kernels;
+                break;
+            case AAP_KERNELS_AVX2:
+                active_kernels = &avx2_kernels;
+                break;
+#endif
+            default:
+                return false;
+        }
+        return true;
+    }
+
+    void interleave(const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gain) {
+        active_kernels->interleave(src, dst, numChannels, numFrames, gain, false);
+    }
+
+    void interleaveAdd(const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gain) {
+        active_kernels->interleave(src, dst, numChannels, numFrames, gain, true);
+    }
+
+    void deinterleave(const float* src, float* const* dst, int32_t numChannels, int32_t numFrames) {
+        if (numChannels == 1) {
+            if (dst[0] != src)
+                memcpy(dst[0], src, numFrames * sizeof(float));
+            return;
+        }
+        active_kernels->deinterleave(src, dst, numChannels, numFrames);
+    }
+
+    void copyWithGain(const float* src, float* dst, int32_t numSamples, float gain) {
+        if (gain == 1.0f) {
+            if (dst != src)
+                memcpy(dst, src, numSamples * sizeof(float));
+            return;
+        }
+        active_kernels->apply_gain(src, dst, numSamples, gain, false);
+    }
+
+    void addWithGain(const float* src, float* dst, int32_t numSamples, float gain) {
+        active_kernels->apply_gain(src, dst, numSamples, gain, true);
+    }
+
+    void copyWithGainRamp(const float* src, float* dst, int32_t numSamples, float gainStart, float gainEnd) {
+        if (numSamples > 0)
+            active_kernels->apply_gain_ramp(src, dst, numSamples, gainStart, (gainEnd - gainStart) / numSamples, false);
+    }
+
+    void addWithGainRamp(const float* src, float* dst, int32_t numSamples, float gainStart, float gainEnd) {
+        if (numSamples > 0)
+            active_kernels->apply_gain_ramp(src, dst, numSamples, gainStart, (gainEnd - gainStart) / numSamples, true);
+    }
+
+    void measurePeakAndSumOfSquares(const float* src, int32_t numSamples, float& peak, float& sumOfSquares) {
+        active_kernels->measure(src, numSamples, peak, sumOfSquares);
+    }
+
+    float dotProduct(const float* x, const float* y, int32_t numSamples) {
+        return active_kernels->dot_product(x, y, numSamples);
+    }
+
+    void floatToInt16(const float* src, int16_t* dst, int32_t numSamples, DitherState* dither) {
+        active_kernels->float_to_int16(src, dst, numSamples, dither);
+    }
+
+    void int16ToFloat(const int16_t* src, float* dst, int32_t numSamples) {
+        active_kernels->int16_to_float(src, dst, numSamples);
+    }
+
+    // The scaling, dither and rounding are vectorized on int32; only the 3-byte (un)packing is scalar.
+    void floatToInt24(const float* src, uint8_t* dst, int32_t numSamples, DitherState* dither) {
+        int32_t chunk[AAP_KERNELS_INT24_CHUNK_SIZE];
+        for (int32_t offset = 0; offset < numSamples; offset += AAP_KERNELS_INT24_CHUNK_SIZE) {
+            int32_t size = std::min(numSamples - offset, AAP_KERNELS_INT24_CHUNK_SIZE);
+            active_kernels->float_to_int32(src + offset, chunk, size, 8388608.0f, dither);
+            for (int32_t i = 0; i < size; i++, dst += 3) {
+                auto v = (uint32_t) chunk[i];
+                dst[0] = (uint8_t) v;
+                dst[1] = (uint8_t) (v >> 8);
+                dst[2] = (uint8_t) (v >> 16);
+            }
+        }
+    }
+
+    void int24ToFloat(const uint8_t* src, float* dst, int32_t numSamples) {
+        int32_t chunk[AAP_KERNELS_INT24_CHUNK_SIZE];
+        for (int32_t offset = 0; offset < numSamples; offset += AAP_KERNELS_INT24_CHUNK_SIZE) {
+            int32_t size = std::min(numSamples - offset, AAP_KERNELS_INT24_CHUNK_SIZE);
+            // place the 24 bits at the top of int32 so that the sign is kept.
+            for (int32_t i = 0; i < size; i++, src += 3)
+                chunk[i] = (int32_t) (((uint32_t) src[0] << 8) | ((uint32_t) src[1] << 16) | ((uint32_t) src[2] << 24));
+            active_kernels->int32_to_float(chunk, dst + offset, size, 1.0f / 2147483648.0f);
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #ifndef AAP_CORE_AUDIO_PLUGIN_HOST_INTERNALS_H
 #define AAP_CORE_AUDIO_PLUGIN_HOST_INTERNALS_H
 
+#include "aap/core/host/plugin-host.h"
 #include "aap/unstable/logging.h"
 
 #if ANDROID
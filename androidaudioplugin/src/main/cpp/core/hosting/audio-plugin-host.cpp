@@ -49,6 +49,8 @@ bool AbstractPluginBuffer::initialize(int32_t numPorts, int32_t numFrames) {
 //-----------------------------------
 
 int32_t ClientPluginSharedMemoryStore::allocateClientBuffer(size_t numPorts, size_t numFrames, aap::PluginInstance& instance, size_t defaultControllBytesPerBlock) {
+	// re-preparation (for a larger frame count) replaces the existing buffers.
+	disposeAudioBufferFDs();
 	memory_origin = PLUGIN_BUFFER_ORIGIN_LOCAL;
 
 	size_t commonMemSize = numFrames * sizeof(float);
@@ -77,6 +79,7 @@ int32_t ClientPluginSharedMemoryStore::allocateClientBuffer(size_t numPorts, siz
 }
 
 int32_t ServicePluginSharedMemoryStore::allocateServiceBuffer(std::vector<int32_t>& clientFDs, size_t numFrames, aap::PluginInstance& instance, size_t defaultControllBytesPerBlock) {
+	disposeAudioBufferFDs();
 	memory_origin = PLUGIN_BUFFER_ORIGIN_REMOTE;
 
 	size_t numPorts = clientFDs.size();
@@ -1,14 +1,102 @@
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include "aap/core/host/plugin-client-system.h"
 
 namespace aap {
 
-std::vector<PluginInformation*> PluginClientSystem::getInstalledPlugins(bool returnCacheIfExists, std::vector<std::string>* searchPaths) {
-    std::vector<std::string> aapPaths{};
-    for (auto path : getPluginPaths())
-        getAAPMetadataPaths(path, aapPaths);
-    auto ret = getPluginsFromMetadataPaths(aapPaths);
+static int64_t getModificationTime(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return 0;
+#if __APPLE__
+    return (int64_t) st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+int64_t PluginClientSystem::getPluginPathTimestamp(const std::string& path, const std::vector<std::string>& aapMetadataPaths) {
+    // The directory mtime only reflects added or removed entries, so the metadata files are checked too.
+    int64_t ret = getModificationTime(path);
+    for (auto& metadataPath : aapMetadataPaths) {
+        auto t = getModificationTime(metadataPath);
+        if (t == 0)
+            return 0;
+        ret = std::max(ret, t);
+    }
     return ret;
 }
 
+int32_t PluginClientSystem::getMaxScanningThreads() {
+    return std::max(1, (int32_t) std::thread::hardware_concurrency());
+}
+
+PluginClientSystem::PluginPathCacheEntry PluginClientSystem::scanPluginPath(const std::string& path, const PluginPathCacheEntry* cached) {
+    std::vector<std::string> aapPaths{};
+    getAAPMetadataPaths(path, aapPaths);
+    PluginPathCacheEntry entry{};
+    entry.timestamp = getPluginPathTimestamp(path, aapPaths);
+    if (cached && entry.timestamp != 0 && cached->timestamp == entry.timestamp)
+        entry.plugins = cached->plugins;
+    else
+        entry.plugins = getPluginsFromMetadataPaths(aapPaths);
+    return entry;
+}
+
+std::vector<PluginInformation*> PluginClientSystem::getInstalledPlugins(bool returnCacheIfExists, std::vector<std::string>* searchPaths) {
+    const std::lock_guard<std::mutex> lock{installed_plugins_mutex};
+
+    if (returnCacheIfExists && installed_plugins_cached &&
+        (searchPaths ? *searchPaths == installed_plugins_search_paths : installed_plugins_from_plugin_paths))
+        return installed_plugins;
+
+    auto paths = searchPaths ? *searchPaths : getPluginPaths();
+
+    // Scan the paths on up to getMaxScanningThreads() threads (including this one).
+    std::vector<PluginPathCacheEntry> results(paths.size());
+    std::atomic<size_t> nextPath{0};
+    auto scan = [&] {
+        for (size_t i = nextPath++; i < paths.size(); i = nextPath++) {
+            auto cached = plugin_path_cache.find(paths[i]);
+            results[i] = scanPluginPath(paths[i], cached != plugin_path_cache.end() ? &cached->second : nullptr);
+        }
+    };
+    auto numThreads = std::min((size_t) getMaxScanningThreads(), paths.size());
+    std::vector<std::thread> workers{};
+    for (size_t t = 1; t < numThreads; t++)
+        workers.emplace_back(scan);
+    scan();
+    for (auto& w : workers)
+        w.join();
+
+    std::vector<PluginInformation*> plugins{};
+    for (size_t i = 0; i < paths.size(); i++) {
+        plugins.insert(plugins.end(), results[i].plugins.begin(), results[i].plugins.end());
+        auto old = plugin_path_cache.find(paths[i]);
+        if (old != plugin_path_cache.end() && old->second.plugins != results[i].plugins)
+            retired_plugins.insert(retired_plugins.end(), old->second.plugins.begin(), old->second.plugins.end());
+        plugin_path_cache[paths[i]] = std::move(results[i]);
+    }
+    // The paths that are gone from the plugin paths (e.g. uninstalled) are dropped.
+    // Scanning explicit search paths keeps the cache for the other paths.
+    if (!searchPaths) {
+        for (auto it = plugin_path_cache.begin(); it != plugin_path_cache.end();) {
+            if (std::find(paths.begin(), paths.end(), it->first) == paths.end()) {
+                retired_plugins.insert(retired_plugins.end(), it->second.plugins.begin(), it->second.plugins.end());
+                it = plugin_path_cache.erase(it);
+            }
+            else
+                it++;
+        }
+    }
+
+    installed_plugins = plugins;
+    installed_plugins_search_paths = paths;
+    installed_plugins_from_plugin_paths = searchPaths == nullptr;
+    installed_plugins_cached = true;
+    return plugins;
+}
+
 } // namespace aap
@@ -6,28 +6,32 @@ namespace aap {
 
 PluginListSnapshot PluginListSnapshot::queryServices() {
     PluginListSnapshot ret{};
-    for (auto p : PluginClientSystem::getInstance()->getInstalledPlugins())
+    // Rescan, so that installed, updated and removed plugins show up. Only the changed paths are reparsed.
+    for (auto p : PluginClientSystem::getInstance()->getInstalledPlugins(false)) {
         ret.plugins.emplace_back(p);
+        // keep the first one for duplicate IDs, as the lookup did before the index was introduced.
+        ret.plugins_by_id.emplace(p->getPluginID(), p);
+    }
     return ret;
 }
 
-void* PluginClientConnectionList::getServiceHandleForConnectedPlugin(std::string packageName, std::string className)
+void* PluginClientConnectionList::getServiceHandleForConnectedPlugin(const std::string& packageName, const std::string& className)
 {
-    for (int i = 0; i < serviceConnections.size(); i++) {
-        auto s = serviceConnections[i];
-        if (s->getPackageName() == packageName && s->getClassName() == className)
-            return serviceConnections[i]->getConnectionData();
-    }
-    return nullptr;
+    std::lock_guard<std::mutex> lock{connections_mutex};
+    auto entry = connections_by_name.find(getConnectionKey(packageName, className));
+    return entry != connections_by_name.end() ? entry->second->getConnectionData() : nullptr;
 }
 
 void* PluginClientConnectionList::getServiceHandleForConnectedPlugin(std::string pluginId)
 {
-    auto pl = PluginClientSystem::getInstance()->getInstalledPlugins();
-    for (auto &plugin : pl)
-        if (plugin->getPluginID() == pluginId)
-            return getServiceHandleForConnectedPlugin(plugin->getPluginPackageName(),
-                                                      plugin->getPluginLocalName());
+    // A connected plugin is usually in the cached list already; rescan only if it is not (e.g. just installed).
+    for (bool returnCache : {true, false}) {
+        auto pl = PluginClientSystem::getInstance()->getInstalledPlugins(returnCache);
+        for (auto &plugin : pl)
+            if (plugin->getPluginID() == pluginId)
+                return getServiceHandleForConnectedPlugin(plugin->getPluginPackageName(),
+                                                          plugin->getPluginLocalName());
+    }
     return nullptr;
 }
 
@@ -0,0 +1,135 @@
+
+#include <dlfcn.h>
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <aap/core/host/plugin-library-cache.h>
+#include <aap/core/plugin-information.h>
+#include <aap/unstable/logging.h>
+#include <aap/unstable/utility.h>
+
+#define LOG_TAG "AAP.PluginLibraryCache"
+#define AAP_DEFAULT_PLUGIN_LIBRARY "libandroidaudioplugin.so"
+#define AAP_DEFAULT_PLUGIN_ENTRYPOINT "GetAndroidAudioPluginFactory"
+
+aap::PluginLibraryCache* aap::PluginLibraryCache::getInstance() {
+    static PluginLibraryCache instance{};
+    return &instance;
+}
+
+std::string aap::PluginLibraryCache::resolveLibraryPath(const PluginInformation* pluginInfo) {
+    auto file = pluginInfo->getLocalPluginSharedLibrary();
+    auto metadataFullPath = pluginInfo->getMetadataFullPath();
+    if (!metadataFullPath.empty()) {
+        size_t idx = metadataFullPath.find_last_of('/');
+        if (idx != std::string::npos) {
+            auto soFullPath = metadataFullPath.substr(0, idx + 1) + file;
+            struct stat st;
+            if (stat(soFullPath.c_str(), &st) == 0)
+                file = soFullPath;
+        }
+    }
+    if (file.empty())
+        return AAP_DEFAULT_PLUGIN_LIBRARY;
+    // The same library can be reached through different paths (symlinks, "..", relative paths), and the
+    // cache must not load it twice. A bare library name is looked up by the dynamic linker, so keep it.
+    if (file.find('/') != std::string::npos) {
+        char canonical[PATH_MAX];
+        if (realpath(file.c_str(), canonical))
+            file = canonical;
+    }
+    return file;
+}
+
+aap::PluginLibrary* aap::PluginLibraryCache::acquire(const PluginInformation* pluginInfo, bool resolveNow) {
+    auto file = resolveLibraryPath(pluginInfo);
+    auto entrypoint = pluginInfo->getLocalPluginLibraryEntryPoint();
+    if (entrypoint.empty())
+        entrypoint = AAP_DEFAULT_PLUGIN_ENTRYPOINT;
+    auto key = file + '\n' + entrypoint;
+
+    const std::lock_guard<std::mutex> lock{mutex};
+
+    auto existing = libraries.find(key);
+    if (existing != libraries.end()) {
+        auto library = existing->second.get();
+        // dlopen() again with RTLD_NOW to resolve the remaining lazy bindings. It only bumps the refcount
+        // of the already-loaded library, and we dlclose() it immediately to keep one handle per library.
+        if (resolveNow) {
+            auto dl = dlopen(file.c_str(), RTLD_NOW);
+            if (dl)
+                dlclose(dl);
+        }
+        library->ref_count++;
+        return library;
+    }
+
+    dlerror(); // clean up any previous error state
+    auto dl = dlopen(file.c_str(), resolveNow ? RTLD_NOW : RTLD_LAZY);
+    if (dl == nullptr) {
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "AAP library %s could not be loaded: %s", file.c_str(), dlerror());
+        return nullptr;
+    }
+    auto factoryGetter = (aap_factory_t) dlsym(dl, entrypoint.c_str());
+    if (factoryGetter == nullptr) {
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "AAP factory entrypoint function %s was not found in %s.", entrypoint.c_str(), file.c_str());
+        dlclose(dl);
+        return nullptr;
+    }
+    auto factory = factoryGetter();
+    if (factory == nullptr) {
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "AAP factory entrypoint function %s could not instantiate a plugin.", entrypoint.c_str());
+        dlclose(dl);
+        return nullptr;
+    }
+
+    auto library = std::make_unique<PluginLibrary>();
+    library->file = file;
+    library->entrypoint = entrypoint;
+    library->handle = dl;
+    library->factory = factory;
+    library->ref_count = 1;
+    auto ret = library.get();
+    libraries[key] = std::move(library);
+    return ret;
+}
+
+void aap::PluginLibraryCache::release(PluginLibrary* library) {
+    const std::lock_guard<std::mutex> lock{mutex};
+
+    if (library->ref_count <= 0) {
+        AAP_ASSERT_FALSE;
+        return;
+    }
+    if (--library->ref_count > 0)
+        return;
+
+    auto handle = library->handle;
+    libraries.erase(library->file + '\n' + library->entrypoint);
+    if (dlclose(handle) != 0)
+        aap::a_log_f(AAP_LOG_LEVEL_WARN, LOG_TAG, "AAP library could not be unloaded: %s", dlerror());
+}
+
+bool aap::PluginLibraryCache::preload(const PluginInformation* pluginInfo) {
+    auto library = acquire(pluginInfo, true);
+    if (!library)
+        return false;
+    const std::lock_guard<std::mutex> lock{mutex};
+    preloaded.emplace_back(library);
+    return true;
+}
+
+void aap::PluginLibraryCache::releasePreloadedLibraries() {
+    std::vector<PluginLibrary*> libs{};
+    {
+        const std::lock_guard<std::mutex> lock{mutex};
+        libs.swap(preloaded);
+    }
+    for (auto library : libs)
+        release(library);
+}
+
+size_t aap::PluginLibraryCache::getLoadedLibraryCount() {
+    const std::lock_guard<std::mutex> lock{mutex};
+    return libraries.size();
+}
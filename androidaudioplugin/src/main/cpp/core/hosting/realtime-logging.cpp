@@ -0,0 +1,522 @@
+
+#include "aap/unstable/logging.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define LOG_TAG "AAP.RealtimeLogging"
+// per thread. It must be a power of two.
+#define AAP_RT_LOG_RING_SIZE 128
+#define AAP_RT_LOG_MAX_ARGS 16
+// The `%s` strings of a log are copied into this space, and truncated if they do not fit.
+#define AAP_RT_LOG_MAX_STRING_BYTES 192
+// The format string is copied too (it may be a temporary), and truncated if it does not fit.
+#define AAP_RT_LOG_MAX_FORMAT_LENGTH 256
+// The number of thread rings that can exist at a time. The rings of exited threads are reused.
+#define AAP_RT_LOG_MAX_THREADS 64
+#define AAP_RT_LOG_MAX_MESSAGE_LENGTH 1024
+#define AAP_RT_LOG_FLUSH_INTERVAL_MILLISECONDS 50
+// Each format string is logged at most AAP_RT_LOG_RATE_LIMIT_COUNT times per window (per thread).
+#define AAP_RT_LOG_RATE_LIMIT_COUNT 10
+#define AAP_RT_LOG_RATE_LIMIT_WINDOW_NANOSECONDS 1000000000LL
+// The number of format strings whose rates are tracked at a time. It must be a power of two.
+#define AAP_RT_LOG_RATE_LIMIT_SLOTS 32
+// for the messages of its own. a_log_f() does not add newlines on desktop.
+#if ANDROID
+#define AAP_RT_LOG_LINE_END ""
+#else
+#define AAP_RT_LOG_LINE_END "\n"
+#endif
+
+namespace aap::logging {
+
+    enum LogArgType : uint8_t {
+        AAP_RT_LOG_ARG_NONE, // `%%`
+        AAP_RT_LOG_ARG_INT,
+        AAP_RT_LOG_ARG_LONG,
+        AAP_RT_LOG_ARG_LONG_LONG,
+        AAP_RT_LOG_ARG_INTMAX,
+        AAP_RT_LOG_ARG_SIZE,
+        AAP_RT_LOG_ARG_PTRDIFF,
+        AAP_RT_LOG_ARG_DOUBLE,
+        AAP_RT_LOG_ARG_LONG_DOUBLE,
+        AAP_RT_LOG_ARG_STRING,
+        AAP_RT_LOG_ARG_POINTER,
+        // positional arguments, `%n`, `%m`, wide strings: the format is emitted as is.
+        AAP_RT_LOG_ARG_UNSUPPORTED
+    };
+
+    struct Conversion {
+        const char* begin; // '%'
+        const char* end; // next to the conversion specifier
+        int32_t num_stars; // `*` width and precision, which take int arguments before the value
+        LogArgType type;
+    };
+
+    // Parses the conversion specification at `p` (which points to '%').
+    static Conversion parseConversion(const char* p) {
+        Conversion c{p, p + 1, 0, AAP_RT_LOG_ARG_UNSUPPORTED};
+        auto q = p + 1;
+        if (*q == '%') {
+            c.end = q + 1;
+            c.type = AAP_RT_LOG_ARG_NONE;
+            return c;
+        }
+        while (*q && strchr("-+ #0'", *q))
+            q++;
+        auto digits = q;
+        while (*q >= '0' && *q <= '9')
+            q++;
+        if (*q == '$' && q != digits)
+            return c; // positional
+        if (*q == '*') {
+            c.num_stars++;
+            q++;
+        }
+        if (*q == '.') {
+            q++;
+            if (*q == '*') {
+                c.num_stars++;
+                q++;
+            }
+            while (*q >= '0' && *q <= '9')
+                q++;
+        }
+        char length = 0;
+        bool doubled = false;
+        if (*q && strchr("hljztLq", *q)) {
+            length = *q++;
+            if ((length == 'h' || length == 'l') && *q == length) {
+                doubled = true;
+                q++;
+            }
+        }
+        auto specifier = *q;
+        if (!specifier)
+            return c;
+        c.end = q + 1;
+        switch (specifier) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+                c.type = length == 'l' ? (doubled ? AAP_RT_LOG_ARG_LONG_LONG : AAP_RT_LOG_ARG_LONG) :
+                         length == 'q' ? AAP_RT_LOG_ARG_LONG_LONG :
+                         length == 'j' ? AAP_RT_LOG_ARG_INTMAX :
+                         length == 'z' ? AAP_RT_LOG_ARG_SIZE :
+                         length == 't' ? AAP_RT_LOG_ARG_PTRDIFF : AAP_RT_LOG_ARG_INT;
+                break;
+            case 'c':
+                c.type = AAP_RT_LOG_ARG_INT; // wint_t for `%lc`, which is promoted to int too
+                break;
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                c.type = length == 'L' ? AAP_RT_LOG_ARG_LONG_DOUBLE : AAP_RT_LOG_ARG_DOUBLE;
+                break;
+            case 's':
+                c.type = length == 'l' ? AAP_RT_LOG_ARG_UNSUPPORTED : AAP_RT_LOG_ARG_STRING;
+                break;
+            case 'p':
+                c.type = AAP_RT_LOG_ARG_POINTER;
+                break;
+            default:
+                break;
+        }
+        return c;
+    }
+
+    union LogArg {
+        int64_t i;
+        double d;
+        const void* p;
+        int32_t string_offset; // -1 for null
+    };
+
+    struct LogRecord {
+        const char* tag;
+        char fmt[AAP_RT_LOG_MAX_FORMAT_LENGTH];
+        int32_t level;
+        // the number of logs of the same format that were suppressed by the rate limit before this one.
+        uint32_t num_suppressed;
+        bool unsupported;
+        int32_t num_args;
+        LogArg args[AAP_RT_LOG_MAX_ARGS];
+        char strings[AAP_RT_LOG_MAX_STRING_BYTES];
+    };
+
+    struct RateLimitEntry {
+        const char* fmt{nullptr};
+        int64_t window_start{0};
+        uint32_t count{0};
+        uint32_t num_suppressed{0};
+    };
+
+    enum ThreadRingState : int32_t {
+        AAP_RT_LOG_RING_FREE,
+        AAP_RT_LOG_RING_IN_USE,
+        // the owner thread has gone; the flusher drains it and makes it FREE again.
+        AAP_RT_LOG_RING_RETIRED
+    };
+
+    // single producer (the owner thread), single consumer (the flusher).
+    struct ThreadRing {
+        LogRecord records[AAP_RT_LOG_RING_SIZE];
+        std::atomic<uint32_t> write_position{0};
+        std::atomic<uint32_t> read_position{0};
+        std::atomic<int32_t> state{AAP_RT_LOG_RING_FREE};
+        // owned by the producer.
+        RateLimitEntry rate_limits[AAP_RT_LOG_RATE_LIMIT_SLOTS]{};
+        // owned by the consumer, for folding the identical consecutive messages.
+        const char* last_tag{nullptr};
+        int32_t last_level{0};
+        std::string last_message{};
+        int32_t num_repeats{0};
+    };
+
+    struct ThreadRingHolder {
+        ThreadRing* ring{nullptr};
+        ~ThreadRingHolder() {
+            if (ring)
+                ring->state = AAP_RT_LOG_RING_RETIRED;
+        }
+    };
+
+    static thread_local ThreadRingHolder current_thread_ring{};
+    // guards adding rings. The slots are filled once and never cleared, so they can be read without it.
+    static std::mutex registry_mutex{};
+    static std::atomic<ThreadRing*> thread_rings[AAP_RT_LOG_MAX_THREADS]{};
+    static std::atomic<int64_t> num_dropped_logs{0};
+    static int64_t num_reported_dropped_logs{0};
+    // guards draining, which the flusher and flushRealtimeLogs() do.
+    static std::mutex flush_mutex{};
+
+    static inline int64_t monotonicNanoseconds() {
+        struct timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    // ---- producer side
+
+    // Returns the number of the suppressed logs to report with this one, or -1 if this one should be suppressed too.
+    static int64_t checkRateLimit(ThreadRing* ring, const char* fmt) {
+        auto& entry = ring->rate_limits[((uintptr_t) fmt >> 3) & (AAP_RT_LOG_RATE_LIMIT_SLOTS - 1)];
+        auto now = monotonicNanoseconds();
+        if (entry.fmt != fmt || now - entry.window_start >= AAP_RT_LOG_RATE_LIMIT_WINDOW_NANOSECONDS) {
+            uint32_t suppressed = entry.fmt == fmt ? entry.num_suppressed : 0;
+            entry = {fmt, now, 1, 0};
+            return suppressed;
+        }
+        if (entry.count >= AAP_RT_LOG_RATE_LIMIT_COUNT) {
+            entry.num_suppressed++;
+            return -1;
+        }
+        entry.count++;
+        return 0;
+    }
+
+    static void captureArgs(LogRecord& rec, const char* fmt, va_list ap) {
+        rec.num_args = 0;
+        rec.unsupported = false;
+        int32_t stringOffset = 0;
+        for (auto p = strchr(fmt, '%'); p; p = strchr(p, '%')) {
+            auto c = parseConversion(p);
+            p = c.end;
+            if (c.type == AAP_RT_LOG_ARG_NONE)
+                continue;
+            if (c.type == AAP_RT_LOG_ARG_UNSUPPORTED || rec.num_args + c.num_stars + 1 > AAP_RT_LOG_MAX_ARGS) {
+                rec.unsupported = true;
+                return;
+            }
+            for (int32_t i = 0; i < c.num_stars; i++)
+                rec.args[rec.num_args++].i = va_arg(ap, int);
+            auto& arg = rec.args[rec.num_args++];
+            switch (c.type) {
+                case AAP_RT_LOG_ARG_INT: arg.i = va_arg(ap, int); break;
+                case AAP_RT_LOG_ARG_LONG: arg.i = va_arg(ap, long); break;
+                case AAP_RT_LOG_ARG_LONG_LONG: arg.i = va_arg(ap, long long); break;
+                case AAP_RT_LOG_ARG_INTMAX: arg.i = (int64_t) va_arg(ap, intmax_t); break;
+                case AAP_RT_LOG_ARG_SIZE: arg.i = (int64_t) va_arg(ap, size_t); break;
+                case AAP_RT_LOG_ARG_PTRDIFF: arg.i = va_arg(ap, ptrdiff_t); break;
+                case AAP_RT_LOG_ARG_DOUBLE: arg.d = va_arg(ap, double); break;
+                case AAP_RT_LOG_ARG_LONG_DOUBLE: arg.d = (double) va_arg(ap, long double); break;
+                case AAP_RT_LOG_ARG_POINTER: arg.p = va_arg(ap, void*); break;
+                case AAP_RT_LOG_ARG_STRING: {
+                    auto s = va_arg(ap, const char*);
+                    if (!s) {
+                        arg.string_offset = -1;
+                        break;
+                    }
+                    // an empty string if there is no more space.
+                    stringOffset = std::min(stringOffset, AAP_RT_LOG_MAX_STRING_BYTES - 1);
+                    arg.string_offset = stringOffset;
+                    auto available = AAP_RT_LOG_MAX_STRING_BYTES - 1 - stringOffset;
+                    auto length = (int32_t) strnlen(s, available);
+                    memcpy(rec.strings + stringOffset, s, length);
+                    rec.strings[stringOffset + length] = '\0';
+                    stringOffset += length + 1;
+                    break;
+                }
+                default: break;
+            }
+        }
+    }
+
+    static bool enqueue(int logLevel, const char* tag, const char* fmt, va_list ap) {
+        auto ring = current_thread_ring.ring;
+        if (!ring)
+            return false;
+        auto suppressed = checkRateLimit(ring, fmt);
+        if (suppressed < 0)
+            return true;
+        auto w = ring->write_position.load(std::memory_order_relaxed);
+        auto r = ring->read_position.load(std::memory_order_acquire);
+        if (w - r >= AAP_RT_LOG_RING_SIZE) {
+            num_dropped_logs.fetch_add(1 + suppressed, std::memory_order_relaxed);
+            return true;
+        }
+        auto& rec = ring->records[w & (AAP_RT_LOG_RING_SIZE - 1)];
+        rec.tag = tag;
+        auto fmtLength = strnlen(fmt, sizeof(rec.fmt) - 1);
+        memcpy(rec.fmt, fmt, fmtLength);
+        rec.fmt[fmtLength] = '\0';
+        rec.level = logLevel;
+        rec.num_suppressed = (uint32_t) suppressed;
+        // parse the copy, so that the flusher sees the same conversions even if it was truncated.
+        captureArgs(rec, rec.fmt, ap);
+        ring->write_position.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    // ---- consumer side
+
+    template <typename T>
+    static int formatOne(char* buffer, size_t size, const char* spec, const LogArg* stars, int32_t numStars, T value) {
+        switch (numStars) {
+            case 0: return snprintf(buffer, size, spec, value);
+            case 1: return snprintf(buffer, size, spec, (int) stars[0].i, value);
+            default: return snprintf(buffer, size, spec, (int) stars[0].i, (int) stars[1].i, value);
+        }
+    }
+
+    static void formatRecord(const LogRecord& rec, std::string& message) {
+        message.clear();
+        if (rec.unsupported) {
+            message = rec.fmt;
+            return;
+        }
+        char buffer[AAP_RT_LOG_MAX_MESSAGE_LENGTH];
+        char spec[32];
+        int32_t argIndex = 0;
+        const char* literal = rec.fmt;
+        for (auto p = strchr(rec.fmt, '%'); p; p = strchr(p, '%')) {
+            auto c = parseConversion(p);
+            message.append(literal, c.type == AAP_RT_LOG_ARG_NONE ? p + 1 : p);
+            literal = p = c.end;
+            if (c.type == AAP_RT_LOG_ARG_NONE)
+                continue;
+            auto specLength = std::min((size_t) (c.end - c.begin), sizeof(spec) - 1);
+            memcpy(spec, c.begin, specLength);
+            spec[specLength] = '\0';
+            auto stars = rec.args + argIndex;
+            auto& arg = rec.args[argIndex + c.num_stars];
+            argIndex += c.num_stars + 1;
+            int n = 0;
+            switch (c.type) {
+                case AAP_RT_LOG_ARG_INT: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, (int) arg.i); break;
+                case AAP_RT_LOG_ARG_LONG: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, (long) arg.i); break;
+                case AAP_RT_LOG_ARG_LONG_LONG: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, (long long) arg.i); break;
+                case AAP_RT_LOG_ARG_INTMAX: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, (intmax_t) arg.i); break;
+                case AAP_RT_LOG_ARG_SIZE: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, (size_t) arg.i); break;
+                case AAP_RT_LOG_ARG_PTRDIFF: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, (ptrdiff_t) arg.i); break;
+                case AAP_RT_LOG_ARG_DOUBLE: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, arg.d); break;
+                case AAP_RT_LOG_ARG_LONG_DOUBLE: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, (long double) arg.d); break;
+                case AAP_RT_LOG_ARG_POINTER: n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars, arg.p); break;
+                case AAP_RT_LOG_ARG_STRING:
+                    n = formatOne(buffer, sizeof(buffer), spec, stars, c.num_stars,
+                                  arg.string_offset < 0 ? "(null)" : rec.strings + arg.string_offset);
+                    break;
+                default: break;
+            }
+            if (n > 0)
+                message.append(buffer, std::min((size_t) n, sizeof(buffer) - 1));
+        }
+        message.append(literal);
+    }
+
+    static void emit(int32_t level, const char* tag, const char* message) {
+#if ANDROID
+        __android_log_write(level, tag, message);
+#else
+        (void) level;
+        (void) tag;
+        fputs(message, stdout);
+#endif
+    }
+
+    static void emitRepeats(ThreadRing* ring) {
+        if (ring->num_repeats == 0)
+            return;
+        char buffer[64];
+        // follow the newline convention of the message (desktop logs do not add newlines).
+        bool newline = !ring->last_message.empty() && ring->last_message.back() == '\n';
+        snprintf(buffer, sizeof(buffer), "(last message repeated %d times)%s", (int) ring->num_repeats, newline ? "\n" : "");
+        emit(ring->last_level, ring->last_tag, buffer);
+        ring->num_repeats = 0;
+    }
+
+    // Makes the ring of an exited thread available to another thread.
+    static void recycle(ThreadRing* ring) {
+        ring->write_position.store(0, std::memory_order_relaxed);
+        ring->read_position.store(0, std::memory_order_relaxed);
+        for (auto& entry : ring->rate_limits)
+            entry = {};
+        ring->last_tag = nullptr;
+        ring->last_level = 0;
+        ring->last_message.clear();
+        ring->num_repeats = 0;
+        ring->state.store(AAP_RT_LOG_RING_FREE, std::memory_order_release);
+    }
+
+    // Drains all the thread rings. It runs on the flusher thread (or in flushRealtimeLogs()).
+    static void drain() {
+        const std::lock_guard<std::mutex> flushLock{flush_mutex};
+        std::string message{};
+        for (auto& slot : thread_rings) {
+            auto ring = slot.load(std::memory_order_acquire);
+            if (!ring)
+                break;
+            // check it before draining, so that nothing is written after the last drain.
+            auto state = ring->state.load(std::memory_order_acquire);
+            if (state == AAP_RT_LOG_RING_FREE)
+                continue;
+            bool alive = state == AAP_RT_LOG_RING_IN_USE;
+            auto r = ring->read_position.load(std::memory_order_relaxed);
+            auto w = ring->write_position.load(std::memory_order_acquire);
+            bool idle = r == w;
+            for (; r != w; r++) {
+                auto& rec = ring->records[r & (AAP_RT_LOG_RING_SIZE - 1)];
+                formatRecord(rec, message);
+                if (rec.num_suppressed > 0) {
+                    // before the trailing newline, if any.
+                    auto position = !message.empty() && message.back() == '\n' ? message.size() - 1 : message.size();
+                    message.insert(position, " (" + std::to_string(rec.num_suppressed) + " similar messages suppressed)");
+                }
+                if (rec.tag == ring->last_tag && rec.level == ring->last_level && message == ring->last_message) {
+                    ring->num_repeats++;
+                    continue;
+                }
+                emitRepeats(ring);
+                emit(rec.level, rec.tag, message.c_str());
+                ring->last_tag = rec.tag;
+                ring->last_level = rec.level;
+                ring->last_message.swap(message);
+            }
+            ring->read_position.store(r, std::memory_order_release);
+
+            if (idle || !alive)
+                emitRepeats(ring);
+            if (!alive)
+                recycle(ring);
+        }
+
+        auto dropped = num_dropped_logs.load(std::memory_order_relaxed);
+        if (dropped > num_reported_dropped_logs) {
+            char buffer[96];
+            snprintf(buffer, sizeof(buffer), "%" PRId64 " realtime log messages were dropped." AAP_RT_LOG_LINE_END,
+                     dropped - num_reported_dropped_logs);
+            emit(AAP_LOG_LEVEL_WARN, LOG_TAG, buffer);
+            num_reported_dropped_logs = dropped;
+        }
+#if !ANDROID
+        fflush(stdout);
+#endif
+    }
+
+    // Runs the flusher from the first registration until the exit, where it emits the remaining logs.
+    class Flusher {
+        std::thread thread{};
+        std::atomic<bool> running{false};
+    public:
+        void ensureStarted() {
+            if (running.exchange(true))
+                return;
+            thread = std::thread([this] {
+                while (running) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(AAP_RT_LOG_FLUSH_INTERVAL_MILLISECONDS));
+                    drain();
+                }
+            });
+        }
+        ~Flusher() {
+            if (!running.exchange(false))
+                return;
+            thread.join();
+            drain();
+        }
+    };
+
+    // declared after the registry, so that it is destructed before it.
+    static Flusher flusher{};
+
+    void reserveRealtimeThreads(int32_t count) {
+        const std::lock_guard<std::mutex> lock{registry_mutex};
+        flusher.ensureStarted();
+        for (auto& slot : thread_rings) {
+            auto ring = slot.load(std::memory_order_relaxed);
+            if (!ring) {
+                if (count <= 0)
+                    return;
+                slot.store(new ThreadRing(), std::memory_order_release);
+                count--;
+            } else if (ring->state.load(std::memory_order_relaxed) != AAP_RT_LOG_RING_IN_USE)
+                count--; // free, or will be free at the next drain.
+        }
+    }
+
+    static bool acquireRing() {
+        for (auto& slot : thread_rings) {
+            auto ring = slot.load(std::memory_order_acquire);
+            if (!ring)
+                return false;
+            int32_t expected = AAP_RT_LOG_RING_FREE;
+            if (ring->state.compare_exchange_strong(expected, AAP_RT_LOG_RING_IN_USE, std::memory_order_acquire)) {
+                current_thread_ring.ring = ring;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void registerRealtimeThread() {
+        if (current_thread_ring.ring || acquireRing())
+            return;
+        // nothing was reserved for this thread; it is not realtime-safe anymore.
+        reserveRealtimeThreads(1);
+        acquireRing();
+    }
+
+    void unregisterRealtimeThread() {
+        auto ring = current_thread_ring.ring;
+        if (!ring)
+            return;
+        current_thread_ring.ring = nullptr;
+        ring->state = AAP_RT_LOG_RING_RETIRED;
+    }
+
+    void flushRealtimeLogs() {
+        drain();
+    }
+
+    int64_t getNumDroppedRealtimeLogs() {
+        return num_dropped_logs;
+    }
+}
+
+extern "C" bool aap_rt_log_vprintf(int logLevel, const char* tag, const char* fmt, va_list ap) {
+    return aap::logging::enqueue(logLevel, tag, fmt, ap);
+}
@@ -0,0 +1,283 @@
+
+#include "aap/unstable/tracing.h"
+#include "aap/unstable/logging.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define LOG_TAG "AAP.Tracing"
+// per thread. It must be a power of two.
+#define AAP_TRACE_RING_SIZE 16384
+#define AAP_TRACE_FLUSH_INTERVAL_MILLISECONDS 100
+#define AAP_TRACE_MAX_THREAD_NAME_LENGTH 32
+// The rings that startTracing() allocates in advance for the realtime threads (see registerCurrentThread()).
+#define AAP_TRACE_RESERVED_RINGS 8
+
+namespace aap::trace {
+
+    std::atomic<bool> trace_enabled{false};
+
+    struct TraceRecord {
+        int64_t timestamp_nanoseconds;
+        int64_t value;
+        const char* name;
+        TraceEventType type;
+    };
+
+    // single producer (the owner thread), single consumer (the flusher).
+    struct ThreadRing {
+        TraceRecord records[AAP_TRACE_RING_SIZE];
+        std::atomic<uint32_t> write_position{0};
+        std::atomic<uint32_t> read_position{0};
+        std::atomic<bool> thread_alive{true};
+        // false while it is reserved and no thread has taken it. The flusher skips such rings.
+        std::atomic<bool> claimed{true};
+        int64_t thread_id{0};
+        char thread_name[AAP_TRACE_MAX_THREAD_NAME_LENGTH]{};
+        bool metadata_written{false};
+    };
+
+    // marks the ring as orphaned at thread exit, so that the flusher releases it after draining.
+    struct ThreadRingHolder {
+        ThreadRing* ring{nullptr};
+        ~ThreadRingHolder() {
+            if (ring)
+                ring->thread_alive = false;
+        }
+    };
+
+    static thread_local ThreadRingHolder current_thread_ring{};
+    // set by registerCurrentThread(). Such threads only take reserved rings, and never allocate one.
+    static thread_local bool is_realtime_thread{false};
+    static thread_local char registered_thread_name[AAP_TRACE_MAX_THREAD_NAME_LENGTH]{};
+    static std::atomic<ThreadRing*> reserved_rings[AAP_TRACE_RESERVED_RINGS]{};
+    static std::mutex registry_mutex{};
+    static std::vector<ThreadRing*> thread_rings{};
+    static std::atomic<int64_t> num_dropped_events{0};
+
+    // tracing session, guarded by `session_mutex`.
+    static std::mutex session_mutex{};
+    static FILE* output{nullptr};
+    static bool is_first_event{true};
+    static std::thread flusher{};
+    static std::atomic<bool> flusher_running{false};
+
+    static inline int64_t monotonicNanoseconds() {
+        struct timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    static int64_t currentThreadId() {
+#if defined(__linux__)
+        return (int64_t) syscall(SYS_gettid);
+#else
+        return (int64_t) std::hash<std::thread::id>{}(std::this_thread::get_id());
+#endif
+    }
+
+    static void setThreadIdentity(ThreadRing* ring) {
+        ring->thread_id = currentThreadId();
+        if (registered_thread_name[0])
+            memcpy(ring->thread_name, registered_thread_name, AAP_TRACE_MAX_THREAD_NAME_LENGTH);
+#if defined(__linux__)
+        else
+            prctl(PR_GET_NAME, ring->thread_name);
+#endif
+    }
+
+    // Takes one of the rings that startTracing() reserved. It neither allocates nor locks.
+    static ThreadRing* claimReservedRing() {
+        for (auto& slot : reserved_rings) {
+            if (!slot.load(std::memory_order_relaxed))
+                continue;
+            auto ring = slot.exchange(nullptr, std::memory_order_acquire);
+            if (!ring)
+                continue;
+            setThreadIdentity(ring);
+            ring->claimed.store(true, std::memory_order_release);
+            current_thread_ring.ring = ring;
+            return ring;
+        }
+        return nullptr;
+    }
+
+    static ThreadRing* allocateRing() {
+        auto ring = new ThreadRing();
+        setThreadIdentity(ring);
+        const std::lock_guard<std::mutex> lock{registry_mutex};
+        thread_rings.emplace_back(ring);
+        current_thread_ring.ring = ring;
+        return ring;
+    }
+
+    void registerCurrentThread(const char* threadName) {
+        is_realtime_thread = true;
+        if (threadName)
+            strncpy(registered_thread_name, threadName, AAP_TRACE_MAX_THREAD_NAME_LENGTH - 1);
+        if (!current_thread_ring.ring && isEnabled())
+            claimReservedRing();
+    }
+
+    void record(TraceEventType type, const char* name, int64_t value) {
+        auto ring = current_thread_ring.ring;
+        if (!ring)
+            ring = claimReservedRing();
+        if (!ring && !is_realtime_thread)
+            ring = allocateRing();
+        if (!ring) {
+            num_dropped_events.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto w = ring->write_position.load(std::memory_order_relaxed);
+        auto r = ring->read_position.load(std::memory_order_acquire);
+        if (w - r >= AAP_TRACE_RING_SIZE) {
+            num_dropped_events.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ring->records[w & (AAP_TRACE_RING_SIZE - 1)] = {monotonicNanoseconds(), value, name, type};
+        ring->write_position.store(w + 1, std::memory_order_release);
+    }
+
+    static void writeJsonString(const char* s) {
+        fputc('"', output);
+        for (; *s; s++) {
+            if (*s == '"' || *s == '\\')
+                fputc('\\', output);
+            if ((unsigned char) *s >= 0x20)
+                fputc(*s, output);
+        }
+        fputc('"', output);
+    }
+
+    static void beginJsonEvent(const char* name, const char* phase, int64_t threadId) {
+        fputs(is_first_event ? "\n" : ",\n", output);
+        is_first_event = false;
+        fputs("{\"name\":", output);
+        writeJsonString(name);
+        fprintf(output, ",\"ph\":\"%s\",\"pid\":%d,\"tid\":%" PRId64, phase, (int) getpid(), threadId);
+    }
+
+    // Drains all the thread rings into the output. It runs on the flusher thread (or in stopTracing()).
+    static void flush() {
+        std::vector<ThreadRing*> rings{};
+        {
+            const std::lock_guard<std::mutex> lock{registry_mutex};
+            rings = thread_rings;
+        }
+
+        std::vector<ThreadRing*> finished{};
+        for (auto ring : rings) {
+            // check it before draining, so that nothing is written after the last drain.
+            bool alive = ring->thread_alive;
+            if (!ring->claimed.load(std::memory_order_acquire))
+                continue;
+            if (!ring->metadata_written) {
+                beginJsonEvent("thread_name", "M", ring->thread_id);
+                fputs(",\"args\":{\"name\":", output);
+                writeJsonString(ring->thread_name);
+                fputs("}}", output);
+                ring->metadata_written = true;
+            }
+
+            auto r = ring->read_position.load(std::memory_order_relaxed);
+            auto w = ring->write_position.load(std::memory_order_acquire);
+            for (; r != w; r++) {
+                auto& rec = ring->records[r & (AAP_TRACE_RING_SIZE - 1)];
+                const char* phase = rec.type == AAP_TRACE_EVENT_BEGIN ? "B" : rec.type == AAP_TRACE_EVENT_END ? "E" : "C";
+                beginJsonEvent(rec.name, phase, ring->thread_id);
+                fprintf(output, ",\"ts\":%" PRId64 ".%03d", rec.timestamp_nanoseconds / 1000, (int) (rec.timestamp_nanoseconds % 1000));
+                if (rec.type == AAP_TRACE_EVENT_COUNTER)
+                    fprintf(output, ",\"args\":{\"value\":%" PRId64 "}", rec.value);
+                fputc('}', output);
+            }
+            ring->read_position.store(r, std::memory_order_release);
+
+            if (!alive)
+                finished.emplace_back(ring);
+        }
+        fflush(output);
+
+        if (!finished.empty()) {
+            const std::lock_guard<std::mutex> lock{registry_mutex};
+            for (auto ring : finished) {
+                thread_rings.erase(std::find(thread_rings.begin(), thread_rings.end(), ring));
+                delete ring;
+            }
+        }
+    }
+
+    bool startTracing(const char* outputPath) {
+        const std::lock_guard<std::mutex> lock{session_mutex};
+        if (output) {
+            aap::a_log_f(AAP_LOG_LEVEL_WARN, LOG_TAG, "Tracing has already started.");
+            return false;
+        }
+        output = fopen(outputPath, "w");
+        if (!output) {
+            aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "Could not open the trace output %s", outputPath);
+            return false;
+        }
+        fputc('[', output);
+        is_first_event = true;
+        num_dropped_events = 0;
+        {
+            // discard whatever remains from the previous session.
+            const std::lock_guard<std::mutex> registryLock{registry_mutex};
+            for (auto ring : thread_rings) {
+                ring->read_position.store(ring->write_position.load());
+                ring->metadata_written = false;
+            }
+            // the realtime threads take them at their first event, instead of allocating.
+            for (auto& slot : reserved_rings) {
+                if (slot.load())
+                    continue;
+                auto ring = new ThreadRing();
+                ring->claimed = false;
+                thread_rings.emplace_back(ring);
+                slot.store(ring, std::memory_order_release);
+            }
+        }
+
+        trace_enabled = true;
+        flusher_running = true;
+        flusher = std::thread([] {
+            while (flusher_running) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(AAP_TRACE_FLUSH_INTERVAL_MILLISECONDS));
+                flush();
+            }
+        });
+        return true;
+    }
+
+    void stopTracing() {
+        const std::lock_guard<std::mutex> lock{session_mutex};
+        if (!output)
+            return;
+        trace_enabled = false;
+        flusher_running = false;
+        flusher.join();
+        flush();
+        fputs("\n]\n", output);
+        fclose(output);
+        output = nullptr;
+        if (num_dropped_events > 0)
+            aap::a_log_f(AAP_LOG_LEVEL_WARN, LOG_TAG, "%" PRId64 " trace events were dropped.", num_dropped_events.load());
+    }
+
+    int64_t getNumDroppedEvents() {
+        return num_dropped_events;
+    }
+}
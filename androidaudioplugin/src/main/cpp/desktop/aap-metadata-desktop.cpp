@@ -0,0 +1,371 @@
+#include "aap/core/host/plugin-client-system.h"
+#include "aap/unstable/logging.h"
+#include "audio-plugin-host-desktop-internal.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if !ANDROID
+
+#define LOG_TAG "AAP.Desktop.Metadata"
+// Metadata files deeper than this in a plugin path are not searched.
+#define AAP_DESKTOP_METADATA_MAX_DEPTH 4
+
+namespace aap {
+
+// A minimal reader for aap_metadata.xml. It supports what AudioPluginHostHelper.parseAapMetadata() reads:
+// elements and attributes (namespace prefixes are stripped, not resolved), comments, processing instructions,
+// DOCTYPE and the predefined and numeric character references. Text content is skipped.
+class AapMetadataReader {
+	const std::string& xml;
+	size_t pos{0};
+
+public:
+	struct Element {
+		std::string name{};
+		std::map<std::string,std::string> attributes{};
+		bool isEndTag{false};
+		bool isEmpty{false};
+
+		const char* get(const char* attribute) const {
+			auto it = attributes.find(attribute);
+			return it == attributes.end() ? nullptr : it->second.c_str();
+		}
+	};
+
+	explicit AapMetadataReader(const std::string& content) : xml(content) {}
+
+	size_t getLineNumber() const { return (size_t) std::count(xml.begin(), xml.begin() + (long) std::min(pos, xml.size()), '\n') + 1; }
+
+	// Reads the next start or end tag. Returns false at the end of the document, or on a malformed tag (error is set).
+	bool next(Element& element, std::string& error) {
+		while (true) {
+			pos = xml.find('<', pos);
+			if (pos == std::string::npos)
+				return false;
+			if (skipMarkup("<!--", "-->") || skipMarkup("<![CDATA[", "]]>") || skipMarkup("<?", "?>") || skipMarkup("<!", ">"))
+				continue;
+			return readTag(element, error);
+		}
+	}
+
+private:
+	static std::string localName(const std::string& name) {
+		auto colon = name.find(':');
+		return colon == std::string::npos ? name : name.substr(colon + 1);
+	}
+
+	static bool isNameChar(char c) { return isalnum((unsigned char) c) || c == ':' || c == '-' || c == '_' || c == '.'; }
+
+	bool skipMarkup(const char* open, const char* close) {
+		if (xml.compare(pos, strlen(open), open) != 0)
+			return false;
+		auto end = xml.find(close, pos + strlen(open));
+		pos = end == std::string::npos ? xml.size() : end + strlen(close);
+		return true;
+	}
+
+	void skipSpaces() {
+		while (pos < xml.size() && isspace((unsigned char) xml[pos]))
+			pos++;
+	}
+
+	std::string readName() {
+		auto start = pos;
+		while (pos < xml.size() && isNameChar(xml[pos]))
+			pos++;
+		return xml.substr(start, pos - start);
+	}
+
+	static std::string decodeEntities(const std::string& s) {
+		std::string ret{};
+		for (size_t i = 0; i < s.size(); i++) {
+			auto semicolon = s[i] == '&' ? s.find(';', i) : std::string::npos;
+			if (semicolon == std::string::npos) {
+				ret += s[i];
+				continue;
+			}
+			auto entity = s.substr(i + 1, semicolon - i - 1);
+			if (entity == "amp") ret += '&';
+			else if (entity == "lt") ret += '<';
+			else if (entity == "gt") ret += '>';
+			else if (entity == "quot") ret += '"';
+			else if (entity == "apos") ret += '\'';
+			else if (entity.size() > 1 && entity[0] == '#') {
+				auto code = entity[1] == 'x' ? strtol(entity.c_str() + 2, nullptr, 16) : strtol(entity.c_str() + 1, nullptr, 10);
+				// UTF-8
+				if (code < 0x80)
+					ret += (char) code;
+				else if (code < 0x800) {
+					ret += (char) (0xC0 | (code >> 6));
+					ret += (char) (0x80 | (code & 0x3F));
+				} else if (code < 0x10000) {
+					ret += (char) (0xE0 | (code >> 12));
+					ret += (char) (0x80 | ((code >> 6) & 0x3F));
+					ret += (char) (0x80 | (code & 0x3F));
+				} else {
+					ret += (char) (0xF0 | (code >> 18));
+					ret += (char) (0x80 | ((code >> 12) & 0x3F));
+					ret += (char) (0x80 | ((code >> 6) & 0x3F));
+					ret += (char) (0x80 | (code & 0x3F));
+				}
+			}
+			else {
+				ret += s[i];
+				continue;
+			}
+			i = semicolon;
+		}
+		return ret;
+	}
+
+	bool readTag(Element& element, std::string& error) {
+		element = Element{};
+		pos++; // '<'
+		if (pos < xml.size() && xml[pos] == '/') {
+			element.isEndTag = true;
+			pos++;
+		}
+		element.name = localName(readName());
+		if (element.name.empty()) {
+			error = "missing element name";
+			return false;
+		}
+		while (true) {
+			skipSpaces();
+			if (pos >= xml.size()) {
+				error = "unterminated element <" + element.name + ">";
+				return false;
+			}
+			if (xml[pos] == '>') {
+				pos++;
+				return true;
+			}
+			if (xml.compare(pos, 2, "/>") == 0) {
+				element.isEmpty = true;
+				pos += 2;
+				return true;
+			}
+			auto attribute = readName();
+			skipSpaces();
+			if (attribute.empty() || pos >= xml.size() || xml[pos] != '=') {
+				error = "malformed attribute in <" + element.name + ">";
+				return false;
+			}
+			pos++;
+			skipSpaces();
+			auto quote = pos < xml.size() ? xml[pos] : '\0';
+			auto end = quote == '"' || quote == '\'' ? xml.find(quote, pos + 1) : std::string::npos;
+			if (end == std::string::npos) {
+				error = "malformed value of attribute " + attribute + " in <" + element.name + ">";
+				return false;
+			}
+			// namespace declarations are not attributes of the element.
+			if (attribute != "xmlns" && attribute.compare(0, 6, "xmlns:") != 0)
+				element.attributes[localName(attribute)] = decodeEntities(xml.substr(pos + 1, end - pos - 1));
+			pos = end + 1;
+		}
+	}
+};
+
+static bool parseDouble(const char* s, double& result) {
+	if (!s || !*s)
+		return false;
+	char* end;
+	result = strtod(s, &end);
+	return *end == '\0';
+}
+
+static bool parseInteger(const char* s, int32_t& result) {
+	if (!s || !*s)
+		return false;
+	char* end;
+	result = (int32_t) strtol(s, &end, 10);
+	return *end == '\0';
+}
+
+static double safeDouble(double v) { return std::isfinite(v) ? v : 0.0; }
+
+// The counterpart of AudioPluginHostHelper.parseAapMetadata() for desktop.
+// The relative library name is resolved against the metadata directory if the library exists there.
+std::vector<PluginInformation*> parseAapMetadata(const std::string& metadataPath) {
+	std::vector<PluginInformation*> results{};
+	std::ifstream file{metadataPath};
+	if (!file) {
+		aap::a_log_f(AAP_LOG_LEVEL_WARN, LOG_TAG, "Could not read %s", metadataPath.c_str());
+		return results;
+	}
+	std::stringstream stream{};
+	stream << file.rdbuf();
+	auto xml = stream.str();
+	auto slash = metadataPath.rfind('/');
+	auto directory = slash == std::string::npos ? std::string{"."} : metadataPath.substr(0, slash);
+
+	AapMetadataReader reader{xml};
+	AapMetadataReader::Element e{};
+	std::string error{};
+	PluginInformation* currentPlugin{nullptr};
+	ParameterInformation* currentParameter{nullptr};
+	auto fail = [&](const std::string& message) {
+		aap::a_log_f(AAP_LOG_LEVEL_WARN, LOG_TAG, "%s: %s (line %d)", metadataPath.c_str(), message.c_str(), (int) reader.getLineNumber());
+	};
+
+	while (reader.next(e, error)) {
+		if (e.isEndTag) {
+			if (e.name == "plugin")
+				currentPlugin = nullptr;
+			else if (e.name == "parameter")
+				currentParameter = nullptr;
+			continue;
+		}
+		if (e.name == "plugin") {
+			if (currentPlugin)
+				continue;
+			auto get = [&](const char* attribute) { auto v = e.get(attribute); return v ? v : ""; };
+			std::string library{get("library")};
+			if (!library.empty() && library[0] != '/' && access((directory + "/" + library).c_str(), F_OK) == 0)
+				library = directory + "/" + library;
+			currentPlugin = new PluginInformation(false, directory.c_str(), "", get("name"), get("developer"),
+												  get("version"), get("unique-id"), library.c_str(), get("entrypoint"),
+												  metadataPath.c_str(), get("category"), get("ui-view-factory"),
+												  get("ui-activity"), get("ui-web"));
+			results.emplace_back(currentPlugin);
+			if (e.isEmpty)
+				currentPlugin = nullptr;
+		} else if (e.name == "extension") {
+			if (currentPlugin) {
+				auto required = e.get("required");
+				auto uri = e.get("uri");
+				currentPlugin->addExtension(PluginExtensionInformation{required && strcmp(required, "true") == 0, uri ? uri : ""});
+			}
+		} else if (e.name == "parameter") {
+			if (!currentPlugin)
+				continue;
+			int32_t id;
+			auto name = e.get("name");
+			double defaultValue{0}, minimum{0}, maximum{1};
+			if (!parseInteger(e.get("id"), id))
+				fail("The \"id\" attribute on a <parameter> element is missing or not a valid integer");
+			else if (!name)
+				fail("Mandatory attribute \"name\" is missing on <parameter> element");
+			else {
+				parseDouble(e.get("default"), defaultValue);
+				parseDouble(e.get("minimum"), minimum);
+				parseDouble(e.get("maximum"), maximum);
+				currentParameter = new ParameterInformation(id, name, safeDouble(minimum), safeDouble(maximum), safeDouble(defaultValue));
+				currentPlugin->addDeclaredParameter(currentParameter);
+				if (e.isEmpty)
+					currentParameter = nullptr;
+			}
+		} else if (e.name == "port") {
+			if (!currentPlugin)
+				continue;
+			int32_t index = currentPlugin->getNumDeclaredPorts();
+			if (e.get("index") && !parseInteger(e.get("index"), index)) {
+				fail("The \"index\" attribute on a <port> element must be a valid integer");
+				continue;
+			}
+			auto direction = e.get("direction");
+			auto content = e.get("content");
+			auto contentType = !content ? AAP_CONTENT_TYPE_UNDEFINED :
+							   !strcmp(content, "midi") ? AAP_CONTENT_TYPE_MIDI :
+							   !strcmp(content, "midi2") ? AAP_CONTENT_TYPE_MIDI2 :
+							   !strcmp(content, "audio") ? AAP_CONTENT_TYPE_AUDIO : AAP_CONTENT_TYPE_UNDEFINED;
+			auto name = e.get("name");
+			auto port = new PortInformation((uint32_t) index, name ? name : "", contentType,
+											direction && !strcmp(direction, "input") ? AAP_PORT_DIRECTION_INPUT : AAP_PORT_DIRECTION_OUTPUT);
+			int32_t minimumSize;
+			if (e.get("minimumSize")) {
+				if (parseInteger(e.get("minimumSize"), minimumSize))
+					port->setPropertyValueString(AAP_PORT_MINIMUM_SIZE, std::to_string(minimumSize));
+				else
+					fail("The \"minimumSize\" attribute on a <port> element must be a valid integer");
+			}
+			currentPlugin->addDeclaredPort(port);
+		} else if (e.name == "enumeration") {
+			if (!currentParameter)
+				continue;
+			double value;
+			auto name = e.get("name");
+			if (!parseDouble(e.get("value"), value))
+				fail("A mandatory attribute `value` is missing or invalid double value for an `enumeration` element");
+			else if (!name || !*name)
+				fail("A mandatory attribute `name` is missing or empty on an `enumeration` element");
+			else {
+				ParameterInformation::Enumeration enumeration{currentParameter->getEnumCount(), value, name};
+				currentParameter->addEnumeration(enumeration);
+			}
+		}
+	}
+	if (!error.empty())
+		fail(error);
+	return results;
+}
+
+static void findMetadataFiles(const std::string& path, int32_t depth, std::vector<std::string>& results) {
+	auto dir = opendir(path.c_str());
+	if (!dir)
+		return;
+	std::vector<std::string> subdirectories{};
+	while (auto entry = readdir(dir)) {
+		std::string name{entry->d_name};
+		if (name == "." || name == "..")
+			continue;
+		auto full = path + "/" + name;
+		struct stat st;
+		if (stat(full.c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			subdirectories.emplace_back(full);
+		else if (name == AAP_DESKTOP_METADATA_FILENAME)
+			results.emplace_back(full);
+	}
+	closedir(dir);
+	if (depth < AAP_DESKTOP_METADATA_MAX_DEPTH)
+		for (auto& subdirectory : subdirectories)
+			findMetadataFiles(subdirectory, depth + 1, results);
+}
+
+std::vector<std::string> DesktopPluginClientSystem::getPluginPaths() {
+	std::vector<std::string> ret{};
+	auto env = getenv(AAP_DESKTOP_PLUGIN_PATH_ENV);
+	if (env) {
+		std::string paths{env};
+		for (size_t start = 0, end; start <= paths.size(); start = end + 1) {
+			end = paths.find(':', start);
+			if (end == std::string::npos)
+				end = paths.size();
+			if (end > start)
+				ret.emplace_back(paths.substr(start, end - start));
+		}
+	} else if (auto home = getenv("HOME"))
+		ret.emplace_back(std::string{home} + "/" + AAP_DESKTOP_DEFAULT_PLUGIN_PATH);
+	return ret;
+}
+
+void DesktopPluginClientSystem::getAAPMetadataPaths(std::string path, std::vector<std::string>& results) {
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && !S_ISDIR(st.st_mode))
+		results.emplace_back(path); // a metadata file itself
+	else
+		findMetadataFiles(path, 0, results);
+}
+
+std::vector<PluginInformation*> DesktopPluginClientSystem::getPluginsFromMetadataPaths(std::vector<std::string>& aapMetadataPaths) {
+	std::vector<PluginInformation*> results{};
+	for (auto& metadataPath : aapMetadataPaths)
+		for (auto p : parseAapMetadata(metadataPath))
+			results.emplace_back(p);
+	return results;
+}
+
+} // namespace aap
+
+#endif // !ANDROID
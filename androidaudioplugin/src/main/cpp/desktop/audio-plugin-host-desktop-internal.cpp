@@ -3,6 +3,12 @@
 #include "aap/core/host/plugin-client-system.h"
 #include "aap/core/host/desktop/audio-plugin-host-desktop.h"
 #include "aap/core/aapxs/extension-service.h"
+#include "aap/ext/midi.h"
+#include "audio-plugin-host-desktop-internal.h"
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #if !ANDROID
 
@@ -14,11 +20,37 @@ int32_t createGui(std::string pluginId, int32_t instanceId, void* audioPluginVie
 namespace aap {
 
 int32_t getMidiSettingsFromLocalConfig(std::string pluginId) {
-	assert(false); // FIXME: implement
+	// There is no per-plugin MIDI settings store on desktop (yet).
+	return AAP_PARAMETERS_MAPPING_POLICY_NONE;
 }
 
 PluginClientSystem* PluginClientSystem::getInstance() {
-	assert(false); // FIXME: implement
+	static DesktopPluginClientSystem instance{};
+	return &instance;
+}
+
+int32_t DesktopPluginClientSystem::createSharedMemory(size_t size) {
+#if __APPLE__
+	// there is no memfd. Create a named one and unlink it immediately so that only the FD refers to it.
+	static std::atomic<int32_t> serial{0};
+	char name[64];
+	snprintf(name, sizeof(name), "/aap-shm-%d-%d", (int) getpid(), serial++);
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0)
+		shm_unlink(name);
+#else
+	int fd = memfd_create("aap-shm", MFD_CLOEXEC);
+#endif
+	if (fd >= 0 && ftruncate(fd, (off_t) size) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void DesktopPluginClientSystem::ensurePluginServiceConnected(aap::PluginClientConnectionList* connections, std::string serviceName, std::function<void(std::string&)> callback) {
+	std::string error{"There is no plugin service on desktop: " + serviceName};
+	callback(error);
 }
 
 } // namespace aap
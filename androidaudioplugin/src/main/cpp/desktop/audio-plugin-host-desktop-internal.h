@@ -0,0 +1,38 @@
+#ifndef AAP_CORE_AUDIO_PLUGIN_HOST_DESKTOP_INTERNAL_H
+#define AAP_CORE_AUDIO_PLUGIN_HOST_DESKTOP_INTERNAL_H
+#if !ANDROID
+
+#include "aap/core/host/plugin-client-system.h"
+
+// The plugin paths are separated by ':' in this environment variable, like LD_LIBRARY_PATH.
+#define AAP_DESKTOP_PLUGIN_PATH_ENV "AAP_PLUGIN_PATH"
+// The plugin path under $HOME when AAP_PLUGIN_PATH is not set.
+#define AAP_DESKTOP_DEFAULT_PLUGIN_PATH ".aap/plugins"
+// The plugins are found by the metadata files of this name in the plugin paths (or their subdirectories).
+#define AAP_DESKTOP_METADATA_FILENAME "aap_metadata.xml"
+
+namespace aap {
+
+// Parses an aap_metadata.xml the same way as AudioPluginHostHelper.parseAapMetadata() on Android.
+std::vector<PluginInformation*> parseAapMetadata(const std::string& metadataPath);
+
+// There is no plugin service on desktop. Plugins are only instantiated locally (see StandalonePluginService).
+class DesktopPluginClientSystem : public PluginClientSystem {
+public:
+    virtual inline ~DesktopPluginClientSystem() {}
+
+    int32_t createSharedMemory(size_t size) override;
+
+    void ensurePluginServiceConnected(aap::PluginClientConnectionList* connections, std::string serviceName, std::function<void(std::string&)> callback) override;
+
+    std::vector<std::string> getPluginPaths() override;
+
+    void getAAPMetadataPaths(std::string path, std::vector<std::string>& results) override;
+
+    std::vector<PluginInformation*> getPluginsFromMetadataPaths(std::vector<std::string>& aapMetadataPaths) override;
+};
+
+} // namespace aap
+
+#endif // !ANDROID
+#endif // AAP_CORE_AUDIO_PLUGIN_HOST_DESKTOP_INTERNAL_H
@@ -0,0 +1,585 @@
+// libaaprtcheck: the realtime-safety checker to preload. See aap/unstable/rt-safety.h for the usage.
+//
+// It interposes the RT-unsafe functions, and records a violation when one of them is called on a thread
+// inside a realtime section. Violations are deduplicated by their function and stack trace into a fixed,
+// lock-free table, so that recording itself does not allocate or lock on the audio thread.
+//
+// Calls within the C library (e.g. the write() by printf()) are not interposable, so the entry points
+// (printf() etc.) are interposed instead. ioctl() is not checked, since it is how Binder IPC works.
+// syscall() is interposed for the futex waits that libstdc++ (std::future, std::atomic::wait etc.) and
+// libc++ make directly, bypassing the pthread functions.
+
+#include <aap/unstable/rt-safety.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+#include <unwind.h>
+#if ANDROID
+#include <android/log.h>
+#endif
+
+#define LOG_TAG "AAP.RTCheck"
+// The frames recorded for each violation.
+#define AAP_RTCHECK_MAX_FRAMES 24
+// The number of distinct violations (function + stack trace) that can be recorded. The rest are counted as dropped.
+#define AAP_RTCHECK_MAX_VIOLATIONS 512
+
+#define AAP_RTCHECK_TLS __thread __attribute__((tls_model("initial-exec")))
+
+// ---- per-thread state
+
+// The innermost realtime section of the thread, or null outside the sections.
+static AAP_RTCHECK_TLS const char* current_section;
+// Set while the checker itself runs (recording, reporting), to not check the calls it makes.
+static AAP_RTCHECK_TLS bool in_checker;
+
+static inline bool shouldCheck() { return current_section != nullptr && !in_checker; }
+
+// ---- the violation table
+
+struct Violation {
+    // 0 if unused. The slot is claimed by the first thread that CASes it from 0.
+    std::atomic<uint64_t> key{0};
+    std::atomic<bool> ready{false};
+    const char* function{nullptr};
+    const char* section{nullptr};
+    int32_t num_frames{0};
+    uintptr_t frames[AAP_RTCHECK_MAX_FRAMES]{};
+    std::atomic<int64_t> count{0};
+    // the count at the last report
+    int64_t reported_count{0};
+};
+
+static Violation violations[AAP_RTCHECK_MAX_VIOLATIONS];
+static std::atomic<int64_t> dropped_violations{0};
+static int64_t reported_dropped_violations{0};
+static std::atomic<int32_t> report_serial{0};
+static bool abort_on_violation{false};
+static const char* report_path{nullptr};
+static pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct UnwindState {
+    uintptr_t* frames;
+    int32_t count;
+};
+
+static _Unwind_Reason_Code unwindCallback(struct _Unwind_Context* context, void* arg) {
+    auto state = (UnwindState*) arg;
+    auto pc = (uintptr_t) _Unwind_GetIP(context);
+    if (pc == 0)
+        return _URC_END_OF_STACK;
+    state->frames[state->count++] = pc;
+    return state->count < AAP_RTCHECK_MAX_FRAMES ? _URC_NO_REASON : _URC_END_OF_STACK;
+}
+
+static void writeViolation(FILE* out, int32_t index, Violation& v, int64_t count);
+
+static void recordViolation(const char* function) {
+    in_checker = true;
+    uintptr_t frames[AAP_RTCHECK_MAX_FRAMES];
+    UnwindState state{frames, 0};
+    _Unwind_Backtrace(unwindCallback, &state);
+
+    // FNV-1a of the function and the frames
+    uint64_t key = 14695981039346656037ULL;
+    auto mix = [&key](uintptr_t v) { key = (key ^ v) * 1099511628211ULL; };
+    mix((uintptr_t) function);
+    for (int32_t i = 0; i < state.count; i++)
+        mix(frames[i]);
+    key |= 1;
+
+    Violation* slot{nullptr};
+    for (int32_t i = 0; i < AAP_RTCHECK_MAX_VIOLATIONS; i++) {
+        auto& v = violations[(key + i) % AAP_RTCHECK_MAX_VIOLATIONS];
+        uint64_t expected = 0;
+        if (v.key.load(std::memory_order_acquire) == key) {
+            slot = &v;
+            break;
+        }
+        if (v.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) {
+            v.function = function;
+            v.section = current_section;
+            v.num_frames = state.count;
+            memcpy(v.frames, frames, sizeof(uintptr_t) * state.count);
+            v.ready.store(true, std::memory_order_release);
+            slot = &v;
+            break;
+        }
+        if (expected == key) {
+            slot = &v;
+            break;
+        }
+    }
+    if (slot)
+        slot->count.fetch_add(1, std::memory_order_relaxed);
+    else
+        dropped_violations.fetch_add(1, std::memory_order_relaxed);
+
+    if (abort_on_violation && slot) {
+        FILE* out = report_path ? fopen(report_path, "a") : stderr;
+        writeViolation(out ? out : stderr, 0, *slot, 1);
+        if (out && out != stderr)
+            fclose(out);
+        abort();
+    }
+    in_checker = false;
+}
+
+#define AAP_RTCHECK(function) do { if (shouldCheck()) recordViolation(function); } while (0)
+
+// ---- reporting
+
+static void reportLine(FILE* out, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+#if ANDROID
+    if (out == stderr) {
+        __android_log_vprint(ANDROID_LOG_WARN, LOG_TAG, format, args);
+        va_end(args);
+        return;
+    }
+#endif
+    vfprintf(out, format, args);
+    fputc('\n', out);
+    va_end(args);
+}
+
+static void writeViolation(FILE* out, int32_t index, Violation& v, int64_t count) {
+    reportLine(out, "[%d] %s() x %lld in %s", index, v.function, (long long) count, v.section ? v.section : "(unknown)");
+    // skip the frames in this library (the interceptor and the recorder).
+    Dl_info self{};
+    dladdr((void*) recordViolation, &self);
+    bool skipping = true;
+    for (int32_t i = 0, n = 0; i < v.num_frames; i++) {
+        Dl_info info{};
+        // the return address may be just beyond the call, even beyond the function, so look up pc - 1.
+        auto pc = v.frames[i] - (i > 0 ? 1 : 0);
+        if (!dladdr((void*) pc, &info)) {
+            reportLine(out, "    #%02d 0x%llx", n++, (unsigned long long) pc);
+            continue;
+        }
+        if (skipping && info.dli_fbase == self.dli_fbase)
+            continue;
+        skipping = false;
+        auto offset = (unsigned long long) (pc - (uintptr_t) info.dli_fbase);
+        if (info.dli_sname)
+            reportLine(out, "    #%02d %s+0x%llx (%s+0x%llx)", n++, info.dli_fname, offset,
+                       info.dli_sname, (unsigned long long) (pc - (uintptr_t) info.dli_saddr));
+        else
+            reportLine(out, "    #%02d %s+0x%llx", n++, info.dli_fname, offset);
+    }
+}
+
+static void writeReport() {
+    pthread_mutex_lock(&report_mutex);
+    int32_t numLocations = 0;
+    int64_t numViolations = 0;
+    for (auto& v : violations) {
+        if (v.ready.load(std::memory_order_acquire) && v.count.load(std::memory_order_relaxed) > v.reported_count) {
+            numLocations++;
+            numViolations += v.count.load(std::memory_order_relaxed) - v.reported_count;
+        }
+    }
+    auto dropped = dropped_violations.load(std::memory_order_relaxed) - reported_dropped_violations;
+    if (numLocations > 0 || dropped > 0) {
+        FILE* out = report_path ? fopen(report_path, "a") : stderr;
+        if (!out)
+            out = stderr;
+        reportLine(out, "AAP realtime-safety report #%d: %lld violation(s) at %d location(s), %lld dropped",
+                   ++report_serial, (long long) numViolations, numLocations, (long long) dropped);
+        int32_t index = 0;
+        for (auto& v : violations) {
+            if (!v.ready.load(std::memory_order_acquire))
+                continue;
+            auto count = v.count.load(std::memory_order_relaxed);
+            if (count <= v.reported_count)
+                continue;
+            writeViolation(out, index++, v, count - v.reported_count);
+            v.reported_count = count;
+        }
+        reported_dropped_violations += dropped;
+        if (out != stderr)
+            fclose(out);
+        else
+            fflush(stderr);
+    }
+    pthread_mutex_unlock(&report_mutex);
+}
+
+// ---- the hooks (see rt-safety.h)
+
+extern "C" {
+
+const char* aap_rtcheck_enter(const char* section) {
+    auto previous = current_section;
+    current_section = section;
+    return previous;
+}
+
+void aap_rtcheck_leave(const char* previousSection) {
+    current_section = previousSection;
+}
+
+void aap_rtcheck_end_session() {
+    if (in_checker)
+        return;
+    in_checker = true;
+    writeReport();
+    in_checker = false;
+}
+
+}
+
+__attribute__((constructor))
+static void initializeChecker() {
+    auto mode = getenv("AAP_RTCHECK_MODE");
+    abort_on_violation = mode && !strcmp(mode, "abort");
+    report_path = getenv("AAP_RTCHECK_REPORT");
+}
+
+__attribute__((destructor))
+static void finalizeChecker() {
+    current_section = nullptr;
+    aap_rtcheck_end_session();
+}
+
+// ---- interceptors
+
+// Resolves the next definition of the interposed function (i.e. the one in libc).
+#define AAP_RTCHECK_NEXT(name) \
+    static std::atomic<void*> next_##name{nullptr}; \
+    auto nextAddress = next_##name.load(std::memory_order_relaxed); \
+    if (!nextAddress) { \
+        nextAddress = dlsym(RTLD_NEXT, #name); \
+        next_##name.store(nextAddress, std::memory_order_relaxed); \
+    } \
+    auto next = (decltype(&::name)) nextAddress;
+
+#if defined(__GLIBC__)
+// glibc dlsym() calls calloc(), so the malloc family must not be resolved by dlsym().
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+#define AAP_RTCHECK_NEXT_MALLOC(name) auto next = __libc_##name;
+#else
+#define AAP_RTCHECK_NEXT_MALLOC(name) AAP_RTCHECK_NEXT(name)
+#endif
+
+extern "C" {
+
+void* malloc(size_t size) {
+    AAP_RTCHECK("malloc");
+    AAP_RTCHECK_NEXT_MALLOC(malloc)
+    return next(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    AAP_RTCHECK("calloc");
+    AAP_RTCHECK_NEXT_MALLOC(calloc)
+    return next(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    AAP_RTCHECK("realloc");
+    AAP_RTCHECK_NEXT_MALLOC(realloc)
+    return next(ptr, size);
+}
+
+void free(void* ptr) {
+    if (ptr)
+        AAP_RTCHECK("free");
+    AAP_RTCHECK_NEXT_MALLOC(free)
+    next(ptr);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    AAP_RTCHECK("memalign");
+    AAP_RTCHECK_NEXT_MALLOC(memalign)
+    return next(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    AAP_RTCHECK("posix_memalign");
+    AAP_RTCHECK_NEXT(posix_memalign)
+    return next(ptr, alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    AAP_RTCHECK("aligned_alloc");
+    AAP_RTCHECK_NEXT(aligned_alloc)
+    return next(alignment, size);
+}
+
+void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    AAP_RTCHECK("mmap");
+    AAP_RTCHECK_NEXT(mmap)
+    return next(addr, length, prot, flags, fd, offset);
+}
+
+int munmap(void* addr, size_t length) {
+    AAP_RTCHECK("munmap");
+    AAP_RTCHECK_NEXT(munmap)
+    return next(addr, length);
+}
+
+// locks and waits. pthread_mutex_trylock() is fine.
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    AAP_RTCHECK("pthread_mutex_lock");
+    AAP_RTCHECK_NEXT(pthread_mutex_lock)
+    return next(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* rwlock) {
+    AAP_RTCHECK("pthread_rwlock_rdlock");
+    AAP_RTCHECK_NEXT(pthread_rwlock_rdlock)
+    return next(rwlock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* rwlock) {
+    AAP_RTCHECK("pthread_rwlock_wrlock");
+    AAP_RTCHECK_NEXT(pthread_rwlock_wrlock)
+    return next(rwlock);
+}
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+    AAP_RTCHECK("pthread_cond_wait");
+    AAP_RTCHECK_NEXT(pthread_cond_wait)
+    return next(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime) {
+    AAP_RTCHECK("pthread_cond_timedwait");
+    AAP_RTCHECK_NEXT(pthread_cond_timedwait)
+    return next(cond, mutex, abstime);
+}
+
+int pthread_join(pthread_t thread, void** result) {
+    AAP_RTCHECK("pthread_join");
+    AAP_RTCHECK_NEXT(pthread_join)
+    return next(thread, result);
+}
+
+int sem_wait(sem_t* sem) {
+    AAP_RTCHECK("sem_wait");
+    AAP_RTCHECK_NEXT(sem_wait)
+    return next(sem);
+}
+
+#if defined(__linux__)
+// Only the futex operations that wait are violations; waking and FUTEX_UNLOCK_PI do not block.
+static bool isFutexWait(long op) {
+    switch (op & FUTEX_CMD_MASK) {
+    case FUTEX_WAIT:
+    case FUTEX_WAIT_BITSET:
+    case FUTEX_LOCK_PI:
+    case FUTEX_WAIT_REQUEUE_PI:
+#ifdef FUTEX_LOCK_PI2
+    case FUTEX_LOCK_PI2:
+#endif
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The arguments are passed through as 6 longs, as libc syscall() itself takes them.
+long syscall(long number, ...) {
+    va_list args;
+    va_start(args, number);
+    long a[6];
+    for (auto& arg : a)
+        arg = va_arg(args, long);
+    va_end(args);
+    if (number == SYS_futex && isFutexWait(a[1]))
+        AAP_RTCHECK("futex");
+    AAP_RTCHECK_NEXT(syscall)
+    return next(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+#endif
+
+// sleeps
+
+unsigned int sleep(unsigned int seconds) {
+    AAP_RTCHECK("sleep");
+    AAP_RTCHECK_NEXT(sleep)
+    return next(seconds);
+}
+
+int usleep(useconds_t usec) {
+    AAP_RTCHECK("usleep");
+    AAP_RTCHECK_NEXT(usleep)
+    return next(usec);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+    AAP_RTCHECK("nanosleep");
+    AAP_RTCHECK_NEXT(nanosleep)
+    return next(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* request, struct timespec* remaining) {
+    AAP_RTCHECK("clock_nanosleep");
+    AAP_RTCHECK_NEXT(clock_nanosleep)
+    return next(clock, flags, request, remaining);
+}
+
+// file I/O
+
+int open(const char* path, int flags, ...) {
+    AAP_RTCHECK("open");
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t) va_arg(args, int);
+        va_end(args);
+    }
+    AAP_RTCHECK_NEXT(open)
+    return next(path, flags, mode);
+}
+
+int close(int fd) {
+    AAP_RTCHECK("close");
+    AAP_RTCHECK_NEXT(close)
+    return next(fd);
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+    AAP_RTCHECK("read");
+    AAP_RTCHECK_NEXT(read)
+    return next(fd, buf, count);
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+    AAP_RTCHECK("write");
+    AAP_RTCHECK_NEXT(write)
+    return next(fd, buf, count);
+}
+
+int fsync(int fd) {
+    AAP_RTCHECK("fsync");
+    AAP_RTCHECK_NEXT(fsync)
+    return next(fd);
+}
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+    AAP_RTCHECK("poll");
+    AAP_RTCHECK_NEXT(poll)
+    return next(fds, nfds, timeout);
+}
+
+int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout) {
+    AAP_RTCHECK("select");
+    AAP_RTCHECK_NEXT(select)
+    return next(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+// stdio and logging
+
+FILE* fopen(const char* path, const char* mode) {
+    AAP_RTCHECK("fopen");
+    AAP_RTCHECK_NEXT(fopen)
+    return next(path, mode);
+}
+
+size_t fwrite(const void* ptr, size_t size, size_t count, FILE* stream) {
+    AAP_RTCHECK("fwrite");
+    AAP_RTCHECK_NEXT(fwrite)
+    return next(ptr, size, count, stream);
+}
+
+int fflush(FILE* stream) {
+    AAP_RTCHECK("fflush");
+    AAP_RTCHECK_NEXT(fflush)
+    return next(stream);
+}
+
+int puts(const char* s) {
+    AAP_RTCHECK("puts");
+    AAP_RTCHECK_NEXT(puts)
+    return next(s);
+}
+
+int fputs(const char* s, FILE* stream) {
+    AAP_RTCHECK("fputs");
+    AAP_RTCHECK_NEXT(fputs)
+    return next(s, stream);
+}
+
+int vprintf(const char* format, va_list args) {
+    AAP_RTCHECK("vprintf");
+    AAP_RTCHECK_NEXT(vprintf)
+    return next(format, args);
+}
+
+int vfprintf(FILE* stream, const char* format, va_list args) {
+    AAP_RTCHECK("vfprintf");
+    AAP_RTCHECK_NEXT(vfprintf)
+    return next(stream, format, args);
+}
+
+int printf(const char* format, ...) {
+    AAP_RTCHECK("printf");
+    AAP_RTCHECK_NEXT(vprintf)
+    va_list args;
+    va_start(args, format);
+    auto ret = next(format, args);
+    va_end(args);
+    return ret;
+}
+
+int fprintf(FILE* stream, const char* format, ...) {
+    AAP_RTCHECK("fprintf");
+    AAP_RTCHECK_NEXT(vfprintf)
+    va_list args;
+    va_start(args, format);
+    auto ret = next(stream, format, args);
+    va_end(args);
+    return ret;
+}
+
+#if ANDROID
+int __android_log_write(int priority, const char* tag, const char* text) {
+    AAP_RTCHECK("__android_log_write");
+    AAP_RTCHECK_NEXT(__android_log_write)
+    return next(priority, tag, text);
+}
+
+int __android_log_vprint(int priority, const char* tag, const char* format, va_list args) {
+    AAP_RTCHECK("__android_log_vprint");
+    AAP_RTCHECK_NEXT(__android_log_vprint)
+    return next(priority, tag, format, args);
+}
+
+int __android_log_print(int priority, const char* tag, const char* format, ...) {
+    AAP_RTCHECK("__android_log_print");
+    AAP_RTCHECK_NEXT(__android_log_vprint)
+    va_list args;
+    va_start(args, format);
+    auto ret = next(priority, tag, format, args);
+    va_end(args);
+    return ret;
+}
+#endif
+
+} // extern "C"
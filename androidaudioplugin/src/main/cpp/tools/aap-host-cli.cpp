@@ -0,0 +1,462 @@
+// A headless host that runs a plugin for profiling and qualification (desktop only).
+//
+// Usage: aap-host-cli [--plugin-path dir-or-aap_metadata.xml]... [--list] [--sample-rate 48000] [--block-size 256]
+//                     [--seconds 10] [--audio sine|noise|impulse|silence] [--midi none|notes|params|aapxs|all]
+//                     [--output out.wav] [--strict] [plugin-id-or-name]
+//
+// The plugins are looked up in the `--plugin-path`s, or AAP_PLUGIN_PATH if none is given. A plugin path is a
+// directory that contains aap_metadata.xml (in subdirectories too), or the metadata file itself. A relative
+// `library` in the metadata is resolved against the metadata directory.
+//
+// It processes the generated input for the duration as fast as possible (not in realtime) on the main thread,
+// then reports the process() time percentiles against the block duration, the heap allocations that process()
+// made on the main thread and the MIDI2/AAPXS traffic. With `--strict`, it exits with 1 if process() allocated
+// or missed a deadline.
+//
+// To find out where process() allocates or blocks, run it with the realtime-safety checker:
+// `LD_PRELOAD=libaaprtcheck.so aap-host-cli ...` (see aap/unstable/rt-safety.h).
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <aap/core/aap_midi2_helper.h>
+#include <aap/core/aapxs/parameters-aapxs.h>
+#include <aap/core/host/plugin-client-system.h>
+#include <aap/core/host/plugin-host.h>
+#include <aap/core/host/plugin-instance.h>
+#include <aap/ext/midi.h>
+#include <aap/ext/parameters.h>
+#include "../core/include_cmidi2.h"
+#include "../benchmarks/allocation-counter.h"
+
+#define AAP_HOST_CLI_DEFAULT_SAMPLE_RATE 48000
+#define AAP_HOST_CLI_DEFAULT_BLOCK_SIZE 256
+#define AAP_HOST_CLI_DEFAULT_SECONDS 10
+// MIDI 2.0 JR Timestamp resolution (1/31250 sec.)
+#define AAP_HOST_CLI_JR_TICKS_PER_SECOND 31250
+// notes: a note on every this period, and its note off in the half of it.
+#define AAP_HOST_CLI_NOTE_INTERVAL_MS 500
+// aapxs: a parameters extension request every this period.
+#define AAP_HOST_CLI_AAPXS_INTERVAL_MS 100
+
+using namespace aap::benchmark;
+
+enum AudioInputKind { AUDIO_SINE, AUDIO_NOISE, AUDIO_IMPULSE, AUDIO_SILENCE };
+
+enum MidiInputFlags {
+    MIDI_NOTES = 1,
+    MIDI_PARAMS = 2,
+    MIDI_AAPXS = 4,
+};
+
+struct HostOptions {
+    std::vector<std::string> pluginPaths{};
+    std::string plugin{};
+    bool list{false};
+    int32_t sampleRate{AAP_HOST_CLI_DEFAULT_SAMPLE_RATE};
+    int32_t blockSize{AAP_HOST_CLI_DEFAULT_BLOCK_SIZE};
+    double seconds{AAP_HOST_CLI_DEFAULT_SECONDS};
+    AudioInputKind audio{AUDIO_SINE};
+    int32_t midi{MIDI_NOTES};
+    const char* outputPath{nullptr};
+    bool strict{false};
+};
+
+static int64_t getMonotonicNanoseconds() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ---- plugin lookup
+
+static const aap::PluginInformation* findPlugin(const std::vector<aap::PluginInformation*>& plugins, const std::string& query) {
+    if (query.empty())
+        return plugins.size() == 1 ? plugins[0] : nullptr;
+    for (auto p : plugins)
+        if (p->getPluginID() == query)
+            return p;
+    const aap::PluginInformation* ret{nullptr};
+    for (auto p : plugins) {
+        if (p->getDisplayName().find(query) == std::string::npos)
+            continue;
+        if (ret)
+            return nullptr; // ambiguous
+        ret = p;
+    }
+    return ret;
+}
+
+static void listPlugins(const std::vector<aap::PluginInformation*>& plugins) {
+    for (auto p : plugins)
+        printf("%s\n    name: %s, category: %s, library: %s\n    metadata: %s\n", p->getPluginID().c_str(),
+               p->getDisplayName().c_str(), p->getPrimaryCategory().c_str(),
+               p->getLocalPluginSharedLibrary().c_str(), p->getMetadataFullPath().c_str());
+}
+
+// ---- input generators
+
+class InputGenerator {
+    const HostOptions& options;
+    aap::LocalPluginInstance* instance;
+    uint32_t noise_state{0x12345678};
+    int64_t note_interval;
+    int64_t aapxs_interval;
+    uint32_t aapxs_request_id{0};
+    std::vector<uint8_t> conversion_helper;
+
+    struct MidiWriter {
+        AAPMidiBufferHeader* header;
+        uint32_t capacity;
+        int32_t sampleRate;
+        int32_t lastFrame{0};
+
+        // the JR ticks from the beginning of the block to the frame offset.
+        int64_t ticksAt(int32_t frameOffset) const {
+            return (int64_t) frameOffset * AAP_HOST_CLI_JR_TICKS_PER_SECOND / sampleRate;
+        }
+
+        // writes a JR timestamp for the frame offset (if it moved) and then the UMP. Returns false if it does not fit.
+        // The delta is taken between the absolute tick positions, so that the rounding errors do not accumulate.
+        bool add(int32_t frameOffset, const void* ump, uint32_t size) {
+            auto ticks = (uint32_t) (ticksAt(frameOffset) - ticksAt(lastFrame));
+            if (header->length + (ticks > 0 ? 4 : 0) + size > capacity)
+                return false;
+            auto dst = (uint8_t*) (header + 1) + header->length;
+            if (ticks > 0) {
+                *(uint32_t*) dst = cmidi2_ump_jr_timestamp_direct(0, ticks);
+                dst += 4;
+                header->length += 4;
+            }
+            memcpy(dst, ump, size);
+            header->length += size;
+            lastFrame = frameOffset;
+            return true;
+        }
+    };
+
+    void generateAudio(float* samples, int32_t numFrames, int64_t position, int32_t channel) {
+        for (int32_t i = 0; i < numFrames; i++) {
+            auto frame = position + i;
+            switch (options.audio) {
+                case AUDIO_SINE:
+                    samples[i] = 0.5f * (float) sin(2 * M_PI * (440.0 + channel * 110.0) * frame / options.sampleRate);
+                    break;
+                case AUDIO_NOISE:
+                    noise_state = noise_state * 1664525 + 1013904223;
+                    samples[i] = 0.5f * ((float) (noise_state >> 8) / (float) (1 << 24) * 2 - 1);
+                    break;
+                case AUDIO_IMPULSE:
+                    samples[i] = frame % options.sampleRate == 0 ? 1.0f : 0.0f;
+                    break;
+                case AUDIO_SILENCE:
+                    samples[i] = 0;
+                    break;
+            }
+        }
+    }
+
+    void generateMidi(AAPMidiBufferHeader* header, uint32_t capacity, int32_t numFrames, int64_t position) {
+        MidiWriter writer{header, capacity, options.sampleRate};
+        header->length = 0;
+        for (int32_t i = 0; i < numFrames; i++) {
+            auto frame = position + i;
+            if (options.midi & MIDI_NOTES && frame % (note_interval / 2) == 0) {
+                static const uint8_t scale[] {60, 62, 64, 65, 67, 69, 71, 72};
+                auto n = frame / note_interval;
+                auto key = scale[n % sizeof(scale)];
+                bool on = frame % note_interval == 0;
+                auto ump = on ? cmidi2_ump_midi2_note_on(0, 0, key, 0, 0xC000, 0) : cmidi2_ump_midi2_note_off(0, 0, key, 0, 0, 0);
+                uint32_t words[2];
+                cmidi2_ump_write64((cmidi2_ump*) words, ump);
+                writer.add(i, words, sizeof(words));
+            }
+            if (options.midi & MIDI_AAPXS && frame % aapxs_interval == 0) {
+                uint32_t ump[AAP_MIDI2_AAPXS_DATA_MAX_SIZE / sizeof(uint32_t)];
+                int32_t data = 0;
+                auto size = aap_midi2_generate_aapxs_sysex8(ump, sizeof(ump) / sizeof(uint32_t),
+                                                            conversion_helper.data(), conversion_helper.size(),
+                                                            0, aapxs_request_id++, 0, AAP_PARAMETERS_EXTENSION_URI,
+                                                            OPCODE_PARAMETERS_GET_PARAMETER_COUNT, (uint8_t*) &data, sizeof(data));
+                writer.add(i, ump, (uint32_t) size);
+            }
+        }
+        // one parameter change per block, sweeping over the declared parameters.
+        auto numParameters = instance->getNumParameters();
+        if (options.midi & MIDI_PARAMS && numParameters > 0) {
+            auto block = position / options.blockSize;
+            auto para = instance->getParameter((int32_t) (block % numParameters));
+            auto phase = 0.5 + 0.5 * sin(2 * M_PI * position / options.sampleRate);
+            auto value = (float) (para->getMinimumValue() + (para->getMaximumValue() - para->getMinimumValue()) * phase);
+            uint32_t ump[4];
+            aapMidi2ParameterSysex8(ump, ump + 1, ump + 2, ump + 3, 0, 0, 0, 0, (uint16_t) para->getId(), value);
+            writer.add(numFrames - 1, ump, sizeof(ump));
+        }
+    }
+
+public:
+    InputGenerator(const HostOptions& hostOptions, aap::LocalPluginInstance* pluginInstance)
+            : options(hostOptions), instance(pluginInstance),
+              note_interval((int64_t) options.sampleRate * AAP_HOST_CLI_NOTE_INTERVAL_MS / 1000),
+              aapxs_interval((int64_t) options.sampleRate * AAP_HOST_CLI_AAPXS_INTERVAL_MS / 1000),
+              conversion_helper(AAP_MIDI2_AAPXS_DATA_MAX_SIZE) {
+    }
+
+    // Fills the input ports for the block at `position`, and resets the MIDI output ports.
+    void fillBlock(int32_t numFrames, int64_t position) {
+        auto buffer = instance->getAudioPluginBuffer();
+        int32_t audioChannel = 0;
+        for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+            auto port = instance->getPort(i);
+            auto data = buffer->get_buffer(*buffer, i);
+            if (port->getContentType() == AAP_CONTENT_TYPE_AUDIO && port->getPortDirection() == AAP_PORT_DIRECTION_INPUT)
+                generateAudio((float*) data, numFrames, position, audioChannel++);
+            else if (port->getContentType() == AAP_CONTENT_TYPE_MIDI2) {
+                if (port->getPortDirection() == AAP_PORT_DIRECTION_INPUT)
+                    generateMidi((AAPMidiBufferHeader*) data, buffer->get_buffer_size(*buffer, i) - sizeof(AAPMidiBufferHeader),
+                                 numFrames, position);
+                else
+                    ((AAPMidiBufferHeader*) data)->length = 0;
+            }
+        }
+    }
+};
+
+// ---- output
+
+// Writes the audio outputs in 32-bit float WAV. The sizes in the header are written at close().
+class WavOutput {
+    FILE* file{nullptr};
+    int32_t channels{0};
+    uint32_t dataBytes{0};
+    int32_t sample_rate{0};
+    std::vector<float> interleaved{};
+
+    void writeHeader() {
+        auto write32 = [&](uint32_t v) { fwrite(&v, 4, 1, file); };
+        auto write16 = [&](uint16_t v) { fwrite(&v, 2, 1, file); };
+        fwrite("RIFF", 4, 1, file);
+        write32(36 + dataBytes);
+        fwrite("WAVEfmt ", 8, 1, file);
+        write32(16);
+        write16(3); // WAVE_FORMAT_IEEE_FLOAT
+        write16((uint16_t) channels);
+        write32((uint32_t) sample_rate);
+        write32((uint32_t) (sample_rate * channels * sizeof(float)));
+        write16((uint16_t) (channels * sizeof(float)));
+        write16(32);
+        fwrite("data", 4, 1, file);
+        write32(dataBytes);
+    }
+
+public:
+    bool open(const char* path, int32_t numChannels, int32_t sampleRate, int32_t blockSize) {
+        file = fopen(path, "wb");
+        if (!file)
+            return false;
+        channels = numChannels;
+        sample_rate = sampleRate;
+        interleaved.resize((size_t) numChannels * blockSize);
+        writeHeader();
+        return true;
+    }
+
+    void write(aap::PluginInstance* instance, int32_t numFrames) {
+        if (!file)
+            return;
+        auto buffer = instance->getAudioPluginBuffer();
+        int32_t ch = 0;
+        for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+            auto port = instance->getPort(i);
+            if (port->getContentType() != AAP_CONTENT_TYPE_AUDIO || port->getPortDirection() != AAP_PORT_DIRECTION_OUTPUT)
+                continue;
+            auto samples = (float*) buffer->get_buffer(*buffer, i);
+            for (int32_t f = 0; f < numFrames; f++)
+                interleaved[(size_t) f * channels + ch] = samples[f];
+            ch++;
+        }
+        fwrite(interleaved.data(), sizeof(float), (size_t) numFrames * channels, file);
+        dataBytes += (uint32_t) (numFrames * channels * sizeof(float));
+    }
+
+    void close() {
+        if (!file)
+            return;
+        fseek(file, 0, SEEK_SET);
+        writeHeader();
+        fclose(file);
+        file = nullptr;
+    }
+};
+
+// ---- profiling
+
+static int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    auto index = (size_t) std::ceil(p / 100 * sorted.size());
+    return sorted[std::min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+static int run(const HostOptions& options, const aap::PluginInformation* pluginInfo) {
+    aap::StandalonePluginService service{};
+    auto instance = service.instantiate(pluginInfo, options.sampleRate);
+    if (!instance) {
+        fprintf(stderr, "Could not instantiate %s (%s)\n", pluginInfo->getPluginID().c_str(),
+                pluginInfo->getLocalPluginSharedLibrary().c_str());
+        return 1;
+    }
+    auto error = service.setupInstance(instance, options.blockSize);
+    if (!error.empty()) {
+        fprintf(stderr, "Could not set up %s: %s\n", pluginInfo->getPluginID().c_str(), error.c_str());
+        return 1;
+    }
+
+    int32_t numAudioIn = 0, numAudioOut = 0, numMidiIn = 0, numMidiOut = 0;
+    for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+        auto port = instance->getPort(i);
+        bool input = port->getPortDirection() == AAP_PORT_DIRECTION_INPUT;
+        if (port->getContentType() == AAP_CONTENT_TYPE_AUDIO)
+            (input ? numAudioIn : numAudioOut)++;
+        else if (port->getContentType() == AAP_CONTENT_TYPE_MIDI2)
+            (input ? numMidiIn : numMidiOut)++;
+    }
+    printf("plugin:       %s (%s)\n", pluginInfo->getDisplayName().c_str(), pluginInfo->getPluginID().c_str());
+    printf("ports:        audio %d in / %d out, midi2 %d in / %d out, %d parameters\n",
+           numAudioIn, numAudioOut, numMidiIn, numMidiOut, instance->getNumParameters());
+
+    WavOutput output{};
+    if (options.outputPath && !output.open(options.outputPath, numAudioOut, options.sampleRate, options.blockSize)) {
+        fprintf(stderr, "Could not write to %s\n", options.outputPath);
+        return 1;
+    }
+
+    InputGenerator generator{options, instance};
+    auto numBlocks = (int64_t) std::ceil(options.seconds * options.sampleRate / options.blockSize);
+    std::vector<int64_t> processTimes((size_t) numBlocks);
+    int64_t totalAllocations = 0, totalAllocatedBytes = 0, allocatingBlocks = 0;
+
+    for (int64_t block = 0; block < numBlocks; block++) {
+        generator.fillBlock(options.blockSize, block * options.blockSize);
+
+        // only this thread is counted; the other threads (e.g. the plugin's own workers) may allocate meanwhile.
+        auto allocations = getThreadAllocationCount();
+        auto bytes = getThreadAllocatedBytes();
+        auto begin = getMonotonicNanoseconds();
+        instance->process(options.blockSize, 0);
+        processTimes[(size_t) block] = getMonotonicNanoseconds() - begin;
+        allocations = getThreadAllocationCount() - allocations;
+        if (allocations > 0) {
+            allocatingBlocks++;
+            totalAllocations += allocations;
+            totalAllocatedBytes += getThreadAllocatedBytes() - bytes;
+        }
+
+        output.write(instance, options.blockSize);
+    }
+    output.close();
+
+    aap::PluginInstanceStatisticsSnapshot stats{};
+    instance->getStatistics().getSnapshot(stats);
+
+    auto sorted = processTimes;
+    std::sort(sorted.begin(), sorted.end());
+    auto budget = (int64_t) options.blockSize * 1000000000 / options.sampleRate;
+    auto overruns = std::count_if(sorted.begin(), sorted.end(), [budget](int64_t t) { return t > budget; });
+    int64_t total = 0;
+    for (auto t : sorted)
+        total += t;
+    auto us = [](int64_t ns) { return ns / 1000.0; };
+
+    printf("setup:        %d Hz, %d frames/block, %lld blocks (%.2f s)\n", options.sampleRate, options.blockSize,
+           (long long) numBlocks, (double) numBlocks * options.blockSize / options.sampleRate);
+    printf("budget:       %.1f us/block\n", us(budget));
+    printf("process time: min %.1f / p50 %.1f / p90 %.1f / p99 %.1f / p99.9 %.1f / max %.1f us\n",
+           us(sorted.front()), us(percentile(sorted, 50)), us(percentile(sorted, 90)), us(percentile(sorted, 99)),
+           us(percentile(sorted, 99.9)), us(sorted.back()));
+    printf("load:         %.2f%% average, %.2f%% at p99\n",
+           100.0 * total / numBlocks / budget, 100.0 * percentile(sorted, 99) / budget);
+    printf("deadline:     %lld block(s) over the budget\n", (long long) overruns);
+    printf("allocations:  %lld in %lld block(s), %lld bytes\n", (long long) totalAllocations,
+           (long long) allocatingBlocks, (long long) totalAllocatedBytes);
+    printf("midi2:        %llu events in, %llu events out\n",
+           (unsigned long long) stats.ump_input_events, (unsigned long long) stats.ump_output_events);
+    printf("aapxs:        %llu messages (%llu bytes) in, %llu messages (%llu bytes) out\n",
+           (unsigned long long) stats.aapxs_incoming_messages, (unsigned long long) stats.aapxs_incoming_bytes,
+           (unsigned long long) stats.aapxs_outgoing_messages, (unsigned long long) stats.aapxs_outgoing_bytes);
+    if (options.outputPath)
+        printf("output:       %s (%d channels)\n", options.outputPath, numAudioOut);
+
+    if (options.strict && (overruns > 0 || totalAllocations > 0)) {
+        printf("FAILED: %s\n", totalAllocations > 0 ? "process() allocates memory" : "process() missed the deadline");
+        return 1;
+    }
+    return 0;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [--plugin-path dir-or-aap_metadata.xml]... [--list] [--sample-rate %d] [--block-size %d] "
+                    "[--seconds %d] [--audio sine|noise|impulse|silence] [--midi none|notes|params|aapxs|all] "
+                    "[--output out.wav] [--strict] [plugin-id-or-name]\n",
+            name, AAP_HOST_CLI_DEFAULT_SAMPLE_RATE, AAP_HOST_CLI_DEFAULT_BLOCK_SIZE, AAP_HOST_CLI_DEFAULT_SECONDS);
+}
+
+int main(int argc, char** argv) {
+    HostOptions options{};
+    for (int i = 1; i < argc; i++) {
+        std::string arg{argv[i]};
+        bool hasValue = i + 1 < argc;
+        if (arg == "--plugin-path" && hasValue)
+            options.pluginPaths.emplace_back(argv[++i]);
+        else if (arg == "--list")
+            options.list = true;
+        else if (arg == "--sample-rate" && hasValue)
+            options.sampleRate = atoi(argv[++i]);
+        else if (arg == "--block-size" && hasValue)
+            options.blockSize = atoi(argv[++i]);
+        else if (arg == "--seconds" && hasValue)
+            options.seconds = atof(argv[++i]);
+        else if (arg == "--audio" && hasValue) {
+            std::string v{argv[++i]};
+            options.audio = v == "noise" ? AUDIO_NOISE : v == "impulse" ? AUDIO_IMPULSE : v == "silence" ? AUDIO_SILENCE : AUDIO_SINE;
+        }
+        else if (arg == "--midi" && hasValue) {
+            std::string v{argv[++i]};
+            options.midi = v == "none" ? 0 : v == "params" ? MIDI_PARAMS : v == "aapxs" ? MIDI_AAPXS :
+                           v == "all" ? MIDI_NOTES | MIDI_PARAMS | MIDI_AAPXS : MIDI_NOTES;
+        }
+        else if (arg == "--output" && hasValue)
+            options.outputPath = argv[++i];
+        else if (arg == "--strict")
+            options.strict = true;
+        else if (arg[0] != '-' && options.plugin.empty())
+            options.plugin = arg;
+        else {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+    if (options.sampleRate <= 0 || options.blockSize <= 0 || options.seconds <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    auto system = aap::PluginClientSystem::getInstance();
+    auto plugins = options.pluginPaths.empty() ? system->getInstalledPlugins(false) :
+                   system->getInstalledPlugins(false, &options.pluginPaths);
+    if (options.list) {
+        listPlugins(plugins);
+        return 0;
+    }
+    auto pluginInfo = findPlugin(plugins, options.plugin);
+    if (!pluginInfo) {
+        fprintf(stderr, plugins.empty() ? "No plugin was found.\n" :
+                        "Specify one of these plugins by ID or (a unique part of) the name:\n");
+        listPlugins(plugins);
+        return 2;
+    }
+    return run(options, pluginInfo);
+}
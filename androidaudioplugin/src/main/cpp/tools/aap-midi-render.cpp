@@ -0,0 +1,217 @@
+// Renders MIDI input through the MIDI device service processor (AAPMidiProcessor) without any audio device (desktop only).
+//
+// Usage: aap-midi-render [--plugin-path dir-or-aap_metadata.xml]... [--sample-rate 48000] [--block-size 1024]
+//                        [--frames-per-callback 256] [--realtime] [--midi in.mid] [--output out.wav]
+//                        [--check-determinism] plugin-id...
+//
+// The instrument plugins are looked up in the `--plugin-path`s, or AAP_PLUGIN_PATH if none is given. More than one
+// plugin makes a layered setup. Without `--midi`, it plays a built-in sequence of notes.
+//
+// It drives the processor by AAPMidiProcessorStub, as fast as possible unless `--realtime` is given, then reports
+// the throughput and the MIDI-to-audio latency. It exits with 1 if nothing could be rendered.
+//
+// `--check-determinism` (freewheeling only) renders the same input once more into a temporary file next to `--output`,
+// and exits with 1 if the two outputs differ.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <aap/core/host/plugin-connections.h>
+#include "AAPMidiProcessor_stub.h"
+
+#define AAP_MIDI_RENDER_DEFAULT_SAMPLE_RATE 48000
+#define AAP_MIDI_RENDER_DEFAULT_BLOCK_SIZE 1024
+#define AAP_MIDI_RENDER_DEFAULT_FRAMES_PER_CALLBACK 256
+#define AAP_MIDI_RENDER_MIDI_BUFFER_SIZE 4096
+#define AAP_MIDI_RENDER_NUM_CHANNELS 2
+#define AAP_MIDI_RENDER_WAV_HEADER_SIZE 44
+// the built-in sequence: a note on every this period, and its note off in the half of it.
+#define AAP_MIDI_RENDER_NOTE_INTERVAL_MS 250
+#define AAP_MIDI_RENDER_NUM_NOTES 8
+
+struct RenderOptions {
+    std::vector<std::string> pluginPaths{};
+    std::vector<std::string> plugins{};
+    int32_t sampleRate{AAP_MIDI_RENDER_DEFAULT_SAMPLE_RATE};
+    int32_t blockSize{AAP_MIDI_RENDER_DEFAULT_BLOCK_SIZE};
+    int32_t framesPerCallback{AAP_MIDI_RENDER_DEFAULT_FRAMES_PER_CALLBACK};
+    bool realtime{false};
+    const char* midiPath{nullptr};
+    const char* outputPath{nullptr};
+    bool checkDeterminism{false};
+};
+
+static void createNoteSequence(std::vector<aap::midi::StubMidiEvent>& events, std::vector<uint8_t>& bytes) {
+    const int64_t interval = AAP_MIDI_RENDER_NOTE_INTERVAL_MS * 1000000LL;
+    for (int32_t i = 0; i < AAP_MIDI_RENDER_NUM_NOTES; i++) {
+        auto key = (uint8_t) (60 + i);
+        events.emplace_back(aap::midi::StubMidiEvent{i * interval, (uint32_t) bytes.size(), 3});
+        bytes.insert(bytes.end(), {0x90, key, 100});
+        events.emplace_back(aap::midi::StubMidiEvent{i * interval + interval / 2, (uint32_t) bytes.size(), 3});
+        bytes.insert(bytes.end(), {0x80, key, 0});
+    }
+}
+
+static int run(const RenderOptions& options, const char* outputPath) {
+    aap::PluginClientConnectionList connections{};
+    aap::midi::AAPMidiProcessorStub processor{};
+    auto pal = processor.getStubPAL();
+    pal->setFramesPerCallback(options.framesPerCallback);
+    pal->setFreewheel(!options.realtime);
+    if (outputPath)
+        pal->setOutputWavFile(outputPath);
+    if (options.midiPath) {
+        if (!pal->loadMidiInputFile(options.midiPath)) {
+            fprintf(stderr, "Could not load %s\n", options.midiPath);
+            return 1;
+        }
+    } else {
+        std::vector<aap::midi::StubMidiEvent> events{};
+        std::vector<uint8_t> bytes{};
+        createNoteSequence(events, bytes);
+        pal->setMidiInputEvents(std::move(events), std::move(bytes));
+    }
+
+    processor.initialize(&connections, options.sampleRate, AAP_MIDI_RENDER_NUM_CHANNELS, options.blockSize,
+                         AAP_MIDI_RENDER_MIDI_BUFFER_SIZE, 1);
+    for (auto& plugin : options.plugins) {
+        processor.instantiatePlugin(plugin);
+        if (processor.getState() == aap::midi::AAP_MIDI_PROCESSOR_STATE_ERROR) {
+            fprintf(stderr, "Could not instantiate %s\n", plugin.c_str());
+            processor.terminate();
+            return 1;
+        }
+    }
+    processor.activate();
+    if (processor.getState() != aap::midi::AAP_MIDI_PROCESSOR_STATE_ACTIVE) {
+        fprintf(stderr, "Could not activate the processor\n");
+        processor.terminate();
+        return 1;
+    }
+    pal->waitForCompletion();
+    processor.deactivate();
+
+    auto s = pal->getStatistics();
+    aap::midi::AdaptiveBlockSizeStatistics blockSize{};
+    processor.getBlockSizeController().getStatistics(blockSize);
+    auto workerTimeouts = processor.getWorkerTimeoutCount();
+    auto slicedCallbacks = processor.getSlicedCallbackCount();
+    processor.terminate();
+
+    printf("instruments:  %zu, %llu worker timeout(s)\n", options.plugins.size(), (unsigned long long) workerTimeouts);
+    printf("rendered:     %lld frames in %.3f s (%.1fx realtime)\n", (long long) s.frames_rendered,
+           s.elapsed_nanoseconds / 1000000000.0,
+           s.elapsed_nanoseconds > 0 ? s.frames_rendered * 1000000000.0 / options.sampleRate / s.elapsed_nanoseconds : 0.0);
+    printf("callbacks:    %lld, %.1f us average, %.1f us worst, %llu sliced\n", (long long) s.num_callbacks,
+           s.num_callbacks > 0 ? s.total_callback_nanoseconds / 1000.0 / s.num_callbacks : 0.0,
+           s.worst_callback_nanoseconds / 1000.0, (unsigned long long) slicedCallbacks);
+    printf("block size:   %d (%d - %d), %d adaptation(s), %llu overrun(s)\n", blockSize.block_size,
+           blockSize.min_block_size, blockSize.max_block_size, blockSize.num_adaptations,
+           (unsigned long long) blockSize.num_overruns);
+    printf("midi events:  %lld dispatched, %lld skipped\n", (long long) s.midi_events_dispatched,
+           (long long) s.midi_events_skipped);
+    printf("latency:      %d measurement(s), min %lld / avg %.1f / max %lld frames\n", s.num_latency_measurements,
+           (long long) s.min_latency_frames, s.average_latency_frames, (long long) s.max_latency_frames);
+    if (outputPath)
+        printf("output:       %s\n", outputPath);
+
+    return s.frames_rendered > 0 ? 0 : 1;
+}
+
+// Returns the first frame that differs between the two WAV files that the stub wrote, -1 if they are identical.
+static int64_t compareWavFiles(const char* path1, const char* path2, int32_t numChannels) {
+    FILE* f1 = fopen(path1, "rb");
+    FILE* f2 = fopen(path2, "rb");
+    int64_t diffBytes = f1 && f2 ? -1 : 0;
+    std::vector<uint8_t> b1(4096), b2(4096);
+    for (int64_t position = 0; diffBytes < 0;) {
+        auto n1 = fread(b1.data(), 1, b1.size(), f1);
+        auto n2 = fread(b2.data(), 1, b2.size(), f2);
+        if (n1 != n2 || memcmp(b1.data(), b2.data(), n1) != 0) {
+            size_t i = 0;
+            while (i < std::min(n1, n2) && b1[i] == b2[i])
+                i++;
+            diffBytes = position + (int64_t) i;
+        }
+        if (n1 < b1.size())
+            break;
+        position += (int64_t) n1;
+    }
+    if (f1)
+        fclose(f1);
+    if (f2)
+        fclose(f2);
+    return diffBytes < 0 ? -1 : std::max((int64_t) 0, diffBytes - AAP_MIDI_RENDER_WAV_HEADER_SIZE) / (int64_t) (sizeof(float) * numChannels);
+}
+
+static int checkDeterminism(const RenderOptions& options) {
+    std::string checkPath = std::string{options.outputPath} + ".check.wav";
+    int result = run(options, checkPath.c_str());
+    if (result == 0) {
+        auto frame = compareWavFiles(options.outputPath, checkPath.c_str(), AAP_MIDI_RENDER_NUM_CHANNELS);
+        if (frame >= 0) {
+            fprintf(stderr, "The outputs differ at frame %lld: %s and %s\n", (long long) frame, options.outputPath, checkPath.c_str());
+            return 1;
+        }
+        printf("determinism:  the outputs are identical\n");
+    }
+    remove(checkPath.c_str());
+    return result;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [--plugin-path dir-or-aap_metadata.xml]... [--sample-rate %d] [--block-size %d] "
+                    "[--frames-per-callback %d] [--realtime] [--midi in.mid] [--output out.wav] [--check-determinism] plugin-id...\n",
+            name, AAP_MIDI_RENDER_DEFAULT_SAMPLE_RATE, AAP_MIDI_RENDER_DEFAULT_BLOCK_SIZE,
+            AAP_MIDI_RENDER_DEFAULT_FRAMES_PER_CALLBACK);
+}
+
+int main(int argc, char** argv) {
+    RenderOptions options{};
+    for (int i = 1; i < argc; i++) {
+        std::string arg{argv[i]};
+        bool hasValue = i + 1 < argc;
+        if (arg == "--plugin-path" && hasValue)
+            options.pluginPaths.emplace_back(argv[++i]);
+        else if (arg == "--sample-rate" && hasValue)
+            options.sampleRate = atoi(argv[++i]);
+        else if (arg == "--block-size" && hasValue)
+            options.blockSize = atoi(argv[++i]);
+        else if (arg == "--frames-per-callback" && hasValue)
+            options.framesPerCallback = atoi(argv[++i]);
+        else if (arg == "--realtime")
+            options.realtime = true;
+        else if (arg == "--midi" && hasValue)
+            options.midiPath = argv[++i];
+        else if (arg == "--output" && hasValue)
+            options.outputPath = argv[++i];
+        else if (arg == "--check-determinism")
+            options.checkDeterminism = true;
+        else if (arg[0] != '-')
+            options.plugins.emplace_back(arg);
+        else {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+    if (options.plugins.empty() || options.sampleRate <= 0 || options.blockSize <= 0 || options.framesPerCallback <= 0 ||
+        (options.checkDeterminism && (options.realtime || !options.outputPath))) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // The processor looks up the plugins by itself (PluginListSnapshot::queryServices()).
+    if (!options.pluginPaths.empty()) {
+        std::string paths{};
+        for (auto& p : options.pluginPaths)
+            paths += (paths.empty() ? "" : ":") + p;
+        setenv("AAP_PLUGIN_PATH", paths.c_str(), 1);
+    }
+    auto result = run(options, options.outputPath);
+    if (result == 0 && options.checkDeterminism)
+        result = checkDeterminism(options);
+    return result;
+}
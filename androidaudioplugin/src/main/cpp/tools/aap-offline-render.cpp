@@ -0,0 +1,107 @@
+// Renders audio and/or MIDI 2.0 input through a chain of plugins into a WAV file, without any audio device
+// (desktop only).
+//
+// Usage: aap-offline-render [--plugin-path dir-or-aap_metadata.xml]... [--sample-rate 48000] [--block-size 1024]
+//                           [--channels 2] [--input in.wav] [--midi2 in.midi2] [--tail-frames 0] [--frames 0]
+//                           [--realtime] --output out.wav plugin-id...
+//
+// The plugins are looked up in the `--plugin-path`s, or AAP_PLUGIN_PATH if none is given, and processed in the
+// order of the arguments. `--midi2` takes a MIDI 2.0 Clip File, which is sent to every plugin in the chain.
+// It renders as fast as possible (and tells the plugins so) unless `--realtime` is given. See OfflineRenderer.
+// It exits with 1 if the rendering failed.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <aap/core/host/plugin-client-system.h>
+#include "offline-renderer.h"
+
+struct RenderOptions {
+    std::vector<std::string> pluginPaths{};
+    std::vector<std::string> plugins{};
+    aap::OfflineRenderJob job{};
+};
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [--plugin-path dir-or-aap_metadata.xml]... [--sample-rate 48000] [--block-size 1024] "
+                    "[--channels 2] [--input in.wav] [--midi2 in.midi2] [--tail-frames 0] [--frames 0] [--realtime] "
+                    "--output out.wav plugin-id...\n", name);
+}
+
+static int run(RenderOptions& options) {
+    auto system = aap::PluginClientSystem::getInstance();
+    auto installed = options.pluginPaths.empty() ? system->getInstalledPlugins(false) :
+                     system->getInstalledPlugins(false, &options.pluginPaths);
+    for (auto& id : options.plugins) {
+        const aap::PluginInformation* pluginInfo{nullptr};
+        for (auto p : installed)
+            if (p->getPluginID() == id)
+                pluginInfo = p;
+        if (!pluginInfo) {
+            fprintf(stderr, "Plugin %s is not found. The plugins are:\n", id.c_str());
+            for (auto p : installed)
+                fprintf(stderr, "    %s (%s)\n", p->getPluginID().c_str(), p->getDisplayName().c_str());
+            return 2;
+        }
+        options.job.plugins.emplace_back(pluginInfo);
+    }
+
+    auto result = aap::OfflineRenderer::render(options.job);
+    if (!result.success) {
+        fprintf(stderr, "Rendering failed: %s\n", result.error.c_str());
+        return 1;
+    }
+
+    printf("rendered:     %lld frames at %d Hz in %.3f s (%.1fx realtime)\n", (long long) result.num_frames,
+           result.sample_rate, result.elapsed_nanoseconds / 1000000000.0, result.getRealtimeRatio());
+    for (size_t i = 0; i < result.statistics.size(); i++) {
+        auto& s = result.statistics[i];
+        printf("plugin %zu:     %s: %llu process() calls, %.1f us average, %.1f us worst, %llu deadline miss(es)\n",
+               i, options.plugins[i].c_str(), (unsigned long long) s.process_count,
+               s.process_count > 0 ? s.total_process_time_nanoseconds / 1000.0 / s.process_count : 0.0,
+               s.worst_process_time_nanoseconds / 1000.0, (unsigned long long) s.deadline_misses);
+    }
+    printf("output:       %s (%d channels)\n", options.job.output_path.c_str(), options.job.num_channels);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RenderOptions options{};
+    auto& job = options.job;
+    for (int i = 1; i < argc; i++) {
+        std::string arg{argv[i]};
+        bool hasValue = i + 1 < argc;
+        if (arg == "--plugin-path" && hasValue)
+            options.pluginPaths.emplace_back(argv[++i]);
+        else if (arg == "--sample-rate" && hasValue)
+            job.sample_rate = atoi(argv[++i]);
+        else if (arg == "--block-size" && hasValue)
+            job.block_size = atoi(argv[++i]);
+        else if (arg == "--channels" && hasValue)
+            job.num_channels = atoi(argv[++i]);
+        else if (arg == "--input" && hasValue)
+            job.input_audio_path = argv[++i];
+        else if (arg == "--midi2" && hasValue)
+            job.input_midi2_clip_path = argv[++i];
+        else if (arg == "--tail-frames" && hasValue)
+            job.tail_frames = atoll(argv[++i]);
+        else if (arg == "--frames" && hasValue)
+            job.num_frames = atoll(argv[++i]);
+        else if (arg == "--realtime")
+            job.freewheel = false;
+        else if (arg == "--output" && hasValue)
+            job.output_path = argv[++i];
+        else if (arg[0] != '-')
+            options.plugins.emplace_back(arg);
+        else {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+    if (job.output_path.empty() || job.sample_rate < 0 || job.block_size <= 0 || job.num_channels <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    return run(options);
+}
@@ -0,0 +1,384 @@
+#include "offline-renderer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <aap/core/host/plugin-host.h>
+#include <aap/core/host/plugin-instance.h>
+#include <aap/ext/midi.h>
+#include <aap/ext/render-mode.h>
+#include <aap/unstable/logging.h>
+#include "../core/include_cmidi2.h"
+#include "LocalDefinitions.h"
+#include "Midi2ClipFile.h"
+
+#define LOG_TAG "AAP.OfflineRenderer"
+#define AAP_OFFLINE_RENDERER_DEFAULT_SAMPLE_RATE 48000
+#define AAP_WAV_FORMAT_PCM 1
+#define AAP_WAV_FORMAT_IEEE_FLOAT 3
+#define AAP_WAV_FORMAT_EXTENSIBLE 0xFFFE
+// the RIFF chunk size (36 + data bytes) has to fit in 32 bits.
+#define AAP_WAV_MAX_DATA_BYTES (UINT32_MAX - 36)
+
+static inline uint16_t readLE16(const uint8_t* p) { return (uint16_t) (p[0] | (p[1] << 8)); }
+static inline uint32_t readLE32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24); }
+
+// Reads the frames of an uncompressed WAV file block by block, into planar float channels.
+class WavInput {
+    FILE* file{nullptr};
+    uint16_t format{0};
+    int32_t num_channels{0};
+    int32_t bytes_per_sample{0};
+    int32_t sample_rate{0};
+    int64_t num_frames{0};
+    int64_t position{0};
+    std::vector<uint8_t> block{};
+
+    float sampleToFloat(const uint8_t* p) {
+        switch (bytes_per_sample) {
+            case 1:
+                return (p[0] - 128) / 128.0f;
+            case 2:
+                return (int16_t) readLE16(p) / 32768.0f;
+            case 3:
+                return (((int32_t) ((uint32_t) p[0] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 24)) >> 8) / 8388608.0f;
+            case 4:
+                if (format == AAP_WAV_FORMAT_IEEE_FLOAT) {
+                    float f;
+                    memcpy(&f, p, sizeof(float));
+                    return f;
+                }
+                return (int32_t) readLE32(p) / 2147483648.0f;
+            case 8: {
+                double d;
+                memcpy(&d, p, sizeof(double));
+                return (float) d;
+            }
+            default:
+                return 0;
+        }
+    }
+
+public:
+    ~WavInput() {
+        if (file)
+            fclose(file);
+    }
+
+    int32_t getSampleRate() { return sample_rate; }
+    int64_t getNumFrames() { return num_frames; }
+
+    bool open(const char* path, int32_t maxFramesPerRead) {
+        file = fopen(path, "rb");
+        if (!file)
+            return false;
+        uint8_t riff[12];
+        if (fread(riff, 1, 12, file) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+            return false;
+        for (uint8_t chunk[8]; fread(chunk, 1, 8, file) == 8;) {
+            auto size = readLE32(chunk + 4);
+            if (memcmp(chunk, "fmt ", 4) == 0) {
+                uint8_t fmt[40]{};
+                if (size < 16 || fread(fmt, 1, std::min(size, (uint32_t) sizeof(fmt)), file) != std::min(size, (uint32_t) sizeof(fmt)))
+                    return false;
+                format = readLE16(fmt);
+                // the sub format GUID begins with the format tag.
+                if (format == AAP_WAV_FORMAT_EXTENSIBLE && size >= 26)
+                    format = readLE16(fmt + 24);
+                num_channels = readLE16(fmt + 2);
+                sample_rate = (int32_t) readLE32(fmt + 4);
+                bytes_per_sample = readLE16(fmt + 14) / 8;
+                fseek(file, (size > sizeof(fmt) ? size - sizeof(fmt) : 0) + (size & 1), SEEK_CUR);
+            } else if (memcmp(chunk, "data", 4) == 0) {
+                bool supported = num_channels > 0 && sample_rate > 0 &&
+                        ((format == AAP_WAV_FORMAT_PCM && bytes_per_sample >= 1 && bytes_per_sample <= 4) ||
+                         (format == AAP_WAV_FORMAT_IEEE_FLOAT && (bytes_per_sample == 4 || bytes_per_sample == 8)));
+                if (!supported)
+                    return false;
+                num_frames = size / (num_channels * bytes_per_sample);
+                block.resize((size_t) maxFramesPerRead * num_channels * bytes_per_sample);
+                return true;
+            } else
+                fseek(file, size + (size & 1), SEEK_CUR);
+        }
+        return false;
+    }
+
+    // Reads up to `numFrames` frames. A mono input is copied to all the channels; the channels that the
+    // input does not have are left as they are. Returns the number of frames read.
+    int32_t read(float* const* channels, int32_t numChannels, int32_t numFrames) {
+        auto bytesPerFrame = num_channels * bytes_per_sample;
+        auto size = (int32_t) std::min((int64_t) std::min(numFrames, (int32_t) (block.size() / bytesPerFrame)),
+                                       num_frames - position);
+        if (size <= 0)
+            return 0;
+        size = (int32_t) fread(block.data(), bytesPerFrame, size, file);
+        for (int32_t ch = 0; ch < numChannels; ch++) {
+            int32_t srcChannel = num_channels == 1 ? 0 : ch;
+            if (srcChannel >= num_channels)
+                continue;
+            auto in = block.data() + srcChannel * bytes_per_sample;
+            for (int32_t i = 0; i < size; i++)
+                channels[ch][i] = sampleToFloat(in + (size_t) i * bytesPerFrame);
+        }
+        position += size;
+        return size;
+    }
+};
+
+// Writes 32-bit float WAV. The sizes in the header are written at close().
+// It refuses to write beyond AAP_WAV_MAX_DATA_BYTES instead of wrapping the header sizes.
+class WavOutput {
+    FILE* file{nullptr};
+    int32_t channels{0};
+    uint64_t dataBytes{0};
+    int32_t sample_rate{0};
+    std::vector<float> interleaved{};
+
+    void writeHeader() {
+        auto write32 = [&](uint32_t v) { fwrite(&v, 4, 1, file); };
+        auto write16 = [&](uint16_t v) { fwrite(&v, 2, 1, file); };
+        fwrite("RIFF", 4, 1, file);
+        write32((uint32_t) (36 + dataBytes));
+        fwrite("WAVEfmt ", 8, 1, file);
+        write32(16);
+        write16(AAP_WAV_FORMAT_IEEE_FLOAT);
+        write16((uint16_t) channels);
+        write32((uint32_t) sample_rate);
+        write32((uint32_t) (sample_rate * channels * sizeof(float)));
+        write16((uint16_t) (channels * sizeof(float)));
+        write16(32);
+        fwrite("data", 4, 1, file);
+        write32((uint32_t) dataBytes);
+    }
+
+public:
+    ~WavOutput() { close(); }
+
+    bool open(const char* path, int32_t numChannels, int32_t sampleRate, int32_t blockSize) {
+        file = fopen(path, "wb");
+        if (!file)
+            return false;
+        channels = numChannels;
+        sample_rate = sampleRate;
+        interleaved.resize((size_t) numChannels * blockSize);
+        writeHeader();
+        return true;
+    }
+
+    bool write(const float* const* src, int32_t numFrames) {
+        auto bytes = (uint64_t) numFrames * channels * sizeof(float);
+        if (dataBytes + bytes > AAP_WAV_MAX_DATA_BYTES)
+            return false;
+        for (int32_t ch = 0; ch < channels; ch++)
+            for (int32_t f = 0; f < numFrames; f++)
+                interleaved[(size_t) f * channels + ch] = src[ch][f];
+        dataBytes += bytes;
+        return fwrite(interleaved.data(), sizeof(float), (size_t) numFrames * channels, file) == (size_t) numFrames * channels;
+    }
+
+    void close() {
+        if (!file)
+            return;
+        fseek(file, 0, SEEK_SET);
+        writeHeader();
+        fclose(file);
+        file = nullptr;
+    }
+};
+
+// Returns whether the instance has no more audio input/output ports than `numChannels`.
+static bool fitsChannels(aap::LocalPluginInstance* instance, int32_t numChannels) {
+    int32_t numAudioInputs = 0, numAudioOutputs = 0;
+    for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+        auto port = instance->getPort(i);
+        if (port->getContentType() == AAP_CONTENT_TYPE_AUDIO)
+            (port->getPortDirection() == AAP_PORT_DIRECTION_INPUT ? numAudioInputs : numAudioOutputs)++;
+    }
+    return numAudioInputs <= numChannels && numAudioOutputs <= numChannels;
+}
+
+// Writes the clip events in [position, position + numFrames) to `midiIn` with JR timestamps,
+// in the same manner as MidiSourceNode. Returns the index of the first event that is not sent yet.
+static size_t writeMidiInput(uint8_t* midiIn, size_t capacity, const std::vector<aap::Midi2ClipEvent>& events,
+                             size_t nextEvent, int64_t position, int32_t numFrames, int32_t sampleRate) {
+    auto header = (AAPMidiBufferHeader*) midiIn;
+    auto dst8 = (uint8_t*) (header + 1);
+    auto maxLength = (uint32_t) (capacity - sizeof(AAPMidiBufferHeader));
+    uint32_t length = 0;
+    int64_t emittedTicks = 0;
+    for (; nextEvent < events.size(); nextEvent++) {
+        auto& event = events[nextEvent];
+        if (event.frame_position >= position + numFrames)
+            break;
+        auto frameOffset = std::max((int64_t) 0, event.frame_position - position);
+        int64_t ticks = llround((double) frameOffset * AAP_JR_TIMESTAMP_TICKS_PER_SECOND / sampleRate);
+        auto deltaTicks = ticks - emittedTicks;
+        auto numTimestamps = (deltaTicks + AAP_JR_TIMESTAMP_MAX_TICKS - 1) / AAP_JR_TIMESTAMP_MAX_TICKS;
+        if (length + numTimestamps * 4 + event.length > maxLength)
+            break; // send the rest in the next block.
+        for (; deltaTicks > 0; deltaTicks -= AAP_JR_TIMESTAMP_MAX_TICKS, length += 4)
+            *(uint32_t*) (dst8 + length) = cmidi2_ump_jr_timestamp_direct(0,
+                    (uint32_t) std::min(deltaTicks, (int64_t) AAP_JR_TIMESTAMP_MAX_TICKS));
+        emittedTicks = ticks;
+        memcpy(dst8 + length, event.ump, event.length);
+        length += event.length;
+    }
+    header->length = length;
+    return nextEvent;
+}
+
+// Processes `instance` on `channels` in place: the audio input ports take the channels in order, and the
+// audio output ports replace them in order. The channels beyond the audio outputs are silenced, so that the
+// dry input does not leak past the plugin. The MIDI2 input ports take `midiIn`.
+static void processInstance(aap::LocalPluginInstance* instance, float* const* channels, int32_t numChannels,
+                            const uint8_t* midiIn, int32_t numFrames) {
+    auto buffer = instance->getAudioPluginBuffer();
+    int32_t ch = 0;
+    for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+        auto port = instance->getPort(i);
+        if (port->getPortDirection() != AAP_PORT_DIRECTION_INPUT)
+            continue;
+        if (port->getContentType() == AAP_CONTENT_TYPE_AUDIO)
+            memcpy(buffer->get_buffer(*buffer, i), channels[ch++], numFrames * sizeof(float));
+        else if (port->getContentType() == AAP_CONTENT_TYPE_MIDI2) {
+            auto midiSize = std::min(sizeof(AAPMidiBufferHeader) + ((const AAPMidiBufferHeader*) midiIn)->length,
+                                     (size_t) buffer->get_buffer_size(*buffer, i));
+            memcpy(buffer->get_buffer(*buffer, i), midiIn, midiSize);
+        }
+    }
+
+    instance->process(numFrames, 0);
+
+    ch = 0;
+    for (int32_t i = 0, n = instance->getNumPorts(); i < n; i++) {
+        auto port = instance->getPort(i);
+        if (port->getPortDirection() == AAP_PORT_DIRECTION_OUTPUT && port->getContentType() == AAP_CONTENT_TYPE_AUDIO)
+            memcpy(channels[ch++], buffer->get_buffer(*buffer, i), numFrames * sizeof(float));
+    }
+    for (; ch < numChannels; ch++)
+        memset(channels[ch], 0, numFrames * sizeof(float));
+}
+
+static int64_t getMonotonicNanoseconds() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+aap::OfflineRenderResult aap::OfflineRenderer::render(const OfflineRenderJob& job) {
+    OfflineRenderResult result{};
+    auto fail = [&](const std::string& error) {
+        result.error = error;
+        aap::a_log_f(AAP_LOG_LEVEL_ERROR, LOG_TAG, "OfflineRenderer: %s (output: %s)",
+                     error.c_str(), job.output_path.c_str());
+        return result;
+    };
+
+    if (job.block_size <= 0 || job.num_channels <= 0)
+        return fail("invalid block size or channel count");
+
+    WavInput audioInput{};
+    bool hasAudioInput = !job.input_audio_path.empty();
+    if (hasAudioInput && !audioInput.open(job.input_audio_path.c_str(), job.block_size))
+        return fail("could not read input audio " + job.input_audio_path);
+    int32_t sampleRate = job.sample_rate > 0 ? job.sample_rate :
+                         hasAudioInput ? audioInput.getSampleRate() : AAP_OFFLINE_RENDERER_DEFAULT_SAMPLE_RATE;
+    if (hasAudioInput && audioInput.getSampleRate() != sampleRate)
+        return fail("the input audio sample rate does not match");
+    result.sample_rate = sampleRate;
+
+    Midi2ClipFile clip{};
+    if (!job.input_midi2_clip_path.empty() && !clip.load(job.input_midi2_clip_path.c_str(), sampleRate))
+        return fail("could not read MIDI 2.0 clip " + job.input_midi2_clip_path);
+    auto& events = clip.getEvents();
+
+    int64_t numFrames = job.num_frames > 0 ? job.num_frames :
+                        std::max(audioInput.getNumFrames(), clip.getLengthInFrames()) + job.tail_frames;
+    if ((uint64_t) numFrames * job.num_channels * sizeof(float) > AAP_WAV_MAX_DATA_BYTES)
+        return fail("the output exceeds the 4GB size limit of WAV files");
+
+    // It has to outlive the instances.
+    StandalonePluginService host{};
+    std::vector<LocalPluginInstance*> chain{};
+    for (auto pluginInfo : job.plugins) {
+        auto instance = host.instantiate(pluginInfo, sampleRate);
+        if (!instance)
+            return fail("could not load plugin " + pluginInfo->getPluginID());
+        chain.emplace_back(instance);
+        instance->setRenderMode(job.freewheel ? AAP_RENDER_MODE_OFFLINE : AAP_RENDER_MODE_REALTIME);
+        auto error = host.setupInstance(instance, job.block_size);
+        if (!error.empty())
+            return fail(error + ": " + pluginInfo->getPluginID());
+        if (!fitsChannels(instance, job.num_channels))
+            return fail("the plugin has more audio ports than the channels to render: " + pluginInfo->getPluginID());
+    }
+
+    WavOutput writer{};
+    if (!writer.open(job.output_path.c_str(), job.num_channels, sampleRate, job.block_size))
+        return fail("could not open the output file");
+    // The plugins process the bus in place, so every channel is cleared before the input of each block is read.
+    std::vector<std::vector<float>> bus((size_t) job.num_channels, std::vector<float>((size_t) job.block_size));
+    std::vector<float*> channels{};
+    for (auto& c : bus)
+        channels.emplace_back(c.data());
+    std::vector<uint8_t> midiIn(AAP_MANAGER_MIDI_BUFFER_SIZE);
+
+    auto begin = getMonotonicNanoseconds();
+    size_t nextEvent = 0;
+    for (int64_t position = 0; position < numFrames; position += job.block_size) {
+        auto n = (int32_t) std::min((int64_t) job.block_size, numFrames - position);
+
+        for (auto c : channels)
+            memset(c, 0, n * sizeof(float));
+        if (hasAudioInput)
+            audioInput.read(channels.data(), job.num_channels, n);
+        nextEvent = writeMidiInput(midiIn.data(), midiIn.size(), events, nextEvent, position, n, sampleRate);
+
+        for (auto instance : chain)
+            processInstance(instance, channels.data(), job.num_channels, midiIn.data(), n);
+
+        if (!writer.write(channels.data(), n))
+            return fail("could not write to the output file");
+        result.num_frames += n;
+
+        if (!job.freewheel) {
+            auto deadline = begin + (position + n) * 1000000000LL / sampleRate;
+            struct timespec ts{(time_t) (deadline / 1000000000LL), (long) (deadline % 1000000000LL)};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+        }
+    }
+    result.elapsed_nanoseconds = getMonotonicNanoseconds() - begin;
+    writer.close();
+
+    for (auto instance : chain) {
+        PluginInstanceStatisticsSnapshot snapshot{};
+        instance->getStatistics().getSnapshot(snapshot);
+        snapshot.instance_id = instance->getInstanceId();
+        result.statistics.emplace_back(snapshot);
+    }
+    result.success = true;
+    return result;
+}
+
+std::vector<aap::OfflineRenderResult> aap::OfflineRenderer::renderAll(const std::vector<OfflineRenderJob>& jobs, int32_t maxThreads) {
+    std::vector<OfflineRenderResult> results(jobs.size());
+    std::atomic<size_t> nextJob{0};
+    auto run = [&] {
+        for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+            results[i] = render(jobs[i]);
+    };
+    if (maxThreads <= 0)
+        maxThreads = std::max(1, (int32_t) std::thread::hardware_concurrency());
+    auto numThreads = std::min((size_t) maxThreads, jobs.size());
+    std::vector<std::thread> workers{};
+    for (size_t t = 1; t < numThreads; t++)
+        workers.emplace_back(run);
+    run();
+    for (auto& w : workers)
+        w.join();
+    return results;
+}
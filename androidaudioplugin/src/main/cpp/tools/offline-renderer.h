@@ -0,0 +1,72 @@
+#ifndef AAP_CORE_OFFLINERENDERER_H
+#define AAP_CORE_OFFLINERENDERER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <aap/core/host/plugin-statistics.h>
+
+namespace aap {
+    class PluginInformation;
+
+    /**
+     * Describes an offline rendering: an input WAV file and/or a MIDI 2.0 clip, processed by a chain
+     * of plugins, and written to a 32-bit float WAV file.
+     */
+    struct OfflineRenderJob {
+        /// The plugins processed in order. They are loaded into this process (not bound as services).
+        std::vector<const PluginInformation*> plugins{};
+        /// Optional. Its sample rate must match `sample_rate` (no resampling is done).
+        std::string input_audio_path{};
+        /// Optional (see Midi2ClipFile). It is sent to every plugin in the chain.
+        std::string input_midi2_clip_path{};
+        std::string output_path{};
+        /// 0 takes the sample rate of the input audio (or 48000 if there is no input audio).
+        int32_t sample_rate{0};
+        int32_t block_size{1024};
+        int32_t num_channels{2};
+        /// The frames rendered after the end of the inputs (e.g. for reverb tails).
+        int64_t tail_frames{0};
+        /// If positive, it is rendered instead of the length of the inputs plus `tail_frames`.
+        int64_t num_frames{0};
+        /// Renders as fast as possible, and tells the plugins that they are processed offline
+        /// (AAP_RENDER_MODE_OFFLINE via render-mode extension). Otherwise, the blocks are paced in realtime.
+        bool freewheel{true};
+    };
+
+    struct OfflineRenderResult {
+        bool success{false};
+        std::string error{};
+        int32_t sample_rate{0};
+        int64_t num_frames{0};
+        int64_t elapsed_nanoseconds{0};
+        /// Per plugin in the chain, in order.
+        std::vector<PluginInstanceStatisticsSnapshot> statistics{};
+
+        /// How many times faster than realtime it was rendered.
+        double getRealtimeRatio() {
+            return elapsed_nanoseconds > 0 ? num_frames * 1e9 / sample_rate / elapsed_nanoseconds : 0;
+        }
+    };
+
+    /**
+     * OfflineRenderer processes OfflineRenderJobs block by block without any audio device (desktop only).
+     *
+     * The plugins are loaded with `dlopen()` (see PluginLibraryCache) and instantiated as
+     * LocalPluginInstances on a StandalonePluginService, with their port buffers allocated in this process.
+     * Each job has its own StandalonePluginService and instances, so independent jobs run in parallel.
+     *
+     * The input WAV can be 8/16/24/32-bit integer or 32/64-bit float. A mono input goes to all the channels,
+     * and the channels that the input does not have are silent.
+     */
+    class OfflineRenderer {
+    public:
+        static OfflineRenderResult render(const OfflineRenderJob& job);
+
+        /// Renders the jobs on up to `maxThreads` threads (0 for the number of CPU cores).
+        /// The results are in the same order as `jobs`.
+        static std::vector<OfflineRenderResult> renderAll(const std::vector<OfflineRenderJob>& jobs, int32_t maxThreads = 0);
+    };
+}
+
+#endif //AAP_CORE_OFFLINERENDERER_H
@@ -20,6 +20,12 @@ internal class AudioPluginNatives
         @JvmStatic
         external fun destroyBinderForService(binder: IBinder)
 
+        @JvmStatic
+        external fun preloadPluginLibraries(pluginIds: Array<String>) : Int
+
+        @JvmStatic
+        external fun releasePreloadedPluginLibraries()
+
         @JvmStatic
         external fun prepareNativeLooper()
 
@@ -20,6 +20,13 @@ open class AudioPluginService : Service()
         private var initialized = false
         private var waitForDebugger = false
 
+        /**
+         * When it is true (default), the native libraries of the plugins in the service are loaded
+         * (with all the symbols resolved) at `onCreate()`, so that the first instantiation does not pay for it.
+         * Set it before the service is created.
+         */
+        var preloadPluginLibraries = true
+
         fun initialize(context: Context) {
             if (initialized)
                 return
@@ -61,6 +68,15 @@ open class AudioPluginService : Service()
             ext.initialize(this)
             extensions.add(ext)
         }
+
+        if (preloadPluginLibraries)
+            AudioPluginNatives.preloadPluginLibraries(si.plugins.mapNotNull { it.pluginId }.toTypedArray())
+    }
+
+    override fun onDestroy() {
+        if (preloadPluginLibraries)
+            AudioPluginNatives.releasePreloadedPluginLibraries()
+        super.onDestroy()
     }
 
     private var eventProcessorLooper: Looper? = null
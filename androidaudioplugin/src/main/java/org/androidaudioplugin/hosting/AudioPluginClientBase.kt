@@ -45,6 +45,19 @@ open class AudioPluginClientBase(private val applicationContext: Context) {
         return native.createInstanceFromExistingConnection(sampleRate, pluginInfo.pluginId!!)
     }
 
+    // Instance pool: the configured plugins are instantiated and prepared in the background, and
+    // instantiateNativePlugin() hands one of them out immediately if the sample rate matches.
+    // The plugin services must be connected (see connectToPluginService()) for pooling.
+    fun configureInstancePool(configurations: List<PluginInstancePoolConfiguration>) =
+        native.configureInstancePool(configurations)
+
+    fun clearInstancePool() = native.configureInstancePool(listOf())
+
+    fun getPooledInstanceCount(pluginId: String) = native.getPooledInstanceCount(pluginId)
+
+    val instancePoolHitCount : Long
+        get() = native.instancePoolHitCount
+
     var sampleRate : Int
 
     init {
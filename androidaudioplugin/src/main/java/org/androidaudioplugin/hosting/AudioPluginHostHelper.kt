@@ -165,6 +165,29 @@ object AudioPluginHostHelper {
         return queryAudioPluginServices(context).flatMap { s -> s.plugins }.toTypedArray()
     }
 
+    // Used by native plugin discovery: it only needs the plugins in a package whose metadata has changed.
+    @JvmStatic
+    fun queryAudioPluginsInPackage(context: Context, packageName: String): Array<PluginInformation> {
+        return queryAudioPluginServices(context, packageName).flatMap { s -> s.plugins }.toTypedArray()
+    }
+
+    // Used by native plugin discovery: the package names of the AudioPluginServices, without parsing their metadata.
+    @JvmStatic
+    fun queryAudioPluginPackageNames(context: Context): Array<String> {
+        val intent = Intent(AAP_ACTION_NAME)
+        return context.packageManager.queryIntentServices(intent, 0)
+            .map { ri -> ri.serviceInfo.packageName }.distinct().toTypedArray()
+    }
+
+    // Used by native plugin discovery to tell whether the metadata in the package may have changed.
+    @JvmStatic
+    fun getPackageLastUpdateTime(context: Context, packageName: String): Long =
+        try {
+            context.packageManager.getPackageInfo(packageName, 0).lastUpdateTime
+        } catch (ex: PackageManager.NameNotFoundException) {
+            0
+        }
+
     @JvmStatic
     fun createAudioPluginServiceInformation(context: Context, serviceInfo: ServiceInfo) : PluginServiceInformation? {
         try {
@@ -12,6 +12,18 @@ class NativePluginClient(val native: Long) {
         return NativeRemotePluginInstance.create(pluginId, sampleRate, native)
     }
 
+    fun configureInstancePool(configurations: List<PluginInstancePoolConfiguration>) =
+        configureInstancePool(native,
+            configurations.map { it.pluginId }.toTypedArray(),
+            configurations.map { it.poolSize }.toIntArray(),
+            configurations.map { it.sampleRate }.toIntArray(),
+            configurations.map { it.frameCount }.toIntArray())
+
+    fun getPooledInstanceCount(pluginId: String) = getPooledInstanceCount(native, pluginId)
+
+    val instancePoolHitCount : Long
+        get() = getInstancePoolHitCount(native)
+
     companion object {
         fun createFromConnection(serviceConnectionId: Int) = NativePluginClient(newInstance(serviceConnectionId))
 
@@ -20,5 +32,14 @@ class NativePluginClient(val native: Long) {
 
         @JvmStatic
         private external fun destroyInstance(native: Long)
+
+        @JvmStatic
+        private external fun configureInstancePool(native: Long, pluginIds: Array<String>, poolSizes: IntArray, sampleRates: IntArray, frameCounts: IntArray)
+
+        @JvmStatic
+        private external fun getPooledInstanceCount(native: Long, pluginId: String) : Int
+
+        @JvmStatic
+        private external fun getInstancePoolHitCount(native: Long) : Long
     }
 }
\ No newline at end of file
@@ -0,0 +1,4 @@
+package org.androidaudioplugin.hosting
+
+/* maps to aap::PluginInstancePoolConfiguration */
+data class PluginInstancePoolConfiguration(val pluginId: String, val sampleRate: Int, val poolSize: Int = 1, val frameCount: Int = 1024)
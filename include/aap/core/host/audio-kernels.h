@@ -0,0 +1,88 @@
+#ifndef AAP_CORE_AUDIO_KERNELS_H
+#define AAP_CORE_AUDIO_KERNELS_H
+
+#include <cstdint>
+
+// Vectorized sample conversion kernels that the hosts share (Oboe device layer, AudioPluginNode,
+// AAPMidiProcessor, WAV reader/writer, mixer, meter, resampler): planar <-> interleaved,
+// float <-> int16/int24 with dither, gain-while-copying (also ramped), metering and dot products.
+//
+// The implementation (AVX2, SSE, NEON or scalar) is chosen once at library load, by CPU detection.
+// All the functions are RT-safe. Buffers do not have to be aligned.
+
+namespace aap::kernels {
+
+    enum KernelImplementation {
+        AAP_KERNELS_SCALAR,
+        AAP_KERNELS_SSE,
+        AAP_KERNELS_AVX2,
+        AAP_KERNELS_NEON
+    };
+
+    /// The implementation in use.
+    KernelImplementation getImplementation();
+
+    const char* getImplementationName(KernelImplementation implementation);
+
+    /// Switches the implementation (e.g. for benchmarking). Returns false if the CPU does not support it.
+    /// It must not be called while any kernel is running on another thread.
+    bool setImplementation(KernelImplementation implementation);
+
+    /**
+     * State of the TPDF (triangular probability density function) dither noise generator.
+     * Each converting thread (or stream) should have its own state.
+     */
+    struct DitherState {
+        uint32_t lanes[8];
+
+        explicit DitherState(uint32_t seed = 0x9E3779B9u) { reset(seed); }
+
+        void reset(uint32_t seed) {
+            for (int i = 0; i < 8; i++)
+                lanes[i] = (seed + 0x6D2B79F5u * (i + 1)) | 1; // xorshift state must not be 0
+        }
+    };
+
+    /// dst[frame * numChannels + ch] = src[ch][frame] * gain.
+    /// `numChannels` is typically 1 to 8 (which have dedicated kernels), but any positive count works.
+    /// `src` may contain the same channel pointer more than once (e.g. mono to all channels).
+    void interleave(const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gain = 1.0f);
+
+    /// dst[frame * numChannels + ch] += src[ch][frame] * gain.
+    void interleaveAdd(const float* const* src, float* dst, int32_t numChannels, int32_t numFrames, float gain = 1.0f);
+
+    /// dst[ch][frame] = src[frame * numChannels + ch].
+    void deinterleave(const float* src, float* const* dst, int32_t numChannels, int32_t numFrames);
+
+    /// dst[i] = src[i] * gain. `src` and `dst` may be the same buffer.
+    void copyWithGain(const float* src, float* dst, int32_t numSamples, float gain);
+
+    /// dst[i] += src[i] * gain.
+    void addWithGain(const float* src, float* dst, int32_t numSamples, float gain);
+
+    /// dst[i] = src[i] * gain(i), where gain(i) ramps linearly from `gainStart` (i = 0) towards `gainEnd`
+    /// (i = numSamples), for click-free gain changes. `src` and `dst` may be the same buffer.
+    void copyWithGainRamp(const float* src, float* dst, int32_t numSamples, float gainStart, float gainEnd);
+
+    /// dst[i] += src[i] * gain(i) (see copyWithGainRamp()).
+    void addWithGainRamp(const float* src, float* dst, int32_t numSamples, float gainStart, float gainEnd);
+
+    /// The maximum of |src[i]| to `peak`, and the sum of src[i]^2 to `sumOfSquares`.
+    void measurePeakAndSumOfSquares(const float* src, int32_t numSamples, float& peak, float& sumOfSquares);
+
+    /// Returns the sum of x[i] * y[i] (e.g. FIR filter taps).
+    float dotProduct(const float* x, const float* y, int32_t numSamples);
+
+    /// Converts [-1.0, 1.0] floats to int16 with saturation. Dither is added if `dither` is not null.
+    void floatToInt16(const float* src, int16_t* dst, int32_t numSamples, DitherState* dither = nullptr);
+
+    void int16ToFloat(const int16_t* src, float* dst, int32_t numSamples);
+
+    /// Converts [-1.0, 1.0] floats to packed little-endian 24-bit integers (3 bytes per sample) with saturation.
+    void floatToInt24(const float* src, uint8_t* dst, int32_t numSamples, DitherState* dither = nullptr);
+
+    /// Converts packed little-endian 24-bit integers (3 bytes per sample) to floats.
+    void int24ToFloat(const uint8_t* src, float* dst, int32_t numSamples);
+}
+
+#endif //AAP_CORE_AUDIO_KERNELS_H
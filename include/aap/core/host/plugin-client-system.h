@@ -3,6 +3,9 @@
 
 #include <sys/stat.h>
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <vector>
 #include "../plugin-information.h"
 #include "plugin-connections.h"
@@ -11,9 +14,30 @@ namespace aap {
 
 class PluginClientSystem
 {
+    struct PluginPathCacheEntry {
+        int64_t timestamp{0};
+        std::vector<PluginInformation*> plugins{};
+    };
+
+    std::mutex installed_plugins_mutex{};
+    bool installed_plugins_cached{false};
+    // whether the cache is for getPluginPaths() (true) or for explicit search paths (false).
+    bool installed_plugins_from_plugin_paths{false};
+    std::vector<std::string> installed_plugins_search_paths{};
+    std::vector<PluginInformation*> installed_plugins{};
+    // plugin path -> the plugins that were parsed from it, and the timestamp of the path at that time.
+    std::map<std::string, PluginPathCacheEntry> plugin_path_cache{};
+    // PluginInformation that were replaced by rescanning. Existing PluginListSnapshots may still
+    // refer to them, so they are never freed.
+    std::vector<PluginInformation*> retired_plugins{};
+
+    PluginPathCacheEntry scanPluginPath(const std::string& path, const PluginPathCacheEntry* cached);
+
 public:
     static PluginClientSystem* getInstance();
 
+    virtual ~PluginClientSystem() {}
+
     virtual int32_t createSharedMemory(size_t size) = 0;
 
     virtual void ensurePluginServiceConnected(aap::PluginClientConnectionList* connections, std::string serviceName, std::function<void(std::string&)> callback) = 0;
@@ -22,6 +46,21 @@ public:
     virtual void getAAPMetadataPaths(std::string path, std::vector<std::string>& results) = 0;
     virtual std::vector<PluginInformation*> getPluginsFromMetadataPaths(std::vector<std::string>& aapMetadataPaths) = 0;
 
+    // Returns a value that changes whenever the plugins in the path change (0 if unknown, which means always
+    // reparsing). The default implementation returns the latest mtime of the path and its metadata files.
+    virtual int64_t getPluginPathTimestamp(const std::string& path, const std::vector<std::string>& aapMetadataPaths);
+
+    // The number of threads that scan the plugin paths in parallel. Implementations whose scanning functions
+    // must not be called from other threads should return 1.
+    virtual int32_t getMaxScanningThreads();
+
+    /**
+     * Returns the plugins in the plugin paths (or `searchPaths` if specified).
+     *
+     * The result is cached. If `returnCacheIfExists` is true and the cache for the same paths exists,
+     * it is returned without scanning. Otherwise the paths are scanned, but only the paths whose
+     * timestamp changed are reparsed. The cache lives in memory for the process lifetime.
+     */
     std::vector<PluginInformation*> getInstalledPlugins(bool returnCacheIfExists = true, std::vector<std::string>* searchPaths = nullptr);
 };
 
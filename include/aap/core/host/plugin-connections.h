@@ -2,6 +2,8 @@
 #ifndef AAP_CORE_PLUGIN_CONNECTIONS_H
 #define AAP_CORE_PLUGIN_CONNECTIONS_H
 
+#include <mutex>
+#include <unordered_map>
 #include "../plugin-information.h"
 
 namespace aap {
@@ -9,6 +11,8 @@ namespace aap {
 class PluginListSnapshot {
     std::vector<const PluginServiceInformation*> services{};
     std::vector<const PluginInformation*> plugins{};
+    // pluginId -> plugin. Built at queryServices().
+    std::unordered_map<std::string, const PluginInformation*> plugins_by_id{};
 
 public:
     static PluginListSnapshot queryServices();
@@ -23,13 +27,10 @@ public:
         return plugins[(size_t) index];
     }
 
-    const PluginInformation* getPluginInformation(std::string identifier)
+    const PluginInformation* getPluginInformation(const std::string& identifier)
     {
-        for (auto plugin : plugins) {
-            if (plugin->getPluginID().compare(identifier) == 0)
-                return plugin;
-        }
-        return nullptr;
+        auto entry = plugins_by_id.find(identifier);
+        return entry != plugins_by_id.end() ? entry->second : nullptr;
     }
 };
 
@@ -48,26 +49,49 @@ public:
     inline void * getConnectionData() { return connection_data; }
 };
 
+// Connections are added and removed on the service connection callbacks while they are looked up
+// from other threads (e.g. the instance pool worker), so the list is guarded by a mutex.
 class PluginClientConnectionList {
+    std::mutex connections_mutex{};
     std::vector<PluginClientConnection*> serviceConnections{};
+    // "packageName/className" -> connection
+    std::unordered_map<std::string, PluginClientConnection*> connections_by_name{};
+
+    static inline std::string getConnectionKey(const std::string& packageName, const std::string& className) {
+        return packageName + '/' + className;
+    }
 
 public:
     inline void add(std::unique_ptr<PluginClientConnection> entry) {
-        serviceConnections.emplace_back(entry.release());
+        auto key = getConnectionKey(entry->getPackageName(), entry->getClassName());
+        auto c = entry.release();
+        std::lock_guard<std::mutex> lock{connections_mutex};
+        serviceConnections.emplace_back(c);
+        // keep the first one, as the lookup did before the index was introduced.
+        connections_by_name.emplace(key, c);
     }
 
     inline void remove(std::string packageName, std::string className) {
+        std::lock_guard<std::mutex> lock{connections_mutex};
         for (size_t i = 0; i < serviceConnections.size(); i++) {
             auto &c = serviceConnections[i];
             if (c->getPackageName() == packageName && c->getClassName() == className) {
+                auto key = getConnectionKey(packageName, className);
+                connections_by_name.erase(key);
                 delete serviceConnections[i];
                 serviceConnections.erase(serviceConnections.begin() + i);
+                // another connection to the same service (if any) becomes the one to look up.
+                for (auto other : serviceConnections)
+                    if (other->getPackageName() == packageName && other->getClassName() == className) {
+                        connections_by_name.emplace(key, other);
+                        break;
+                    }
                 break;
             }
         }
     }
 
-    void* getServiceHandleForConnectedPlugin(std::string packageName, std::string className);
+    void* getServiceHandleForConnectedPlugin(const std::string& packageName, const std::string& className);
 
     void* getServiceHandleForConnectedPlugin(std::string pluginId);
 
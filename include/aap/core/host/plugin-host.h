@@ -7,7 +7,11 @@
 #include <dlfcn.h>
 #include <time.h>
 #include <unistd.h>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <map>
 #include <string>
@@ -20,10 +24,18 @@
 #include "aap/plugin-meta-info.h"
 #include "plugin-connections.h"
 #include "plugin-instance.h"
+#include "plugin-library-cache.h"
+#include "plugin-statistics.h"
 #include "../aapxs/extension-service.h"
 #include "../aapxs/standard-extensions.h"
 #include "../aapxs/aapxs-hosting-runtime.h"
 
+// PluginHost looks up instances by instance ID in a two-level table of
+// AAP_INSTANCE_TABLE_CHUNKS x AAP_INSTANCE_TABLE_CHUNK_SIZE entries.
+// IDs beyond the table are looked up by linear search (not realtime-safe).
+#define AAP_INSTANCE_TABLE_CHUNK_SIZE 256
+#define AAP_INSTANCE_TABLE_CHUNKS 256
+
 namespace aap {
 
     class PluginInstance;
@@ -37,6 +49,17 @@ namespace aap {
         virtual void requestProcess(int32_t in_instanceId) = 0;
     };
 
+    /**
+     * Specifies the instances that a PluginClient keeps instantiated and prepared in its instance pool.
+     */
+    struct PluginInstancePoolConfiguration {
+        std::string plugin_id{};
+        int32_t pool_size{1};
+        int32_t sample_rate{48000};
+        // the block size that the pooled instances are prepared for.
+        int32_t frame_count{1024};
+    };
+
 /* Common foundation for both Plugin service and Plugin client to provide common features:
  *
  * - retrieve AAPXSFeature*
@@ -51,7 +74,25 @@ namespace aap {
         PluginListSnapshot* plugin_list{nullptr};
 
         std::vector<PluginInstance*> instances{};
+        // guards the changes to `instances` against the statistics queries on other threads.
+        std::mutex instances_mutex{};
+
+        // instanceId -> instance. Chunks are allocated on demand and never freed until the host is gone,
+        // so that lookups are wait-free and can be done on the audio thread while another thread
+        // adds or removes instances.
+        struct InstanceTableChunk {
+            std::atomic<PluginInstance*> entries[AAP_INSTANCE_TABLE_CHUNK_SIZE]{};
+        };
+        std::atomic<InstanceTableChunk*> instance_table[AAP_INSTANCE_TABLE_CHUNKS]{};
+        std::atomic<PluginInstance*>* getInstanceTableEntry(int32_t instanceId, bool allocate);
+
+        // Adds the instance to `instances` and the instance table. The instance ID must be already assigned.
+        void registerInstance(PluginInstance* instance);
+        // the libraries that the local instances are referencing (released at disposeInstance()).
+        std::map<PluginInstance*, PluginLibrary*> local_instance_libraries{};
         PluginInstance* instantiateLocalPlugin(const PluginInformation *pluginInfo, int sampleRate);
+        // Deletes an instance that is not (or no longer) in `instances`.
+        void disposeInstance(PluginInstance* instance);
         int32_t event_midi2_input_buffer_size{4096};
 
     public:
@@ -59,7 +100,7 @@ namespace aap {
                    xs::AAPXSDefinitionRegistry* aapxsDefinitionRegistry,
                    int32_t eventMidi2InputBufferSize = 4096);
 
-        virtual ~PluginHost() {}
+        virtual ~PluginHost();
 
         void destroyInstance(PluginInstance* instance);
 
@@ -68,7 +109,15 @@ namespace aap {
         // Note that the argument is NOT instanceId
         PluginInstance* getInstanceByIndex(int32_t index);
 
+        // It is wait-free and realtime-safe for instance IDs within the instance table
+        // (as long as the instance is not being destroyed at the same time).
         PluginInstance* getInstanceById(int32_t instanceId);
+
+        // Retrieves the performance counters of the instance. Returns false if there is no such instance.
+        bool getInstanceStatistics(int32_t instanceId, PluginInstanceStatisticsSnapshot& snapshot);
+
+        // Retrieves the performance counters of all the instances.
+        std::vector<PluginInstanceStatisticsSnapshot> getAllInstanceStatistics();
     };
 
 
@@ -93,6 +142,25 @@ namespace aap {
         }
     };
 
+    /**
+     * A PluginService that hosts plugins in this process without any client, e.g. for offline rendering,
+     * benchmarks and command line hosts.
+     *
+     * The extension and port buffers that a client would pass are allocated by itself (via
+     * `PluginClientSystem::createSharedMemory()`). It owns the instances and destroys them when it is destroyed.
+     */
+    class StandalonePluginService : public PluginService {
+    public:
+        StandalonePluginService(xs::AAPXSDefinitionRegistry* aapxsDefinitionRegistry = nullptr);
+        ~StandalonePluginService() override;
+
+        LocalPluginInstance* instantiate(const PluginInformation* pluginInfo, int32_t sampleRate);
+
+        // Goes through the same steps as AudioPluginInterfaceImpl (beginCreate() to activate()).
+        // Returns an error message, or empty on success.
+        std::string setupInstance(LocalPluginInstance* instance, int32_t framesPerBlock);
+    };
+
     class PluginClient : public PluginHost {
         PluginClientConnectionList* connections;
 
@@ -103,6 +171,28 @@ namespace aap {
         };
 
         Result<int32_t> instantiateRemotePlugin(const PluginInformation *pluginInfo, int sampleRate);
+        // Creates a RemotePluginInstance without registering it to `instances`.
+        Result<PluginInstance*> createRemotePluginInstance(const PluginInformation *pluginInfo, int sampleRate);
+
+        // Instance pool. The pooled instances are not in `instances` until they are taken.
+        struct PooledInstance {
+            PluginInstance* instance;
+            int32_t sample_rate;
+            int32_t frame_count;
+        };
+        std::vector<PluginInstancePoolConfiguration> instance_pool_configurations{};
+        std::vector<PooledInstance> pooled_instances{};
+        std::mutex instance_pool_mutex{};
+        std::condition_variable instance_pool_refill_requested{};
+        bool instance_pool_alive{false};
+        bool instance_pool_needs_refill{false};
+        std::unique_ptr<std::thread> instance_pool_worker{nullptr};
+        std::atomic<int64_t> instance_pool_hits{0};
+
+        void runInstancePoolWorker();
+        // Returns a pooled instance of the plugin (registered to `instances`), or nullptr if there is none.
+        // It requests refilling the pool.
+        PluginInstance* takePooledInstance(const PluginInformation *pluginInfo, int sampleRate);
 
     public:
         PluginClient(PluginClientConnectionList* pluginConnections, PluginListSnapshot* contextPluginList, xs::AAPXSDefinitionRegistry* aapxsDefinitionRegistry = nullptr)
@@ -112,12 +202,35 @@ namespace aap {
         {
         }
 
+        ~PluginClient() override;
+
         inline PluginClientConnectionList* getConnections() { return connections; }
 
         // Synchronous version that does not expect service connection on the fly (fails immediately).
         // It is probably better suited for Kotlin client to avoid complicated JNI interop.
         Result<int32_t> createInstance(std::string identifier, int sampleRate, bool isRemoteExplicit);
 
+        /**
+         * Sets up the instance pool, replacing the existing configurations. For each configuration,
+         * `pool_size` remote instances are instantiated and prepared in the background, and
+         * `createInstance()` for the same plugin and sample rate hands one of them out immediately
+         * (the pool is then refilled in the background).
+         *
+         * The plugin services must be connected (see `connectToPluginService()`) for pooling.
+         * The pooled instances have never been activated, so they are in the same state as new ones,
+         * except that `prepare()` is a no-op for them if it does not need more frames than `frame_count`
+         * (otherwise it re-allocates the shared memory and prepares the plugin again).
+         */
+        void configureInstancePool(std::vector<PluginInstancePoolConfiguration> configurations);
+
+        // Destroys all the pooled instances and stops pooling.
+        void clearInstancePool() { configureInstancePool({}); }
+
+        size_t getPooledInstanceCount(const std::string& pluginId);
+
+        // Returns how many times `createInstance()` handed out a pooled instance.
+        int64_t getInstancePoolHitCount() { return instance_pool_hits.load(std::memory_order_relaxed); }
+
         void connectToPluginService(const std::string& identifier, std::function<void(std::string&)> callback);
 
         void connectToPluginService(const std::string& packageName, const std::string& className, std::function<void(std::string&)> callback);
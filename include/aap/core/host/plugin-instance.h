@@ -6,7 +6,9 @@
 #include "aap/core/aapxs/standard-extensions.h"
 #include "aap/unstable/utility.h"
 #include "plugin-host.h"
+#include "plugin-statistics.h"
 #include "aap/ext/plugin-info.h"
+#include "aap/ext/render-mode.h"
 #include "../aap_midi2_helper.h"
 #include "aap/core/AAPXSMidi2RecipientSession.h"
 #include "aap/core/AAPXSMidi2InitiatorSession.h"
@@ -34,8 +36,7 @@ namespace aap {
         AndroidAudioPluginFactory *plugin_factory;
 
     protected:
-        NanoSleepLock ump_sequence_merger_mutex{};
-        void merge_ump_sequences(aap_port_direction portDirection, void *mergeTmp, int32_t mergeBufSize, void* sequence, int32_t sequenceSize, aap_buffer_t *buffer, PluginInstance* instance);
+        AdaptiveMutex ump_sequence_merger_mutex{};
 
         aap_host_plugin_info_extension_t host_plugin_info{};
         static aap_plugin_info_t
@@ -56,6 +57,13 @@ namespace aap {
         int32_t event_midi2_buffer_size{0};
         int32_t event_midi2_buffer_offset{0};
 
+        PluginInstanceStatistics statistics{};
+        // Returns the number of MIDI events in the MIDI2 ports of the direction. JR timestamps and other
+        // utility messages are not counted, and a multi-packet SysEx counts as one event.
+        int32_t countUmps(aap_port_direction direction);
+        // Records a process() call that started at `beginNanoseconds` (CLOCK_MONOTONIC).
+        void recordProcess(int64_t beginNanoseconds, int32_t frameCount);
+
         PluginInstance(const PluginInformation *pluginInformation,
                        AndroidAudioPluginFactory *loadedPluginFactory,
                        int32_t sampleRate,
@@ -70,6 +78,9 @@ namespace aap {
     public:
         virtual ~PluginInstance();
 
+        // Merges `sequence` into the first MIDI2 port of `portDirection` in `buffer`, using `mergeTmp` as the work area.
+        static void merge_ump_sequences(aap_port_direction portDirection, void *mergeTmp, int32_t mergeBufSize, void* sequence, int32_t sequenceSize, aap_buffer_t *buffer, PluginInstance* instance);
+
         virtual int32_t getInstanceId() = 0;
 
         PluginSharedMemoryStore *getSharedMemoryStore() { return shared_memory_store; }
@@ -128,6 +139,10 @@ namespace aap {
 
         virtual void process(int32_t frameCount, int32_t timeoutInNanoseconds) = 0;
 
+        PluginInstanceStatistics& getStatistics() { return statistics; }
+
+        AdaptiveMutexStatistics getUmpMergerLockStatistics() { return ump_sequence_merger_mutex.getStatistics(); }
+
         virtual void setupAAPXS() = 0;
         virtual xs::StandardExtensions &getStandardExtensions() = 0;
 
@@ -171,9 +186,11 @@ namespace aap {
         std::unique_ptr<xs::AAPXSDefinitionServiceRegistry> feature_registry;
         xs::AAPXSServiceDispatcher aapxs_dispatcher;
         bool process_requested_to_host{false};
+        aap_host_render_mode_extension_t host_render_mode{};
+        std::atomic<int32_t> render_mode{AAP_RENDER_MODE_REALTIME};
 
         AAPXSMidi2RecipientSession aapxs_midi2_in_session{};
-        NanoSleepLock aapxs_out_merger_mutex_out{};
+        AdaptiveMutex aapxs_out_merger_mutex_out{};
         void* aapxs_out_midi2_buffer{nullptr};
         void* aapxs_out_merge_buffer{nullptr};
         int32_t aapxs_out_midi2_buffer_offset{0};
@@ -183,6 +200,9 @@ namespace aap {
         }
         void* getHostExtension(uint8_t urid, const char *uri);
         static void internalRequestProcess(AndroidAudioPluginHost *host);
+        static int32_t internalGetRenderMode(aap_host_render_mode_extension_t* ext, AndroidAudioPluginHost *host) {
+            return ((LocalPluginInstance*) host->context)->render_mode;
+        }
 
         /** it is an unwanted exposure, but we need this internal-only member as public. You are not supposed to use it. */
         aapxs_host_ipc_sender ipc_send_extension_message_func;
@@ -229,6 +249,11 @@ namespace aap {
 
         void addEventUmpOutput(void* input, int32_t size);
 
+        // The mode that the plugin retrieves via render-mode host extension (AAP_RENDER_MODE_*).
+        // Offline renderers set AAP_RENDER_MODE_OFFLINE. It must not be changed during `process()`.
+        void setRenderMode(int32_t mode) { render_mode = mode; }
+        int32_t getRenderMode() { return render_mode; }
+
         void process(int32_t frameCount, int32_t timeoutInNanoseconds) override;
 
         void requestProcessToHost();
@@ -286,6 +311,8 @@ namespace aap {
         /** it is an unwanted exposure, but we need this internal-only member as public. You are not supposed to use it. */
         aapxs_client_ipc_sender ipc_send_extension_message_impl;
 
+        int32_t prepared_frame_count{0};
+
     protected:
         AndroidAudioPluginHost *getHostFacadeForCompleteInstantiation() override;
 
@@ -0,0 +1,79 @@
+#ifndef AAP_CORE_PLUGIN_LIBRARY_CACHE_H
+#define AAP_CORE_PLUGIN_LIBRARY_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "aap/android-audio-plugin.h"
+
+namespace aap {
+
+    class PluginInformation;
+
+    /**
+     * A plugin shared library that is loaded in this process, and the factory that its entry point returned.
+     * It is owned by PluginLibraryCache.
+     */
+    class PluginLibrary {
+        friend class PluginLibraryCache;
+
+        std::string file;
+        std::string entrypoint;
+        void* handle{nullptr};
+        AndroidAudioPluginFactory* factory{nullptr};
+        int32_t ref_count{0};
+
+    public:
+        const std::string& getFile() const { return file; }
+        const std::string& getEntryPoint() const { return entrypoint; }
+        AndroidAudioPluginFactory* getFactory() const { return factory; }
+    };
+
+    /**
+     * Process-wide cache of the plugin shared libraries and their factories, keyed by the canonical
+     * library path (see `resolveLibraryPath()`) and the entry point.
+     *
+     * Each local plugin instance holds a reference to its library, so that `dlopen()`, `dlsym()` and
+     * the factory getter run only once per library, and the library is `dlclose()`d when the last
+     * instance is gone.
+     * `preload()` loads a library with `RTLD_NOW` beforehand (e.g. at service start), so that the
+     * first instantiation (and the first `process()`) does not resolve symbols lazily.
+     *
+     * It is not meant to be used on the realtime thread.
+     */
+    class PluginLibraryCache {
+        std::mutex mutex{};
+        std::map<std::string, std::unique_ptr<PluginLibrary>> libraries{};
+        std::vector<PluginLibrary*> preloaded{};
+
+        PluginLibrary* acquire(const PluginInformation* pluginInfo, bool resolveNow);
+
+    public:
+        static PluginLibraryCache* getInstance();
+
+        // Returns the path of the plugin library, resolved against the plugin metadata location if possible,
+        // and canonicalized by realpath() unless it is a bare library name. It is also the cache key.
+        static std::string resolveLibraryPath(const PluginInformation* pluginInfo);
+
+        // Returns the (possibly cached) library of the plugin with an additional reference,
+        // or nullptr if it could not be loaded. It must be released by `release()`.
+        PluginLibrary* acquire(const PluginInformation* pluginInfo) { return acquire(pluginInfo, false); }
+
+        // Drops a reference, and unloads the library if it was the last one.
+        void release(PluginLibrary* library);
+
+        // Loads the library of the plugin with all its symbols resolved, and keeps it loaded
+        // until `releasePreloadedLibraries()`. Returns false if it could not be loaded.
+        bool preload(const PluginInformation* pluginInfo);
+
+        void releasePreloadedLibraries();
+
+        size_t getLoadedLibraryCount();
+    };
+
+} // namespace
+
+#endif //AAP_CORE_PLUGIN_LIBRARY_CACHE_H
@@ -0,0 +1,120 @@
+#ifndef AAP_CORE_PLUGIN_STATISTICS_H
+#define AAP_CORE_PLUGIN_STATISTICS_H
+
+#include <atomic>
+#include <cstdint>
+#include "aap/unstable/utility.h"
+
+// bucket 0 is for < 1 microsecond, bucket N (N > 0) is for [2^(N-1), 2^N) microseconds.
+// The last bucket also contains everything longer.
+#define AAP_PROCESS_TIME_HISTOGRAM_BUCKETS 24
+
+namespace aap {
+
+    /**
+     * A copy of PluginInstanceStatistics at some point.
+     * Each field is read atomically, but the fields are not consistent with each other as a whole.
+     */
+    struct PluginInstanceStatisticsSnapshot {
+        int32_t instance_id{-1};
+        uint64_t process_count{0};
+        /// the number of process() calls that took longer than the audio duration of the block.
+        uint64_t deadline_misses{0};
+        int64_t last_process_time_nanoseconds{0};
+        int64_t worst_process_time_nanoseconds{0};
+        int64_t total_process_time_nanoseconds{0};
+        uint64_t process_time_histogram[AAP_PROCESS_TIME_HISTOGRAM_BUCKETS]{};
+        /// AAPXS SysEx8 requests and replies sent by this instance, and their payload size.
+        uint64_t aapxs_outgoing_messages{0};
+        uint64_t aapxs_outgoing_bytes{0};
+        /// AAPXS SysEx8 requests and replies received by this instance, and their payload size.
+        uint64_t aapxs_incoming_messages{0};
+        uint64_t aapxs_incoming_bytes{0};
+        /// MIDI events in the MIDI2 input ports (passed to the plugin) and the output ports (from the plugin).
+        /// Utility messages (JR timestamps) are excluded and a multi-packet SysEx counts once.
+        uint64_t ump_input_events{0};
+        uint64_t ump_output_events{0};
+        /// contention on the lock that guards the UMP input merge buffer (between addEventUmpInput() and process()).
+        AdaptiveMutexStatistics ump_merger_lock{};
+    };
+
+    /**
+     * Lock-free performance counters of a PluginInstance.
+     *
+     * They are updated with relaxed atomic operations, so they can be recorded on the audio thread
+     * and read on any other thread (e.g. by `PluginHost::getInstanceStatistics()`).
+     */
+    class PluginInstanceStatistics {
+        std::atomic<uint64_t> process_count{0};
+        std::atomic<uint64_t> deadline_misses{0};
+        std::atomic<int64_t> last_process_time{0};
+        std::atomic<int64_t> worst_process_time{0};
+        std::atomic<int64_t> total_process_time{0};
+        std::atomic<uint64_t> process_time_histogram[AAP_PROCESS_TIME_HISTOGRAM_BUCKETS]{};
+        std::atomic<uint64_t> aapxs_outgoing_messages{0};
+        std::atomic<uint64_t> aapxs_outgoing_bytes{0};
+        std::atomic<uint64_t> aapxs_incoming_messages{0};
+        std::atomic<uint64_t> aapxs_incoming_bytes{0};
+        std::atomic<uint64_t> ump_input_events{0};
+        std::atomic<uint64_t> ump_output_events{0};
+
+        static inline int32_t histogramBucket(int64_t nanoseconds) {
+            auto us = (uint64_t) (nanoseconds / 1000);
+            int32_t bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+            return bucket < AAP_PROCESS_TIME_HISTOGRAM_BUCKETS ? bucket : AAP_PROCESS_TIME_HISTOGRAM_BUCKETS - 1;
+        }
+
+    public:
+        void recordProcess(int64_t elapsedNanoseconds, int64_t deadlineNanoseconds) {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            process_count.fetch_add(1, relaxed);
+            if (elapsedNanoseconds > deadlineNanoseconds)
+                deadline_misses.fetch_add(1, relaxed);
+            last_process_time.store(elapsedNanoseconds, relaxed);
+            total_process_time.fetch_add(elapsedNanoseconds, relaxed);
+            auto worst = worst_process_time.load(relaxed);
+            while (elapsedNanoseconds > worst && !worst_process_time.compare_exchange_weak(worst, elapsedNanoseconds, relaxed))
+                ;
+            process_time_histogram[histogramBucket(elapsedNanoseconds)].fetch_add(1, relaxed);
+        }
+
+        void recordAAPXSOutgoing(int32_t dataSize) {
+            aapxs_outgoing_messages.fetch_add(1, std::memory_order_relaxed);
+            aapxs_outgoing_bytes.fetch_add(dataSize, std::memory_order_relaxed);
+        }
+
+        void recordAAPXSIncoming(int32_t dataSize) {
+            aapxs_incoming_messages.fetch_add(1, std::memory_order_relaxed);
+            aapxs_incoming_bytes.fetch_add(dataSize, std::memory_order_relaxed);
+        }
+
+        void recordUmpInput(int32_t numEvents) {
+            if (numEvents > 0)
+                ump_input_events.fetch_add(numEvents, std::memory_order_relaxed);
+        }
+
+        void recordUmpOutput(int32_t numEvents) {
+            if (numEvents > 0)
+                ump_output_events.fetch_add(numEvents, std::memory_order_relaxed);
+        }
+
+        void getSnapshot(PluginInstanceStatisticsSnapshot& snapshot) {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            snapshot.process_count = process_count.load(relaxed);
+            snapshot.deadline_misses = deadline_misses.load(relaxed);
+            snapshot.last_process_time_nanoseconds = last_process_time.load(relaxed);
+            snapshot.worst_process_time_nanoseconds = worst_process_time.load(relaxed);
+            snapshot.total_process_time_nanoseconds = total_process_time.load(relaxed);
+            for (int32_t i = 0; i < AAP_PROCESS_TIME_HISTOGRAM_BUCKETS; i++)
+                snapshot.process_time_histogram[i] = process_time_histogram[i].load(relaxed);
+            snapshot.aapxs_outgoing_messages = aapxs_outgoing_messages.load(relaxed);
+            snapshot.aapxs_outgoing_bytes = aapxs_outgoing_bytes.load(relaxed);
+            snapshot.aapxs_incoming_messages = aapxs_incoming_messages.load(relaxed);
+            snapshot.aapxs_incoming_bytes = aapxs_incoming_bytes.load(relaxed);
+            snapshot.ump_input_events = ump_input_events.load(relaxed);
+            snapshot.ump_output_events = ump_output_events.load(relaxed);
+        }
+    };
+}
+
+#endif //AAP_CORE_PLUGIN_STATISTICS_H
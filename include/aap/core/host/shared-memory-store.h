@@ -172,6 +172,8 @@ namespace aap {
                     close(fd);
             }
             extension_fds->clear();
+            extension_buffers->clear();
+            extension_buffer_sizes->clear();
         }
 
         void disposeAudioBufferFDs() {
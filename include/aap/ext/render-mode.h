@@ -0,0 +1,34 @@
+#ifndef ANDROIDAUDIOPLUGIN_RENDER_MODE_EXTENSION_H_INCLUDED
+#define ANDROIDAUDIOPLUGIN_RENDER_MODE_EXTENSION_H_INCLUDED
+
+// render-mode extension lets a plugin ask the host whether it is being processed in realtime, or
+// offline (freewheeling, e.g. bouncing to a file) where `process()` has no deadline.
+// Plugins may then pick higher quality (slower) algorithms, or avoid skipping work under load.
+//
+// Like plugin-info, IPC is not involved for `get_render_mode()`, as it is implemented at LocalPluginInstance.
+// The mode may change between `process()` calls (but not during one).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../android-audio-plugin.h"
+#include "stdint.h"
+
+#define AAP_RENDER_MODE_EXTENSION_URI "urn://androidaudioplugin.org/extensions/render-mode/v1"
+
+enum aap_render_mode {
+    AAP_RENDER_MODE_REALTIME = 0,
+    AAP_RENDER_MODE_OFFLINE = 1
+};
+
+typedef struct aap_host_render_mode_extension_t {
+    // returns one of `aap_render_mode` values.
+    int32_t (*get_render_mode) (aap_host_render_mode_extension_t* ext, AndroidAudioPluginHost* host);
+} aap_host_render_mode_extension_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANDROIDAUDIOPLUGIN_RENDER_MODE_EXTENSION_H_INCLUDED
@@ -4,6 +4,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #if ANDROID
 #include <android/log.h>
@@ -33,10 +34,45 @@ enum AAP_LOG_LEVEL {
 #endif
 };
 
+// Realtime-safe logging (implemented in realtime-logging.cpp).
+//
+// On the threads registered by `aap::logging::registerRealtimeThread()` (the audio threads), the functions below
+// neither format nor write anything. They copy the format string and the raw arguments (and the contents of `%s`
+// strings, both truncated) into the lock-free ring of the thread, and a background thread formats and emits them.
+// Only the tag pointer is kept, so the tags must be string literals there (as they almost always are).
+// Each format string is rate-limited per thread, and identical consecutive messages are folded into one.
+extern "C" {
+    // Returns false without consuming `ap` if the calling thread is not registered.
+    // It is weak, so that this header works without libandroidaudioplugin too.
+    __attribute__((weak)) bool aap_rt_log_vprintf(int logLevel, const char* tag, const char* fmt, va_list ap);
+}
+
 namespace aap
 {
 
+namespace logging {
+    /// Makes sure that the rings for `count` more threads are available, and starts the background flusher.
+    /// Call it when an audio stream is started (not on the audio thread), so that registerRealtimeThread() on the
+    /// audio thread neither allocates nor locks.
+    void reserveRealtimeThreads(int32_t count);
+
+    /// Routes the logs on the calling thread to the realtime-safe logger from now on. It takes a ring that
+    /// reserveRealtimeThreads() allocated; if there is none, it allocates one (which is not realtime-safe).
+    void registerRealtimeThread();
+
+    /// Stops routing the logs on the calling thread. The logs in its ring are still emitted.
+    void unregisterRealtimeThread();
+
+    /// Formats and emits all the pending logs. It must not be called on a realtime thread.
+    void flushRealtimeLogs();
+
+    /// The number of logs that were dropped because a thread ring was full.
+    int64_t getNumDroppedRealtimeLogs();
+}
+
 static inline int a_log_vprintf(AAP_LOG_LEVEL logLevel, const char *tag, const char *fmt, va_list ap) {
+    if (aap_rt_log_vprintf && aap_rt_log_vprintf(logLevel, tag, fmt, ap))
+        return 0;
 #if ANDROID
     return __android_log_vprint(logLevel, tag, fmt, ap);
 #else
@@ -64,10 +100,22 @@ static inline int aprintf(const char *fmt,...) {
     return ret;
 }
 
+static inline bool a_log_rt(AAP_LOG_LEVEL logLevel, const char *tag, const char *fmt,...) {
+    va_list ap;
+    va_start (ap, fmt);
+    auto ret = aap_rt_log_vprintf(logLevel, tag, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
 static inline void a_log(AAP_LOG_LEVEL logLevel, const char *tag, const char* s) {
 #if ANDROID
+    if (aap_rt_log_vprintf && a_log_rt(logLevel, tag, "%s", s))
+        return;
     __android_log_print(logLevel, tag, "%s", s);
 #else
+    if (aap_rt_log_vprintf && a_log_rt(logLevel, tag, "%s\n", s))
+        return;
     puts(s);
 #endif
 }
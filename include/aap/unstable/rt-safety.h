@@ -0,0 +1,57 @@
+#ifndef AAP_CORE_UNSTABLE_RT_SAFETY_H
+#define AAP_CORE_UNSTABLE_RT_SAFETY_H
+
+// Runtime checks of the realtime sections, i.e. PluginInstance::process() and the audio graph processing
+// (opt-in, for debugging).
+//
+// The sections are marked with `ScopedRealtimeSection`. They do nothing unless the checker library
+// (libaaprtcheck.so, built from rtcheck/) is preloaded. Then it intercepts malloc/free (which covers
+// operator new/delete), pthread_mutex_lock and other blocking calls (sleeps, condition variables,
+// semaphores, futex waits by syscall(), file and console I/O, logging, mmap) on the threads inside the
+// sections, and records each violation with its stack trace. The violations that happened since the last
+// report are written at the end of each session (`PluginInstance::deactivate()` or the graph pause), and
+// at exit.
+//
+// The futex waits that libstdc++ makes by syscall() (e.g. std::future::wait()/get(), std::atomic::wait())
+// are caught. Those made by an inlined `svc`/`syscall` instruction are not, nor the waits inside libc.
+//
+// Desktop:  LD_PRELOAD=libaaprtcheck.so aap-host-cli ...
+// Android:  package libaaprtcheck.so and use a wrap.sh (like the ASan setup in setup-asan-for-debugging.sh)
+//           that runs `LD_PRELOAD=$(dirname $0)/libaaprtcheck.so "$@"`. The reports go to logcat.
+//
+// Environment variables read by the checker:
+//   AAP_RTCHECK_MODE=report|abort  `abort` aborts at the first violation, after printing it (default: report)
+//   AAP_RTCHECK_REPORT=path        appends the reports to the file instead of stderr (or logcat)
+
+extern "C" {
+    // Implemented by libaaprtcheck.so. They are weak, so they are null unless it is preloaded.
+    // Returns the previous section of the calling thread, which must be passed to aap_rtcheck_leave().
+    __attribute__((weak)) const char* aap_rtcheck_enter(const char* section);
+    __attribute__((weak)) void aap_rtcheck_leave(const char* previousSection);
+    __attribute__((weak)) void aap_rtcheck_end_session();
+}
+
+namespace aap::rt {
+
+    /// Marks the enclosing scope as realtime. The name is NOT copied; it must be a string literal.
+    class ScopedRealtimeSection {
+        const char* previous;
+    public:
+        explicit ScopedRealtimeSection(const char* section)
+                : previous(aap_rtcheck_enter ? aap_rtcheck_enter(section) : nullptr) {
+        }
+        ~ScopedRealtimeSection() {
+            if (aap_rtcheck_leave)
+                aap_rtcheck_leave(previous);
+        }
+    };
+
+    /// Lets the checker write the report of the violations since the last report (if any).
+    /// It must not be called in a realtime section.
+    static inline void endSession() {
+        if (aap_rtcheck_end_session)
+            aap_rtcheck_end_session();
+    }
+}
+
+#endif//AAP_CORE_UNSTABLE_RT_SAFETY_H
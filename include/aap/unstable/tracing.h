@@ -0,0 +1,78 @@
+#ifndef AAP_CORE_UNSTABLE_TRACING_H
+#define AAP_CORE_UNSTABLE_TRACING_H
+
+#include <atomic>
+#include <cstdint>
+
+// Portable, low-overhead tracing of the hot paths (graph nodes, plugin process, AAPXS sessions, UMP merges).
+//
+// Each thread records fixed-size events into its own lock-free ring, and a background thread
+// writes them into a Chrome trace event JSON file (which chrome://tracing and ui.perfetto.dev can load).
+// When tracing is not started, each trace point costs one relaxed atomic load.
+//
+// Event names are NOT copied; they must be string literals (or outlive the tracing session).
+
+namespace aap::trace {
+
+    enum TraceEventType : uint8_t {
+        AAP_TRACE_EVENT_BEGIN,
+        AAP_TRACE_EVENT_END,
+        AAP_TRACE_EVENT_COUNTER
+    };
+
+    extern std::atomic<bool> trace_enabled;
+
+    static inline bool isEnabled() { return trace_enabled.load(std::memory_order_relaxed); }
+
+    /// Records an event on the ring of the calling thread. The first event on a thread takes one of the rings
+    /// that `startTracing()` reserved, or allocates one unless the thread is registered as realtime
+    /// (see `registerCurrentThread()`).
+    void record(TraceEventType type, const char* name, int64_t value = 0);
+
+    static inline void begin(const char* name) {
+        if (isEnabled())
+            record(AAP_TRACE_EVENT_BEGIN, name);
+    }
+
+    static inline void end(const char* name) {
+        if (isEnabled())
+            record(AAP_TRACE_EVENT_END, name);
+    }
+
+    static inline void counter(const char* name, int64_t value) {
+        if (isEnabled())
+            record(AAP_TRACE_EVENT_COUNTER, name, value);
+    }
+
+    /// Records a begin/end pair for the enclosing scope.
+    class ScopedTrace {
+        const char* name;
+        bool active;
+    public:
+        explicit ScopedTrace(const char* traceName) : name(traceName), active(isEnabled()) {
+            if (active)
+                record(AAP_TRACE_EVENT_BEGIN, name);
+        }
+        ~ScopedTrace() {
+            if (active)
+                record(AAP_TRACE_EVENT_END, name);
+        }
+    };
+
+    /// Marks the calling thread as realtime (call it at the audio thread startup, along with
+    /// `aap::logging::registerRealtimeThread()`), so that tracing never allocates or locks on it.
+    /// The thread takes one of the rings that `startTracing()` reserved; if none is left, its events are
+    /// dropped. It is RT-safe. `threadName` is shown in the trace viewer (it is copied).
+    void registerCurrentThread(const char* threadName = nullptr);
+
+    /// Starts tracing into a Chrome trace event JSON file at `outputPath`. Returns false if it could not be opened.
+    bool startTracing(const char* outputPath);
+
+    /// Stops tracing, writes out all the remaining events, and closes the file.
+    void stopTracing();
+
+    /// The number of events that were dropped because a thread ring was full, since `startTracing()`.
+    int64_t getNumDroppedEvents();
+}
+
+#endif//AAP_CORE_UNSTABLE_TRACING_H
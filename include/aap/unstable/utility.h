@@ -3,12 +3,26 @@
 
 #include <sys/time.h>
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #define AAP_ASSERT_FALSE assert(false)
+// The upper bound of the adaptive spin count of AdaptiveMutex (in pause instructions).
+#define AAP_ADAPTIVE_MUTEX_MAX_SPINS 100
 
 namespace aap {
 
     // I don't think any simple and stupid SpinLock works well on mobiles, as we do not want to dry up battery.
+    // Kept for source compatibility; use AdaptiveMutex instead.
     class NanoSleepLock {
         std::atomic_flag state = ATOMIC_FLAG_INIT;
     public:
@@ -21,7 +35,210 @@ namespace aap {
         bool try_lock() noexcept { return !state.test_and_set(); }
     };
 
+    struct AdaptiveMutexStatistics {
+        int64_t acquisitions{0};
+        // lock() calls that did not get the lock immediately.
+        int64_t contentions{0};
+        // contended lock() calls that got the lock by spinning, and the ones that had to sleep.
+        int64_t spin_acquisitions{0};
+        int64_t sleeps{0};
+        int64_t failed_try_locks{0};
+        // the time spent in contended lock() calls.
+        int64_t total_wait_nanoseconds{0};
+        int64_t max_wait_nanoseconds{0};
+    };
+
+    // A mutex that spins for a short, adaptive duration and then sleeps, with priority inheritance.
+    //
+    // On Linux (and Android) the lock word is the owner thread ID. Realtime (SCHED_FIFO/SCHED_RR) waiters sleep
+    // by FUTEX_LOCK_PI, so the kernel boosts a (non-RT) owner to their priority and hands the lock over to them at
+    // unlock(). Other waiters sleep on a plain futex that unlock() wakes, and compete for the lock again; handing
+    // the lock over to them would make a convoy of context switches under contention. Uncontended lock() and
+    // unlock() are one CAS each. Elsewhere it falls back to polling with 1 microsecond sleeps, like NanoSleepLock.
+    //
+    // The spin limit follows the spins that recent contended acquisitions took (as glibc adaptive mutexes do).
+    // It does not spin on single-core devices.
+    // It satisfies Lockable, so it works with std::lock_guard and std::unique_lock (including std::try_to_lock).
+    // It is not recursive.
+    class AdaptiveMutex {
+        std::atomic<uint32_t> word{0};
+        std::atomic<int32_t> spin_estimate{0};
+        // the futex that non-realtime waiters sleep on. unlock() increments it if there are such waiters.
+        std::atomic<uint32_t> wake_sequence{0};
+        std::atomic<int32_t> num_sleepers{0};
+
+        std::atomic<int64_t> acquisitions{0};
+        std::atomic<int64_t> contentions{0};
+        std::atomic<int64_t> spin_acquisitions{0};
+        std::atomic<int64_t> sleeps{0};
+        std::atomic<int64_t> failed_try_locks{0};
+        std::atomic<int64_t> total_wait_nanoseconds{0};
+        std::atomic<int64_t> max_wait_nanoseconds{0};
+
+#if defined(__linux__)
+        // the kernel sets FUTEX_WAITERS (and FUTEX_OWNER_DIED) besides the owner TID.
+        static constexpr uint32_t owner_mask = FUTEX_TID_MASK;
+#else
+        static constexpr uint32_t owner_mask = UINT32_MAX;
+#endif
+
+        static uint32_t currentThreadId() noexcept {
+#if defined(__linux__)
+            static thread_local uint32_t tid = (uint32_t) syscall(SYS_gettid);
+#else
+            static std::atomic<uint32_t> last_id{0};
+            static thread_local uint32_t tid = ++last_id;
+#endif
+            return tid;
+        }
+
+        static int64_t monotonicNanoseconds() noexcept {
+            struct timespec ts{};
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        }
+
+        static inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            asm volatile("yield" ::: "memory");
+#endif
+        }
+
+        bool tryAcquire(uint32_t tid) noexcept {
+            uint32_t expected = 0;
+            return word.compare_exchange_strong(expected, tid, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        static bool isMultiCore() noexcept {
+#if defined(__linux__)
+            static const bool multiCore = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+            return multiCore;
+#else
+            return true;
+#endif
+        }
+
+        void sleepUntilAcquired(uint32_t tid) noexcept {
+#if defined(__linux__)
+            auto policy = sched_getscheduler(0);
+            if (policy == SCHED_FIFO || policy == SCHED_RR) {
+                while (syscall(SYS_futex, &word, FUTEX_LOCK_PI_PRIVATE, 0, nullptr, nullptr, 0) != 0) {
+                    if (errno == EINTR)
+                        continue;
+                    // PI futexes are unavailable (e.g. filtered out).
+                    break;
+                }
+                if ((word.load(std::memory_order_relaxed) & FUTEX_TID_MASK) == tid)
+                    return;
+            }
+            while (true) {
+                auto sequence = wake_sequence.load();
+                num_sleepers.fetch_add(1);
+                // either this sees the unlocked word, or unlock() sees num_sleepers and changes wake_sequence.
+                bool acquired = tryAcquire(tid);
+                if (!acquired)
+                    syscall(SYS_futex, &wake_sequence, FUTEX_WAIT_PRIVATE, sequence, nullptr, nullptr, 0);
+                num_sleepers.fetch_sub(1);
+                if (acquired || tryAcquire(tid))
+                    return;
+            }
+#else
+            const auto delay = timespec{0, 1000}; // 1 microsecond
+            while (!tryAcquire(tid))
+                clock_nanosleep(CLOCK_MONOTONIC, 0, &delay, nullptr);
+#endif
+        }
+
+        void recordWait(int64_t begin) noexcept {
+            auto elapsed = monotonicNanoseconds() - begin;
+            total_wait_nanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+            auto max = max_wait_nanoseconds.load(std::memory_order_relaxed);
+            while (elapsed > max && !max_wait_nanoseconds.compare_exchange_weak(max, elapsed, std::memory_order_relaxed))
+                ;
+        }
+
+        void lockContended(uint32_t tid) noexcept {
+            contentions.fetch_add(1, std::memory_order_relaxed);
+            auto begin = monotonicNanoseconds();
+            auto estimate = spin_estimate.load(std::memory_order_relaxed);
+            int32_t limit = isMultiCore() ? std::min(AAP_ADAPTIVE_MUTEX_MAX_SPINS, estimate * 2 + 10) : 0;
+            int32_t spins = 0;
+            bool acquired = false;
+            while (spins < limit) {
+                spins++;
+                cpuRelax();
+                if (word.load(std::memory_order_relaxed) == 0 && tryAcquire(tid)) {
+                    acquired = true;
+                    break;
+                }
+            }
+            if (limit > 0)
+                spin_estimate.store(estimate + (spins - estimate) / 8, std::memory_order_relaxed);
+            if (acquired)
+                spin_acquisitions.fetch_add(1, std::memory_order_relaxed);
+            else {
+                sleeps.fetch_add(1, std::memory_order_relaxed);
+                sleepUntilAcquired(tid);
+            }
+            recordWait(begin);
+        }
+
+    public:
+        void lock() noexcept {
+            acquisitions.fetch_add(1, std::memory_order_relaxed);
+            auto tid = currentThreadId();
+            if (!tryAcquire(tid))
+                lockContended(tid);
+        }
+
+        void unlock() noexcept {
+            uint32_t expected = currentThreadId();
+            // unlocking a mutex that this thread does not own is undefined (and would corrupt the PI state).
+            assert((word.load(std::memory_order_relaxed) & owner_mask) == expected);
+#if defined(__linux__)
+            if (word.compare_exchange_strong(expected, 0)) {
+                if (num_sleepers.load() > 0) {
+                    wake_sequence.fetch_add(1);
+                    syscall(SYS_futex, &wake_sequence, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+                }
+                return;
+            }
+            // FUTEX_WAITERS is set; the kernel hands the lock over to the top realtime waiter.
+            // It fails only with EPERM (not the owner), which the assertion above catches.
+            auto result = syscall(SYS_futex, &word, FUTEX_UNLOCK_PI_PRIVATE, 0, nullptr, nullptr, 0);
+            assert(result == 0);
+            (void) result;
+#else
+            word.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed);
+#endif
+        }
+
+        bool try_lock() noexcept {
+            if (tryAcquire(currentThreadId())) {
+                acquisitions.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            failed_try_locks.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        AdaptiveMutexStatistics getStatistics() const noexcept {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            return {acquisitions.load(relaxed), contentions.load(relaxed), spin_acquisitions.load(relaxed),
+                    sleeps.load(relaxed), failed_try_locks.load(relaxed), total_wait_nanoseconds.load(relaxed),
+                    max_wait_nanoseconds.load(relaxed)};
+        }
+
+        void resetStatistics() noexcept {
+            for (auto counter : {&acquisitions, &contentions, &spin_acquisitions, &sleeps, &failed_try_locks,
+                                 &total_wait_nanoseconds, &max_wait_nanoseconds})
+                counter->store(0, std::memory_order_relaxed);
+        }
+    };
+
 }
 
 
-#endif//AAP_CORE_UNSTABLE_UTILITY_H
\ No newline at end of file
+#endif//AAP_CORE_UNSTABLE_UTILITY_H
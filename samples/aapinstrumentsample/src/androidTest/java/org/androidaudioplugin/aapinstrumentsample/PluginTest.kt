@@ -38,4 +38,10 @@ class PluginTest {
         for (i in 0 until 5)
             testing.testInstancingAndProcessing(pluginInfo)
     }
+
+    @Test
+    fun instancePool() {
+        val pluginInfo = AudioPluginServiceHelper.getLocalAudioPluginService(applicationContext).plugins.first()
+        testing.testInstancePool(pluginInfo)
+    }
 }